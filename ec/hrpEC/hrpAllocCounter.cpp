@@ -0,0 +1,88 @@
+// -*- C++ -*-
+/*!
+ * @file  hrpAllocCounter.cpp
+ * @brief counter of memory allocations
+ *
+ * This library replaces malloc() and its relatives to count allocations of
+ * each thread. It is loaded by LD_PRELOAD, e.g.
+ *
+ *   LD_PRELOAD=hrpAllocCounter.so rtcd -f rtc.conf
+ *
+ * and then hrpExecutionContext finds hrpAllocCount() and reports the number
+ * of allocations of each component through ExecutionProfileService.
+ */
+#include <stddef.h>
+#include <errno.h>
+
+extern "C"
+{
+    // allocators of glibc
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t nmemb, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *ptr);
+}
+
+namespace
+{
+    __thread unsigned long s_count __attribute__((tls_model("initial-exec"))) = 0;
+}
+
+extern "C"
+{
+    /**
+       \brief the number of memory allocations by the calling thread
+     */
+    unsigned long hrpAllocCount()
+    {
+        return s_count;
+    }
+
+    void *malloc(size_t size)
+    {
+        s_count++;
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t nmemb, size_t size)
+    {
+        s_count++;
+        return __libc_calloc(nmemb, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        s_count++;
+        return __libc_realloc(ptr, size);
+    }
+
+    void *memalign(size_t alignment, size_t size)
+    {
+        s_count++;
+        return __libc_memalign(alignment, size);
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        s_count++;
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **memptr, size_t alignment, size_t size)
+    {
+        if (alignment % sizeof(void *) || alignment & (alignment - 1)){
+            return EINVAL;
+        }
+        s_count++;
+        void *p = __libc_memalign(alignment, size);
+        if (!p) return ENOMEM;
+        *memptr = p;
+        return 0;
+    }
+
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
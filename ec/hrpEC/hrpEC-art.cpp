@@ -9,7 +9,9 @@ namespace RTC
 {
     hrpExecutionContext::hrpExecutionContext()
         : PeriodicExecutionContext(), 
-          m_priority(ART_PRIO_MAX-1)
+          m_priority(ART_PRIO_MAX-1),
+          m_allocCount(NULL),
+          m_abortAllocAfter(0)
     {
         resetProfile();
         rtclog.setName("hrpEC");
@@ -19,6 +21,7 @@ namespace RTC
         getProperty(prop, "exec_cxt.periodic.priority", m_priority);
         getProperty(prop, "exec_cxt.periodic.art.priority", m_priority);
         RTC_DEBUG(("Priority: %d", m_priority));
+        getProperty(prop, "exec_cxt.periodic.abort_on_alloc_after", m_abortAllocAfter);
     }
 
     bool hrpExecutionContext::waitForNextPeriod()
@@ -1,5 +1,7 @@
 #include "hrpEC.h"
 #include "io/iob.h"
+#include <dlfcn.h>
+#include <cstdlib>
 #ifdef OPENRTM_VERSION_TRUNK
 #include <rtm/RTObjectStateMachine.h>
 #endif
@@ -36,6 +38,12 @@ namespace RTC
         set_signal_period(period_nsec/nsubstep);
         std::cout << "period = " << get_signal_period()*nsubstep/1e6
                   << "[ms], priority = " << m_priority << std::endl;
+        m_allocCount = (unsigned long (*)())dlsym(RTLD_DEFAULT, "hrpAllocCount");
+        if (m_allocCount){
+            std::cout << "memory allocations are counted" << std::endl;
+        }else if (m_abortAllocAfter > 0){
+            std::cerr << "abort_on_alloc_after is ignored since hrpAllocCounter is not preloaded" << std::endl;
+        }
 
         if (!enterRT()){
             unlock_iob();
@@ -63,29 +71,38 @@ namespace RTC
 #ifndef OPENRTM_VERSION_TRUNK
             invoke_worker iw;
             struct timeval tbegin, tend;
-	        std::vector<double> processes(m_comps.size());
-            gettimeofday(&tbegin, NULL);
-            for (unsigned int i=0; i< m_comps.size(); i++){
-                iw(m_comps[i]);
-                gettimeofday(&tend, NULL);
-                double dt = DELTA_SEC(tbegin, tend);
-                processes[i] = dt;
-                tbegin = tend;
-            }
+            unsigned int ncomp = m_comps.size();
 #else
             struct timeval tbegin, tend;
             const RTCList& list = getComponentList();
-            std::vector<double> processes(list.length());
+            unsigned int ncomp = list.length();
+#endif
+            // keep buffers to avoid allocation in every cycle
+            if (m_processes.size() != ncomp){
+                m_processes.resize(ncomp);
+                m_allocs.resize(ncomp);
+                m_activeCycles.assign(ncomp, 0);
+            }
+            std::vector<double>& processes = m_processes;
+            unsigned long nalloc = m_allocCount ? m_allocCount() : 0;
             gettimeofday(&tbegin, NULL);
-            for (unsigned int i=0; i< list.length(); i++){
+            for (unsigned int i=0; i< ncomp; i++){
+#ifndef OPENRTM_VERSION_TRUNK
+                iw(m_comps[i]);
+#else
                 RTC_impl::RTObjectStateMachine* rtobj = m_worker.findComponent(list[i]);
                 rtobj->workerDo(); 
+#endif
                 gettimeofday(&tend, NULL);
                 double dt = DELTA_SEC(tbegin, tend);
                 processes[i] = dt;
                 tbegin = tend;
+                if (m_allocCount){
+                    unsigned long n = m_allocCount();
+                    m_allocs[i] = n - nalloc;
+                    nalloc = n;
+                }
             }
-#endif
 
             gettimeofday(&tv, NULL);
             double dt = DELTA_SEC(m_tv, tv);
@@ -93,9 +110,7 @@ namespace RTC
 	    if (m_profile.profiles.length() != processes.size()){
 	        m_profile.profiles.length(processes.size());
 		for (unsigned int i=0; i<m_profile.profiles.length(); i++){
-		    m_profile.profiles[i].count = 0;
-		    m_profile.profiles[i].avg_process = 0;
-		    m_profile.profiles[i].max_process = 0;
+		    resetComponentProfile(m_profile.profiles[i]);
 		}
 	    }
 	    for (unsigned int i=0; i<m_profile.profiles.length(); i++){
@@ -109,23 +124,36 @@ namespace RTC
                     = m_profile.profiles[i];
                 double dt = processes[i];
                 if (lcs == ACTIVE_STATE){
+                    if (m_allocCount){
+                        prof.avg_alloc = (prof.avg_alloc*prof.count + m_allocs[i])/(prof.count+1);
+                    }
                     prof.avg_process = (prof.avg_process*prof.count + dt)/(++prof.count);
                 }
 	        if (prof.max_process < dt) prof.max_process = dt;
+                if (m_allocCount){
+                    if (prof.max_alloc < m_allocs[i]) prof.max_alloc = m_allocs[i];
+                    // onActivated() and onDeactivated() may allocate memory
+                    if (m_abortAllocAfter > 0 && lcs == ACTIVE_STATE
+                        && m_activeCycles[i] >= m_abortAllocAfter
+                        && m_allocs[i] > 0){
+                        updateRtcNames(processes.size());
+                        fprintf(stderr, "%s allocated memory %ld times in a cycle after %d cycles from its activation\n",
+                                rtc_names[i].c_str(), m_allocs[i], m_activeCycles[i]);
+                        abort();
+                    }
+                }
+                if (lcs == ACTIVE_STATE){
+                    if (m_activeCycles[i] < m_abortAllocAfter) m_activeCycles[i]++;
+                }else{
+                    m_activeCycles[i] = 0;
+                }
 	    }
             if (dt > period_sec*nsubstep){
   	        m_profile.timeover++; 
 #ifdef NDEBUG
                 fprintf(stderr, "[%d.%6.6d] Timeover: processing time = %4.2f[ms]\n",
                         tv.tv_sec, tv.tv_usec, dt*1e3);
-                // Update rtc_names only when rtcs length change.
-                if (processes.size() != rtc_names.size()){
-                    rtc_names.clear();
-                    for (unsigned int i=0; i< processes.size(); i++){
-                        RTC::RTObject_var rtc = RTC::RTObject::_narrow(m_comps[i]._ref);
-                        rtc_names.push_back(std::string(rtc->get_component_profile()->instance_name));
-                    }
-                }
+                updateRtcNames(processes.size());
                 for (unsigned int i=0; i< processes.size(); i++){
                     fprintf(stderr, "%s(%4.2f), ", rtc_names[i].c_str(),processes[i]*1e3);
                 }
@@ -176,10 +204,36 @@ namespace RTC
         m_profile.min_period = 1.0; // enough long 
         m_profile.max_process = 0.0;
 	for( unsigned int i = 0 ; i < m_profile.profiles.length() ; i++ ){
-            m_profile.profiles[i].count       = 0;
-	    m_profile.profiles[i].avg_process = 0;
-	    m_profile.profiles[i].max_process = 0;
+            resetComponentProfile(m_profile.profiles[i]);
         }
         m_profile.count = m_profile.timeover = 0;
     }
+
+    void hrpExecutionContext::resetComponentProfile(OpenHRP::ExecutionProfileService::ComponentProfile& prof)
+    {
+        prof.count       = 0;
+        prof.avg_process = 0;
+        prof.max_process = 0;
+        // -1 means that allocations are not counted
+        prof.avg_alloc   = m_allocCount ? 0 : -1;
+        prof.max_alloc   = m_allocCount ? 0 : -1;
+    }
+
+    void hrpExecutionContext::updateRtcNames(unsigned int n)
+    {
+        // Update rtc_names only when rtcs length change.
+        if (n == rtc_names.size()) return;
+        rtc_names.clear();
+#ifdef OPENRTM_VERSION_TRUNK
+        const RTCList& list = getComponentList();
+#endif
+        for (unsigned int i=0; i< n; i++){
+#ifndef OPENRTM_VERSION_TRUNK
+            RTC::RTObject_var rtc = RTC::RTObject::_narrow(m_comps[i]._ref);
+#else
+            RTC::RTObject_var rtc = RTC::RTObject::_narrow(list[i]);
+#endif
+            rtc_names.push_back(std::string(rtc->get_component_profile()->instance_name));
+        }
+    }
 };
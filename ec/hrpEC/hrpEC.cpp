@@ -33,7 +33,9 @@ namespace RTC
 #else
         : RTC_exp::PeriodicExecutionContext(),
 #endif 
-          m_priority(49)
+          m_priority(49),
+          m_allocCount(NULL),
+          m_abortAllocAfter(0)
     {
         resetProfile();
         rtclog.setName("hrpEC");
@@ -43,6 +45,7 @@ namespace RTC
         getProperty(prop, "exec_cxt.periodic.priority", m_priority);
         getProperty(prop, "exec_cxt.periodic.rtpreempt.priority", m_priority);
         RTC_DEBUG(("Priority: %d", m_priority));
+        getProperty(prop, "exec_cxt.periodic.abort_on_alloc_after", m_abortAllocAfter);
     }
 
     bool hrpExecutionContext::waitForNextPeriod()
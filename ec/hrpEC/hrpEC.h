@@ -52,10 +52,20 @@ namespace RTC
           }
       }
     }
+    void resetComponentProfile(OpenHRP::ExecutionProfileService::ComponentProfile& prof);
+    void updateRtcNames(unsigned int n);
     OpenHRP::ExecutionProfileService::Profile m_profile;
     struct timeval m_tv;
     int m_priority;
     std::vector<std::string> rtc_names;
+    std::vector<double> m_processes;
+    // hrpAllocCount() of hrpAllocCounter.so, NULL if it isn't preloaded
+    unsigned long (*m_allocCount)();
+    // the number of cycles after activation of a component after which
+    // memory allocation in the component is not allowed, 0 to allow always
+    int m_abortAllocAfter;
+    std::vector<long> m_allocs;
+    std::vector<int> m_activeCycles;
   };
 };
 
@@ -0,0 +1,22 @@
+#ifndef __CONFIG_UPDATE_FLAG_H__
+#define __CONFIG_UPDATE_FLAG_H__
+
+#include <rtm/ConfigurationListener.h>
+
+/**
+   \brief set a flag when configuration variables are updated
+
+   Configuration sets are applied in the thread of the execution context,
+   so the flag can be checked and cleared in onExecute() without locking.
+   Register it by addConfigurationSetNameListener(ON_UPDATE_CONFIG_SET, ...).
+ */
+class ConfigUpdateFlag : public RTC::ConfigurationSetNameListener
+{
+public:
+    ConfigUpdateFlag(bool& o_flag) : m_flag(o_flag) {}
+    virtual void operator()(const char *config_set_name) { m_flag = true; }
+private:
+    bool& m_flag;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include <cmath>
+#include <cstring>
+#include <boost/bind.hpp>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#include "DepthUnprojector.h"
+
+DepthUnprojector::DepthUnprojector() :
+    m_width(0), m_height(0),
+    m_fovy(0), m_near(0), m_far(0), m_fovx(0),
+    m_nearFar(0), m_farMinusNear(0),
+    m_input(NULL), m_output(NULL), m_step(1), m_rgb(NULL), m_stage(COUNT),
+    m_nthreads(1)
+{
+}
+
+void DepthUnprojector::run(int i_part)
+{
+    switch(m_stage){
+    case COUNT:
+        m_offset[i_part+1] = countRows(m_input, m_step, m_rowBegin[i_part],
+                                       m_rowBegin[i_part+1]);
+        break;
+    case UNPROJECT:
+        unprojectRows(m_input, m_output + (size_t)m_offset[i_part]*4, m_step,
+                      m_rgb, m_rowBegin[i_part], m_rowBegin[i_part+1]);
+        break;
+    }
+}
+
+void DepthUnprojector::dispatch(Stage i_stage)
+{
+    m_stage = i_stage;
+    m_pool.run(boost::bind(&DepthUnprojector::run, this, _1));
+}
+
+bool DepthUnprojector::setup(int i_width, int i_height,
+                             double i_fovy, double i_near, double i_far)
+{
+    if (i_width == m_width && i_height == m_height && i_fovy == m_fovy
+        && i_near == m_near && i_far == m_far) return false;
+
+    m_width = i_width; m_height = i_height;
+    m_fovy = i_fovy; m_near = i_near; m_far = i_far;
+    m_nearFar = m_far*m_near;
+    m_farMinusNear = m_far - m_near;
+
+    int w = m_width, h = m_height;
+    m_fovx = 2*atan(w*tan(m_fovy/2)/h);
+    double zs = w/(2*tan(m_fovx/2));
+    m_xcoef.resize(w);
+    m_theta.resize(w);
+    m_invCos.resize(w);
+    for (int j=0; j<w; j++){
+        m_xcoef[j] = -(j-w/2)/zs;
+        m_theta[j] = -atan((j-w/2)*2*tan(m_fovx/2)/w);
+        m_invCos[j] = 1.0/cos(m_theta[j]);
+    }
+    m_ycoef.resize(h);
+    for (int i=0; i<h; i++){
+        m_ycoef[i] = -(i-h/2)/zs;
+    }
+    m_depth.resize(w*h);
+    return true;
+}
+
+unsigned int DepthUnprojector::countRows(const float *i_depth, int i_step,
+                                         int i_rowBegin, int i_rowEnd) const
+{
+    unsigned int n = 0;
+    for (int i=i_rowBegin; i<i_rowEnd; i+=i_step){
+        const float *d = i_depth + i*m_width;
+        for (int j=0; j<m_width; j+=i_step){
+            if (d[j] != 1.0f) n++;
+        }
+    }
+    return n;
+}
+
+unsigned int DepthUnprojector::unprojectRows(const float *i_depth,
+                                             float *o_points,
+                                             int i_step,
+                                             const unsigned char *i_rgb,
+                                             int i_rowBegin, int i_rowEnd) const
+{
+    const int w = m_width, h = m_height;
+    const float nf = m_nearFar, fmn = m_farMinusNear, f = m_far;
+    const float *xcoef = &m_xcoef[0];
+    float *ptr = o_points;
+    for (int i=i_rowBegin; i<i_rowEnd; i+=i_step){
+        const float *depth = i_depth + i*w;
+        const float ycoef = m_ycoef[i];
+        const unsigned char *rgb = i_rgb ? i_rgb + (h-1-i)*w*3 : NULL;
+        int j=0;
+#ifdef __SSE__
+        if (i_step == 1){
+            const __m128 vnf = _mm_set1_ps(nf);
+            const __m128 vfmn = _mm_set1_ps(fmn);
+            const __m128 vf = _mm_set1_ps(f);
+            const __m128 vy = _mm_set1_ps(ycoef);
+            const __m128 vone = _mm_set1_ps(1.0f);
+            for (; j+4<=w; j+=4){
+                __m128 d = _mm_loadu_ps(depth + j);
+                int valid = _mm_movemask_ps(_mm_cmpneq_ps(d, vone));
+                if (!valid) continue;
+                __m128 z = _mm_div_ps(vnf, _mm_sub_ps(_mm_mul_ps(d, vfmn), vf));
+                __m128 x = _mm_mul_ps(_mm_loadu_ps(xcoef + j), z);
+                __m128 y = _mm_mul_ps(vy, z);
+                __m128 pad = _mm_setzero_ps();
+                _MM_TRANSPOSE4_PS(x, y, z, pad);
+                __m128 p[4] = {x, y, z, pad};
+                for (int k=0; k<4; k++){
+                    if (!(valid & (1<<k))) continue;
+                    _mm_storeu_ps(ptr, p[k]);
+                    if (rgb){
+                        memcpy(ptr + 3, rgb + (j+k)*3, 3);
+                    }
+                    ptr += 4;
+                }
+            }
+        }
+#endif
+        for (; j<w; j+=i_step){
+            float d = depth[j];
+            if (d == 1.0f) continue;
+            ptr[2] = nf/(d*fmn-f);
+            ptr[0] = xcoef[j]*ptr[2];
+            ptr[1] = ycoef*ptr[2];
+            ptr[3] = 0;
+            if (rgb){
+                memcpy(ptr + 3, rgb + j*3, 3);
+            }
+            ptr += 4;
+        }
+    }
+    return (ptr - o_points)/4;
+}
+
+unsigned int DepthUnprojector::unproject(const float *i_depth,
+                                         float *o_points,
+                                         int i_step,
+                                         const unsigned char *i_rgb,
+                                         int i_nthreads)
+{
+    if (i_step < 1) i_step = 1;
+    int nrows = (m_height + i_step - 1)/i_step;
+    if (i_nthreads > nrows) i_nthreads = nrows;
+    if (i_nthreads <= 1){
+        return unprojectRows(i_depth, o_points, i_step, i_rgb, 0, m_height);
+    }
+
+    m_pool.setNumThreads(i_nthreads);
+    m_nthreads = i_nthreads;
+
+    // split sampled rows into bands and compute where each band starts
+    // in the output buffer so that the bands can be written concurrently
+    m_rowBegin.resize(m_nthreads+1);
+    m_offset.resize(m_nthreads+1);
+    for (int k=0; k<m_nthreads; k++){
+        m_rowBegin[k] = (nrows*k/m_nthreads)*i_step;
+    }
+    m_rowBegin[m_nthreads] = m_height;
+    m_input = i_depth;
+    m_output = o_points;
+    m_step = i_step;
+    m_rgb = i_rgb;
+
+    dispatch(COUNT);
+    m_offset[0] = 0;
+    for (int k=0; k<m_nthreads; k++){
+        m_offset[k+1] += m_offset[k];
+    }
+    dispatch(UNPROJECT);
+    return m_offset[m_nthreads];
+}
@@ -0,0 +1,85 @@
+#ifndef __DEPTH_UNPROJECTOR_H__
+#define __DEPTH_UNPROJECTOR_H__
+
+#include <cstddef>
+#include <vector>
+#include "WorkerPool.h"
+
+/**
+   \brief converts an OpenGL depth buffer into range data and point clouds
+
+   Per-column and per-row ray coefficients are computed once in setup() and
+   reused until resolution, fov or near/far planes change. Threads used by
+   unproject() are kept until the number of threads changes.
+ */
+class DepthUnprojector
+{
+public:
+    DepthUnprojector();
+    /**
+       \brief (re)build unprojection tables if camera parameters changed
+       \return true if tables were rebuilt
+     */
+    bool setup(int i_width, int i_height,
+               double i_fovy, double i_near, double i_far);
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    double fovx() const { return m_fovx; }
+    /**
+       \brief buffer of width()*height() floats to store depth values read by glReadPixels
+     */
+    float *depthBuffer() { return &m_depth[0]; }
+    /**
+       \brief horizontal angle of the ray through column i_col
+     */
+    double columnAngle(int i_col) const { return m_theta[i_col]; }
+    /**
+       \brief distance along the ray through column i_col
+       \param i_col column index
+       \param i_depth depth value in [0,1]
+     */
+    double range(int i_col, float i_depth) const {
+        return -m_nearFar/(i_depth*m_farMinusNear - m_far)*m_invCos[i_col];
+    }
+    /**
+       \brief unproject depth buffer into 16 byte points(x,y,z,pad/rgb)
+       \param i_depth depth values(bottom row first as read by glReadPixels)
+       \param o_points output buffer which can store width()*height() points
+       \param i_step sampling step in pixels
+       \param i_rgb RGB image(top row first) to colorize points, or NULL
+       \param i_nthreads number of threads used for unprojection
+       \return the number of generated points
+     */
+    unsigned int unproject(const float *i_depth, float *o_points,
+                           int i_step=1, const unsigned char *i_rgb=NULL,
+                           int i_nthreads=1);
+private:
+    enum Stage { COUNT, UNPROJECT };
+    void run(int i_part);
+    void dispatch(Stage i_stage);
+    unsigned int countRows(const float *i_depth, int i_step,
+                           int i_rowBegin, int i_rowEnd) const;
+    unsigned int unprojectRows(const float *i_depth, float *o_points,
+                               int i_step, const unsigned char *i_rgb,
+                               int i_rowBegin, int i_rowEnd) const;
+    int m_width, m_height;
+    double m_fovy, m_near, m_far, m_fovx;
+    double m_nearFar, m_farMinusNear;
+    std::vector<float> m_xcoef, m_ycoef;
+    std::vector<double> m_theta, m_invCos;
+    std::vector<float> m_depth;
+    std::vector<int> m_rowBegin;        ///< first row of each band
+    std::vector<unsigned int> m_offset; ///< first point of each band
+
+    // arguments of the current call and the current stage
+    const float *m_input;
+    float *m_output;
+    int m_step;
+    const unsigned char *m_rgb;
+    Stage m_stage;
+
+    int m_nthreads;
+    WorkerPool m_pool;
+};
+
+#endif
@@ -189,42 +189,17 @@ void GLcamera::render(GLsceneBase *i_scene)
     if (m_sensor->imageType == VisionSensor::DEPTH
         || m_sensor->imageType == VisionSensor::COLOR_DEPTH
         || m_sensor->imageType == VisionSensor::MONO_DEPTH){
-        float depth[m_width*m_height];
+        m_unprojector.setup(m_width, m_height, m_sensor->fovy,
+                            m_sensor->near, m_sensor->far);
+        float *depth = m_unprojector.depthBuffer();
         glReadPixels(0,0,m_width, m_height, GL_DEPTH_COMPONENT, GL_FLOAT,
                      depth);
         // depth -> point cloud
-        int w = m_sensor->width;
-        int h = m_sensor->height;
-        m_sensor->depth.resize(w*h*16);// will be shrinked later
-        double far = m_sensor->far;
-        double near = m_sensor->near;
-        double fovx = 2*atan(w*tan(m_sensor->fovy/2)/h);
-        double zs = w/(2*tan(fovx/2));
-        unsigned int npoints=0;
-        float *ptr = (float *)&m_sensor->depth[0];
-        unsigned char *rgb = &m_sensor->image[0];
+        m_sensor->depth.resize(m_width*m_height*16);// will be shrinked later
         bool colored = m_sensor->imageType == VisionSensor::COLOR_DEPTH;
-        int step = 1;
-        for (int i=0; i<h; i+=step){
-            for (int j=0; j<w; j+=step){
-                float d = depth[i*w+j];
-                if (d == 1.0) {
-                    continue;
-                }
-                ptr[2] = far*near/(d*(far-near)-far);
-                ptr[0] = -(j-w/2)*ptr[2]/zs;
-                ptr[1] = -(i-h/2)*ptr[2]/zs;
-                if (colored){
-                    unsigned char *c = (unsigned char *)(ptr + 3);
-                    int offset = ((h-1-i)*w+j)*3;
-                    c[0] = rgb[offset];
-                    c[1] = rgb[offset+1];
-                    c[2] = rgb[offset+2];
-                }
-                ptr += 4;
-                npoints++;
-            }
-        }
+        unsigned int npoints = m_unprojector.unproject(
+            depth, (float *)&m_sensor->depth[0], 1,
+            colored ? &m_sensor->image[0] : NULL);
         m_sensor->depth.resize(npoints*16);
         
         m_sensor->isUpdated = true;
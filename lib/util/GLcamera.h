@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include "GLcoordinates.h"
+#include "DepthUnprojector.h"
 
 class GLsceneBase;
 class GLlink;
@@ -52,6 +53,7 @@ private:
     GLuint m_frameBuffer, m_renderBuffer, m_texture;
     hrp::VisionSensor *m_sensor;
     unsigned char *m_colorBuffer;
+    DepthUnprojector m_unprojector;
 };
 
 #endif
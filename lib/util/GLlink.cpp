@@ -24,7 +24,8 @@ void GLlink::useAbsTransformToDraw()
     m_useAbsTransformToDraw = true;
 }
 
-GLlink::GLlink() : m_showAxes(false), m_highlight(false)
+GLlink::GLlink() : m_coldetSource(NULL), m_coldetTriangles(0),
+                   m_showAxes(false), m_highlight(false)
 {
     Rs = hrp::Matrix33::Identity();
     R  = hrp::Matrix33::Identity();
@@ -60,8 +61,29 @@ size_t GLlink::draw(){
     }else{
         if (coldetModel && coldetModel->getNumTriangles()){
             ntri = coldetModel->getNumTriangles();
-            Eigen::Vector3f n, v[3];
-            int vindex[3];
+            // rebuild the mesh when the collision model has been replaced
+            if (!m_coldetMesh || m_coldetSource != coldetModel.get()
+                || m_coldetTriangles != (int)ntri){
+                m_coldetSource = coldetModel.get();
+                m_coldetTriangles = ntri;
+                m_coldetMesh = new GLmesh();
+                Eigen::Vector3f n, v[3];
+                int vindex[3];
+                for (int i=0; i<coldetModel->getNumTriangles(); i++){
+                    coldetModel->getTriangle(i, vindex[0], vindex[1], vindex[2]);
+                    for (int j=0; j<3; j++){
+                        coldetModel->getVertex(vindex[j], v[j][0], v[j][1], v[j][2]);
+                        m_coldetMesh->vertices.push_back(v[j]);
+                    }
+                    m_coldetMesh->triangles.push_back(
+                        Eigen::Vector3i(i*3, i*3+1, i*3+2));
+                    n = (v[1]-v[0]).cross(v[2]-v[0]);
+                    n.normalize();
+                    m_coldetMesh->normals.push_back(n);
+                }
+                m_coldetMesh->normalPerVertex = false;
+                m_coldetMesh->solid = true;
+            }
             if (m_highlight){
                 float red[] = {1,0,0,1};
                 glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, red);
@@ -69,20 +91,7 @@ size_t GLlink::draw(){
                 float gray[] = {0.8,0.8,0.8,1};
                 glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, gray);
             }
-            glBegin(GL_TRIANGLES);
-            for (int i=0; i<coldetModel->getNumTriangles(); i++){
-                coldetModel->getTriangle(i, vindex[0], vindex[1], vindex[2]);
-                for (int j=0; j<3; j++){
-                    coldetModel->getVertex(vindex[j], v[j][0], v[j][1], v[j][2]);
-                }
-                n = (v[1]-v[0]).cross(v[2]-v[0]);
-                n.normalize();
-                glNormal3fv(n.data());
-                for (int j=0; j<3; j++){
-                    glVertex3fv(v[j].data());
-                }
-            }
-            glEnd();
+            m_coldetMesh->draw(false, false);
         }
     }
     for (size_t i=0; i<sensors.size(); i++){
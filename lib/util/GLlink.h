@@ -10,6 +10,7 @@
 #endif
 #include <hrpModel/Link.h>
 #include "GLcoordinates.h"
+#include "GLmesh.h"
 
 class GLcamera;
 class GLshape;
@@ -45,6 +46,9 @@ protected:
     std::vector<GLcamera *> m_cameras;
     double m_T_j[16], m_absTrans[16];
     std::vector<GLshape *> m_shapes;
+    GLmeshPtr m_coldetMesh;
+    const hrp::ColdetModel *m_coldetSource; ///< model m_coldetMesh is built from
+    int m_coldetTriangles;
     bool m_showAxes, m_highlight;
 };
 
@@ -0,0 +1,390 @@
+#include <iostream>
+#include <sstream>
+#include <GL/glew.h>
+#ifdef __APPLE__
+#include <OpenGL/glu.h>
+#else
+#include <GL/glu.h>
+#endif
+#include "GLmesh.h"
+#include "GLtexture.h"
+// included after Eigen since X11 headers define Success
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#else
+#include <GL/glx.h>
+#endif
+
+// layout of the interleaved vertex array
+// position(3), normal or color(3), texture coordinate(2)
+#define VERTEX_SIZE 8
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+static void *currentContext()
+{
+#ifdef __APPLE__
+    return CGLGetCurrentContext();
+#else
+    return glXGetCurrentContext();
+#endif
+}
+
+// live meshes whose objects are released by GLmesh::releaseContext()
+static boost::mutex s_meshesMutex;
+static std::set<GLmesh *> s_meshes;
+
+GLmesh::GLmesh() :
+    normalPerVertex(false), solid(false), texture(NULL),
+    shininess(0.2), m_refCount(0), m_isBuilt(false), m_hasTexture(false),
+    m_isColored(false), m_nTriangleIndices(0), m_nLineIndices(0),
+    m_nPoints(0), m_version(1)
+{
+    for (int i=0; i<3; i++) scale[i] = 1.0;
+    for (int i=0; i<4; i++) diffuse[i] = specular[i] = 0;
+    boost::mutex::scoped_lock lock(s_meshesMutex);
+    s_meshes.insert(this);
+}
+
+GLmesh::~GLmesh()
+{
+    {
+        boost::mutex::scoped_lock lock(s_meshesMutex);
+        s_meshes.erase(this);
+    }
+    // objects in other contexts are released with the contexts
+    std::map<void *, GLbuffers>::iterator it = m_buffers.find(currentContext());
+    if (it != m_buffers.end()) release(it->second);
+    if (texture) delete texture;
+}
+
+void GLmesh::invalidate()
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    // objects in other contexts are released on their next draw
+    std::map<void *, GLbuffers>::iterator it = m_buffers.find(currentContext());
+    if (it != m_buffers.end()) release(it->second);
+    m_vertexData.clear();
+    m_triangleIndices.clear();
+    m_lineIndices.clear();
+    m_isBuilt = false;
+    m_version++;
+}
+
+void GLmesh::releaseContext()
+{
+    void *context = currentContext();
+    boost::mutex::scoped_lock lock(s_meshesMutex);
+    for (std::set<GLmesh *>::iterator it=s_meshes.begin();
+         it!=s_meshes.end(); it++){
+        GLmesh *mesh = *it;
+        boost::mutex::scoped_lock mlock(mesh->m_mutex);
+        std::map<void *, GLbuffers>::iterator b
+            = mesh->m_buffers.find(context);
+        if (b == mesh->m_buffers.end()) continue;
+        release(b->second);
+        mesh->m_buffers.erase(b);
+    }
+}
+
+void GLmesh::release(GLbuffers& io_buffers)
+{
+    if (io_buffers.vertexBuffer) glDeleteBuffers(1, &io_buffers.vertexBuffer);
+    if (io_buffers.triangleBuffer) glDeleteBuffers(1, &io_buffers.triangleBuffer);
+    if (io_buffers.lineBuffer) glDeleteBuffers(1, &io_buffers.lineBuffer);
+    if (io_buffers.textureId) glDeleteTextures(1, &io_buffers.textureId);
+    io_buffers.vertexBuffer = io_buffers.triangleBuffer = 0;
+    io_buffers.lineBuffer = io_buffers.textureId = 0;
+    io_buffers.version = 0;
+}
+
+GLmesh *GLmesh::clone() const
+{
+    GLmesh *mesh = new GLmesh();
+    mesh->vertices = vertices;
+    mesh->normals = normals;
+    mesh->colors = colors;
+    mesh->textureCoordinates = textureCoordinates;
+    mesh->triangles = triangles;
+    mesh->normalIndices = normalIndices;
+    mesh->textureCoordIndices = textureCoordIndices;
+    mesh->normalPerVertex = normalPerVertex;
+    mesh->solid = solid;
+    for (int i=0; i<3; i++) mesh->scale[i] = scale[i];
+    if (texture) mesh->texture = new GLtexture(*texture);
+    for (int i=0; i<4; i++){
+        mesh->diffuse[i] = diffuse[i];
+        mesh->specular[i] = specular[i];
+    }
+    mesh->shininess = shininess;
+    return mesh;
+}
+
+void GLmesh::build()
+{
+    m_vertexData.clear();
+    m_triangleIndices.clear();
+    m_lineIndices.clear();
+    m_nPoints = 0;
+
+    m_hasTexture = texture && textureCoordIndices.size() >= triangles.size()*3;
+    if (triangles.size()){
+        // vertices which share position, normal and texture coordinate
+        // are merged into one entry of the vertex array
+        std::map<Eigen::Vector3i, unsigned int, bool(*)(const Eigen::Vector3i&, const Eigen::Vector3i&)>
+            indexMap(&GLmesh::lessIndex);
+        for (size_t j=0; j<triangles.size(); j++){
+            int faceNormal = -1;
+            if (!normalPerVertex){
+                faceNormal = normalIndices.size() ? normalIndices[j] : j;
+            }
+            unsigned int idx[3];
+            for (int k=0; k<3; k++){
+                int vi = triangles[j][k];
+                int ni;
+                if (normalPerVertex){
+                    ni = normalIndices.size() ? normalIndices[j*3+k] : vi;
+                }else{
+                    ni = faceNormal;
+                }
+                if (ni >= (int)normals.size()) ni = -1;
+                int ti = m_hasTexture ? textureCoordIndices[j*3+k] : -1;
+                Eigen::Vector3i key(vi, ni, ti);
+                std::map<Eigen::Vector3i, unsigned int, bool(*)(const Eigen::Vector3i&, const Eigen::Vector3i&)>::iterator it = indexMap.find(key);
+                if (it != indexMap.end()){
+                    idx[k] = it->second;
+                    continue;
+                }
+                idx[k] = m_vertexData.size()/VERTEX_SIZE;
+                indexMap[key] = idx[k];
+                const Eigen::Vector3f &v = vertices[vi];
+                m_vertexData.push_back(v[0]);
+                m_vertexData.push_back(v[1]);
+                m_vertexData.push_back(v[2]);
+                if (ni >= 0){
+                    const Eigen::Vector3f &n = normals[ni];
+                    m_vertexData.push_back(scale[0]*n[0]);
+                    m_vertexData.push_back(scale[1]*n[1]);
+                    m_vertexData.push_back(scale[2]*n[2]);
+                }else{
+                    m_vertexData.push_back(0);
+                    m_vertexData.push_back(0);
+                    m_vertexData.push_back(1);
+                }
+                if (ti >= 0){
+                    m_vertexData.push_back(textureCoordinates[ti][0]);
+                    m_vertexData.push_back(-textureCoordinates[ti][1]);
+                }else{
+                    m_vertexData.push_back(0);
+                    m_vertexData.push_back(0);
+                }
+            }
+            for (int k=0; k<3; k++){
+                m_triangleIndices.push_back(idx[k]);
+                m_lineIndices.push_back(idx[k]);
+                m_lineIndices.push_back(idx[(k+1)%3]);
+            }
+        }
+    }else{
+        // point cloud, drawn in the current color if it has no color
+        m_isColored = colors.size() >= vertices.size();
+        for (size_t i=0; i<vertices.size(); i++){
+            const Eigen::Vector3f &v = vertices[i];
+            m_vertexData.push_back(v[0]);
+            m_vertexData.push_back(v[1]);
+            m_vertexData.push_back(v[2]);
+            for (int k=0; k<3; k++){
+                m_vertexData.push_back(m_isColored ? colors[i][k] : 0.0f);
+            }
+            m_vertexData.push_back(0);
+            m_vertexData.push_back(0);
+        }
+        m_nPoints = vertices.size();
+    }
+    m_nTriangleIndices = m_triangleIndices.size();
+    m_nLineIndices = m_lineIndices.size();
+
+    m_isBuilt = true;
+}
+
+GLmesh::GLbuffers& GLmesh::buffers()
+{
+    GLbuffers& b = m_buffers[currentContext()];
+    if (b.version != m_version){
+        release(b);
+        upload(b);
+        b.version = m_version;
+    }
+    return b;
+}
+
+void GLmesh::upload(GLbuffers& io_buffers)
+{
+    // arrays on the host side are kept for other contexts
+    if (glGenBuffers && m_vertexData.size()){
+        glGenBuffers(1, &io_buffers.vertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, io_buffers.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, m_vertexData.size()*sizeof(float),
+                     &m_vertexData[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (m_nTriangleIndices){
+            glGenBuffers(1, &io_buffers.triangleBuffer);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, io_buffers.triangleBuffer);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         m_nTriangleIndices*sizeof(unsigned int),
+                         &m_triangleIndices[0], GL_STATIC_DRAW);
+            glGenBuffers(1, &io_buffers.lineBuffer);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, io_buffers.lineBuffer);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         m_nLineIndices*sizeof(unsigned int),
+                         &m_lineIndices[0], GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        }
+    }
+    if (m_hasTexture) uploadTexture(io_buffers);
+}
+
+void GLmesh::uploadTexture(GLbuffers& io_buffers)
+{
+    if (!texture->image.size()) return;
+
+    glGenTextures(1, &io_buffers.textureId);
+    glBindTexture(GL_TEXTURE_2D, io_buffers.textureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                    texture->repeatS ? GL_REPEAT : GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                    texture->repeatT ? GL_REPEAT : GL_CLAMP);
+    int format = texture->numComponents == 4 ? GL_RGBA : GL_RGB;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    gluBuild2DMipmaps(GL_TEXTURE_2D, 3,
+                      texture->width, texture->height,
+                      format, GL_UNSIGNED_BYTE,
+                      &texture->image[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+size_t GLmesh::draw(bool i_wireFrame, bool i_useTexture)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (!m_isBuilt) build();
+    if (!m_nTriangleIndices && !m_nPoints) return 0;
+    const GLbuffers& b = buffers();
+
+    const float *base;
+    if (b.vertexBuffer){
+        glBindBuffer(GL_ARRAY_BUFFER, b.vertexBuffer);
+        base = NULL;
+    }else{
+        base = &m_vertexData[0];
+    }
+    GLsizei stride = VERTEX_SIZE*sizeof(float);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, base);
+
+    if (m_nTriangleIndices){
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, stride, base + 3);
+        bool drawTexture = !i_wireFrame && i_useTexture && b.textureId;
+        if (drawTexture){
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glTexCoordPointer(2, GL_FLOAT, stride, base + 6);
+            glBindTexture(GL_TEXTURE_2D, b.textureId);
+            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+            glEnable(GL_TEXTURE_2D);
+        }
+        GLenum mode = i_wireFrame ? GL_LINES : GL_TRIANGLES;
+        GLsizei count = i_wireFrame ? m_nLineIndices : m_nTriangleIndices;
+        if (b.vertexBuffer){
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                         i_wireFrame ? b.lineBuffer : b.triangleBuffer);
+            glDrawElements(mode, count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        }else{
+            glDrawElements(mode, count, GL_UNSIGNED_INT,
+                           i_wireFrame ? &m_lineIndices[0] : &m_triangleIndices[0]);
+        }
+        if (drawTexture){
+            glDisable(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        }
+        glDisableClientState(GL_NORMAL_ARRAY);
+    }else{
+        glPointSize(3);
+        glDisable(GL_LIGHTING);
+        if (m_isColored){
+            glEnableClientState(GL_COLOR_ARRAY);
+            glColorPointer(3, GL_FLOAT, stride, base + 3);
+        }
+        glDrawArrays(GL_POINTS, 0, m_nPoints);
+        if (m_isColored) glDisableClientState(GL_COLOR_ARRAY);
+        glEnable(GL_LIGHTING);
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (b.vertexBuffer) glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return triangles.size();
+}
+
+bool GLmesh::lessIndex(const Eigen::Vector3i& i_a, const Eigen::Vector3i& i_b)
+{
+    for (int i=0; i<3; i++){
+        if (i_a[i] != i_b[i]) return i_a[i] < i_b[i];
+    }
+    return false;
+}
+
+void intrusive_ptr_add_ref(GLmesh *i_mesh)
+{
+    boost::mutex::scoped_lock lock(GLmeshCache::instance().m_mutex);
+    i_mesh->m_refCount++;
+}
+
+void intrusive_ptr_release(GLmesh *i_mesh)
+{
+    GLmeshCache& cache = GLmeshCache::instance();
+    {
+        boost::mutex::scoped_lock lock(cache.m_mutex);
+        if (--i_mesh->m_refCount > 0) return;
+        if (!i_mesh->m_key.empty()) cache.m_meshes.erase(i_mesh->m_key);
+    }
+    delete i_mesh;
+}
+
+GLmeshCache& GLmeshCache::instance()
+{
+    static GLmeshCache cache;
+    return cache;
+}
+
+GLmeshPtr GLmeshCache::find(const std::string& i_key)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    std::map<std::string, GLmesh *>::iterator it = m_meshes.find(i_key);
+    if (it == m_meshes.end()) return GLmeshPtr();
+    // add a reference here since intrusive_ptr_add_ref() locks the mutex
+    it->second->m_refCount++;
+    return GLmeshPtr(it->second, false);
+}
+
+void GLmeshCache::add(const std::string& i_key, GLmesh *i_mesh)
+{
+    if (i_key.empty() || !i_mesh->m_key.empty()) return;
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (m_meshes.count(i_key)) return;
+    i_mesh->m_key = i_key;
+    m_meshes[i_key] = i_mesh;
+}
+
+std::string GLmeshCache::key(const std::string& i_url, int i_shapeIndex,
+                             const double i_scale[3])
+{
+    if (i_url.empty()) return std::string();
+    std::ostringstream oss;
+    oss << i_url << "#" << i_shapeIndex
+        << "#" << i_scale[0] << "," << i_scale[1] << "," << i_scale[2];
+    return oss.str();
+}
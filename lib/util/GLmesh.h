@@ -0,0 +1,121 @@
+#ifndef __GLMESH_H__
+#define __GLMESH_H__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+class GLtexture;
+
+/**
+   \brief triangle mesh which is shared among GLshapes and drawn with
+   indexed vertex buffer objects
+
+   Geometry is stored in the same layout as OpenHRP::ShapeInfo and
+   OpenHRP::AppearanceInfo. It is converted into an interleaved vertex array
+   on the first draw, which is shared by all GL contexts. Buffers and
+   textures are created in each context where the mesh is drawn and kept
+   until releaseContext() is called in the context.
+ */
+class GLmesh
+{
+public:
+    GLmesh();
+    ~GLmesh();
+    /**
+       \brief draw the mesh
+       \param i_wireFrame draw edges of triangles instead of faces
+       \param i_useTexture bind the texture if the mesh has one
+       \return the number of triangles
+     */
+    size_t draw(bool i_wireFrame, bool i_useTexture);
+    /**
+       \brief release buffers so that they are rebuilt from the geometry in
+       all contexts
+     */
+    void invalidate();
+    /**
+       \brief release objects of all meshes in the current context. The owner
+       of a context must call this before it destroys or recreates the
+       context, since another context may be created at the same address
+     */
+    static void releaseContext();
+    /**
+       \brief create a copy of geometry, material and texture
+     */
+    GLmesh *clone() const;
+    const std::string& key() const { return m_key; }
+    /**
+       \brief true if the mesh is in the cache or referred by several shapes
+     */
+    bool isShared() const { return !m_key.empty() || m_refCount > 1; }
+
+    std::vector<Eigen::Vector3f> vertices, normals, colors;
+    std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > textureCoordinates;
+    std::vector<Eigen::Vector3i> triangles;
+    std::vector<int> normalIndices, textureCoordIndices;
+    bool normalPerVertex, solid;
+    double scale[3];
+    GLtexture *texture;
+    // default material which is given to shapes which share this mesh
+    float diffuse[4], specular[4], shininess;
+private:
+    friend class GLmeshCache;
+    friend void intrusive_ptr_add_ref(GLmesh *);
+    friend void intrusive_ptr_release(GLmesh *);
+    // names of GL objects in a context
+    struct GLbuffers {
+        GLbuffers() : version(0), vertexBuffer(0), triangleBuffer(0),
+                      lineBuffer(0), textureId(0) {}
+        unsigned int version; ///< m_version when they were created
+        unsigned int vertexBuffer, triangleBuffer, lineBuffer, textureId;
+    };
+    void build();
+    GLbuffers& buffers();
+    void upload(GLbuffers& io_buffers);
+    void uploadTexture(GLbuffers& io_buffers);
+    static void release(GLbuffers& io_buffers);
+    static bool lessIndex(const Eigen::Vector3i& i_a, const Eigen::Vector3i& i_b);
+    int m_refCount;
+    std::string m_key;
+    bool m_isBuilt, m_hasTexture, m_isColored;
+    std::vector<float> m_vertexData;
+    std::vector<unsigned int> m_triangleIndices, m_lineIndices;
+    unsigned int m_nTriangleIndices, m_nLineIndices, m_nPoints;
+    unsigned int m_version; ///< incremented when the geometry is invalidated
+    std::map<void *, GLbuffers> m_buffers; ///< keyed by GL context
+    boost::mutex m_mutex; ///< meshes can be drawn by threads of contexts
+};
+
+void intrusive_ptr_add_ref(GLmesh *);
+void intrusive_ptr_release(GLmesh *);
+typedef boost::intrusive_ptr<GLmesh> GLmeshPtr;
+
+/**
+   \brief process-wide cache of meshes keyed by model URL and shape index
+
+   Only the geometry is shared among GL contexts, see GLmesh. A mesh is
+   removed from the cache when the last shape which refers it is
+   destroyed.
+ */
+class GLmeshCache
+{
+public:
+    static GLmeshCache& instance();
+    GLmeshPtr find(const std::string& i_key);
+    void add(const std::string& i_key, GLmesh *i_mesh);
+    static std::string key(const std::string& i_url, int i_shapeIndex,
+                           const double i_scale[3]);
+private:
+    friend void intrusive_ptr_add_ref(GLmesh *);
+    friend void intrusive_ptr_release(GLmesh *);
+    std::map<std::string, GLmesh *> m_meshes;
+    boost::mutex m_mutex;
+};
+
+#endif
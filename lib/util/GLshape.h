@@ -11,6 +11,7 @@
 #include <boost/intrusive_ptr.hpp>
 #include <hrpCorba/ModelLoader.hh>
 #include "GLcoordinates.h"
+#include "GLmesh.h"
 
 class GLtexture;
 
@@ -38,20 +39,20 @@ public:
     void divideLargeTriangles(double maxEdgeLen);
     void computeAABB(const hrp::Vector3& i_p, const hrp::Matrix33& i_R,
                      hrp::Vector3& o_min, hrp::Vector3& o_max);
+    /**
+       \brief share a mesh with other shapes
+       \param i_mesh mesh
+       \param i_useMaterial use the default material stored in the mesh
+     */
+    void setMesh(const GLmeshPtr& i_mesh, bool i_useMaterial=true);
+    GLmesh *mesh() { return m_mesh.get(); }
 protected:
-    int doCompile(bool isWireFrameMode);
+    GLmesh *editableMesh();
+    void computeScale(double o_scale[3]);
 
-    std::vector<Eigen::Vector3f> m_vertices, m_normals, m_colors;
-    std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > m_textureCoordinates;
-    std::vector<Eigen::Vector3i> m_triangles;
-    std::vector<int> m_normalIndices, m_textureCoordIndices;
+    GLmeshPtr m_mesh;
     float m_diffuse[4], m_specular[4], m_shininess;
-    bool m_normalPerVertex;
-    bool m_solid;
-    GLtexture *m_texture;
     bool m_requestCompile;
-    int m_shadingList, m_wireFrameList;
-    GLuint m_textureId;
     bool m_highlight;
 };
 
@@ -13,6 +13,7 @@
 #include "GLlink.h"
 #include "GLcamera.h"
 #include "GLtexture.h"
+#include "GLmesh.h"
 #include "GLutil.h"
 
 using namespace OpenHRP;
@@ -20,24 +21,42 @@ using namespace hrp;
 
 class shapeLoader{
 public:
-    void setShapeSetInfo(ShapeSetInfo_ptr i_ssinfo);
+    shapeLoader() : m_isFetched(false) {}
+    void setShapeSetInfo(ShapeSetInfo_ptr i_ssinfo, const std::string& i_url="");
     void loadShapeFromBodyInfo(GLbody *body, BodyInfo_var i_binfo, GLshape *(*shapeFactory)());
     void loadShapeFromLinkInfo(GLlink *link, const LinkInfo &i_li, GLshape *(*shapeFactory)());
     void loadShape(GLshape *shape, 
                    const OpenHRP::TransformedShapeIndex &i_tsi);
     void loadCamera(GLcamera *camera, const OpenHRP::SensorInfo &i_si); 
+    GLmesh *createMesh(int i_shapeIndex, const double i_scale[3]);
+    void fetch();
+    ShapeSetInfo_var ssinfo;
+    std::string url;
     ShapeInfoSequence_var sis;
     AppearanceInfoSequence_var ais;
     MaterialInfoSequence_var mis;
     TextureInfoSequence_var txs;
+private:
+    bool m_isFetched;
 };
 
-void shapeLoader::setShapeSetInfo(ShapeSetInfo_ptr i_ssinfo)
+void shapeLoader::setShapeSetInfo(ShapeSetInfo_ptr i_ssinfo,
+                                  const std::string& i_url)
 {
-    sis = i_ssinfo->shapes();
-    ais = i_ssinfo->appearances();
-    mis = i_ssinfo->materials(); 
-    txs = i_ssinfo->textures();
+    ssinfo = ShapeSetInfo::_duplicate(i_ssinfo);
+    url = i_url;
+    m_isFetched = false;
+}
+
+void shapeLoader::fetch()
+{
+    // shapes are transferred only when some of them are not cached yet
+    if (m_isFetched) return;
+    sis = ssinfo->shapes();
+    ais = ssinfo->appearances();
+    mis = ssinfo->materials(); 
+    txs = ssinfo->textures();
+    m_isFetched = true;
 }
 
 void shapeLoader::loadShapeFromBodyInfo(GLbody *body, BodyInfo_var i_binfo,
@@ -95,19 +114,60 @@ void shapeLoader::loadShape(GLshape *shape,
                             const OpenHRP::TransformedShapeIndex &i_tsi)
 {
     shape->setTransform(i_tsi.transformMatrix);
-    ShapeInfo& si = sis[i_tsi.shapeIndex];
-    shape->setVertices(si.vertices.length()/3, si.vertices.get_buffer());
-    shape->setTriangles(si.triangles.length()/3, 
-                        (int *)si.triangles.get_buffer());
+    double scale[3];
+    double *T = shape->getTransform();
+    for (int i=0; i<3; i++){
+        scale[i] = sqrt(T[i]*T[i] + T[i+4]*T[i+4] + T[i+8]*T[i+8]);
+    }
+    std::string key = GLmeshCache::key(url, i_tsi.shapeIndex, scale);
+    GLmeshPtr mesh = GLmeshCache::instance().find(key);
+    if (!mesh){
+        mesh = createMesh(i_tsi.shapeIndex, scale);
+        GLmeshCache::instance().add(key, mesh.get());
+    }
+    shape->setMesh(mesh);
+}
+
+GLmesh *shapeLoader::createMesh(int i_shapeIndex, const double i_scale[3])
+{
+    fetch();
+    GLmesh *mesh = new GLmesh();
+    for (int i=0; i<3; i++) mesh->scale[i] = i_scale[i];
+    ShapeInfo& si = sis[i_shapeIndex];
+    mesh->vertices.resize(si.vertices.length()/3);
+    for (size_t i=0; i<mesh->vertices.size(); i++){
+        mesh->vertices[i] = Eigen::Vector3f(si.vertices[i*3  ],
+                                            si.vertices[i*3+1],
+                                            si.vertices[i*3+2]);
+    }
+    mesh->triangles.resize(si.triangles.length()/3);
+    for (size_t i=0; i<mesh->triangles.size(); i++){
+        mesh->triangles[i] = Eigen::Vector3i(si.triangles[i*3  ],
+                                             si.triangles[i*3+1],
+                                             si.triangles[i*3+2]);
+    }
     const AppearanceInfo& ai = ais[si.appearanceIndex];
-    shape->setNormals(ai.normals.length()/3, ai.normals.get_buffer());
-    shape->setNormalIndices(ai.normalIndices.length(), 
-                            (int *)ai.normalIndices.get_buffer()); 
-    shape->setTextureCoordinates(ai.textureCoordinate.length()/2, 
-                                 ai.textureCoordinate.get_buffer());
-    shape->setTextureCoordIndices(ai.textureCoordIndices.length(),
-                                  (int *)ai.textureCoordIndices.get_buffer());
-    shape->setColors(ai.colors.length()/3, ai.colors.get_buffer());
+    mesh->normals.resize(ai.normals.length()/3);
+    for (size_t i=0; i<mesh->normals.size(); i++){
+        mesh->normals[i] = Eigen::Vector3f(ai.normals[i*3  ],
+                                           ai.normals[i*3+1],
+                                           ai.normals[i*3+2]);
+    }
+    mesh->normalIndices.assign(ai.normalIndices.get_buffer(),
+                               ai.normalIndices.get_buffer()+ai.normalIndices.length());
+    mesh->textureCoordinates.resize(ai.textureCoordinate.length()/2);
+    for (size_t i=0; i<mesh->textureCoordinates.size(); i++){
+        mesh->textureCoordinates[i] = Eigen::Vector2f(ai.textureCoordinate[i*2  ],
+                                                      ai.textureCoordinate[i*2+1]);
+    }
+    mesh->textureCoordIndices.assign(ai.textureCoordIndices.get_buffer(),
+                                     ai.textureCoordIndices.get_buffer()+ai.textureCoordIndices.length());
+    mesh->colors.resize(ai.colors.length()/3);
+    for (size_t i=0; i<mesh->colors.size(); i++){
+        mesh->colors[i] = Eigen::Vector3f(ai.colors[i*3  ],
+                                          ai.colors[i*3+1],
+                                          ai.colors[i*3+2]);
+    }
     if (ai.textureIndex >=0){
         if (txs->length() <= ai.textureIndex){
             std::cerr << "invalid texture index(" << ai.textureIndex << ")"
@@ -116,25 +176,31 @@ void shapeLoader::loadShape(GLshape *shape,
             TextureInfo &ti = txs[ai.textureIndex];
             GLtexture *texture = new GLtexture();
             if (loadTextureFromTextureInfo(texture, ti)){
-                shape->setTexture(texture);
+                mesh->texture = texture;
             }else{
                 delete texture;
             }
         }
     }
     if (ai.colors.length()){
-        shape->setDiffuseColor(ai.colors[0], ai.colors[1], ai.colors[2], 1.0);
+        mesh->diffuse[0] = ai.colors[0];
+        mesh->diffuse[1] = ai.colors[1];
+        mesh->diffuse[2] = ai.colors[2];
+        mesh->diffuse[3] = 1.0;
     }else if (ai.materialIndex >= 0){ 
         const MaterialInfo& mi = mis[ai.materialIndex];
-        shape->setDiffuseColor(mi.diffuseColor[0], mi.diffuseColor[1], mi.diffuseColor[2], 1.0-mi.transparency);
-        shape->setShininess(mi.shininess);
-        shape->setSpecularColor(mi.specularColor[0], mi.specularColor[1], mi.specularColor[2]);
+        for (int i=0; i<3; i++){
+            mesh->diffuse[i] = mi.diffuseColor[i];
+            mesh->specular[i] = mi.specularColor[i];
+        }
+        mesh->diffuse[3] = 1.0-mi.transparency;
+        mesh->shininess = mi.shininess;
     }else{
         //std::cout << "no material" << std::endl;
     }
-    shape->normalPerVertex(ai.normalPerVertex);
-    shape->solid(ai.solid);
-    shape->compile();
+    mesh->normalPerVertex = ai.normalPerVertex;
+    mesh->solid = ai.solid;
+    return mesh;
 }
 
 
@@ -182,7 +248,8 @@ void loadShapeFromBodyInfo(GLbody *body, BodyInfo_var i_binfo,
                            GLshape *(*shapeFactory)())
 {
     shapeLoader loader;
-    loader.setShapeSetInfo(i_binfo);
+    CORBA::String_var url = i_binfo->url();
+    loader.setShapeSetInfo(i_binfo, std::string(url));
     loader.loadShapeFromBodyInfo(body, i_binfo, shapeFactory);
 }
 
@@ -190,7 +257,8 @@ void loadShapeFromSceneInfo(GLlink *link, SceneInfo_var i_sinfo,
                             GLshape *(*shapeFactory)())
 {
     shapeLoader loader;
-    loader.setShapeSetInfo(i_sinfo);
+    CORBA::String_var url = i_sinfo->url();
+    loader.setShapeSetInfo(i_sinfo, std::string(url));
     TransformedShapeIndexSequence_var tsis = i_sinfo->shapeIndices();
     for (size_t i = 0; i<tsis->length(); i++){
         GLshape *shape = shapeFactory ? shapeFactory() : new GLshape();
@@ -0,0 +1,161 @@
+#include <iostream>
+#include <map>
+#include <hrpModel/Link.h>
+#include "KinematicsCache.h"
+
+typedef coil::Guard<coil::Mutex> Guard;
+
+namespace {
+    coil::Mutex registryMutex;
+    std::map<std::string, KinematicsCache *> registry;
+}
+
+KinematicsCache *KinematicsCache::attach(const std::string& i_key,
+                                         hrp::BodyPtr i_body)
+{
+    Guard guard(registryMutex);
+    std::map<std::string, KinematicsCache *>::iterator it
+        = registry.find(i_key);
+    if (it == registry.end()){
+        KinematicsCache *cache = new KinematicsCache(i_body);
+        registry[i_key] = cache;
+        return cache;
+    }
+    if (!it->second->compatible(i_body)){
+        std::cerr << "KinematicsCache: links of " << i_key
+                  << " don't match the shared model" << std::endl;
+        return NULL;
+    }
+    return it->second;
+}
+
+KinematicsCache::KinematicsCache(hrp::BodyPtr i_body) :
+    m_body(new hrp::Body(*i_body)), m_capacity(4), m_hits(0), m_misses(0)
+{
+}
+
+bool KinematicsCache::compatible(hrp::BodyPtr i_body) const
+{
+    if (i_body->numLinks() != m_body->numLinks()
+        || i_body->numJoints() != m_body->numJoints()) return false;
+    for (int i=0; i<m_body->numLinks(); i++){
+        const hrp::Link *a = i_body->link(i), *b = m_body->link(i);
+        if (a->name != b->name || a->jointId != b->jointId
+            || a->jointType != b->jointType
+            || a->a != b->a || a->d != b->d || a->b != b->b
+            || (a->parent ? a->parent->index : -1)
+            != (b->parent ? b->parent->index : -1)) return false;
+    }
+    return true;
+}
+
+bool KinematicsCache::match(const KinematicsSnapshot& i_snapshot,
+                            hrp::BodyPtr i_body)
+{
+    hrp::Link *root = i_body->rootLink();
+    if (root->p != i_snapshot.basePos || root->R != i_snapshot.baseR){
+        return false;
+    }
+    for (int i=0; i<i_body->numLinks(); i++){
+        if (i_body->link(i)->q != i_snapshot.q[i]) return false;
+    }
+    return true;
+}
+
+void KinematicsCache::solve(hrp::BodyPtr i_body, KinematicsSnapshot& o_snapshot)
+{
+    int n = m_body->numLinks();
+    o_snapshot.q.resize(n);
+    o_snapshot.links.resize(n);
+    for (int i=0; i<n; i++){
+        o_snapshot.q[i] = m_body->link(i)->q = i_body->link(i)->q;
+    }
+    hrp::Link *root = m_body->rootLink();
+    o_snapshot.basePos = root->p = i_body->rootLink()->p;
+    o_snapshot.baseR = root->R = i_body->rootLink()->R;
+
+    m_body->calcForwardKinematics();
+    o_snapshot.CoM = m_body->calcCM();
+    root->calcSubMassCM();
+
+    for (int i=0; i<n; i++){
+        hrp::Link *l = m_body->link(i);
+        KinematicsSnapshot::LinkState& s = o_snapshot.links[i];
+        s.p = l->p;
+        s.R = l->R;
+        s.wc = l->wc;
+        s.submwc = l->submwc;
+        s.subm = l->subm;
+    }
+}
+
+KinematicsSnapshotPtr KinematicsCache::calcForwardKinematics(hrp::BodyPtr io_body)
+{
+    KinematicsSnapshotPtr ret;
+    {
+        Guard guard(m_mutex);
+        for (int i=m_snapshots.size()-1; i>=0; i--){
+            if (match(*m_snapshots[i], io_body)){
+                SnapshotPtr s = m_snapshots[i];
+                m_snapshots.erase(m_snapshots.begin()+i);
+                m_snapshots.push_back(s);
+                m_hits++;
+                ret = s;
+                break;
+            }
+        }
+        if (!ret){
+            // reuse the oldest snapshot unless a component refers it
+            SnapshotPtr s;
+            if (m_snapshots.size() >= m_capacity){
+                if (m_snapshots.front().unique()) s = m_snapshots.front();
+                m_snapshots.erase(m_snapshots.begin());
+            }
+            if (!s) s = SnapshotPtr(new KinematicsSnapshot);
+            solve(io_body, *s);
+            m_snapshots.push_back(s);
+            m_misses++;
+            ret = s;
+        }
+    }
+    apply(*ret, io_body);
+    return ret;
+}
+
+KinematicsSnapshotPtr KinematicsCache::latest()
+{
+    Guard guard(m_mutex);
+    if (m_snapshots.empty()) return KinematicsSnapshotPtr();
+    return m_snapshots.back();
+}
+
+void KinematicsCache::apply(const KinematicsSnapshot& i_snapshot,
+                            hrp::BodyPtr io_body)
+{
+    for (int i=0; i<io_body->numLinks(); i++){
+        hrp::Link *l = io_body->link(i);
+        const KinematicsSnapshot::LinkState& s = i_snapshot.links[i];
+        l->p = s.p;
+        l->R = s.R;
+        l->wc = s.wc;
+        l->submwc = s.submwc;
+        l->subm = s.subm;
+    }
+}
+
+void KinematicsCache::setCapacity(unsigned int i_n)
+{
+    Guard guard(m_mutex);
+    m_capacity = i_n > 0 ? i_n : 1;
+    while (m_snapshots.size() > m_capacity){
+        m_snapshots.erase(m_snapshots.begin());
+    }
+}
+
+void KinematicsCache::getStatistics(unsigned long& o_hits,
+                                    unsigned long& o_misses)
+{
+    Guard guard(m_mutex);
+    o_hits = m_hits;
+    o_misses = m_misses;
+}
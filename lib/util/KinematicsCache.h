@@ -0,0 +1,95 @@
+#ifndef __KINEMATICS_CACHE_H__
+#define __KINEMATICS_CACHE_H__
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <coil/Mutex.h>
+#include <hrpModel/Body.h>
+
+/**
+   \brief result of forward kinematics. A snapshot is never modified while
+   it is referred by a component
+ */
+struct KinematicsSnapshot
+{
+    struct LinkState
+    {
+        hrp::Vector3 p;       ///< position
+        hrp::Matrix33 R;      ///< attitude
+        hrp::Vector3 wc;      ///< center of mass
+        hrp::Vector3 submwc;  ///< mass times center of mass of the subtree
+        double subm;          ///< mass of the subtree
+    };
+    hrp::dvector q;                 ///< joint angles in the order of links
+    hrp::Vector3 basePos;           ///< position of the root link
+    hrp::Matrix33 baseR;            ///< attitude of the root link
+    std::vector<LinkState> links;   ///< indexed in the order of Body::link()
+    hrp::Vector3 CoM;               ///< center of mass of the whole body
+};
+typedef boost::shared_ptr<const KinematicsSnapshot> KinematicsSnapshotPtr;
+
+/**
+   \brief forward kinematics shared among components in a process
+
+   Components which load the same model and compute forward kinematics of
+   the same posture(joint angles and the root pose) in a cycle, e.g.
+   posture measured by the robot, get the result computed by the first
+   one. A few recent snapshots are kept, so different postures can be
+   solved alternately without recomputation.
+
+   Components which modify the posture(inverse kinematics, balancers)
+   must keep solving their own bodies. ForwardKinematics doesn't use the
+   cache since it solves its poses on demand.
+ */
+class KinematicsCache
+{
+public:
+    /**
+       \brief get the cache shared by bodies of a model
+       \param i_key key of the model, usually its URL
+       \param i_body body of the caller, copied when the cache is created
+       \return NULL if links, joints or the tree of the body differ from
+       those of the cache
+     */
+    static KinematicsCache *attach(const std::string& i_key,
+                                   hrp::BodyPtr i_body);
+    /**
+       \brief solve forward kinematics, the center of mass and masses of
+       subtrees of the posture of a body, or find the snapshot of it
+       \param io_body body whose joint angles and root pose are given. Its
+       links are updated by the snapshot
+     */
+    KinematicsSnapshotPtr calcForwardKinematics(hrp::BodyPtr io_body);
+    /**
+       \brief get the latest snapshot
+       \return NULL if nothing is solved yet
+     */
+    KinematicsSnapshotPtr latest();
+    /**
+       \brief set link states of a snapshot to a body
+     */
+    static void apply(const KinematicsSnapshot& i_snapshot,
+                      hrp::BodyPtr io_body);
+    /**
+       \brief set the number of snapshots kept for reuse
+     */
+    void setCapacity(unsigned int i_n);
+    void getStatistics(unsigned long& o_hits, unsigned long& o_misses);
+private:
+    typedef boost::shared_ptr<KinematicsSnapshot> SnapshotPtr;
+
+    KinematicsCache(hrp::BodyPtr i_body);
+    bool compatible(hrp::BodyPtr i_body) const;
+    static bool match(const KinematicsSnapshot& i_snapshot,
+                      hrp::BodyPtr i_body);
+    void solve(hrp::BodyPtr i_body, KinematicsSnapshot& o_snapshot);
+
+    coil::Mutex m_mutex;
+    hrp::BodyPtr m_body;
+    std::vector<SnapshotPtr> m_snapshots; // the most recent one is last
+    unsigned int m_capacity;
+    unsigned long m_hits, m_misses;
+};
+
+#endif
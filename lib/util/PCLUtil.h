@@ -0,0 +1,138 @@
+// -*- C++ -*-
+/*!
+ * @file  PCLUtil.h
+ * @brief conversion between PointCloudTypes::PointCloud and pcl::PointCloud
+ */
+#ifndef __PCL_UTIL_H__
+#define __PCL_UTIL_H__
+
+#include <cstring>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include "pointcloud.hh"
+
+/**
+   \brief set fields of a 16 byte xyz(or xyzrgb) point cloud
+ */
+inline void setupPointCloudFields(PointCloudTypes::PointCloud& o_cloud,
+                                  bool i_colored=false)
+{
+    o_cloud.type = i_colored ? "xyzrgb" : "xyz";
+    o_cloud.fields.length(i_colored ? 6 : 3);
+    const char *names[] = {"x", "y", "z", "r", "g", "b"};
+    for (unsigned int i=0; i<o_cloud.fields.length(); i++){
+        o_cloud.fields[i].name = names[i];
+        if (i < 3){
+            o_cloud.fields[i].offset = i*4;
+            o_cloud.fields[i].data_type = PointCloudTypes::FLOAT32;
+            o_cloud.fields[i].count = 4;
+        }else{
+            o_cloud.fields[i].offset = 12+(i-3);
+            o_cloud.fields[i].data_type = PointCloudTypes::UINT8;
+            o_cloud.fields[i].count = 1;
+        }
+    }
+    o_cloud.is_bigendian = false;
+    o_cloud.point_step = 16;
+    o_cloud.is_dense = true;
+}
+
+/**
+   \brief check if the memory layout of points matches with pcl::PointXYZ,
+   i.e. 16 byte points which start with three float32 fields x, y and z
+ */
+inline bool isPCLCompatible(const PointCloudTypes::PointCloud& i_cloud)
+{
+    if (i_cloud.point_step != sizeof(pcl::PointXYZ)) return false;
+    if (i_cloud.fields.length() < 3) return false;
+    const char *names[] = {"x", "y", "z"};
+    for (int i=0; i<3; i++){
+        const PointCloudTypes::PointField& f = i_cloud.fields[i];
+        if (strcmp(f.name, names[i]) != 0
+            || f.offset != (CORBA::ULong)i*4
+            || f.data_type != PointCloudTypes::FLOAT32) return false;
+    }
+    return true;
+}
+
+/**
+   \brief copy points into a pcl::PointCloud which is reused across frames
+
+   When the layout matches, points are copied with one memcpy and the pad
+   word(or rgb) of each point is kept as it is. The capacity of o_cloud is
+   kept, so no allocation occurs unless the number of points grows.
+ */
+inline void toPCL(const PointCloudTypes::PointCloud& i_cloud,
+                  pcl::PointCloud<pcl::PointXYZ>& o_cloud)
+{
+    unsigned int npoint = i_cloud.point_step
+        ? i_cloud.data.length()/i_cloud.point_step : 0;
+    if (npoint > i_cloud.width*i_cloud.height){
+        npoint = i_cloud.width*i_cloud.height;
+    }
+    o_cloud.points.resize(npoint);
+    o_cloud.width = npoint;
+    o_cloud.height = 1;
+    o_cloud.is_dense = i_cloud.is_dense;
+    if (!npoint) return;
+    const unsigned char *src = i_cloud.data.get_buffer();
+    if (isPCLCompatible(i_cloud)){
+        memcpy(&o_cloud.points[0], src, npoint*sizeof(pcl::PointXYZ));
+    }else{
+        for (unsigned int i=0; i<npoint; i++){
+            const float *p = (const float *)src;
+            o_cloud.points[i].x = p[0];
+            o_cloud.points[i].y = p[1];
+            o_cloud.points[i].z = p[2];
+            src += i_cloud.point_step;
+        }
+    }
+}
+
+/**
+   \brief copy points into a PointCloudTypes::PointCloud whose fields are
+   set by setupPointCloudFields()
+
+   The sequence keeps its capacity, so no allocation occurs unless the
+   number of points grows.
+ */
+inline void fromPCL(const pcl::PointCloud<pcl::PointXYZ>& i_cloud,
+                    PointCloudTypes::PointCloud& o_cloud)
+{
+    unsigned int npoint = i_cloud.points.size();
+    o_cloud.width = npoint;
+    o_cloud.height = 1;
+    o_cloud.row_step = o_cloud.point_step*npoint;
+    // detach a buffer which was wrapped by wrapPCL()
+    if (!o_cloud.data.release()) o_cloud.data.replace(0, 0, NULL, false);
+    o_cloud.data.length(o_cloud.row_step);
+    if (npoint){
+        memcpy(o_cloud.data.get_buffer(), &i_cloud.points[0],
+               npoint*sizeof(pcl::PointXYZ));
+    }
+}
+
+/**
+   \brief let a PointCloudTypes::PointCloud refer points of a pcl::PointCloud
+   without copying
+
+   i_cloud must not be modified or destroyed until o_cloud is written to
+   an OutPort or detached by another call of fromPCL()/wrapPCL().
+ */
+inline void wrapPCL(pcl::PointCloud<pcl::PointXYZ>& i_cloud,
+                    PointCloudTypes::PointCloud& o_cloud)
+{
+    unsigned int npoint = i_cloud.points.size();
+    o_cloud.width = npoint;
+    o_cloud.height = 1;
+    o_cloud.row_step = o_cloud.point_step*npoint;
+    if (npoint){
+        CORBA::ULong len = npoint*sizeof(pcl::PointXYZ);
+        o_cloud.data.replace(len, len, (CORBA::Octet *)&i_cloud.points[0],
+                             false);
+    }else{
+        o_cloud.data.length(0);
+    }
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __RANGE_PROJECTOR_H__
+#define __RANGE_PROJECTOR_H__
+
+#include <cmath>
+#include <vector>
+#include <hrpUtil/Eigen3d.h>
+
+/**
+   \brief converts a scan of a range sensor into points
+
+   A beam at angle th with range d hits (-d*sin(th), 0, -d*cos(th)) in the
+   sensor frame. sin and cos of beam angles are computed once in setup() and
+   reused until the angles or the number of beams change.
+ */
+class RangeProjector
+{
+public:
+    RangeProjector() : m_minAngle(0), m_angularRes(0) {}
+    /**
+       \brief (re)build tables if the angles or the number of beams changed
+       \return true if tables were rebuilt
+     */
+    bool setup(double i_minAngle, double i_angularRes, unsigned int i_n){
+        if (i_minAngle == m_minAngle && i_angularRes == m_angularRes
+            && i_n == m_sin.size()) return false;
+        m_minAngle = i_minAngle;
+        m_angularRes = i_angularRes;
+        m_sin.resize(i_n);
+        m_cos.resize(i_n);
+        for (unsigned int i=0; i<i_n; i++){
+            double th = i_minAngle + i*i_angularRes;
+            m_sin[i] = sin(th);
+            m_cos[i] = cos(th);
+        }
+        return true;
+    }
+    unsigned int size() const { return m_sin.size(); }
+    /**
+       \brief project ranges and transform them by a sensor pose
+       \param i_ranges size() ranges. Beams with zero range are skipped
+       \param i_p position of the sensor
+       \param i_R orientation of the sensor
+       \param o_points output buffer which can store size() points
+       \param i_stride the number of floats per output point(>=3)
+       \return the number of generated points
+     */
+    unsigned int project(const double *i_ranges,
+                         const hrp::Vector3& i_p, const hrp::Matrix33& i_R,
+                         float *o_points, unsigned int i_stride=4) const {
+        // the y component of points in the sensor frame is zero, so only
+        // two columns of the orientation are used
+        const double ax = -i_R(0,0), ay = -i_R(1,0), az = -i_R(2,0);
+        const double bx = -i_R(0,2), by = -i_R(1,2), bz = -i_R(2,2);
+        const double px = i_p[0], py = i_p[1], pz = i_p[2];
+        const double *s = m_sin.empty() ? NULL : &m_sin[0];
+        const double *c = m_cos.empty() ? NULL : &m_cos[0];
+        float *ptr = o_points;
+        unsigned int n = m_sin.size(), npoint = 0;
+        for (unsigned int i=0; i<n; i++){
+            double d = i_ranges[i];
+            double ds = d*s[i], dc = d*c[i];
+            // the point is always written and kept only if d is not zero
+            ptr[0] = px + ax*ds + bx*dc;
+            ptr[1] = py + ay*ds + by*dc;
+            ptr[2] = pz + az*ds + bz*dc;
+            unsigned int hit = d != 0;
+            ptr += hit*i_stride;
+            npoint += hit;
+        }
+        return npoint;
+    }
+private:
+    double m_minAngle, m_angularRes;
+    std::vector<double> m_sin, m_cos;
+};
+
+#endif
@@ -12,6 +12,7 @@
 #include "util/GLsceneBase.h"
 #include "util/GLcamera.h"
 #include "util/GLlink.h"
+#include "util/GLmesh.h"
 #include "SDLUtil.h"
 
 
@@ -47,6 +48,7 @@ SDLwindow::SDLwindow(GLsceneBase* i_scene, LogManagerBase *i_log,
 SDLwindow::~SDLwindow()
 {
     if ( initialized ) {
+        GLmesh::releaseContext();
         SDL_Quit();
     }
 }
@@ -290,6 +292,8 @@ bool SDLwindow::processEvents()
         case SDL_VIDEORESIZE:
             width = event.resize.w;
             height = event.resize.h;
+            // the context may be recreated
+            GLmesh::releaseContext();
             SDL_SetVideoMode(width,height,32,SDL_HWSURFACE | SDL_GL_DOUBLEBUFFER | SDL_OPENGL | SDL_RESIZABLE);
             scene->setScreenSize(width, height);
             break;
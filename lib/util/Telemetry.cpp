@@ -0,0 +1,477 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "Telemetry.h"
+
+namespace {
+    enum { DATAGRAM_LAYOUT, DATAGRAM_RECORD };
+    // the table of fields is sent once in this number of records
+    const unsigned int LAYOUT_INTERVAL = 100;
+
+    struct DatagramHeader
+    {
+        char magic[8];
+        uint32_t kind;
+        uint32_t layoutId;
+        uint64_t index;
+        double time;
+    };
+
+    std::string shmName(const std::string& i_name)
+    {
+        return "/hrpsys_telemetry_" + i_name;
+    }
+
+    bool parseAddress(const std::string& i_address, sockaddr_in& o_addr)
+    {
+        std::string::size_type pos = i_address.find(':');
+        if (pos == std::string::npos) return false;
+        memset(&o_addr, 0, sizeof(o_addr));
+        o_addr.sin_family = AF_INET;
+        o_addr.sin_port = htons(atoi(i_address.substr(pos+1).c_str()));
+        return inet_aton(i_address.substr(0, pos).c_str(), &o_addr.sin_addr);
+    }
+
+    size_t align8(size_t i_size)
+    {
+        return (i_size + 7) & ~(size_t)7;
+    }
+
+    // interval to retry opening a stream [s]
+    const double MIN_BACKOFF = 1.0;
+    const double MAX_BACKOFF = 32.0;
+    // a subscriber which gets no record for this time checks if the shared
+    // memory has been replaced by a new publisher [s]
+    const double STALE_INTERVAL = 1.0;
+
+    double monotonicTime()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec*1e-9;
+    }
+}
+
+TelemetryPublisher::TelemetryPublisher() :
+    m_nslots(1), m_header(NULL), m_size(0), m_socket(-1),
+    m_retryTime(0), m_backoff(MIN_BACKOFF)
+{
+}
+
+TelemetryPublisher::~TelemetryPublisher()
+{
+    close();
+}
+
+int TelemetryPublisher::addField(const std::string& i_name,
+                                 TelemetryType i_type, unsigned int i_count)
+{
+    TelemetryField f;
+    memset(&f, 0, sizeof(f));
+    strncpy(f.name, i_name.c_str(), sizeof(f.name)-1);
+    f.type = i_type;
+    f.count = i_count;
+    f.offset = m_record.size();
+    m_fields.push_back(f);
+    // doubles are kept aligned
+    m_record.resize(align8(f.offset
+                           + i_count*(i_type == TELEMETRY_DOUBLE ? 8 : 4)));
+    return m_fields.size()-1;
+}
+
+bool TelemetryPublisher::configure(const std::string& i_name,
+                                   const std::string& i_multicast,
+                                   unsigned int i_nslots)
+{
+    close();
+    m_name = i_name;
+    m_multicast = i_multicast;
+    m_nslots = i_nslots ? i_nslots : 1;
+    m_backoff = MIN_BACKOFF;
+    m_retryTime = 0;
+    return ready();
+}
+
+bool TelemetryPublisher::ready()
+{
+    if (m_header) return true;
+    if (m_name.empty()) return false;
+    // failed to open the stream, retry after a while
+    double now = monotonicTime();
+    if (now < m_retryTime) return false;
+    if (open()){
+        m_backoff = MIN_BACKOFF;
+        return true;
+    }
+    std::cerr << "TelemetryPublisher: retry in " << m_backoff << "[s]"
+              << std::endl;
+    m_retryTime = now + m_backoff;
+    m_backoff = std::min(m_backoff*2, MAX_BACKOFF);
+    return false;
+}
+
+bool TelemetryPublisher::open()
+{
+    // readers of the previous stream keep their mappings valid
+    shm_unlink(shmName(m_name).c_str());
+    int fd = shm_open(shmName(m_name).c_str(), O_CREAT|O_RDWR, 0644);
+    if (fd < 0){
+        std::cerr << "TelemetryPublisher: failed to open " << shmName(m_name)
+                  << std::endl;
+        return false;
+    }
+    size_t slotSize = sizeof(TelemetrySlot) + m_record.size();
+    size_t headerSize = align8(sizeof(TelemetryHeader)
+                               + m_fields.size()*sizeof(TelemetryField));
+    m_size = headerSize + slotSize*m_nslots;
+    void *addr = MAP_FAILED;
+    if (ftruncate(fd, m_size) == 0){
+        addr = mmap(NULL, m_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED){
+        std::cerr << "TelemetryPublisher: failed to map " << shmName(m_name)
+                  << std::endl;
+        shm_unlink(shmName(m_name).c_str());
+        return false;
+    }
+    m_header = (TelemetryHeader *)addr;
+    // readers don't accept the stream until the magic is written
+    memset(m_header, 0, m_size);
+    m_header->nfields = m_fields.size();
+    m_header->recordSize = m_record.size();
+    m_header->slotSize = slotSize;
+    m_header->nslots = m_nslots;
+    m_header->layoutId = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16);
+    if (m_fields.size()){
+        memcpy(m_header+1, &m_fields[0], m_fields.size()*sizeof(TelemetryField));
+    }
+    __sync_synchronize();
+    memcpy(m_header->magic, TELEMETRY_MAGIC, sizeof(m_header->magic));
+
+    if (!m_multicast.empty() && !openMulticast(m_multicast)){
+        std::cerr << "TelemetryPublisher: failed to open multicast group "
+                  << m_multicast << std::endl;
+    }
+    return true;
+}
+
+bool TelemetryPublisher::openMulticast(const std::string& i_multicast)
+{
+    if (!parseAddress(i_multicast, m_address)) return false;
+    m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_socket < 0) return false;
+    unsigned char ttl = 1;
+    setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    // the real-time loop must not wait for the network
+    fcntl(m_socket, F_SETFL, fcntl(m_socket, F_GETFL) | O_NONBLOCK);
+    m_datagram.resize(sizeof(DatagramHeader)
+                      + std::max(m_record.size(),
+                                 8 + m_fields.size()*sizeof(TelemetryField)));
+    return true;
+}
+
+void TelemetryPublisher::close()
+{
+    if (m_header){
+        // tell readers that the stream is closed
+        memset(m_header->magic, 0, sizeof(m_header->magic));
+        munmap(m_header, m_size);
+        shm_unlink(shmName(m_name).c_str());
+        m_header = NULL;
+    }
+    if (m_socket >= 0){
+        ::close(m_socket);
+        m_socket = -1;
+    }
+    m_name = m_multicast = "";
+}
+
+double *TelemetryPublisher::doubles(int i_field)
+{
+    return (double *)&m_record[m_fields[i_field].offset];
+}
+
+int32_t *TelemetryPublisher::ints(int i_field)
+{
+    return (int32_t *)&m_record[m_fields[i_field].offset];
+}
+
+void TelemetryPublisher::sendLayout(uint64_t i_index)
+{
+    DatagramHeader *h = (DatagramHeader *)&m_datagram[0];
+    memcpy(h->magic, TELEMETRY_MAGIC, sizeof(h->magic));
+    h->kind = DATAGRAM_LAYOUT;
+    h->layoutId = m_header->layoutId;
+    h->index = i_index;
+    h->time = 0;
+    uint32_t *sizes = (uint32_t *)(h+1);
+    sizes[0] = m_fields.size();
+    sizes[1] = m_record.size();
+    size_t len = m_fields.size()*sizeof(TelemetryField);
+    if (len) memcpy(sizes+2, &m_fields[0], len);
+    sendto(m_socket, h, sizeof(DatagramHeader) + 8 + len, 0,
+           (sockaddr *)&m_address, sizeof(m_address));
+}
+
+void TelemetryPublisher::publish(double i_time)
+{
+    if (!m_header) return;
+    uint64_t index = m_header->count;
+    TelemetrySlot *slot = (TelemetrySlot *)((char *)m_header + m_size
+        - (size_t)m_header->slotSize*(m_header->nslots - index%m_header->nslots));
+    slot->seq++;
+    __sync_synchronize();
+    slot->index = index;
+    slot->time = i_time;
+    if (m_record.size()) memcpy(slot+1, &m_record[0], m_record.size());
+    __sync_synchronize();
+    slot->seq++;
+    __sync_synchronize();
+    m_header->count = index+1;
+
+    if (m_socket < 0) return;
+    if (index%LAYOUT_INTERVAL == 0) sendLayout(index);
+    DatagramHeader *h = (DatagramHeader *)&m_datagram[0];
+    memcpy(h->magic, TELEMETRY_MAGIC, sizeof(h->magic));
+    h->kind = DATAGRAM_RECORD;
+    h->layoutId = m_header->layoutId;
+    h->index = index;
+    h->time = i_time;
+    if (m_record.size()) memcpy(h+1, &m_record[0], m_record.size());
+    sendto(m_socket, h, sizeof(DatagramHeader) + m_record.size(), 0,
+           (sockaddr *)&m_address, sizeof(m_address));
+}
+
+TelemetrySubscriber::TelemetrySubscriber() :
+    m_header(NULL), m_size(0), m_socket(-1), m_layoutId(0), m_inode(0),
+    m_generation(0), m_next(0), m_lost(0), m_idleCount(0), m_idleSince(0),
+    m_time(0)
+{
+}
+
+TelemetrySubscriber::~TelemetrySubscriber()
+{
+    close();
+}
+
+bool TelemetrySubscriber::open(const std::string& i_source)
+{
+    close();
+    m_source = i_source;
+    sockaddr_in addr;
+    if (parseAddress(i_source, addr)){
+        m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (m_socket < 0) return false;
+        int reuse = 1;
+        setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        ip_mreq mreq;
+        mreq.imr_multiaddr = addr.sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(m_socket, (sockaddr *)&addr, sizeof(addr)) < 0
+            || setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                          &mreq, sizeof(mreq)) < 0){
+            close();
+            return false;
+        }
+        fcntl(m_socket, F_SETFL, fcntl(m_socket, F_GETFL) | O_NONBLOCK);
+        m_datagram.resize(65536);
+        return true;
+    }
+
+    int fd = shm_open(shmName(i_source).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    void *addr2 = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(TelemetryHeader)){
+        m_size = st.st_size;
+        m_inode = st.st_ino;
+        addr2 = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (addr2 == MAP_FAILED) return false;
+    m_header = (TelemetryHeader *)addr2;
+    if (memcmp(m_header->magic, TELEMETRY_MAGIC, sizeof(m_header->magic))
+        || m_size < sizeof(TelemetryHeader)
+        + m_header->nfields*sizeof(TelemetryField)
+        + (size_t)m_header->slotSize*m_header->nslots){
+        close();
+        return false;
+    }
+    m_layoutId = m_header->layoutId;
+    m_fields.resize(m_header->nfields);
+    if (m_fields.size()){
+        memcpy(&m_fields[0], m_header+1,
+               m_fields.size()*sizeof(TelemetryField));
+    }
+    m_record.resize(m_header->recordSize);
+    m_generation++;
+    m_next = m_idleCount = m_header->count;
+    m_idleSince = monotonicTime();
+    return true;
+}
+
+void TelemetrySubscriber::close()
+{
+    if (m_header){
+        munmap(m_header, m_size);
+        m_header = NULL;
+    }
+    if (m_socket >= 0){
+        ::close(m_socket);
+        m_socket = -1;
+    }
+    m_fields.clear();
+    m_layoutId = 0;
+    m_next = m_lost = 0;
+}
+
+bool TelemetrySubscriber::readSlot(uint64_t i_index)
+{
+    const TelemetrySlot *slot = (const TelemetrySlot *)((const char *)m_header
+        + m_size - (size_t)m_header->slotSize*m_header->nslots
+        + (size_t)m_header->slotSize*(i_index%m_header->nslots));
+    uint32_t seq = slot->seq;
+    if (seq & 1) return false;
+    __sync_synchronize();
+    double tm = slot->time;
+    uint64_t index = slot->index;
+    if (m_record.size()) memcpy(&m_record[0], slot+1, m_record.size());
+    __sync_synchronize();
+    if (slot->seq != seq || index != i_index) return false;
+    m_time = tm;
+    return true;
+}
+
+bool TelemetrySubscriber::receive()
+{
+    while (1){
+        ssize_t len = recv(m_socket, &m_datagram[0], m_datagram.size(), 0);
+        if (len < (ssize_t)sizeof(DatagramHeader)) return false;
+        const DatagramHeader *h = (const DatagramHeader *)&m_datagram[0];
+        if (memcmp(h->magic, TELEMETRY_MAGIC, sizeof(h->magic))) continue;
+        if (h->kind == DATAGRAM_LAYOUT){
+            const uint32_t *sizes = (const uint32_t *)(h+1);
+            if (h->layoutId == m_layoutId
+                || len < (ssize_t)(sizeof(DatagramHeader) + 8
+                                   + sizes[0]*sizeof(TelemetryField))) continue;
+            m_layoutId = h->layoutId;
+            m_fields.resize(sizes[0]);
+            m_record.resize(sizes[1]);
+            if (m_fields.size()){
+                memcpy(&m_fields[0], sizes+2,
+                       m_fields.size()*sizeof(TelemetryField));
+            }
+            m_generation++;
+            m_next = h->index;
+        }else if (h->kind == DATAGRAM_RECORD){
+            // records are ignored until the layout is received
+            if (h->layoutId != m_layoutId
+                || len != (ssize_t)(sizeof(DatagramHeader) + m_record.size())){
+                continue;
+            }
+            if (h->index < m_next) continue;
+            m_lost += h->index - m_next;
+            m_next = h->index + 1;
+            m_time = h->time;
+            if (m_record.size()) memcpy(&m_record[0], h+1, m_record.size());
+            return true;
+        }
+    }
+}
+
+bool TelemetrySubscriber::replaced()
+{
+    // a publisher which crashed didn't clear the magic, and its successor
+    // created a new shared memory with the same name
+    int fd = shm_open(shmName(m_source).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    TelemetryHeader h;
+    bool ret = fstat(fd, &st) == 0
+        && pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h)
+        && !memcmp(h.magic, TELEMETRY_MAGIC, sizeof(h.magic))
+        && ((uint64_t)st.st_ino != m_inode || h.layoutId != m_layoutId);
+    ::close(fd);
+    return ret;
+}
+
+bool TelemetrySubscriber::next()
+{
+    if (m_socket >= 0) return receive();
+    if (!m_header || memcmp(m_header->magic, TELEMETRY_MAGIC,
+                            sizeof(m_header->magic))){
+        // the publisher has been restarted
+        std::string source = m_source;
+        if (!open(source)) return false;
+        m_next = 0;
+    }
+    while (1){
+        uint64_t count = m_header->count;
+        if (m_next >= count){
+            if (count != m_idleCount){
+                m_idleCount = count;
+                m_idleSince = monotonicTime();
+                return false;
+            }
+            double now = monotonicTime();
+            if (now - m_idleSince < STALE_INTERVAL) return false;
+            m_idleSince = now;
+            if (!replaced()) return false;
+            std::string source = m_source;
+            if (!open(source)) return false;
+            m_next = 0;
+            continue;
+        }
+        if (count - m_next >= m_header->nslots){
+            // keep a slot of margin from the writer
+            uint64_t oldest = count - m_header->nslots + 1;
+            m_lost += oldest - m_next;
+            m_next = oldest;
+        }
+        if (readSlot(m_next)){
+            m_next++;
+            return true;
+        }
+        if (m_header->count == count) return false; // being written
+    }
+}
+
+bool TelemetrySubscriber::latest()
+{
+    if (m_header && m_header->count > m_next + 1){
+        m_lost += m_header->count - 1 - m_next;
+        m_next = m_header->count - 1;
+    }
+    bool ret = false;
+    while (next()) ret = true;
+    return ret;
+}
+
+int TelemetrySubscriber::findField(const std::string& i_name) const
+{
+    for (unsigned int i=0; i<m_fields.size(); i++){
+        if (i_name == m_fields[i].name) return i;
+    }
+    return -1;
+}
+
+const double *TelemetrySubscriber::doubles(int i_field) const
+{
+    return (const double *)&m_record[m_fields[i_field].offset];
+}
+
+const int32_t *TelemetrySubscriber::ints(int i_field) const
+{
+    return (const int32_t *)&m_record[m_fields[i_field].offset];
+}
@@ -0,0 +1,178 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <netinet/in.h>
+
+/**
+   \brief telemetry stream of states of a component
+
+   A publisher writes fixed size records into a ring of slots in POSIX
+   shared memory(/dev/shm/hrpsys_telemetry_<name>). The shared memory begins
+   with a header and a table of fields, so readers don't need to know the
+   layout in advance. Each slot is guarded by a sequence number which is
+   odd while the slot is written(seqlock). There is one writer and readers
+   never block it.
+
+   The same records can be mirrored to a UDP multicast group for readers on
+   other hosts. The table of fields is sent periodically in a separate
+   datagram.
+ */
+
+#define TELEMETRY_MAGIC "HRPTLM1"
+
+enum TelemetryType { TELEMETRY_DOUBLE, TELEMETRY_INT32 };
+
+struct TelemetryField
+{
+    char name[32];
+    uint32_t type;    ///< TelemetryType
+    uint32_t count;   ///< the number of elements
+    uint32_t offset;  ///< offset in a record [byte]
+    uint32_t reserved;
+};
+
+struct TelemetryHeader
+{
+    char magic[8];
+    uint32_t nfields;
+    uint32_t recordSize;  ///< size of a record [byte]
+    uint32_t slotSize;    ///< size of a slot including its header [byte]
+    uint32_t nslots;
+    uint32_t layoutId;    ///< changes when the publisher is restarted
+    uint32_t reserved;
+    volatile uint64_t count;  ///< the number of records written so far
+};
+
+struct TelemetrySlot
+{
+    volatile uint32_t seq;
+    uint32_t reserved;
+    volatile uint64_t index;  ///< index of the record in this slot
+    double time;              ///< [s]
+};
+
+class TelemetryPublisher
+{
+public:
+    TelemetryPublisher();
+    ~TelemetryPublisher();
+    /**
+       \brief add a field. Fields must be added before the first configure()
+       \return index of the field
+     */
+    int addField(const std::string& i_name, TelemetryType i_type,
+                 unsigned int i_count);
+    /**
+       \brief (re)open the stream. Call this only when the configuration is
+       changed
+       \param i_name name of the shared memory. The stream is closed when
+       this is empty
+       \param i_multicast "group:port" of the multicast mirror. The mirror
+       is disabled when this is empty
+       \param i_nslots the number of slots in the ring
+       \return true if the stream is open
+     */
+    bool configure(const std::string& i_name, const std::string& i_multicast,
+                   unsigned int i_nslots=256);
+    /**
+       \brief check if records can be published. A stream which failed to
+       open is reopened with exponential backoff
+       \return true if the stream is open
+     */
+    bool ready();
+    void close();
+    bool isOpen() const { return m_header != NULL; }
+    /**
+       \brief elements of a field in the record being built
+     */
+    double *doubles(int i_field);
+    int32_t *ints(int i_field);
+    /**
+       \brief write the record into the next slot and send it to the
+       multicast group
+     */
+    void publish(double i_time);
+private:
+    bool open();
+    bool openMulticast(const std::string& i_multicast);
+    void sendLayout(uint64_t i_index);
+
+    std::vector<TelemetryField> m_fields;
+    std::vector<char> m_record, m_datagram;
+    std::string m_name, m_multicast;
+    unsigned int m_nslots;
+    TelemetryHeader *m_header;
+    size_t m_size;
+    int m_socket;
+    sockaddr_in m_address;
+    double m_retryTime, m_backoff; ///< [s]
+};
+
+class TelemetrySubscriber
+{
+public:
+    TelemetrySubscriber();
+    ~TelemetrySubscriber();
+    /**
+       \brief open a stream
+       \param i_source name of the shared memory or "group:port" of a
+       multicast group
+     */
+    bool open(const std::string& i_source);
+    void close();
+    bool isOpen() const { return m_header != NULL || m_socket >= 0; }
+    /**
+       \brief read the next record. Records overwritten before they are read
+       are skipped. The stream is reopened when the publisher is restarted
+       \return false if there is no new record
+     */
+    bool next();
+    /**
+       \brief read the latest record, skipping older ones
+     */
+    bool latest();
+    /**
+       \brief time of the record read last [s]
+     */
+    double time() const { return m_time; }
+    /**
+       \brief find a field by name
+       \return index of the field, -1 if not found
+     */
+    int findField(const std::string& i_name) const;
+    unsigned int count(int i_field) const { return m_fields[i_field].count; }
+    const double *doubles(int i_field) const;
+    const int32_t *ints(int i_field) const;
+    /**
+       \brief changes whenever the field table is loaded, so indices found by
+       findField() can be kept until it changes
+     */
+    unsigned int generation() const { return m_generation; }
+    /**
+       \brief the number of records which were skipped
+     */
+    uint64_t lost() const { return m_lost; }
+private:
+    bool readSlot(uint64_t i_index);
+    bool receive();
+    bool replaced();
+
+    std::vector<TelemetryField> m_fields;
+    std::vector<char> m_record, m_datagram;
+    std::string m_source;
+    TelemetryHeader *m_header;
+    size_t m_size;
+    int m_socket;
+    uint32_t m_layoutId;
+    uint64_t m_inode;       ///< inode of the shared memory
+    unsigned int m_generation;
+    uint64_t m_next, m_lost;
+    uint64_t m_idleCount;   ///< count of records when the stream got idle
+    double m_idleSince;     ///< [s]
+    double m_time;
+};
+
+#endif
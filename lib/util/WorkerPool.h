@@ -0,0 +1,108 @@
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/barrier.hpp>
+
+/**
+   \brief persistent threads which run a job over parts in lockstep
+
+   A job is called once per part with the index of the part. Part 0 runs on
+   the calling thread and the others on threads which are started on the
+   first parallel run and kept until the number of threads changes, so no
+   thread is created in steady state. An exception thrown by a part doesn't
+   keep the other threads from the barrier and the first one is rethrown by
+   run() after all parts finished.
+ */
+class WorkerPool : private boost::noncopyable
+{
+public:
+    typedef boost::function<void (int)> Job;
+    WorkerPool() : m_nthreads(1), m_job(NULL), m_workers(NULL),
+                   m_barrier(NULL), m_quit(false) {}
+    ~WorkerPool() { stop(); }
+    /**
+       \brief set the number of threads including the calling thread
+     */
+    void setNumThreads(int i_nthreads){
+        if (i_nthreads < 1) i_nthreads = 1;
+        if (i_nthreads == m_nthreads) return;
+        stop();
+        m_nthreads = i_nthreads;
+    }
+    int numThreads() const { return m_nthreads; }
+    /**
+       \brief call i_job(i) for all parts i in [0, numThreads())
+       \param i_job job to run
+       \param i_parallel run all parts on the calling thread if false, which
+       is cheaper when there is too little work to wake threads up
+     */
+    void run(const Job& i_job, bool i_parallel=true){
+        if (m_nthreads <= 1 || !i_parallel){
+            for (int i=0; i<m_nthreads; i++) i_job(i);
+            return;
+        }
+        start();
+        m_job = &i_job;
+        m_barrier->wait();
+        call(0);
+        m_barrier->wait();
+        m_job = NULL;
+        if (m_error){
+            boost::exception_ptr error = m_error;
+            m_error = boost::exception_ptr();
+            boost::rethrow_exception(error);
+        }
+    }
+private:
+    void start(){
+        if (m_workers) return;
+        m_quit = false;
+        m_barrier = new boost::barrier(m_nthreads);
+        m_workers = new boost::thread_group();
+        for (int i=1; i<m_nthreads; i++){
+            m_workers->create_thread(boost::bind(&WorkerPool::worker, this, i));
+        }
+    }
+    void stop(){
+        if (!m_workers) return;
+        m_quit = true;
+        m_barrier->wait();
+        m_workers->join_all();
+        delete m_workers;
+        delete m_barrier;
+        m_workers = NULL;
+        m_barrier = NULL;
+    }
+    void worker(int i_part){
+        while (1){
+            m_barrier->wait();
+            if (m_quit) break;
+            call(i_part);
+            m_barrier->wait();
+        }
+    }
+    void call(int i_part){
+        try{
+            (*m_job)(i_part);
+        }catch(...){
+            boost::mutex::scoped_lock lock(m_errorMutex);
+            if (!m_error) m_error = boost::current_exception();
+        }
+    }
+
+    int m_nthreads;
+    const Job *m_job;
+    boost::thread_group *m_workers;
+    boost::barrier *m_barrier;
+    bool m_quit;
+    boost::mutex m_errorMutex;
+    boost::exception_ptr m_error;
+};
+
+#endif
@@ -1031,6 +1031,34 @@ class HrpsysConfigurator:
                 angles[i] = angles[i] / 180.0 * math.pi
         return self.seq_svc.setJointAnglesSequence(angless, tms)
 
+    def previewJointAnglesSequence(self, angless, tms, period=0.0):
+        '''!@brief
+        Evaluate joint angles sequence without moving the robot.
+        @param sequence angles list of float: In degree.
+        @param tm sequence of float: Time to complete, In Second
+        @param period float: sampling period of the result. 0.0 means the control period
+        @return OpenHRP.SequencePlayerService.TrajectoryPreview, or None if the sequence is invalid
+        '''
+        angless = [[a / 180.0 * math.pi for a in angles] for angles in angless]
+        ret, preview = self.seq_svc.previewJointAnglesSequenceFull(angless, [], [], [], [], [], [], [], [], tms, period)
+        return preview if ret else None
+
+    def pushSplineSegments(self, segments):
+        '''!@brief
+        Stream polynomial segments of joint angles.
+        @param segments list of (duration, coefficients): coefficients is a list of
+        lists of polynomial coefficients of each joint in radian, from the lowest order
+        @return the number of accepted segments, -1 if segments are invalid, or -2
+        if joint angles are being interpolated by other methods.
+        Rest of segments should be pushed again when the buffer has space.
+        '''
+        segs = []
+        for tm, coeffs in segments:
+            order = len(coeffs[0]) - 1
+            jvs = [c for cs in coeffs for c in cs]
+            segs.append(SequencePlayerService.SplineSegment(tm, order, jvs, [], [], []))
+        return self.seq_svc.pushSplineSegments(segs)
+
     def setJointAnglesSequenceOfGroup(self, gname, angless, tms):
         '''!@brief
         Set all joint angles.
@@ -1323,6 +1351,25 @@ class HrpsysConfigurator:
             raise RuntimeError("need to specify joint name")
         return euler_from_matrix(self.getReferenceRotation(lname, frame_name), 'sxyz')
 
+    def getPoses(self, lnames, frame_name=None, current=True):
+        '''!@brief
+        Returns poses of the specified links in one call.
+        cf. getCurrentPose and getReferencePose
+
+        @type lnames: list of str
+        @param lnames: Names of the links.
+        @param frame_name str: set reference frame name
+        @param current bool: True for physical poses, False for commanded poses
+        @rtype: list of list of float
+        @return: Poses of the links in the same format as getCurrentPose,
+                 in the order of lnames.
+        '''
+        model = ForwardKinematicsService.CURRENT if current else ForwardKinematicsService.REFERENCE
+        ret, poses = self.fk_svc.getPoses(lnames, frame_name if frame_name else "", model)
+        if not ret:
+            raise RuntimeError("Could not find links : " + str(lnames))
+        return [poses.data[i*16:(i+1)*16] for i in range(len(lnames))]
+
     def setTargetPose(self, gname, pos, rpy, tm, frame_name=None):
         '''!@brief
         Move the end-effector to the given absolute pose.
@@ -1415,6 +1462,15 @@ dr=0, dp=0, dw=0, tm=10, wait=True):
         self.log_svc.save(fname)
         print(self.configurator_name + "saved data to " + fname)
 
+    def saveLogCompressed(self, fname='sample'):
+        '''!@brief
+        Save log to compressed files without stopping the logger. They can be read by hrpsys_log.py
+
+        @param fname str: name of the file
+        '''
+        self.log_svc.saveCompressed(fname)
+        print(self.configurator_name + "saved compressed data to " + fname)
+
     def clearLog(self):
         '''!@brief
         Clear logger's buffer
@@ -1428,6 +1484,35 @@ dr=0, dp=0, dw=0, tm=10, wait=True):
         '''
         self.log_svc.maxLength(length)
 
+    def getLogRange(self, port, start=-5.0, end=0.0):
+        '''!@brief
+        Get logged data of a port without stopping the logger
+        @param port str: name of the logger port, e.g. "sh_qOut"
+        @param start float: start time[s]. Negative value is relative to the latest data, e.g. -5.0 for the last 5 seconds
+        @param end float: end time[s]. 0.0 means the latest data
+        @return list of (time, [values]) tuples
+        '''
+        ret, data = self.log_svc.getRange(port, start, end)
+        if not ret:
+            return []
+        w = data.width
+        return [(data.times[i], data.values[i * w:(i + 1) * w]) for i in range(len(data.times))]
+
+    def getLogEnvelope(self, port, start=-60.0, end=0.0, buckets=500):
+        '''!@brief
+        Get minimum and maximum values of logged data of a port to plot them
+        @param port str: name of the logger port
+        @param start float: start time[s], see getLogRange()
+        @param end float: end time[s], see getLogRange()
+        @param buckets int: the number of time buckets
+        @return list of (time, [minimum values], [maximum values]) tuples
+        '''
+        ret, data = self.log_svc.getEnvelope(port, start, end, buckets)
+        if not ret:
+            return []
+        w = data.width
+        return [(data.times[i], data.mins[i * w:(i + 1) * w], data.maxs[i * w:(i + 1) * w]) for i in range(len(data.times))]
+
     def lengthDigitalInput(self):
         '''!@brief
         Returns the length of digital input port
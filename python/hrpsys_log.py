@@ -0,0 +1,200 @@
+#!/usr/bin/env python
+
+"""Reader of compressed log files written by DataLogger.saveCompressed().
+
+See rtc/DataLogger/ColumnFile.h for the format. Only chunks which overlap
+the requested time range are read and a column can be read alone.
+
+  log = ColumnLog("sample.sh_qOut.clog")
+  times, values = log.read(-5.0)         # the last 5 seconds
+  times, q0 = log.read(10.0, 20.0, 0)    # the first element only
+"""
+
+import os
+import struct
+
+FILE_MAGIC = "HRPCLOG1"
+INDEX_MAGIC = "HRPCIDX1"
+CHUNK_MAGIC = "CHNK"
+VERSION = 1
+FLAG_INTEGER = 1
+HEADER = struct.Struct("=8sIII")
+CHUNK = struct.Struct("=4sIIIqq")
+ENTRY = struct.Struct("=QqqII")
+TRAILER = struct.Struct("=QQ8s")
+NSEC = 1000000000
+BYTE_BITS = [format(i, "08b") for i in range(256)]
+
+
+def toSigned(v):
+    return v - (1 << 64) if v & (1 << 63) else v
+
+
+def toDouble(bits):
+    return struct.unpack("=d", struct.pack("=Q", bits))[0]
+
+
+class BitReader:
+    def __init__(self, data, offset=0):
+        self.bits = "".join([BYTE_BITS[b] for b in bytearray(data[offset:])])
+        self.pos = 0
+
+    def read(self, n):
+        if self.pos + n > len(self.bits):
+            raise IOError("broken chunk")
+        v = int(self.bits[self.pos:self.pos + n], 2)
+        self.pos += n
+        return v
+
+
+def decodeTimes(reader, n):
+    """decoder of timestamps written by TimeEncoder"""
+    times = []
+    prev = delta = 0
+    for i in range(n):
+        if i == 0:
+            prev = toSigned(reader.read(64))
+        else:
+            nbits = 0
+            if reader.read(1):
+                if not reader.read(1):
+                    nbits = 16
+                elif not reader.read(1):
+                    nbits = 24
+                elif not reader.read(1):
+                    nbits = 32
+                else:
+                    nbits = 64
+            if nbits:
+                z = reader.read(nbits)
+                delta += (z >> 1) ^ -(z & 1)
+            prev += delta
+        times.append(prev)
+    return times
+
+
+def decodeValues(reader, n):
+    """decoder of values written by ValueEncoder"""
+    values = []
+    prev = leading = trailing = 0
+    for i in range(n):
+        if i == 0:
+            prev = reader.read(64)
+        elif reader.read(1):
+            if reader.read(1):
+                leading = reader.read(5)
+                trailing = 64 - leading - reader.read(6) - 1
+            prev ^= reader.read(64 - leading - trailing) << trailing
+        values.append(toDouble(prev))
+    return values
+
+
+class ColumnLog:
+    def __init__(self, filename):
+        self.f = open(filename, "rb")
+        magic, version, flags, length = HEADER.unpack(self.f.read(HEADER.size))
+        if magic != FILE_MAGIC or version != VERSION:
+            raise IOError("%s is not a compressed log file" % filename)
+        self.name = self.f.read(length)
+        self.integer = bool(flags & FLAG_INTEGER)
+        self.dataOffset = self.f.tell()
+        self.f.seek(0, os.SEEK_END)
+        self.end = self.f.tell()
+        if not self.readIndex():
+            self.scan()
+
+    def readIndex(self):
+        if self.end < self.dataOffset + TRAILER.size:
+            return False
+        self.f.seek(self.end - TRAILER.size)
+        offset, n, magic = TRAILER.unpack(self.f.read(TRAILER.size))
+        if (magic != INDEX_MAGIC or offset < self.dataOffset
+                or offset + n * ENTRY.size + TRAILER.size != self.end):
+            return False
+        self.f.seek(offset)
+        buf = self.f.read(n * ENTRY.size)
+        # (offset, tmin, tmax, size, width)
+        self.index = [ENTRY.unpack_from(buf, i * ENTRY.size) for i in range(n)]
+        return True
+
+    def scan(self):
+        """recover chunks of a file whose index is not written"""
+        self.index = []
+        offset = self.dataOffset
+        while offset + CHUNK.size <= self.end:
+            self.f.seek(offset)
+            magic, width, size, length, tmin, tmax = CHUNK.unpack(self.f.read(CHUNK.size))
+            following = offset + CHUNK.size + width * 20 + length
+            if magic != CHUNK_MAGIC or following > self.end:
+                break
+            self.index.append((offset, tmin, tmax, size, width))
+            offset = following
+
+    def __len__(self):
+        return sum([e[3] for e in self.index])
+
+    def startTime(self):
+        return float(self.index[0][1]) / NSEC if self.index else 0.0
+
+    def endTime(self):
+        return float(self.index[-1][2]) / NSEC if self.index else 0.0
+
+    def readChunk(self, entry, column):
+        offset, tmin, tmax, size, width = entry
+        self.f.seek(offset)
+        length = CHUNK.unpack(self.f.read(CHUNK.size))[3]
+        offsets = struct.unpack("=%dI" % width, self.f.read(4 * width))
+        self.f.seek(16 * width, os.SEEK_CUR)
+        data = self.f.read(length)
+        times = decodeTimes(BitReader(data), size)
+        if column is not None:
+            return times, [decodeValues(BitReader(data, offsets[column]), size)]
+        return times, [decodeValues(BitReader(data, o), size) for o in offsets]
+
+    def read(self, start=0.0, end=0.0, column=None):
+        """Read samples in a time range.
+        start: start time[s]. Negative value is relative to the last sample
+        end: end time[s]. 0.0 means the last sample
+        column: index of the element to be read, or None for all elements
+        Returns a list of time and a list of values. An element of the
+        latter is a list of values of a sample, or a value if column is
+        given."""
+        if not self.index:
+            return [], []
+        latest = self.index[-1][2]
+        to = int(round(end * NSEC)) if end > 0 else latest
+        frm = latest + int(round(start * NSEC)) if start < 0 else int(round(start * NSEC))
+        overlap = [e for e in self.index if e[1] <= to and e[2] >= frm]
+        if not overlap:
+            return [], []
+        width = overlap[-1][4]
+        times, values = [], []
+        for e in overlap:
+            if e[4] != width:
+                continue
+            t, cols = self.readChunk(e, column)
+            for i in range(len(t)):
+                if frm <= t[i] <= to:
+                    times.append(float(t[i]) / NSEC)
+                    if column is None:
+                        values.append([c[i] for c in cols])
+                    else:
+                        values.append(cols[0][i])
+        return times, values
+
+
+if __name__ == '__main__':
+    import sys
+    if len(sys.argv) < 2:
+        print("Usage: %s file.clog [start [end]]" % sys.argv[0])
+        print("  prints samples in the same format as DataLogger.save()")
+        sys.exit(1)
+    log = ColumnLog(sys.argv[1])
+    args = [float(a) for a in sys.argv[2:4]]
+    times, values = log.read(*args)
+    for i in range(len(times)):
+        if log.integer:
+            vs = ["%d" % v for v in values[i]]
+        else:
+            vs = ["%f" % v for v in values[i]]
+        print("%f %s" % (times[i], "".join([v + " " for v in vs])))
@@ -0,0 +1,210 @@
+#!/usr/bin/env python
+
+"""Reader of telemetry streams written by RobotHardware and StateHolder.
+
+A stream is read from shared memory on the same host or from a UDP
+multicast group, see lib/util/Telemetry.h for the format.
+
+  sub = TelemetrySubscriber("rh")      # /dev/shm/hrpsys_telemetry_rh
+  sub = TelemetrySubscriber("239.255.0.1:15000")
+  while True:
+      rec = sub.next()                 # None if there is no new record
+      if rec:
+          print("%f %s" % (rec['time'], rec['angle']))
+"""
+
+import mmap
+import os
+import socket
+import struct
+import time
+
+MAGIC = "HRPTLM1\0"
+HEADER = struct.Struct("=8sIIIIIIQ")
+FIELD = struct.Struct("=32sIIII")
+SLOT = struct.Struct("=IIQd")
+DATAGRAM = struct.Struct("=8sIIQd")
+DATAGRAM_LAYOUT, DATAGRAM_RECORD = 0, 1
+TELEMETRY_DOUBLE, TELEMETRY_INT32 = 0, 1
+# a subscriber which gets no record for this time checks if the shared
+# memory has been replaced by a new publisher [s]
+STALE_INTERVAL = 1.0
+
+
+def parseFields(buf, offset, nfields):
+    fields = []
+    for i in range(nfields):
+        name, typ, count, off, _ = FIELD.unpack_from(buf, offset + i * FIELD.size)
+        fmt = "=%d%s" % (count, 'd' if typ == TELEMETRY_DOUBLE else 'i')
+        fields.append((name.split('\0')[0], struct.Struct(fmt), off))
+    return fields
+
+
+class TelemetrySubscriber:
+    def __init__(self, source):
+        self.source = source
+        self.lost = 0
+        self.mem = None
+        self.sock = None
+        self.fields = None
+        self.layoutId = None
+        if ':' in source:
+            group, port = source.split(':')
+            self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+            self.sock.bind(('', int(port)))
+            mreq = struct.pack("=4sl", socket.inet_aton(group), socket.INADDR_ANY)
+            self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+            self.sock.setblocking(0)
+            self.next_index = 0
+        else:
+            self.openShm()
+
+    def shmPath(self):
+        return "/dev/shm/hrpsys_telemetry_" + self.source
+
+    def openShm(self):
+        fd = os.open(self.shmPath(), os.O_RDONLY)
+        try:
+            self.inode = os.fstat(fd).st_ino
+            self.mem = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ)
+        finally:
+            os.close(fd)
+        (magic, nfields, self.recordSize, self.slotSize, self.nslots,
+         self.layoutId, _, count) = HEADER.unpack_from(self.mem, 0)
+        if magic != MAGIC:
+            raise IOError("telemetry %s is not ready" % self.source)
+        self.fields = parseFields(self.mem, HEADER.size, nfields)
+        self.slots = len(self.mem) - self.slotSize * self.nslots
+        self.next_index = self.idle_count = count
+        self.idle_since = time.time()
+
+    def replaced(self):
+        # a publisher which crashed didn't clear the magic, and its
+        # successor created a new shared memory with the same name
+        try:
+            f = open(self.shmPath(), 'rb')
+            try:
+                inode = os.fstat(f.fileno()).st_ino
+                header = f.read(HEADER.size)
+            finally:
+                f.close()
+        except (IOError, OSError):
+            return False
+        if len(header) < HEADER.size:
+            return False
+        magic, _, _, _, _, layoutId, _, _ = HEADER.unpack_from(header, 0)
+        return magic == MAGIC and (inode != self.inode or layoutId != self.layoutId)
+
+    def reopenShm(self):
+        try:
+            self.openShm()
+        except (IOError, OSError):
+            return False
+        self.next_index = 0
+        return True
+
+    def decode(self, buf, offset, tm):
+        rec = {'time': tm}
+        for name, st, off in self.fields:
+            rec[name] = st.unpack_from(buf, offset + off)
+        return rec
+
+    def count(self):
+        return HEADER.unpack_from(self.mem, 0)[7]
+
+    def readSlot(self, index):
+        offset = self.slots + self.slotSize * (index % self.nslots)
+        seq, _, idx, tm = SLOT.unpack_from(self.mem, offset)
+        if seq & 1:
+            return None
+        data = self.mem[offset:offset + self.slotSize]
+        seq2, _, idx2, _ = SLOT.unpack_from(self.mem, offset)
+        if seq != seq2 or idx2 != index:
+            return None
+        return self.decode(data, SLOT.size, tm)
+
+    def receive(self):
+        while True:
+            try:
+                buf = self.sock.recv(65536)
+            except socket.error:
+                return None
+            if len(buf) < DATAGRAM.size:
+                continue
+            magic, kind, layoutId, index, tm = DATAGRAM.unpack_from(buf, 0)
+            if magic != MAGIC:
+                continue
+            if kind == DATAGRAM_LAYOUT:
+                if layoutId != self.layoutId:
+                    nfields, self.recordSize = struct.unpack_from("=II", buf, DATAGRAM.size)
+                    self.fields = parseFields(buf, DATAGRAM.size + 8, nfields)
+                    self.layoutId = layoutId
+                    self.next_index = index
+            elif (kind == DATAGRAM_RECORD and layoutId == self.layoutId
+                  and len(buf) == DATAGRAM.size + self.recordSize
+                  and index >= self.next_index):
+                self.lost += index - self.next_index
+                self.next_index = index + 1
+                return self.decode(buf, DATAGRAM.size, tm)
+
+    def next(self):
+        """Read the next record as a dictionary of fields and 'time'.
+        Returns None if there is no new record."""
+        if self.sock:
+            return self.receive()
+        if self.mem[0:8] != MAGIC:
+            # the publisher has been restarted
+            if not self.reopenShm():
+                return None
+        while True:
+            count = self.count()
+            if self.next_index >= count:
+                if count != self.idle_count:
+                    self.idle_count = count
+                    self.idle_since = time.time()
+                    return None
+                now = time.time()
+                if now - self.idle_since < STALE_INTERVAL:
+                    return None
+                self.idle_since = now
+                if not self.replaced() or not self.reopenShm():
+                    return None
+                continue
+            if count - self.next_index >= self.nslots:
+                oldest = count - self.nslots + 1
+                self.lost += oldest - self.next_index
+                self.next_index = oldest
+            rec = self.readSlot(self.next_index)
+            if rec:
+                self.next_index += 1
+                return rec
+            if self.count() == count:
+                return None
+
+    def latest(self):
+        """Read the latest record, skipping older ones"""
+        rec = None
+        if self.mem:
+            count = self.count()
+            if count > self.next_index + 1:
+                self.lost += count - 1 - self.next_index
+                self.next_index = count - 1
+        while True:
+            r = self.next()
+            if not r:
+                return rec
+            rec = r
+
+
+if __name__ == '__main__':
+    import sys
+    if len(sys.argv) < 2:
+        print("Usage: %s name|group:port" % sys.argv[0])
+        sys.exit(1)
+    sub = TelemetrySubscriber(sys.argv[1])
+    while True:
+        rec = sub.latest()
+        if rec:
+            print(rec)
+        time.sleep(0.1)
@@ -30,6 +30,8 @@ static const char* spec[] =
     "conf.default.resolution", "0.01",
     "conf.default.windowSize", "4",
     "conf.default.dilation", "0",
+    "conf.default.threads", "1",
+    "conf.default.debugLevel", "0",
 
     ""
   };
@@ -41,7 +43,8 @@ AverageFilter::AverageFilter(RTC::Manager* manager)
     m_originalIn("original", m_original),
     m_filteredOut("filtered", m_filtered),
     // </rtc-template>
-    dummy(0)
+    dummy(0),
+    m_nframes(0), m_elapsed(0), m_tReport(0)
 {
 }
 
@@ -59,6 +62,8 @@ RTC::ReturnCode_t AverageFilter::onInitialize()
   bindParameter("resolution", m_resolution, "0.01");
   bindParameter("windowSize", m_windowSize, "4");
   bindParameter("dilation", m_dilation, "0");
+  bindParameter("threads", m_threads, "1");
+  bindParameter("debugLevel", m_debugLevel, "0");
   
   // </rtc-template>
 
@@ -146,92 +151,39 @@ RTC::ReturnCode_t AverageFilter::onExecute(RTC::UniqueId ec_id)
 
     if (!m_original.data.length()) return RTC::RTC_OK;
 
-    // compute bbox
-    float xmin, xmax, ymin, ymax;
-    float *src = (float *)m_original.data.get_buffer();
+    coil::TimeValue t1(coil::gettimeofday());
+    m_heightMap.setResolution(m_resolution);
+    m_heightMap.setWindowSize(m_windowSize);
+    m_heightMap.setDilation(m_dilation);
+    m_heightMap.setNumThreads(m_threads);
     int npoint = m_original.data.length()/m_original.point_step;
-    for (unsigned int i=0; i<npoint; i++){
-      if (i==0){
-	xmin = xmax = src[0];
-	ymin = ymax = src[1];
-      }else{
-	if (xmin > src[0]) xmin = src[0];
-	if (xmax < src[0]) xmax = src[0];
-	if (ymin > src[1]) ymin = src[1];
-	if (ymax < src[1]) ymax = src[1];
-      }
-      src += 4;
-    }
-    //std::cout << "xmin=" << xmin << ", xmax=" << xmax << ", ymin=" << ymin << ", ymax=" << ymax << std::endl;
-    
-    float xstart = (floor(xmin/m_resolution)-m_windowSize)*m_resolution;
-    float ystart = (floor(ymin/m_resolution)-m_windowSize)*m_resolution;
-    int nx = (xmax - xstart)/m_resolution+m_windowSize*2;
-    int ny = (ymax - ystart)/m_resolution+m_windowSize*2;
-    std::vector<float> cell(nx*ny, std::numeric_limits<float>::quiet_NaN());
-    //std::cout << "xstart=" << xstart << ", ystart=" << ystart << std::endl;
-    //std::cout << "nx=" << nx << ", ny=" << ny << std::endl;
-    
-    src = (float *)m_original.data.get_buffer();
-    if (!m_dilation){
-        for (unsigned int i=0; i<npoint; i++){
-            int ix = round((src[0] - xstart)/m_resolution);
-            int iy = round((src[1] - ystart)/m_resolution);
-            int rank = ix+nx*iy;
-            double z = cell[rank], z_new = src[2];
-            if (isnan(z) || !isnan(z) && z_new > z){
-                cell[rank] = z_new;
-            }
-            src += 4;
-        }
-    }else{
-        for (unsigned int i=0; i<npoint; i++){
-            int ix = floor((src[0] - xstart)/m_resolution);
-            int iy = floor((src[1] - ystart)/m_resolution);
-            for (int j=0; j<2; j++){
-                for (int k=0; k<2; k++){
-                    int rank = ix+j + nx*(iy+k);
-                    double z = cell[rank], z_new = src[2];
-                    if (isnan(z) || !isnan(z) && z_new > z){
-                        cell[rank] = z_new;
-                    }
-                }
-            }
-            src += 4;
-        }
-    }
+    if (!m_heightMap.update(m_original.data.get_buffer(), npoint,
+                            m_original.point_step)) return RTC::RTC_OK;
 
-    
-    m_filtered.data.length(nx*ny*m_filtered.point_step); // shrinked later
+    // the capacity of the output is kept across frames
+    m_filtered.data.length(m_heightMap.maxFilteredPoints()*m_filtered.point_step); // shrinked later
     float *dst = (float *)m_filtered.data.get_buffer();
-    npoint=0;
-    int whalf = m_windowSize/2;
-    for (int x=whalf; x<nx-whalf; x++){
-      for (int y=whalf; y<ny-whalf; y++){
-	int cnt=0;
-	float zsum=0;
-	//if (isnan(cell[x + nx*y])) continue;
-	for (int dx=-whalf; dx<=whalf; dx++){
-	  for (int dy=-whalf; dy<whalf; dy++){
-	    int index = x + dx + nx*(y + dy);
-	    if (!isnan(cell[index])){
-	      zsum += cell[index];
-	      cnt++;
-	    }
-	  }
-	}
-	if (cnt){
-	  dst[0] = xstart + m_resolution*x;
-	  dst[1] = ystart + m_resolution*y;
-	  dst[2] = zsum/cnt;
-	  dst += 4;
-	  npoint++;
-	}
+    unsigned int n = m_heightMap.filter(dst);
+    m_filtered.width = n;
+    m_filtered.row_step = m_filtered.point_step*m_filtered.width;
+    m_filtered.data.length(n*m_filtered.point_step);
+    coil::TimeValue t2(coil::gettimeofday());
+
+    if (m_debugLevel > 0){
+      // report time per frame averaged over about one second
+      coil::TimeValue dt = t2-t1;
+      m_nframes++;
+      m_elapsed += dt.sec()+dt.usec()/1e6;
+      if ((double)t2 - m_tReport > 1.0 || m_debugLevel > 1){
+        m_tReport = (double)t2;
+        std::cout << m_profile.instance_name << ": "
+                  << npoint << " points -> " << m_heightMap.width() << "x"
+                  << m_heightMap.height() << " cells, " << n << " points, "
+                  << m_elapsed/m_nframes*1e3 << "[ms/frame]" << std::endl;
+        m_nframes = 0;
+        m_elapsed = 0;
       }
     }
-    m_filtered.width = npoint;
-    m_filtered.row_step = m_filtered.point_step*m_filtered.width;
-    m_filtered.data.length(npoint*m_filtered.point_step);
 
     m_filteredOut.write();
   }
@@ -17,6 +17,7 @@
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
 #include "pointcloud.hh"
+#include "HeightMap.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -133,10 +134,15 @@ class AverageFilter
   // </rtc-template>
 
  private:
+  HeightMap m_heightMap;
   int dummy;
   double m_resolution;
   int m_windowSize;
   bool m_dilation;
+  int m_threads, m_debugLevel;
+  // statistics for debugLevel
+  unsigned int m_nframes;
+  double m_elapsed, m_tReport;
 };
 
 
@@ -0,0 +1,310 @@
+// -*- C++ -*-
+/*!
+ * @file  HeightMap.cpp
+ * @brief height map built from a point cloud and averaged by a summed area table
+ */
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include "HeightMap.h"
+
+static inline void chunk(unsigned int i_n, int i_part, int i_nparts,
+                         unsigned int& o_begin, unsigned int& o_end)
+{
+    o_begin = (unsigned long long)i_n*i_part/i_nparts;
+    o_end = (unsigned long long)i_n*(i_part+1)/i_nparts;
+}
+
+HeightMap::HeightMap() :
+    m_resolution(0.01), m_windowSize(4), m_dilation(false), m_nthreads(1),
+    m_xstart(0), m_ystart(0), m_nx(0), m_ny(0),
+    m_points(NULL), m_npoints(0), m_pointStep(16), m_output(NULL),
+    m_stage(BOUNDS)
+{
+}
+
+void HeightMap::setNumThreads(int i_nthreads)
+{
+    if (i_nthreads < 1) i_nthreads = 1;
+    m_pool.setNumThreads(i_nthreads);
+    m_nthreads = i_nthreads;
+}
+
+void HeightMap::run(int i_part)
+{
+    switch(m_stage){
+    case BOUNDS:  bounds(i_part); break;
+    case INDEX:   index(i_part); break;
+    case SCATTER: scatter(i_part); break;
+    case BIN:     bin(i_part); break;
+    case ROWS:    rows(i_part); break;
+    case COLUMNS: columns(i_part); break;
+    case AVERAGE: average(i_part); break;
+    }
+}
+
+void HeightMap::dispatch(Stage i_stage)
+{
+    m_stage = i_stage;
+    m_pool.run(boost::bind(&HeightMap::run, this, _1),
+               m_npoints >= (unsigned int)m_nthreads);
+}
+
+void HeightMap::bounds(int i_part)
+{
+    unsigned int begin, end;
+    chunk(m_npoints, i_part, m_nthreads, begin, end);
+    float inf = std::numeric_limits<float>::infinity();
+    float xmin = inf, xmax = -inf, ymin = inf, ymax = -inf;
+    const unsigned char *ptr = m_points + (size_t)begin*m_pointStep;
+    for (unsigned int i=begin; i<end; i++, ptr+=m_pointStep){
+        const float *p = (const float *)ptr;
+        if (std::isnan(p[0]) || std::isnan(p[1]) || std::isnan(p[2])) continue;
+        if (xmin > p[0]) xmin = p[0];
+        if (xmax < p[0]) xmax = p[0];
+        if (ymin > p[1]) ymin = p[1];
+        if (ymax < p[1]) ymax = p[1];
+    }
+    float *b = &m_bounds[i_part*4];
+    b[0] = xmin; b[1] = xmax; b[2] = ymin; b[3] = ymax;
+}
+
+void HeightMap::index(int i_part)
+{
+    unsigned int begin, end;
+    chunk(m_npoints, i_part, m_nthreads, begin, end);
+    // the cell at the upper right is also used with dilation
+    int d = m_dilation ? 1 : 0;
+    unsigned int *counts = &m_counts[i_part*m_nthreads];
+    for (int i=0; i<m_nthreads; i++) counts[i] = 0;
+    const unsigned char *ptr = m_points + (size_t)begin*m_pointStep;
+    for (unsigned int i=begin; i<end; i++, ptr+=m_pointStep){
+        const float *p = (const float *)ptr;
+        m_rank[i] = -1;
+        if (std::isnan(p[0]) || std::isnan(p[1]) || std::isnan(p[2])) continue;
+        int ix, iy;
+        if (!m_dilation){
+            ix = round((p[0] - m_xstart)/m_resolution);
+            iy = round((p[1] - m_ystart)/m_resolution);
+        }else{
+            ix = floor((p[0] - m_xstart)/m_resolution);
+            iy = floor((p[1] - m_ystart)/m_resolution);
+        }
+        if (ix < 0 || ix+d >= m_nx || iy < 0 || iy+d >= m_ny) continue;
+        m_rank[i] = ix + m_nx*iy;
+        m_row[i] = iy;
+        counts[m_band[iy]]++;
+        if (d && m_band[iy+1] != m_band[iy]) counts[m_band[iy+1]]++;
+    }
+}
+
+void HeightMap::scatter(int i_part)
+{
+    // points of band b from chunk c are placed after those of bands before
+    // b and those of b from chunks before c
+    const int n = m_nthreads;
+    unsigned int *offsets = &m_counts[n*n + i_part*n];
+    unsigned int base = 0;
+    for (int b=0; b<n; b++){
+        unsigned int total = 0;
+        offsets[b] = base;
+        for (int c=0; c<n; c++){
+            unsigned int cnt = m_counts[c*n + b];
+            if (c < i_part) offsets[b] += cnt;
+            total += cnt;
+        }
+        if (b == i_part){
+            m_bandBegin[b] = base;
+            m_bandEnd[b] = base + total;
+        }
+        base += total;
+    }
+    unsigned int begin, end;
+    chunk(m_npoints, i_part, n, begin, end);
+    for (unsigned int i=begin; i<end; i++){
+        if (m_rank[i] < 0) continue;
+        int row = m_row[i];
+        m_order[offsets[m_band[row]]++] = i;
+        if (m_dilation && m_band[row+1] != m_band[row]){
+            m_order[offsets[m_band[row+1]]++] = i;
+        }
+    }
+}
+
+void HeightMap::bin(int i_part)
+{
+    // each thread owns a band of rows and looks at points in it
+    unsigned int begin, end;
+    chunk(m_ny, i_part, m_nthreads, begin, end);
+    std::fill(m_cells.begin() + (size_t)begin*m_nx,
+              m_cells.begin() + (size_t)end*m_nx,
+              std::numeric_limits<float>::quiet_NaN());
+    int nrow = m_dilation ? 2 : 1, ncol = nrow;
+    for (unsigned int j=m_bandBegin[i_part]; j<m_bandEnd[i_part]; j++){
+        unsigned int i = m_order[j];
+        int rank = m_rank[i];
+        float z = ((const float *)(m_points + (size_t)i*m_pointStep))[2];
+        for (int k=0; k<nrow; k++){
+            unsigned int row = m_row[i]+k;
+            if (row < begin || row >= end) continue;
+            for (int j=0; j<ncol; j++){
+                float& c = m_cells[rank + j + m_nx*k];
+                if (std::isnan(c) || z > c) c = z;
+            }
+        }
+    }
+}
+
+void HeightMap::rows(int i_part)
+{
+    // row y of cells is accumulated into row y+1 of the tables
+    unsigned int begin, end;
+    chunk(m_ny, i_part, m_nthreads, begin, end);
+    for (unsigned int y=begin; y<end; y++){
+        const float *c = &m_cells[(size_t)m_nx*y];
+        double *s = &m_sum[(size_t)(m_nx+1)*(y+1)];
+        unsigned int *n = &m_count[(size_t)(m_nx+1)*(y+1)];
+        s[0] = 0; n[0] = 0;
+        for (int x=0; x<m_nx; x++){
+            if (std::isnan(c[x])){
+                s[x+1] = s[x];
+                n[x+1] = n[x];
+            }else{
+                s[x+1] = s[x] + c[x];
+                n[x+1] = n[x] + 1;
+            }
+        }
+    }
+}
+
+void HeightMap::columns(int i_part)
+{
+    unsigned int begin, end;
+    chunk(m_nx, i_part, m_nthreads, begin, end);
+    unsigned int w = m_nx+1;
+    for (int y=2; y<=m_ny; y++){
+        double *s = &m_sum[(size_t)w*y], *s0 = s - w;
+        unsigned int *n = &m_count[(size_t)w*y], *n0 = n - w;
+        for (unsigned int x=begin+1; x<end+1; x++){
+            s[x] += s0[x];
+            n[x] += n0[x];
+        }
+    }
+}
+
+void HeightMap::average(int i_part)
+{
+    int whalf = m_windowSize/2;
+    unsigned int nx = m_nx - 2*whalf, ny = m_ny - 2*whalf;
+    unsigned int begin, end;
+    chunk(nx, i_part, m_nthreads, begin, end);
+    // points are packed from the first slot of the chunk
+    float *dst = m_output + (size_t)begin*ny*4;
+    unsigned int n = 0, w = m_nx+1;
+    for (unsigned int i=begin; i<end; i++){
+        int x = i + whalf;
+        // the window spans [x-whalf, x+whalf] and [y-whalf, y+whalf)
+        unsigned int x0 = x - whalf, x1 = x + whalf + 1;
+        for (int y=whalf; y<m_ny-whalf; y++){
+            unsigned int y0 = (unsigned int)(y - whalf)*w;
+            unsigned int y1 = (unsigned int)(y + whalf)*w;
+            unsigned int cnt = m_count[x1+y1] - m_count[x0+y1]
+                - m_count[x1+y0] + m_count[x0+y0];
+            if (!cnt) continue;
+            double zsum = m_sum[x1+y1] - m_sum[x0+y1]
+                - m_sum[x1+y0] + m_sum[x0+y0];
+            dst[0] = m_xstart + m_resolution*x;
+            dst[1] = m_ystart + m_resolution*y;
+            dst[2] = zsum/cnt;
+            dst[3] = 0;
+            dst += 4;
+            n++;
+        }
+    }
+    m_nfiltered[i_part] = n;
+}
+
+bool HeightMap::update(const unsigned char *i_points, unsigned int i_npoints,
+                       unsigned int i_pointStep)
+{
+    m_points = i_points;
+    m_npoints = i_npoints;
+    m_pointStep = i_pointStep;
+    m_nx = m_ny = 0;
+    m_bounds.resize(m_nthreads*4);
+    m_rank.resize(i_npoints);
+    m_row.resize(i_npoints);
+
+    dispatch(BOUNDS);
+    float xmin = m_bounds[0], xmax = m_bounds[1];
+    float ymin = m_bounds[2], ymax = m_bounds[3];
+    for (int i=1; i<m_nthreads; i++){
+        const float *b = &m_bounds[i*4];
+        if (xmin > b[0]) xmin = b[0];
+        if (xmax < b[1]) xmax = b[1];
+        if (ymin > b[2]) ymin = b[2];
+        if (ymax < b[3]) ymax = b[3];
+    }
+    if (xmin > xmax) return false;
+
+    m_xstart = (floor(xmin/m_resolution)-m_windowSize)*m_resolution;
+    m_ystart = (floor(ymin/m_resolution)-m_windowSize)*m_resolution;
+    m_nx = (xmax - m_xstart)/m_resolution+m_windowSize*2;
+    m_ny = (ymax - m_ystart)/m_resolution+m_windowSize*2;
+    m_cells.resize((size_t)m_nx*m_ny);
+    m_band.resize(m_ny);
+    for (int i=0; i<m_nthreads; i++){
+        unsigned int begin, end;
+        chunk(m_ny, i, m_nthreads, begin, end);
+        for (unsigned int y=begin; y<end; y++) m_band[y] = i;
+    }
+    // a point can be put into two bands with dilation
+    m_order.resize(m_dilation ? 2*i_npoints : i_npoints);
+    m_counts.resize(2*m_nthreads*m_nthreads);
+    m_bandBegin.resize(m_nthreads);
+    m_bandEnd.resize(m_nthreads);
+
+    dispatch(INDEX);
+    dispatch(SCATTER);
+    dispatch(BIN);
+    return true;
+}
+
+unsigned int HeightMap::maxFilteredPoints() const
+{
+    int whalf = m_windowSize/2;
+    int nx = m_nx - 2*whalf, ny = m_ny - 2*whalf;
+    return nx > 0 && ny > 0 ? nx*ny : 0;
+}
+
+unsigned int HeightMap::filter(float *o_points)
+{
+    if (!maxFilteredPoints()) return 0;
+    m_output = o_points;
+    m_nfiltered.resize(m_nthreads);
+    m_sum.resize((size_t)(m_nx+1)*(m_ny+1));
+    m_count.resize(m_sum.size());
+    std::fill(m_sum.begin(), m_sum.begin() + m_nx+1, 0.0);
+    std::fill(m_count.begin(), m_count.begin() + m_nx+1, 0);
+
+    dispatch(ROWS);
+    dispatch(COLUMNS);
+    dispatch(AVERAGE);
+
+    // chunks of threads are packed
+    int whalf = m_windowSize/2;
+    unsigned int nx = m_nx - 2*whalf, ny = m_ny - 2*whalf;
+    unsigned int n = 0;
+    for (int i=0; i<m_nthreads; i++){
+        unsigned int begin, end;
+        chunk(nx, i, m_nthreads, begin, end);
+        if (n != begin*ny){
+            memmove(o_points + (size_t)n*4, o_points + (size_t)begin*ny*4,
+                    (size_t)m_nfiltered[i]*16);
+        }
+        n += m_nfiltered[i];
+    }
+    return n;
+}
@@ -0,0 +1,124 @@
+// -*- C++ -*-
+/*!
+ * @file  HeightMap.h
+ * @brief height map built from a point cloud and averaged by a summed area table
+ */
+#ifndef HEIGHT_MAP_H
+#define HEIGHT_MAP_H
+
+#include <vector>
+#include "util/WorkerPool.h"
+
+/**
+   \brief grid of the highest z of points in each cell and its average over
+   a window
+
+   Points are 16 byte or larger records which start with float x, y and z.
+   Points with NaN are skipped. The grid covers the bounding box of points
+   with a margin of the window size. With dilation, each point is put into
+   the 2x2 cells around it instead of the nearest cell.
+
+   Points are sorted by bands of rows and binned by threads in parallel,
+   each of which owns a band and visits only the points in it, so results
+   don't depend on the number of threads. Averages are
+   computed from a summed area table, so their cost doesn't depend on the
+   window size. The grid and tables are kept across calls and only grow, so
+   no allocation occurs in steady state.
+ */
+class HeightMap
+{
+public:
+    HeightMap();
+    /**
+       \brief set the size of a cell[m]
+     */
+    void setResolution(double i_resolution) { m_resolution = i_resolution; }
+    /**
+       \brief set the window size for averaging[cell]
+     */
+    void setWindowSize(int i_size) { m_windowSize = i_size; }
+    /**
+       \brief put points into 2x2 cells if true
+     */
+    void setDilation(bool i_flag) { m_dilation = i_flag; }
+    /**
+       \brief set the number of threads including the calling thread
+     */
+    void setNumThreads(int i_nthreads);
+    int numThreads() const { return m_nthreads; }
+    /**
+       \brief build the grid from points
+       \param i_points input points
+       \param i_npoints the number of input points
+       \param i_pointStep size of an input point[byte]
+       \return false if there is no valid point
+     */
+    bool update(const unsigned char *i_points, unsigned int i_npoints,
+                unsigned int i_pointStep);
+    /**
+       \brief the maximum number of points returned by filter()
+     */
+    unsigned int maxFilteredPoints() const;
+    /**
+       \brief average heights over the window
+       \param o_points output buffer for 16 byte points. It must be able to
+       store maxFilteredPoints() points
+       \return the number of output points, which are ordered by x and then y
+     */
+    unsigned int filter(float *o_points);
+    /**
+       \brief the number of cells along x
+     */
+    int width() const { return m_nx; }
+    /**
+       \brief the number of cells along y
+     */
+    int height() const { return m_ny; }
+    /**
+       \brief position of the cell (0,0)[m]
+     */
+    double originX() const { return m_xstart; }
+    double originY() const { return m_ystart; }
+    /**
+       \brief heights of cells at x + width()*y, NaN if empty
+     */
+    const float *cells() const { return m_cells.empty() ? NULL : &m_cells[0]; }
+private:
+    enum Stage { BOUNDS, INDEX, SCATTER, BIN, ROWS, COLUMNS, AVERAGE };
+    void run(int i_part);
+    void dispatch(Stage i_stage);
+    void bounds(int i_part);
+    void index(int i_part);
+    void scatter(int i_part);
+    void bin(int i_part);
+    void rows(int i_part);
+    void columns(int i_part);
+    void average(int i_part);
+
+    double m_resolution;
+    int m_windowSize;
+    bool m_dilation;
+    int m_nthreads;
+    float m_xstart, m_ystart;
+    int m_nx, m_ny;
+    std::vector<float> m_cells;
+    std::vector<int> m_rank, m_row;    ///< cell and row of each point
+    std::vector<int> m_band;           ///< band of each row
+    std::vector<unsigned int> m_order; ///< indices of points sorted by band
+    std::vector<unsigned int> m_counts; ///< points per chunk and band, then offsets
+    std::vector<unsigned int> m_bandBegin, m_bandEnd; ///< ranges in m_order
+    std::vector<double> m_sum;         ///< summed area table of heights
+    std::vector<unsigned int> m_count; ///< summed area table of cells
+    std::vector<float> m_bounds;       ///< xmin, xmax, ymin, ymax per thread
+    std::vector<unsigned int> m_nfiltered; ///< output points per thread
+
+    // arguments of the current call and the current stage
+    const unsigned char *m_points;
+    unsigned int m_npoints, m_pointStep;
+    float *m_output;
+    Stage m_stage;
+
+    WorkerPool m_pool;
+};
+
+#endif // HEIGHT_MAP_H
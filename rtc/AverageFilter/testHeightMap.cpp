@@ -0,0 +1,367 @@
+/* -*- coding:utf-8-unix; mode:c++; -*- */
+
+#include "HeightMap.h"
+/* samples */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <vector>
+#include <sys/time.h>
+
+class testHeightMap
+{
+protected:
+    double resolution; /* [m] */
+    int windowSize;
+    unsigned int npoints;
+    int nthreads, nloop;
+    std::vector<float> input, output;
+    double uniform (double min, double max) { return min + (max-min)*rand()/(double)RAND_MAX; };
+    void gen_points ()
+    {
+        // steps and a slope in front of a robot
+        input.resize(npoints*4);
+        srand(0);
+        for (unsigned int i = 0; i < npoints; i++) {
+            float *p = &input[i*4];
+            p[0] = uniform(0.3, 2.0); p[1] = uniform(-0.8, 0.8);
+            p[2] = p[0] < 1.0 ? 0 : (p[0] < 1.5 ? 0.15 : 0.15 + (p[0]-1.5)*0.2);
+            p[2] += uniform(-0.005, 0.005);
+            p[3] = 0;
+            // the riser of the step hides the floor just in front of it
+            if (p[0] > 0.95 && p[0] < 1.0) p[2] = std::numeric_limits<float>::quiet_NaN();
+        }
+    };
+    void add_point (std::vector<float>& io_points, float x, float y, float z)
+    {
+        io_points.push_back(x); io_points.push_back(y); io_points.push_back(z); io_points.push_back(0);
+    };
+    unsigned int filter (HeightMap& map, const std::vector<float>& points)
+    {
+        if (!map.update((const unsigned char *)(points.empty() ? NULL : &points[0]), points.size()/4, 16)) return 0;
+        output.resize(map.maxFilteredPoints()*4);
+        return output.empty() ? 0 : map.filter(&output[0]);
+    };
+    unsigned int count_cells (const HeightMap& map)
+    {
+        unsigned int n = 0;
+        for (int i = 0; i < map.width()*map.height(); i++) if (!std::isnan(map.cells()[i])) n++;
+        return n;
+    };
+    // straightforward averaging over the window
+    unsigned int reference (bool dilation, std::vector<float>& o_points)
+    {
+        float inf = std::numeric_limits<float>::infinity();
+        float xmin = inf, xmax = -inf, ymin = inf, ymax = -inf;
+        for (unsigned int i = 0; i < npoints; i++) {
+            const float *p = &input[i*4];
+            if (std::isnan(p[0]) || std::isnan(p[1]) || std::isnan(p[2])) continue;
+            xmin = std::min(xmin, p[0]); xmax = std::max(xmax, p[0]);
+            ymin = std::min(ymin, p[1]); ymax = std::max(ymax, p[1]);
+        }
+        float xstart = (floor(xmin/resolution)-windowSize)*resolution;
+        float ystart = (floor(ymin/resolution)-windowSize)*resolution;
+        int nx = (xmax - xstart)/resolution+windowSize*2;
+        int ny = (ymax - ystart)/resolution+windowSize*2;
+        std::vector<float> cell(nx*ny, std::numeric_limits<float>::quiet_NaN());
+        for (unsigned int i = 0; i < npoints; i++) {
+            const float *p = &input[i*4];
+            if (std::isnan(p[0]) || std::isnan(p[1]) || std::isnan(p[2])) continue;
+            int ix, iy, d = dilation ? 2 : 1;
+            if (dilation) {
+                ix = floor((p[0] - xstart)/resolution); iy = floor((p[1] - ystart)/resolution);
+            } else {
+                ix = round((p[0] - xstart)/resolution); iy = round((p[1] - ystart)/resolution);
+            }
+            for (int j = 0; j < d; j++) {
+                for (int k = 0; k < d; k++) {
+                    float& c = cell[ix+j + nx*(iy+k)];
+                    if (std::isnan(c) || p[2] > c) c = p[2];
+                }
+            }
+        }
+        o_points.resize(nx*ny*4);
+        unsigned int n = 0;
+        int whalf = windowSize/2;
+        for (int x = whalf; x < nx-whalf; x++) {
+            for (int y = whalf; y < ny-whalf; y++) {
+                int cnt = 0;
+                double zsum = 0;
+                for (int dx = -whalf; dx <= whalf; dx++) {
+                    for (int dy = -whalf; dy < whalf; dy++) {
+                        float c = cell[x + dx + nx*(y + dy)];
+                        if (!std::isnan(c)) { zsum += c; cnt++; }
+                    }
+                }
+                if (cnt) {
+                    float *dst = &o_points[n*4];
+                    dst[0] = xstart + resolution*x; dst[1] = ystart + resolution*y; dst[2] = zsum/cnt;
+                    n++;
+                }
+            }
+        }
+        return n;
+    };
+    unsigned int build (HeightMap& map)
+    {
+        unsigned int n = 0;
+        struct timeval t1, t2;
+        gettimeofday(&t1, NULL);
+        for (int i = 0; i < nloop; i++) {
+            if (!map.update((const unsigned char *)&input[0], npoints, 16)) return 0;
+            output.resize(map.maxFilteredPoints()*4);
+            n = map.filter(&output[0]);
+        }
+        gettimeofday(&t2, NULL);
+        double dt = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec)/1e6;
+        std::cerr << "[testHeightMap]   " << npoints << " -> " << n << " points, window = "
+                  << windowSize << ", " << dt/nloop*1e3 << " [ms/frame]" << std::endl;
+        return n;
+    };
+    bool compare (bool dilation, HeightMap& map)
+    {
+        std::vector<float> expected;
+        unsigned int n1 = reference(dilation, expected);
+        map.setDilation(dilation);
+        unsigned int n2 = build(map);
+        if (n1 != n2) {
+            std::cerr << "[testHeightMap]   expected " << n1 << " points" << std::endl;
+            return false;
+        }
+        for (unsigned int i = 0; i < n1*4; i++) {
+            if (i%4 == 3) continue;
+            if (fabs(expected[i] - output[i]) > 1e-5) {
+                std::cerr << "[testHeightMap]   point " << i/4 << " differs" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+public:
+    std::vector<std::string> arg_strs;
+    testHeightMap () : resolution(0.01), windowSize(4), npoints(100000), nthreads(1), nloop(10) {};
+    bool test0 ()
+    {
+        std::cerr << "test0 : compare with averaging over the window" << std::endl;
+        parse_params();
+        gen_points();
+        HeightMap map;
+        map.setResolution(resolution);
+        map.setWindowSize(windowSize);
+        map.setNumThreads(nthreads);
+        if (!compare(false, map) || !compare(true, map)) return false;
+        // the cost doesn't depend on the window size
+        for (windowSize = 8; windowSize <= 32; windowSize *= 2) {
+            map.setWindowSize(windowSize);
+            if (!compare(false, map)) return false;
+        }
+        return true;
+    };
+    bool test1 ()
+    {
+        std::cerr << "test1 : a single point" << std::endl;
+        parse_params();
+        HeightMap map;
+        map.setResolution(resolution);
+        map.setWindowSize(windowSize);
+        std::vector<float> points;
+        add_point(points, 50.3*resolution, -20.7*resolution, 0.25);
+        // one cell, whose center is the nearest to the point
+        unsigned int n = filter(map, points);
+        if (count_cells(map) != 1) {
+            std::cerr << "[testHeightMap]   " << count_cells(map) << " cells are not empty" << std::endl;
+            return false;
+        }
+        // every window which includes the cell
+        int whalf = windowSize/2;
+        if (n != (unsigned int)(2*whalf+1)*(2*whalf)) {
+            std::cerr << "[testHeightMap]   " << n << " points are averaged" << std::endl;
+            return false;
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            const float *p = &output[i*4];
+            if (p[2] != 0.25f || fabs(p[0] - points[0]) > (whalf+0.5)*resolution
+                || p[1] - points[1] > (whalf+0.5)*resolution || points[1] - p[1] > (whalf-0.5)*resolution) {
+                std::cerr << "[testHeightMap]   unexpected point " << p[0] << " " << p[1] << " " << p[2] << std::endl;
+                return false;
+            }
+        }
+        // 2x2 cells around the point with dilation
+        map.setDilation(true);
+        filter(map, points);
+        if (count_cells(map) != 4) {
+            std::cerr << "[testHeightMap]   " << count_cells(map) << " cells are not empty with dilation" << std::endl;
+            return false;
+        }
+        for (int y = 0; y < map.height(); y++) {
+            for (int x = 0; x < map.width(); x++) {
+                if (std::isnan(map.cells()[x + map.width()*y])) continue;
+                double cx = map.originX() + x*resolution, cy = map.originY() + y*resolution;
+                if (fabs(cx - points[0]) > resolution || fabs(cy - points[1]) > resolution) {
+                    std::cerr << "[testHeightMap]   unexpected cell " << x << " " << y << std::endl;
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    bool test2 ()
+    {
+        std::cerr << "test2 : no valid point" << std::endl;
+        parse_params();
+        HeightMap map;
+        map.setResolution(resolution);
+        map.setWindowSize(windowSize);
+        std::vector<float> points;
+        add_point(points, 0.1, 0.1, 0.1);
+        if (!filter(map, points)) return false;
+        // the grid of the last frame is not kept
+        points.clear();
+        if (map.update(NULL, 0, 16) || map.maxFilteredPoints() != 0) {
+            std::cerr << "[testHeightMap]   empty input makes a grid" << std::endl;
+            return false;
+        }
+        float nan = std::numeric_limits<float>::quiet_NaN();
+        add_point(points, nan, 0.1, 0.1);
+        add_point(points, 0.1, nan, 0.1);
+        add_point(points, 0.1, 0.1, nan);
+        if (map.update((const unsigned char *)&points[0], points.size()/4, 16) || map.maxFilteredPoints() != 0) {
+            std::cerr << "[testHeightMap]   points with NaN make a grid" << std::endl;
+            return false;
+        }
+        return true;
+    };
+    bool test3 ()
+    {
+        std::cerr << "test3 : empty cells" << std::endl;
+        parse_params();
+        HeightMap map;
+        map.setResolution(resolution);
+        map.setWindowSize(windowSize);
+        int whalf = windowSize/2;
+        // two points in neighboring cells
+        std::vector<float> points;
+        add_point(points, 0.2*resolution, 0.2*resolution, 0);
+        add_point(points, 1.2*resolution, 0.2*resolution, 1);
+        unsigned int n = filter(map, points);
+        unsigned int nboth = 0;
+        for (unsigned int i = 0; i < n; i++) {
+            float z = output[i*4+2];
+            if (z == 0.5f) nboth++;
+            else if (z != 0 && z != 1) {
+                std::cerr << "[testHeightMap]   empty cells are averaged (" << z << ")" << std::endl;
+                return false;
+            }
+        }
+        // windows which include both, and either of them
+        unsigned int nwindow = (2*whalf+1)*(2*whalf), nexpected = (2*whalf)*(2*whalf);
+        if (nboth != nexpected || n != 2*nwindow - nexpected) {
+            std::cerr << "[testHeightMap]   " << nboth << " of " << n << " points are averaged over both" << std::endl;
+            return false;
+        }
+        // windows over the gap between two patches are skipped
+        points.clear();
+        srand(0);
+        for (int i = 0; i < 1000; i++) {
+            add_point(points, uniform(0, 0.1), uniform(0, 0.1), 0);
+            add_point(points, uniform(0.3, 0.4), uniform(0, 0.1), 1);
+        }
+        n = filter(map, points);
+        for (unsigned int i = 0; i < n; i++) {
+            const float *p = &output[i*4];
+            bool near0 = p[0] < 0.1 + (whalf+1)*resolution, near1 = p[0] > 0.3 - (whalf+1)*resolution;
+            if (near0 == near1 || p[2] != (near0 ? 0.0f : 1.0f)) {
+                std::cerr << "[testHeightMap]   unexpected point " << p[0] << " " << p[1] << " " << p[2] << std::endl;
+                return false;
+            }
+        }
+        return n > 0;
+    };
+    bool test4 ()
+    {
+        std::cerr << "test4 : points on the border of bands" << std::endl;
+        parse_params();
+        // a narrow grid, whose rows are split into bands of a few rows, and
+        // 2x2 cells of most points straddle two bands with dilation
+        std::vector<float> points;
+        srand(0);
+        for (int i = 0; i < 2000; i++) add_point(points, uniform(0, 0.5), uniform(0, 0.1), uniform(0, 0.1));
+        HeightMap map;
+        map.setResolution(resolution);
+        map.setWindowSize(windowSize);
+        map.setDilation(true);
+        unsigned int n1 = filter(map, points);
+        std::vector<float> cells1(map.cells(), map.cells() + map.width()*map.height()), output1(output);
+        for (int i = 2; i <= 6; i++) {
+            map.setNumThreads(i);
+            unsigned int n2 = filter(map, points);
+            if (n1 != n2 || memcmp(map.cells(), &cells1[0], cells1.size()*sizeof(float)) != 0
+                || memcmp(&output[0], &output1[0], n1*16) != 0) {
+                std::cerr << "[testHeightMap]   results differ with " << i << " threads" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+    void parse_params ()
+    {
+      for (unsigned int i = 0; i < arg_strs.size(); ++ i) {
+          if ( arg_strs[i]== "--resolution" ) {
+              if (++i < arg_strs.size()) resolution = atof(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--window" ) {
+              if (++i < arg_strs.size()) windowSize = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--points" ) {
+              if (++i < arg_strs.size()) npoints = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--threads" ) {
+              if (++i < arg_strs.size()) nthreads = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--loop" ) {
+              if (++i < arg_strs.size()) nloop = atoi(arg_strs[i].c_str());
+          }
+      }
+      std::cerr << "[testHeightMap] params" << std::endl;
+      std::cerr << "[testHeightMap]   resolution = " << resolution << "[m], window = " << windowSize << ", points = " << npoints << ", threads = " << nthreads << std::endl;
+    };
+};
+
+void print_usage ()
+{
+    std::cerr << "Usage : testHeightMap [option]" << std::endl;
+    std::cerr << " [option] should be:" << std::endl;
+    std::cerr << "  --test0 : compare with averaging over the window" << std::endl;
+    std::cerr << "  --test1 : a single point" << std::endl;
+    std::cerr << "  --test2 : no valid point" << std::endl;
+    std::cerr << "  --test3 : empty cells" << std::endl;
+    std::cerr << "  --test4 : points on the border of bands" << std::endl;
+};
+
+int main(int argc, char* argv[])
+{
+    int ret = 0;
+    if (argc >= 2) {
+        testHeightMap thm;
+        for (int i = 1; i < argc; ++ i) {
+            thm.arg_strs.push_back(std::string(argv[i]));
+        }
+        if (std::string(argv[1]) == "--test0") {
+            if (!thm.test0()) ret = 1;
+        } else if (std::string(argv[1]) == "--test1") {
+            if (!thm.test1()) ret = 1;
+        } else if (std::string(argv[1]) == "--test2") {
+            if (!thm.test2()) ret = 1;
+        } else if (std::string(argv[1]) == "--test3") {
+            if (!thm.test3()) ret = 1;
+        } else if (std::string(argv[1]) == "--test4") {
+            if (!thm.test4()) ret = 1;
+        } else {
+            print_usage();
+            ret = 1;
+        }
+    } else {
+        print_usage();
+        ret = 1;
+    }
+    return ret;
+}
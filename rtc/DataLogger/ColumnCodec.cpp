@@ -0,0 +1,272 @@
+#include <cstring>
+#include "ColumnCodec.h"
+
+namespace {
+    uint64_t toBits(double v)
+    {
+        uint64_t b;
+        memcpy(&b, &v, sizeof(b));
+        return b;
+    }
+
+    double fromBits(uint64_t b)
+    {
+        double v;
+        memcpy(&v, &b, sizeof(v));
+        return v;
+    }
+
+    int leadingZeros(uint64_t v)
+    {
+        int n = 0;
+        while (!(v & 0x8000000000000000ULL)){ v <<= 1; n++; }
+        return n;
+    }
+
+    int trailingZeros(uint64_t v)
+    {
+        int n = 0;
+        while (!(v & 1)){ v >>= 1; n++; }
+        return n;
+    }
+
+    uint64_t zigzag(int64_t v)
+    {
+        return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    }
+
+    int64_t unzigzag(uint64_t v)
+    {
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+}
+
+BitWriter::BitWriter(std::vector<unsigned char>& o_buf) :
+    m_buf(o_buf), m_acc(0), m_nacc(0)
+{
+}
+
+void BitWriter::write(uint64_t i_bits, int i_n)
+{
+    while (i_n > 0){
+        int k = 8 - m_nacc;
+        if (k > i_n) k = i_n;
+        m_acc = (m_acc << k) | ((i_bits >> (i_n - k)) & ((1u << k) - 1));
+        m_nacc += k;
+        i_n -= k;
+        if (m_nacc == 8){
+            m_buf.push_back((unsigned char)m_acc);
+            m_acc = 0;
+            m_nacc = 0;
+        }
+    }
+}
+
+void BitWriter::flush()
+{
+    if (m_nacc) write(0, 8 - m_nacc);
+}
+
+BitReader::BitReader(const unsigned char *i_buf, size_t i_len) :
+    m_buf(i_buf), m_len(i_len), m_pos(0), m_acc(0), m_nacc(0),
+    m_overrun(false)
+{
+}
+
+uint64_t BitReader::read(int i_n)
+{
+    uint64_t v = 0;
+    while (i_n > 0){
+        if (!m_nacc){
+            if (m_pos >= m_len){
+                m_overrun = true;
+                return 0;
+            }
+            m_acc = m_buf[m_pos++];
+            m_nacc = 8;
+        }
+        int k = m_nacc < i_n ? m_nacc : i_n;
+        v = (v << k) | ((m_acc >> (m_nacc - k)) & ((1u << k) - 1));
+        m_nacc -= k;
+        i_n -= k;
+    }
+    return v;
+}
+
+TimeEncoder::TimeEncoder(BitWriter& io_writer) :
+    m_writer(io_writer), m_prev(0), m_delta(0), m_n(0)
+{
+}
+
+void TimeEncoder::encode(int64_t i_t)
+{
+    if (m_n++ == 0){
+        m_writer.write((uint64_t)i_t, 64);
+        m_prev = i_t;
+        return;
+    }
+    int64_t delta = i_t - m_prev;
+    uint64_t z = zigzag(delta - m_delta);
+    if (z == 0){
+        m_writer.write(0, 1);
+    }else if (z < (1ULL << 16)){
+        m_writer.write(2, 2);
+        m_writer.write(z, 16);
+    }else if (z < (1ULL << 24)){
+        m_writer.write(6, 3);
+        m_writer.write(z, 24);
+    }else if (z < (1ULL << 32)){
+        m_writer.write(14, 4);
+        m_writer.write(z, 32);
+    }else{
+        m_writer.write(15, 4);
+        m_writer.write(z, 64);
+    }
+    m_prev = i_t;
+    m_delta = delta;
+}
+
+TimeDecoder::TimeDecoder(BitReader& io_reader) :
+    m_reader(io_reader), m_prev(0), m_delta(0), m_n(0)
+{
+}
+
+int64_t TimeDecoder::decode()
+{
+    if (m_n++ == 0){
+        m_prev = (int64_t)m_reader.read(64);
+        return m_prev;
+    }
+    int nbits = 0;
+    if (m_reader.read(1)){
+        if (!m_reader.read(1)){
+            nbits = 16;
+        }else if (!m_reader.read(1)){
+            nbits = 24;
+        }else if (!m_reader.read(1)){
+            nbits = 32;
+        }else{
+            nbits = 64;
+        }
+    }
+    if (nbits) m_delta += unzigzag(m_reader.read(nbits));
+    m_prev += m_delta;
+    return m_prev;
+}
+
+ValueEncoder::ValueEncoder(BitWriter& io_writer) :
+    m_writer(io_writer), m_prev(0), m_leading(-1), m_trailing(0),
+    m_first(true)
+{
+}
+
+void ValueEncoder::encode(double i_v)
+{
+    uint64_t bits = toBits(i_v);
+    if (m_first){
+        m_writer.write(bits, 64);
+        m_prev = bits;
+        m_first = false;
+        return;
+    }
+    uint64_t x = bits ^ m_prev;
+    m_prev = bits;
+    if (!x){
+        m_writer.write(0, 1);
+        return;
+    }
+    int leading = leadingZeros(x), trailing = trailingZeros(x);
+    if (leading > 31) leading = 31;
+    if (m_leading >= 0 && leading >= m_leading && trailing >= m_trailing){
+        // fits in the previous window
+        m_writer.write(2, 2);
+        m_writer.write(x >> m_trailing, 64 - m_leading - m_trailing);
+    }else{
+        int len = 64 - leading - trailing;
+        m_writer.write(3, 2);
+        m_writer.write(leading, 5);
+        m_writer.write(len - 1, 6);
+        m_writer.write(x >> trailing, len);
+        m_leading = leading;
+        m_trailing = trailing;
+    }
+}
+
+ValueDecoder::ValueDecoder(BitReader& io_reader) :
+    m_reader(io_reader), m_prev(0), m_leading(0), m_trailing(0),
+    m_first(true)
+{
+}
+
+double ValueDecoder::decode()
+{
+    if (m_first){
+        m_prev = m_reader.read(64);
+        m_first = false;
+        return fromBits(m_prev);
+    }
+    if (m_reader.read(1)){
+        if (m_reader.read(1)){
+            m_leading = m_reader.read(5);
+            int len = m_reader.read(6) + 1;
+            m_trailing = 64 - m_leading - len;
+        }
+        m_prev ^= m_reader.read(64 - m_leading - m_trailing) << m_trailing;
+    }
+    return fromBits(m_prev);
+}
+
+void encodeColumns(const int64_t *i_times, const double *i_values,
+                   unsigned int i_n, unsigned int i_width,
+                   unsigned int i_stride, std::vector<unsigned char>& o_buf,
+                   std::vector<unsigned int>& o_offsets)
+{
+    BitWriter writer(o_buf);
+    TimeEncoder te(writer);
+    for (unsigned int i=0; i<i_n; i++) te.encode(i_times[i]);
+    writer.flush();
+    o_offsets.resize(i_width);
+    for (unsigned int c=0; c<i_width; c++){
+        o_offsets[c] = o_buf.size();
+        ValueEncoder ve(writer);
+        const double *v = i_values + c*i_stride;
+        for (unsigned int i=0; i<i_n; i++) ve.encode(v[i]);
+        writer.flush();
+    }
+}
+
+bool decodeColumns(const unsigned char *i_buf, size_t i_len,
+                   unsigned int i_n, unsigned int i_width,
+                   unsigned int i_stride, int64_t *o_times, double *o_values)
+{
+    BitReader reader(i_buf, i_len);
+    TimeDecoder td(reader);
+    for (unsigned int i=0; i<i_n; i++) o_times[i] = td.decode();
+    reader.align();
+    for (unsigned int c=0; c<i_width; c++){
+        ValueDecoder vd(reader);
+        double *v = o_values + c*i_stride;
+        for (unsigned int i=0; i<i_n; i++) v[i] = vd.decode();
+        reader.align();
+    }
+    return !reader.overrun();
+}
+
+bool decodeTimes(const unsigned char *i_buf, size_t i_len,
+                 unsigned int i_n, int64_t *o_times)
+{
+    BitReader reader(i_buf, i_len);
+    TimeDecoder td(reader);
+    for (unsigned int i=0; i<i_n; i++) o_times[i] = td.decode();
+    return !reader.overrun();
+}
+
+bool decodeColumn(const unsigned char *i_buf, size_t i_len,
+                  unsigned int i_offset, unsigned int i_n, double *o_values)
+{
+    if (i_offset > i_len) return false;
+    BitReader reader(i_buf + i_offset, i_len - i_offset);
+    ValueDecoder vd(reader);
+    for (unsigned int i=0; i<i_n; i++) o_values[i] = vd.decode();
+    return !reader.overrun();
+}
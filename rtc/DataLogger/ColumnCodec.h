@@ -0,0 +1,138 @@
+// -*- C++ -*-
+/*!
+ * @file  ColumnCodec.h
+ * @brief compression of time series
+ */
+#ifndef COLUMN_CODEC_H
+#define COLUMN_CODEC_H
+
+#include <vector>
+#include <stdint.h>
+
+/**
+   \brief write bits into a byte array, MSB first
+ */
+class BitWriter
+{
+public:
+    BitWriter(std::vector<unsigned char>& o_buf);
+    void write(uint64_t i_bits, int i_n);
+    void flush();
+private:
+    std::vector<unsigned char>& m_buf;
+    uint64_t m_acc;
+    int m_nacc;
+};
+
+/**
+   \brief read bits written by BitWriter
+ */
+class BitReader
+{
+public:
+    BitReader(const unsigned char *i_buf, size_t i_len);
+    uint64_t read(int i_n);
+    /**
+       \brief skip bits to the next byte boundary
+     */
+    void align() { m_nacc = 0; }
+    bool overrun() const { return m_overrun; }
+private:
+    const unsigned char *m_buf;
+    size_t m_len, m_pos;
+    uint64_t m_acc;
+    int m_nacc;
+    bool m_overrun;
+};
+
+/**
+   \brief timestamps encoded by delta of delta
+
+   Timestamps are given in nanoseconds. The first one is written as it is,
+   the second one as a delta and the others as differences of deltas which
+   are zero for periodic samples.
+ */
+class TimeEncoder
+{
+public:
+    TimeEncoder(BitWriter& io_writer);
+    void encode(int64_t i_t);
+private:
+    BitWriter& m_writer;
+    int64_t m_prev, m_delta;
+    unsigned int m_n;
+};
+
+class TimeDecoder
+{
+public:
+    TimeDecoder(BitReader& io_reader);
+    int64_t decode();
+private:
+    BitReader& m_reader;
+    int64_t m_prev, m_delta;
+    unsigned int m_n;
+};
+
+/**
+   \brief doubles encoded by XOR with the previous value
+
+   Only the meaningful bits of the XOR are written. The window of the
+   meaningful bits is reused while they fit in it.
+ */
+class ValueEncoder
+{
+public:
+    ValueEncoder(BitWriter& io_writer);
+    void encode(double i_v);
+private:
+    BitWriter& m_writer;
+    uint64_t m_prev;
+    int m_leading, m_trailing;
+    bool m_first;
+};
+
+class ValueDecoder
+{
+public:
+    ValueDecoder(BitReader& io_reader);
+    double decode();
+private:
+    BitReader& m_reader;
+    uint64_t m_prev;
+    int m_leading, m_trailing;
+    bool m_first;
+};
+
+/**
+   \brief encode samples. Timestamps are written first, then each column.
+   Each of them starts at a byte boundary, so a column can be decoded
+   alone
+   \param i_values column-major values, i_values[c*i_stride+i] is the c-th
+   element of the i-th sample
+   \param o_offsets offsets of columns in o_buf[byte]
+ */
+void encodeColumns(const int64_t *i_times, const double *i_values,
+                   unsigned int i_n, unsigned int i_width,
+                   unsigned int i_stride, std::vector<unsigned char>& o_buf,
+                   std::vector<unsigned int>& o_offsets);
+/**
+   \brief decode samples encoded by encodeColumns()
+   \return false if the data is broken
+ */
+bool decodeColumns(const unsigned char *i_buf, size_t i_len,
+                   unsigned int i_n, unsigned int i_width,
+                   unsigned int i_stride, int64_t *o_times, double *o_values);
+/**
+   \brief decode timestamps only
+ */
+bool decodeTimes(const unsigned char *i_buf, size_t i_len,
+                 unsigned int i_n, int64_t *o_times);
+/**
+   \brief decode a column
+   \param i_offset offset of the column given by encodeColumns()
+ */
+bool decodeColumn(const unsigned char *i_buf, size_t i_len,
+                  unsigned int i_offset, unsigned int i_n, double *o_values);
+
+#endif
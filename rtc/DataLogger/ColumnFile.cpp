@@ -0,0 +1,355 @@
+#include <cstring>
+#include "ColumnCodec.h"
+#include "ColumnFile.h"
+
+namespace {
+    const char FILE_MAGIC[] = "HRPCLOG1";
+    const char INDEX_MAGIC[] = "HRPCIDX1";
+    const char CHUNK_MAGIC[] = "CHNK";
+    const uint32_t VERSION = 1;
+    const uint32_t FLAG_INTEGER = 1;
+    // "CHNK", width, size, length of data, tmin, tmax
+    const unsigned int CHUNK_HEADER_SIZE = 4 + 4*3 + 8*2;
+    // offset, tmin, tmax, size, width
+    const unsigned int INDEX_ENTRY_SIZE = 8*3 + 4*2;
+    // offset of the index, the number of chunks, magic
+    const unsigned int TRAILER_SIZE = 8 + 8 + 8;
+    const int64_t NSEC = 1000000000LL;
+
+    // saturated far below the limit of int64_t, so that sums and
+    // differences with timestamps don't overflow
+    const double MAX_NSEC = 4e18;
+
+    int64_t toNsec(double i_t)
+    {
+        double t = i_t*NSEC + (i_t >= 0 ? 0.5 : -0.5);
+        if (t > MAX_NSEC) t = MAX_NSEC;
+        if (t < -MAX_NSEC) t = -MAX_NSEC;
+        return (int64_t)t;
+    }
+
+    double toSec(int64_t i_t)
+    {
+        return (double)(i_t/NSEC) + (i_t%NSEC)/1e9;
+    }
+
+    template <class T>
+    void put(std::ostream& os, const T& v)
+    {
+        os.write((const char *)&v, sizeof(T));
+    }
+
+    template <class T>
+    bool get(std::istream& is, T& v)
+    {
+        return is.read((char *)&v, sizeof(T)).good();
+    }
+}
+
+ColumnFileWriter::ColumnFileWriter() : m_chunk(0)
+{
+}
+
+ColumnFileWriter::~ColumnFileWriter()
+{
+    if (isOpen()) close();
+}
+
+bool ColumnFileWriter::open(const std::string& i_filename,
+                            const std::string& i_name, bool i_integer)
+{
+    if (isOpen()) close();
+    m_ofs.open(i_filename.c_str(), std::ios::out | std::ios::binary
+               | std::ios::trunc);
+    if (!m_ofs.is_open()) return false;
+    m_index.clear();
+    m_chunk = ColumnChunk(0);
+    m_ofs.write(FILE_MAGIC, 8);
+    put(m_ofs, VERSION);
+    put(m_ofs, i_integer ? FLAG_INTEGER : (uint32_t)0);
+    put(m_ofs, (uint32_t)i_name.size());
+    m_ofs.write(i_name.c_str(), i_name.size());
+    return m_ofs.good();
+}
+
+void ColumnFileWriter::append(int64_t i_time, const double *i_values,
+                              unsigned int i_width)
+{
+    if (m_chunk.width != i_width || m_chunk.size == ColumnChunk::CAPACITY){
+        flush();
+        if (m_chunk.width != i_width) m_chunk = ColumnChunk(i_width);
+    }
+    unsigned int i = m_chunk.size;
+    m_chunk.times[i] = i_time;
+    for (unsigned int j=0; j<i_width; j++){
+        m_chunk.values[j*ColumnChunk::CAPACITY + i] = i_values[j];
+    }
+    m_chunk.size = i+1;
+}
+
+void ColumnFileWriter::append(const ColumnChunk& i_chunk)
+{
+    if (!i_chunk.compressed){
+        m_values.resize(i_chunk.width);
+        for (unsigned int i=0; i<i_chunk.size; i++){
+            for (unsigned int j=0; j<i_chunk.width; j++){
+                m_values[j] = i_chunk.values[j*ColumnChunk::CAPACITY + i];
+            }
+            append(i_chunk.times[i], i_chunk.width ? &m_values[0] : NULL,
+                   i_chunk.width);
+        }
+        return;
+    }
+    // keep the order of samples
+    flush();
+    writeChunk(i_chunk);
+}
+
+void ColumnFileWriter::flush()
+{
+    if (!m_chunk.size) return;
+    writeChunk(*compressChunk(m_chunk));
+    m_chunk.size = 0;
+}
+
+void ColumnFileWriter::writeChunk(const ColumnChunk& i_chunk)
+{
+    if (!i_chunk.size) return;
+    IndexEntry e;
+    e.offset = m_ofs.tellp();
+    e.tmin = i_chunk.tmin;
+    e.tmax = i_chunk.tmax;
+    e.size = i_chunk.size;
+    e.width = i_chunk.width;
+    m_index.push_back(e);
+
+    m_ofs.write(CHUNK_MAGIC, 4);
+    put(m_ofs, e.width);
+    put(m_ofs, e.size);
+    put(m_ofs, (uint32_t)i_chunk.data.size());
+    put(m_ofs, e.tmin);
+    put(m_ofs, e.tmax);
+    for (unsigned int k=0; k<i_chunk.width; k++){
+        put(m_ofs, (uint32_t)i_chunk.offsets[k]);
+    }
+    if (i_chunk.width){
+        m_ofs.write((const char *)&i_chunk.mins[0],
+                    sizeof(double)*i_chunk.width);
+        m_ofs.write((const char *)&i_chunk.maxs[0],
+                    sizeof(double)*i_chunk.width);
+    }
+    if (!i_chunk.data.empty()){
+        m_ofs.write((const char *)&i_chunk.data[0], i_chunk.data.size());
+    }
+}
+
+bool ColumnFileWriter::close()
+{
+    if (!isOpen()) return false;
+    flush();
+    uint64_t offset = m_ofs.tellp();
+    for (unsigned int i=0; i<m_index.size(); i++){
+        const IndexEntry& e = m_index[i];
+        put(m_ofs, e.offset);
+        put(m_ofs, e.tmin);
+        put(m_ofs, e.tmax);
+        put(m_ofs, e.size);
+        put(m_ofs, e.width);
+    }
+    put(m_ofs, offset);
+    put(m_ofs, (uint64_t)m_index.size());
+    m_ofs.write(INDEX_MAGIC, 8);
+    bool ret = m_ofs.good();
+    m_ofs.close();
+    return ret;
+}
+
+ColumnFileReader::ColumnFileReader() : m_integer(false), m_dataOffset(0)
+{
+}
+
+bool ColumnFileReader::open(const std::string& i_filename)
+{
+    close();
+    m_ifs.open(i_filename.c_str(), std::ios::in | std::ios::binary);
+    if (!m_ifs.is_open()) return false;
+    char magic[8];
+    uint32_t version, flags, len;
+    if (!m_ifs.read(magic, 8) || memcmp(magic, FILE_MAGIC, 8)
+        || !get(m_ifs, version) || version != VERSION
+        || !get(m_ifs, flags) || !get(m_ifs, len)){
+        close();
+        return false;
+    }
+    m_name.resize(len);
+    if (len && !m_ifs.read(&m_name[0], len)){
+        close();
+        return false;
+    }
+    m_integer = flags & FLAG_INTEGER;
+    m_dataOffset = m_ifs.tellg();
+    if (!readIndex() && !scan()){
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ColumnFileReader::close()
+{
+    if (m_ifs.is_open()) m_ifs.close();
+    m_ifs.clear();
+    m_name.clear();
+    m_index.clear();
+}
+
+bool ColumnFileReader::readIndex()
+{
+    m_ifs.clear();
+    m_ifs.seekg(0, std::ios::end);
+    uint64_t end = m_ifs.tellg();
+    if (end < m_dataOffset + TRAILER_SIZE) return false;
+    m_ifs.seekg(end - TRAILER_SIZE);
+    uint64_t offset, n;
+    char magic[8];
+    if (!get(m_ifs, offset) || !get(m_ifs, n) || !m_ifs.read(magic, 8)
+        || memcmp(magic, INDEX_MAGIC, 8)
+        || offset < m_dataOffset
+        || offset + n*INDEX_ENTRY_SIZE + TRAILER_SIZE != end){
+        return false;
+    }
+    m_ifs.seekg(offset);
+    m_index.resize(n);
+    for (unsigned int i=0; i<n; i++){
+        Entry& e = m_index[i];
+        if (!get(m_ifs, e.offset) || !get(m_ifs, e.tmin) || !get(m_ifs, e.tmax)
+            || !get(m_ifs, e.size) || !get(m_ifs, e.width)){
+            m_index.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ColumnFileReader::scan()
+{
+    m_index.clear();
+    m_ifs.clear();
+    m_ifs.seekg(0, std::ios::end);
+    uint64_t end = m_ifs.tellg();
+    m_ifs.seekg(m_dataOffset);
+    while (1){
+        Entry e;
+        e.offset = m_ifs.tellg();
+        char magic[4];
+        uint32_t len;
+        if (!m_ifs.read(magic, 4) || memcmp(magic, CHUNK_MAGIC, 4)
+            || !get(m_ifs, e.width) || !get(m_ifs, e.size) || !get(m_ifs, len)
+            || !get(m_ifs, e.tmin) || !get(m_ifs, e.tmax)){
+            break;
+        }
+        uint64_t next = e.offset + CHUNK_HEADER_SIZE
+            + e.width*(sizeof(uint32_t) + 2*sizeof(double)) + len;
+        // the last chunk may be truncated
+        if (next > end) break;
+        m_index.push_back(e);
+        m_ifs.seekg(next);
+    }
+    m_ifs.clear();
+    std::cerr << "index of " << m_name << " is not found, "
+              << m_index.size() << " chunks are recovered" << std::endl;
+    return !m_index.empty();
+}
+
+unsigned long ColumnFileReader::size() const
+{
+    unsigned long n = 0;
+    for (unsigned int i=0; i<m_index.size(); i++) n += m_index[i].size;
+    return n;
+}
+
+double ColumnFileReader::startTime() const
+{
+    return m_index.empty() ? 0 : toSec(m_index.front().tmin);
+}
+
+double ColumnFileReader::endTime() const
+{
+    return m_index.empty() ? 0 : toSec(m_index.back().tmax);
+}
+
+bool ColumnFileReader::readChunk(const Entry& i_entry, int i_column,
+                                 std::vector<int64_t>& o_times,
+                                 std::vector<double>& o_values)
+{
+    uint32_t width = i_entry.width;
+    m_ifs.clear();
+    // length of data
+    m_ifs.seekg(i_entry.offset + 4*3);
+    uint32_t len;
+    if (!get(m_ifs, len)) return false;
+    m_ifs.seekg(i_entry.offset + CHUNK_HEADER_SIZE);
+    std::vector<uint32_t> offsets(width);
+    for (unsigned int k=0; k<width; k++){
+        if (!get(m_ifs, offsets[k])) return false;
+    }
+    m_ifs.seekg(2*sizeof(double)*width, std::ios::cur);
+    m_data.resize(len);
+    if (len && !m_ifs.read((char *)&m_data[0], len)) return false;
+
+    unsigned int n = i_entry.size;
+    o_times.resize(n);
+    if (!n) return true;
+    if (i_column < 0){
+        o_values.resize(n*width);
+        return decodeColumns(&m_data[0], len, n, width, n, &o_times[0],
+                             width ? &o_values[0] : NULL);
+    }
+    o_values.resize(n);
+    return decodeTimes(&m_data[0], len, n, &o_times[0])
+        && decodeColumn(&m_data[0], len, offsets[i_column], n, &o_values[0]);
+}
+
+bool ColumnFileReader::read(double i_from, double i_to, int i_column,
+                            std::vector<double>& o_times,
+                            unsigned int& o_width,
+                            std::vector<double>& o_values)
+{
+    o_times.clear();
+    o_values.clear();
+    o_width = 0;
+    if (m_index.empty()) return false;
+    int64_t latest = m_index.back().tmax;
+    int64_t to = i_to > 0 ? toNsec(i_to) : latest;
+    int64_t from = i_from < 0 ? latest + toNsec(i_from) : toNsec(i_from);
+    if (from > to) return false;
+
+    // width of the last chunk in the range
+    int last = -1;
+    for (int i=m_index.size()-1; i>=0; i--){
+        if (m_index[i].tmin <= to && m_index[i].tmax >= from){
+            last = i;
+            break;
+        }
+    }
+    if (last < 0) return false;
+    unsigned int width = m_index[last].width;
+    if (i_column >= (int)width) return false;
+    o_width = i_column < 0 ? width : 1;
+
+    std::vector<int64_t> times;
+    std::vector<double> values;
+    for (int i=0; i<=last; i++){
+        const Entry& e = m_index[i];
+        if (e.width != width || e.tmax < from || e.tmin > to) continue;
+        if (!readChunk(e, i_column, times, values)) continue;
+        for (unsigned int j=0; j<e.size; j++){
+            if (times[j] < from || times[j] > to) continue;
+            o_times.push_back(toSec(times[j]));
+            for (unsigned int k=0; k<o_width; k++){
+                o_values.push_back(values[k*e.size+j]);
+            }
+        }
+    }
+    return !o_times.empty();
+}
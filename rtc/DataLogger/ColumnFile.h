@@ -0,0 +1,135 @@
+// -*- C++ -*-
+/*!
+ * @file  ColumnFile.h
+ * @brief compressed log files
+ *
+ * A file stores samples of a port and consists of
+ *  - a header : "HRPCLOG1", version(uint32), flags(uint32, 1 if elements
+ *    are integers), length of the port name(uint32) and the port name
+ *  - chunks : "CHNK", width(uint32), size(uint32), length of data(uint32),
+ *    tmin(int64), tmax(int64), offsets of columns in data(uint32 x width),
+ *    minimum and maximum values of columns(double x width x 2) and data
+ *    encoded by encodeColumns()
+ *  - an index : offset(uint64), tmin(int64), tmax(int64), size(uint32) and
+ *    width(uint32) of each chunk
+ *  - a trailer : offset of the index(uint64), the number of chunks(uint64)
+ *    and "HRPCIDX1"
+ * Integers are written in the byte order of the host. Time is given in
+ * nanoseconds. A file whose index is not written, e.g. when the writer is
+ * killed, can be read by scanning chunks.
+ */
+#ifndef COLUMN_FILE_H
+#define COLUMN_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "ColumnStore.h"
+
+/**
+   \brief streaming writer of a compressed log file
+
+   Samples are buffered in a chunk and it is compressed and written when it
+   becomes full. The writer can be used by any thread, but not by more than
+   one thread at the same time.
+ */
+class ColumnFileWriter
+{
+public:
+    ColumnFileWriter();
+    ~ColumnFileWriter();
+    /**
+       \param i_name name of the port
+       \param i_integer true if elements are integers
+     */
+    bool open(const std::string& i_filename, const std::string& i_name,
+              bool i_integer);
+    bool isOpen() const { return m_ofs.is_open(); }
+    void append(int64_t i_time, const double *i_values, unsigned int i_width);
+    /**
+       \brief append samples of a chunk. A compressed chunk is written as
+       it is
+     */
+    void append(const ColumnChunk& i_chunk);
+    /**
+       \brief write buffered samples and the index
+       \return false if writing failed
+     */
+    bool close();
+private:
+    struct IndexEntry
+    {
+        uint64_t offset;
+        int64_t tmin, tmax;
+        uint32_t size, width;
+    };
+    void flush();
+    void writeChunk(const ColumnChunk& i_chunk);
+
+    std::ofstream m_ofs;
+    ColumnChunk m_chunk;
+    std::vector<IndexEntry> m_index;
+    std::vector<double> m_values;
+};
+
+/**
+   \brief reader of a compressed log file
+
+   Only chunks which overlap the requested time range are read.
+ */
+class ColumnFileReader
+{
+public:
+    ColumnFileReader();
+    bool open(const std::string& i_filename);
+    void close();
+    const std::string& name() const { return m_name; }
+    bool integer() const { return m_integer; }
+    /**
+       \brief the number of samples
+     */
+    unsigned long size() const;
+    /**
+       \brief time of the first and the last samples [s]
+     */
+    double startTime() const;
+    double endTime() const;
+    /**
+       \brief read samples in a time range
+       \param i_from start time [s]. Negative value means time relative to
+       the last sample
+       \param i_to end time [s]. Zero or negative value means the last
+       sample
+       \param i_column index of the element to be read. All elements are
+       read if it is negative
+       \param o_width the number of elements of a sample in o_values. Samples
+       which have different numbers of elements from the last one in the
+       range are skipped
+       \param o_values o_values[i*o_width+c]
+       \return false if there is no sample in the range
+     */
+    bool read(double i_from, double i_to, int i_column,
+              std::vector<double>& o_times, unsigned int& o_width,
+              std::vector<double>& o_values);
+private:
+    struct Entry
+    {
+        uint64_t offset;
+        int64_t tmin, tmax;
+        uint32_t size, width;
+    };
+    bool readIndex();
+    bool scan();
+    bool readChunk(const Entry& i_entry, int i_column,
+                   std::vector<int64_t>& o_times,
+                   std::vector<double>& o_values);
+
+    std::ifstream m_ifs;
+    std::string m_name;
+    bool m_integer;
+    uint64_t m_dataOffset;
+    std::vector<Entry> m_index;
+    std::vector<unsigned char> m_data;
+};
+
+#endif
@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <iomanip>
+#include "ColumnCodec.h"
+#include "ColumnStore.h"
+#include "ColumnFile.h"
+
+typedef coil::Guard<coil::Mutex> Guard;
+
+namespace {
+    const int64_t NSEC = 1000000000LL;
+
+    // saturated far below the limit of int64_t, so that sums and
+    // differences with timestamps don't overflow
+    const double MAX_NSEC = 4e18;
+
+    int64_t toNsec(double i_t)
+    {
+        double t = i_t*NSEC + (i_t >= 0 ? 0.5 : -0.5);
+        if (t > MAX_NSEC) t = MAX_NSEC;
+        if (t < -MAX_NSEC) t = -MAX_NSEC;
+        return (int64_t)t;
+    }
+
+    double toSec(int64_t i_t)
+    {
+        return (double)(i_t/NSEC) + (i_t%NSEC)/1e9;
+    }
+
+    // index of the bucket of time i_t in buckets of i_span[ns] from i_from
+    unsigned int toBucket(int64_t i_t, int64_t i_from, double i_span,
+                          unsigned int i_buckets)
+    {
+        double b = (double)(i_t - i_from)*i_buckets/i_span;
+        if (b < 0) return 0;
+        if (b >= i_buckets) return i_buckets - 1;
+        return (unsigned int)b;
+    }
+}
+
+ColumnChunk::ColumnChunk(unsigned int i_width) :
+    width(i_width), size(0), tmin(0), tmax(0),
+    times(CAPACITY), values(CAPACITY*i_width), compressed(false)
+{
+}
+
+ColumnChunkPtr compressChunk(const ColumnChunk& i_raw)
+{
+    ColumnChunkPtr c(new ColumnChunk(0));
+    c->width = i_raw.width;
+    c->size = i_raw.size;
+    c->times.clear();
+    c->values.clear();
+    c->mins.resize(i_raw.width);
+    c->maxs.resize(i_raw.width);
+    if (i_raw.size){
+        c->tmin = c->tmax = i_raw.times[0];
+        for (unsigned int j=1; j<i_raw.size; j++){
+            if (i_raw.times[j] < c->tmin) c->tmin = i_raw.times[j];
+            if (i_raw.times[j] > c->tmax) c->tmax = i_raw.times[j];
+        }
+        for (unsigned int k=0; k<i_raw.width; k++){
+            const double *v = &i_raw.values[k*ColumnChunk::CAPACITY];
+            c->mins[k] = c->maxs[k] = v[0];
+            for (unsigned int j=1; j<i_raw.size; j++){
+                if (v[j] < c->mins[k]) c->mins[k] = v[j];
+                if (v[j] > c->maxs[k]) c->maxs[k] = v[j];
+            }
+        }
+    }
+    encodeColumns(&i_raw.times[0], i_raw.width ? &i_raw.values[0] : NULL,
+                  i_raw.size, i_raw.width, ColumnChunk::CAPACITY, c->data,
+                  c->offsets);
+    c->compressed = true;
+    return c;
+}
+
+ColumnStore::ColumnStore(bool i_integer) : m_integer(i_integer)
+{
+}
+
+void ColumnStore::append(int64_t i_time, const double *i_values,
+                         unsigned int i_width)
+{
+    ColumnChunk *c = m_current.get();
+    if (!c || c->width != i_width || c->size == ColumnChunk::CAPACITY){
+        ColumnChunkPtr next;
+        {
+            Guard guard(m_mutex);
+            if (m_spare && m_spare->width == i_width){
+                next = m_spare;
+                m_spare.reset();
+            }
+        }
+        // memory is allocated here only when compact() hasn't prepared it
+        if (!next) next = ColumnChunkPtr(new ColumnChunk(i_width));
+        {
+            Guard guard(m_mutex);
+            m_chunks.push_back(next);
+        }
+        m_current = next;
+        c = next.get();
+    }
+    unsigned int i = c->size;
+    c->times[i] = i_time;
+    for (unsigned int j=0; j<i_width; j++){
+        c->values[j*ColumnChunk::CAPACITY + i] = i_values[j];
+    }
+    // readers see the sample after it is written
+    __sync_synchronize();
+    c->size = i+1;
+}
+
+void ColumnStore::compact(unsigned int i_maxLength)
+{
+    std::vector<ColumnChunkPtr> full;
+    unsigned int width = 0;
+    bool needSpare = false;
+    {
+        Guard guard(m_mutex);
+        // chunks except the last one are not written any more
+        for (unsigned int i=0; i+1<m_chunks.size(); i++){
+            if (!m_chunks[i]->compressed) full.push_back(m_chunks[i]);
+        }
+        if (!m_chunks.empty()){
+            width = m_chunks.back()->width;
+            needSpare = !m_spare || m_spare->width != width;
+        }
+    }
+
+    std::vector<ColumnChunkPtr> packed(full.size());
+    for (unsigned int i=0; i<full.size(); i++){
+        packed[i] = compressChunk(*full[i]);
+    }
+    ColumnChunkPtr spare;
+    if (needSpare) spare = ColumnChunkPtr(new ColumnChunk(width));
+
+    // released after unlocking
+    std::vector<ColumnChunkPtr> dropped;
+    Guard guard(m_mutex);
+    // chunks may have been cleared meanwhile
+    for (unsigned int i=0, j=0; i<full.size() && j<m_chunks.size(); j++){
+        if (m_chunks[j] != full[i]) continue;
+        m_chunks[j] = packed[i++];
+    }
+    if (spare) m_spare = spare;
+    unsigned long total = 0;
+    for (unsigned int i=0; i<m_chunks.size(); i++) total += m_chunks[i]->size;
+    while (m_chunks.size() > 1 && total - m_chunks.front()->size >= i_maxLength){
+        total -= m_chunks.front()->size;
+        dropped.push_back(m_chunks.front());
+        m_chunks.pop_front();
+    }
+}
+
+void ColumnStore::clear()
+{
+    Guard guard(m_mutex);
+    m_chunks.clear();
+    m_current.reset();
+}
+
+void ColumnStore::snapshot(unsigned int i_maxLength,
+                           std::vector<ColumnChunkPtr>& o_chunks,
+                           std::vector<unsigned int>& o_sizes,
+                           unsigned int& o_skip)
+{
+    {
+        Guard guard(m_mutex);
+        o_chunks.assign(m_chunks.begin(), m_chunks.end());
+    }
+    unsigned long total = 0;
+    o_sizes.resize(o_chunks.size());
+    for (unsigned int i=0; i<o_chunks.size(); i++){
+        o_sizes[i] = o_chunks[i]->size;
+        total += o_sizes[i];
+    }
+    __sync_synchronize();
+    o_skip = total > i_maxLength ? total - i_maxLength : 0;
+}
+
+bool ColumnStore::decode(const ColumnChunkPtr& i_chunk, unsigned int i_size,
+                         ColumnBlock& o_block)
+{
+    const ColumnChunk& c = *i_chunk;
+    o_block.width = c.width;
+    o_block.size = i_size;
+    o_block.times.resize(i_size);
+    o_block.values.resize(i_size*c.width);
+    if (!i_size) return true;
+    if (c.compressed){
+        return decodeColumns(&c.data[0], c.data.size(), i_size, c.width,
+                             i_size, &o_block.times[0],
+                             c.width ? &o_block.values[0] : NULL);
+    }
+    std::copy(c.times.begin(), c.times.begin()+i_size, o_block.times.begin());
+    for (unsigned int k=0; k<c.width; k++){
+        std::vector<double>::const_iterator v
+            = c.values.begin() + k*ColumnChunk::CAPACITY;
+        std::copy(v, v+i_size, o_block.values.begin() + k*i_size);
+    }
+    return true;
+}
+
+bool ColumnStore::timeRange(double i_from, double i_to,
+                            const std::vector<ColumnChunkPtr>& i_chunks,
+                            const std::vector<unsigned int>& i_sizes,
+                            unsigned int i_skip, int64_t& o_from,
+                            int64_t& o_to, unsigned int& o_width)
+{
+    unsigned long total = 0;
+    for (unsigned int i=0; i<i_sizes.size(); i++) total += i_sizes[i];
+    if (total <= i_skip) return false;
+
+    // the latest sample
+    int n = i_chunks.size()-1;
+    while (!i_sizes[n]) n--;
+    const ColumnChunkPtr& last = i_chunks[n];
+    int64_t latest;
+    if (last->compressed){
+        latest = last->tmax;
+    }else{
+        latest = last->times[i_sizes[n]-1];
+    }
+    o_width = last->width;
+    o_to = i_to > 0 ? toNsec(i_to) : latest;
+    o_from = i_from < 0 ? latest + toNsec(i_from) : toNsec(i_from);
+    return o_from <= o_to;
+}
+
+bool ColumnStore::range(double i_from, double i_to, unsigned int i_maxLength,
+                        std::vector<double>& o_times, unsigned int& o_width,
+                        std::vector<double>& o_values)
+{
+    o_times.clear();
+    o_values.clear();
+    std::vector<ColumnChunkPtr> chunks;
+    std::vector<unsigned int> sizes;
+    unsigned int skip;
+    snapshot(i_maxLength, chunks, sizes, skip);
+    int64_t from, to;
+    if (!timeRange(i_from, i_to, chunks, sizes, skip, from, to, o_width)){
+        return false;
+    }
+
+    ColumnBlock block;
+    for (unsigned int i=0; i<chunks.size(); i++){
+        unsigned int first = skip < sizes[i] ? skip : sizes[i];
+        skip -= first;
+        const ColumnChunkPtr& c = chunks[i];
+        if (first == sizes[i] || c->width != o_width) continue;
+        if (c->compressed && (c->tmax < from || c->tmin > to)) continue;
+        if (!decode(c, sizes[i], block)) continue;
+        for (unsigned int j=first; j<block.size; j++){
+            int64_t t = block.times[j];
+            if (t < from || t > to) continue;
+            o_times.push_back(toSec(t));
+            for (unsigned int k=0; k<o_width; k++){
+                o_values.push_back(block.values[k*block.size+j]);
+            }
+        }
+    }
+    return !o_times.empty();
+}
+
+bool ColumnStore::envelope(double i_from, double i_to, unsigned int i_buckets,
+                           unsigned int i_maxLength,
+                           std::vector<double>& o_times, unsigned int& o_width,
+                           std::vector<double>& o_mins,
+                           std::vector<double>& o_maxs)
+{
+    o_times.clear();
+    o_mins.clear();
+    o_maxs.clear();
+    if (!i_buckets) return false;
+    std::vector<ColumnChunkPtr> chunks;
+    std::vector<unsigned int> sizes;
+    unsigned int skip;
+    snapshot(i_maxLength, chunks, sizes, skip);
+    int64_t from, to;
+    if (!timeRange(i_from, i_to, chunks, sizes, skip, from, to, o_width)){
+        return false;
+    }
+
+    double span = (double)(to - from) + 1;
+    std::vector<bool> filled(i_buckets, false);
+    std::vector<double> mins(i_buckets*o_width), maxs(i_buckets*o_width);
+    ColumnBlock block;
+    for (unsigned int i=0; i<chunks.size(); i++){
+        unsigned int first = skip < sizes[i] ? skip : sizes[i];
+        skip -= first;
+        const ColumnChunkPtr& c = chunks[i];
+        if (first == sizes[i] || c->width != o_width) continue;
+        if (c->compressed){
+            if (c->tmax < from || c->tmin > to) continue;
+            unsigned int b0 = toBucket(c->tmin, from, span, i_buckets);
+            unsigned int b1 = toBucket(c->tmax, from, span, i_buckets);
+            if (first == 0 && c->tmin >= from && c->tmax <= to && b0 == b1){
+                // ranges of the chunk are used without decoding it
+                double *mn = &mins[b0*o_width], *mx = &maxs[b0*o_width];
+                for (unsigned int k=0; k<o_width; k++){
+                    if (!filled[b0] || c->mins[k] < mn[k]) mn[k] = c->mins[k];
+                    if (!filled[b0] || c->maxs[k] > mx[k]) mx[k] = c->maxs[k];
+                }
+                filled[b0] = true;
+                continue;
+            }
+        }
+        if (!decode(c, sizes[i], block)) continue;
+        for (unsigned int j=first; j<block.size; j++){
+            int64_t t = block.times[j];
+            if (t < from || t > to) continue;
+            unsigned int b = toBucket(t, from, span, i_buckets);
+            double *mn = &mins[b*o_width], *mx = &maxs[b*o_width];
+            for (unsigned int k=0; k<o_width; k++){
+                double v = block.values[k*block.size+j];
+                if (!filled[b] || v < mn[k]) mn[k] = v;
+                if (!filled[b] || v > mx[k]) mx[k] = v;
+            }
+            filled[b] = true;
+        }
+    }
+    for (unsigned int b=0; b<i_buckets; b++){
+        if (!filled[b]) continue;
+        o_times.push_back(toSec(from + (int64_t)(b*span/i_buckets)));
+        o_mins.insert(o_mins.end(), &mins[b*o_width], &mins[b*o_width]+o_width);
+        o_maxs.insert(o_maxs.end(), &maxs[b*o_width], &maxs[b*o_width]+o_width);
+    }
+    return !o_times.empty();
+}
+
+void ColumnStore::dump(std::ostream& os, unsigned int i_maxLength)
+{
+    std::vector<ColumnChunkPtr> chunks;
+    std::vector<unsigned int> sizes;
+    unsigned int skip;
+    snapshot(i_maxLength, chunks, sizes, skip);
+
+    os.setf(std::ios::fixed, std::ios::floatfield);
+    ColumnBlock block;
+    for (unsigned int i=0; i<chunks.size(); i++){
+        unsigned int first = skip < sizes[i] ? skip : sizes[i];
+        skip -= first;
+        if (first == sizes[i] || !decode(chunks[i], sizes[i], block)) continue;
+        for (unsigned int j=first; j<block.size; j++){
+            // time
+            os << std::setprecision(6) << toSec(block.times[j]) << " ";
+            // data
+            for (unsigned int k=0; k<block.width; k++){
+                double v = block.values[k*block.size+j];
+                if (m_integer){
+                    os << (long)v << " ";
+                }else{
+                    os << v << " ";
+                }
+            }
+            os << std::endl;
+        }
+    }
+}
+
+void ColumnStore::write(ColumnFileWriter& o_writer, unsigned int i_maxLength)
+{
+    std::vector<ColumnChunkPtr> chunks;
+    std::vector<unsigned int> sizes;
+    unsigned int skip;
+    snapshot(i_maxLength, chunks, sizes, skip);
+
+    ColumnBlock block;
+    std::vector<double> v;
+    for (unsigned int i=0; i<chunks.size(); i++){
+        unsigned int first = skip < sizes[i] ? skip : sizes[i];
+        skip -= first;
+        const ColumnChunkPtr& c = chunks[i];
+        if (first == sizes[i]) continue;
+        if (c->compressed && first == 0){
+            o_writer.append(*c);
+            continue;
+        }
+        // partially dropped or still written, encoded by the writer
+        if (!decode(c, sizes[i], block)) continue;
+        v.resize(block.width);
+        for (unsigned int j=first; j<block.size; j++){
+            for (unsigned int k=0; k<block.width; k++){
+                v[k] = block.values[k*block.size+j];
+            }
+            o_writer.append(block.times[j], block.width ? &v[0] : NULL,
+                            block.width);
+        }
+    }
+}
+
+void ColumnStore::getStatistics(unsigned long& o_samples,
+                                unsigned long& o_rawBytes,
+                                unsigned long& o_compressedBytes)
+{
+    o_samples = o_rawBytes = o_compressedBytes = 0;
+    Guard guard(m_mutex);
+    for (unsigned int i=0; i<m_chunks.size(); i++){
+        const ColumnChunk& c = *m_chunks[i];
+        o_samples += c.size;
+        if (c.compressed){
+            o_compressedBytes += c.data.size();
+        }else{
+            o_rawBytes += c.times.size()*sizeof(int64_t)
+                + c.values.size()*sizeof(double);
+        }
+    }
+}
@@ -0,0 +1,152 @@
+// -*- C++ -*-
+/*!
+ * @file  ColumnStore.h
+ * @brief in-memory store of time series
+ */
+#ifndef COLUMN_STORE_H
+#define COLUMN_STORE_H
+
+#include <deque>
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <coil/Mutex.h>
+
+class ColumnFileWriter;
+
+/**
+   \brief a block of samples which have the same number of elements
+
+   Samples are written into raw arrays of a chunk until it becomes full.
+   Full chunks are compressed by ColumnStore::compact() and never modified
+   afterwards.
+ */
+struct ColumnChunk
+{
+    enum { CAPACITY = 256 };
+    ColumnChunk(unsigned int i_width);
+
+    unsigned int width;         ///< the number of elements of a sample
+    volatile unsigned int size; ///< the number of samples
+    int64_t tmin, tmax;         ///< time range [ns], valid when compressed
+    std::vector<double> mins, maxs; ///< ranges of columns, valid when compressed
+    std::vector<int64_t> times;     ///< raw timestamps [ns]
+    std::vector<double> values;     ///< raw values, values[c*CAPACITY+i]
+    std::vector<unsigned char> data; ///< compressed samples
+    std::vector<unsigned int> offsets; ///< offsets of columns in data
+    bool compressed;
+};
+typedef boost::shared_ptr<ColumnChunk> ColumnChunkPtr;
+
+/**
+   \brief compress samples of a chunk
+   \param i_raw a chunk which is not compressed
+   \return a new compressed chunk
+ */
+ColumnChunkPtr compressChunk(const ColumnChunk& i_raw);
+
+/**
+   \brief decoded samples of a chunk
+ */
+struct ColumnBlock
+{
+    unsigned int width, size;
+    std::vector<int64_t> times;
+    std::vector<double> values; ///< values[c*size+i]
+};
+
+/**
+   \brief time series of a logger port stored column by column
+
+   append() is called by the real-time thread. It takes the mutex only
+   when a chunk becomes full, just to publish a new one. Readers take the
+   mutex just to copy pointers of chunks and decode them without locking,
+   so queries never block logging.
+ */
+class ColumnStore
+{
+public:
+    /**
+       \param i_integer true if elements are integers. They are printed as
+       integers by dump()
+     */
+    ColumnStore(bool i_integer=false);
+    /**
+       \brief append a sample. Called by the thread which logs data
+     */
+    void append(int64_t i_time, const double *i_values, unsigned int i_width);
+    /**
+       \brief compress full chunks and drop chunks older than the latest
+       i_maxLength samples. Called by a non real-time thread
+     */
+    void compact(unsigned int i_maxLength);
+    /**
+       \brief discard all samples. Logging must be suspended
+     */
+    void clear();
+    /**
+       \brief get samples in a time range
+       \param i_from start time [s]. Negative value means time relative to
+       the latest sample
+       \param i_to end time [s]. Zero or negative value means the latest
+       sample
+       \param i_maxLength only the latest i_maxLength samples are read
+       \param o_width the number of elements of the latest sample. Samples
+       which have different numbers of elements are skipped
+       \param o_values values of samples, o_values[i*o_width+c]
+       \return false if there is no sample in the range
+     */
+    bool range(double i_from, double i_to, unsigned int i_maxLength,
+               std::vector<double>& o_times, unsigned int& o_width,
+               std::vector<double>& o_values);
+    /**
+       \brief get minimum and maximum values of samples in buckets which
+       divide a time range equally, to plot long series
+       \param i_buckets the number of buckets
+       \param o_times start time of each non-empty bucket [s]
+       \param o_mins, o_maxs o_mins[i*o_width+c] is the minimum of the c-th
+       element in the i-th non-empty bucket
+     */
+    bool envelope(double i_from, double i_to, unsigned int i_buckets,
+                  unsigned int i_maxLength, std::vector<double>& o_times,
+                  unsigned int& o_width, std::vector<double>& o_mins,
+                  std::vector<double>& o_maxs);
+    /**
+       \brief print the latest i_maxLength samples, one sample per line
+     */
+    void dump(std::ostream& os, unsigned int i_maxLength);
+    /**
+       \brief write the latest i_maxLength samples to a compressed log
+       file. Compressed chunks are written as they are
+     */
+    void write(ColumnFileWriter& o_writer, unsigned int i_maxLength);
+    /**
+       \brief true if elements are integers
+     */
+    bool integer() const { return m_integer; }
+    /**
+       \brief the number of samples and bytes of raw and compressed data
+     */
+    void getStatistics(unsigned long& o_samples, unsigned long& o_rawBytes,
+                       unsigned long& o_compressedBytes);
+private:
+    void snapshot(unsigned int i_maxLength,
+                  std::vector<ColumnChunkPtr>& o_chunks,
+                  std::vector<unsigned int>& o_sizes, unsigned int& o_skip);
+    bool timeRange(double i_from, double i_to,
+                   const std::vector<ColumnChunkPtr>& i_chunks,
+                   const std::vector<unsigned int>& i_sizes,
+                   unsigned int i_skip, int64_t& o_from, int64_t& o_to,
+                   unsigned int& o_width);
+    static bool decode(const ColumnChunkPtr& i_chunk, unsigned int i_size,
+                       ColumnBlock& o_block);
+
+    bool m_integer;
+    coil::Mutex m_mutex;
+    std::deque<ColumnChunkPtr> m_chunks; // the last one is written
+    ColumnChunkPtr m_current; // accessed by append() only
+    ColumnChunkPtr m_spare; // prepared by compact() to be used by append()
+};
+
+#endif
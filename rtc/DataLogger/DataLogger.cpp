@@ -8,6 +8,7 @@
  */
 
 #include "DataLogger.h"
+#include "ColumnFile.h"
 #include "util/Hrpsys.h"
 #include "pointcloud.hh"
 
@@ -104,6 +105,55 @@ void printData(std::ostream& os, const T& data)
     }
 }
 
+// elements of data in the same order as printData()
+unsigned int toColumns(const RTC::Acceleration3D& data, std::vector<double>& v)
+{
+    v[0] = data.ax; v[1] = data.ay; v[2] = data.az;
+    return 3;
+}
+
+unsigned int toColumns(const RTC::Velocity2D& data, std::vector<double>& v)
+{
+    v[0] = data.vx; v[1] = data.vy; v[2] = data.va;
+    return 3;
+}
+
+unsigned int toColumns(const RTC::Pose3D& data, std::vector<double>& v)
+{
+    v[0] = data.position.x; v[1] = data.position.y; v[2] = data.position.z;
+    v[3] = data.orientation.r; v[4] = data.orientation.p; v[5] = data.orientation.y;
+    return 6;
+}
+
+unsigned int toColumns(const RTC::AngularVelocity3D& data, std::vector<double>& v)
+{
+    v[0] = data.avx; v[1] = data.avy; v[2] = data.avz;
+    return 3;
+}
+
+unsigned int toColumns(const RTC::Point3D& data, std::vector<double>& v)
+{
+    v[0] = data.x; v[1] = data.y; v[2] = data.z;
+    return 3;
+}
+
+unsigned int toColumns(const RTC::Orientation3D& data, std::vector<double>& v)
+{
+    v[0] = data.r; v[1] = data.p; v[2] = data.y;
+    return 3;
+}
+
+template <class T>
+unsigned int toColumns(const T& data, std::vector<double>& v)
+{
+    // grows only when a longer sequence is received
+    if (v.size() < data.length()) v.resize(data.length());
+    for (unsigned int j=0; j<data.length(); j++){
+        v[j] = data[j];
+    }
+    return data.length();
+}
+
 template <class T>
 class LoggerPort : public LoggerPortBase
 {
@@ -143,6 +193,45 @@ protected:
     std::deque<T> m_log;
 };
 
+/**
+   \brief logger port whose data are stored in a ColumnStore
+ */
+template <class T>
+class ColumnLoggerPort : public LoggerPortBase
+{
+public:
+    ColumnLoggerPort(const char *name, bool integer=false)
+        : m_port(name, m_data), m_store(integer), m_values(6) {}
+    const char *name(){
+        return m_port.name();
+    }
+    virtual void dumpLog(std::ostream& os){
+        m_store.dump(os, m_maxLength);
+    }
+    InPort<T>& port(){
+            return m_port;
+    }
+    void log(){
+        if (m_port.isNew()){
+            m_port.read();
+            unsigned int n = toColumns(m_data.data, m_values);
+            m_store.append((int64_t)m_data.tm.sec*1000000000LL + m_data.tm.nsec,
+                           n ? &m_values[0] : NULL, n);
+        }
+    }
+    void clear(){
+        m_store.clear();
+    }
+    ColumnStore *store(){
+        return &m_store;
+    }
+protected:
+    InPort<T> m_port;
+    T m_data;
+    ColumnStore m_store;
+    std::vector<double> m_values;
+};
+
 class LoggerPortForPointCloud : public LoggerPort<PointCloudTypes::PointCloud>
 {
 public:
@@ -167,6 +256,7 @@ DataLogger::DataLogger(RTC::Manager* manager)
     m_DataLoggerServicePort("DataLoggerService"),
     // </rtc-template>
     m_suspendFlag(false),
+    m_compactor(this),
 	dummy(0)
 {
   m_service0.setLogger(this);
@@ -202,17 +292,18 @@ RTC::ReturnCode_t DataLogger::onInitialize()
   
   // </rtc-template>
 
+  m_compactor.start();
+
   return RTC::RTC_OK;
 }
 
 
 
-/*
 RTC::ReturnCode_t DataLogger::onFinalize()
 {
+  m_compactor.stop();
   return RTC::RTC_OK;
 }
-*/
 
 /*
 RTC::ReturnCode_t DataLogger::onStartup(RTC::UniqueId ec_id)
@@ -318,14 +409,14 @@ bool DataLogger::add(const char *i_type, const char *i_name)
 
   LoggerPortBase *new_port=NULL;
   if (strcmp(i_type, "TimedDoubleSeq")==0){
-      LoggerPort<TimedDoubleSeq> *lp = new LoggerPort<TimedDoubleSeq>(i_name);
+      ColumnLoggerPort<TimedDoubleSeq> *lp = new ColumnLoggerPort<TimedDoubleSeq>(i_name);
       new_port = lp;
       if (!addInPort(i_name, lp->port())) {
           resumeLogging();
           return false;
       }
   }else if (strcmp(i_type, "TimedLongSeq")==0){
-      LoggerPort<TimedLongSeq> *lp = new LoggerPort<TimedLongSeq>(i_name);
+      ColumnLoggerPort<TimedLongSeq> *lp = new ColumnLoggerPort<TimedLongSeq>(i_name, true);
       new_port = lp;
       if (!addInPort(i_name, lp->port())) {
           resumeLogging();
@@ -346,42 +437,42 @@ bool DataLogger::add(const char *i_type, const char *i_name)
           return false;
       }
   }else if (strcmp(i_type, "TimedPoint3D")==0){
-      LoggerPort<TimedPoint3D> *lp = new LoggerPort<TimedPoint3D>(i_name);
+      ColumnLoggerPort<TimedPoint3D> *lp = new ColumnLoggerPort<TimedPoint3D>(i_name);
       new_port = lp;
       if (!addInPort(i_name, lp->port())) {
           resumeLogging();
           return false;
       }
   }else if (strcmp(i_type, "TimedOrientation3D")==0){
-      LoggerPort<TimedOrientation3D> *lp = new LoggerPort<TimedOrientation3D>(i_name);
+      ColumnLoggerPort<TimedOrientation3D> *lp = new ColumnLoggerPort<TimedOrientation3D>(i_name);
       new_port = lp;
       if (!addInPort(i_name, lp->port())) {
           resumeLogging();
           return false;
       }
   }else if (strcmp(i_type, "TimedAcceleration3D")==0){
-      LoggerPort<TimedAcceleration3D> *lp = new LoggerPort<TimedAcceleration3D>(i_name);
+      ColumnLoggerPort<TimedAcceleration3D> *lp = new ColumnLoggerPort<TimedAcceleration3D>(i_name);
       new_port = lp;
       if (!addInPort(i_name, lp->port())) {
           resumeLogging();
           return false;
       }
   }else if (strcmp(i_type, "TimedAngularVelocity3D")==0){
-      LoggerPort<TimedAngularVelocity3D> *lp = new LoggerPort<TimedAngularVelocity3D>(i_name);
+      ColumnLoggerPort<TimedAngularVelocity3D> *lp = new ColumnLoggerPort<TimedAngularVelocity3D>(i_name);
       new_port = lp;
       if (!addInPort(i_name, lp->port())) {
           resumeLogging();
           return false;
       }
   }else if (strcmp(i_type, "TimedVelocity2D")==0){
-      LoggerPort<TimedVelocity2D> *lp = new LoggerPort<TimedVelocity2D>(i_name);
+      ColumnLoggerPort<TimedVelocity2D> *lp = new ColumnLoggerPort<TimedVelocity2D>(i_name);
       new_port = lp;
       if (!addInPort(i_name, lp->port())) {
           resumeLogging();
           return false;
       }
   }else if (strcmp(i_type, "TimedPose3D")==0){
-      LoggerPort<TimedPose3D> *lp = new LoggerPort<TimedPose3D>(i_name);
+      ColumnLoggerPort<TimedPose3D> *lp = new ColumnLoggerPort<TimedPose3D>(i_name);
       new_port = lp;
       if (!addInPort(i_name, lp->port())) {
           resumeLogging();
@@ -400,7 +491,10 @@ bool DataLogger::add(const char *i_type, const char *i_name)
       resumeLogging();
       return false;
   }
-  m_ports.push_back(new_port);
+  {
+    Guard guard(m_portsMutex);
+    m_ports.push_back(new_port);
+  }
   resumeLogging();
   return true;
 }
@@ -426,6 +520,47 @@ bool DataLogger::save(const char *i_basename)
   return ret;
 }
 
+bool DataLogger::saveCompressed(const char *i_basename)
+{
+  std::vector<LoggerPortBase *> ports;
+  {
+    Guard guard(m_portsMutex);
+    ports = m_ports;
+  }
+  bool ret = true;
+  for (unsigned int i=0; i<ports.size(); i++){
+    std::string fname = i_basename;
+    fname.append(".");
+    fname.append(ports[i]->name());
+    ColumnStore *store = ports[i]->store();
+    if (store){
+      // logging continues while chunks are written
+      fname.append(".clog");
+      ColumnFileWriter writer;
+      if (writer.open(fname, ports[i]->name(), store->integer())){
+        store->write(writer, ports[i]->maxLength());
+        if (!writer.close()){
+          std::cerr << "[" << m_profile.instance_name << "] failed to write(" << fname << ")" << std::endl;
+          ret = false;
+        }
+        continue;
+      }
+    }else{
+      std::ofstream ofs(fname.c_str());
+      if (ofs.is_open()){
+        suspendLogging();
+        ports[i]->dumpLog(ofs);
+        resumeLogging();
+        continue;
+      }
+    }
+    std::cerr << "[" << m_profile.instance_name << "] failed to open(" << fname << ")" << std::endl;
+    ret = false;
+  }
+  if (ret) std::cerr << "[" << m_profile.instance_name << "] Save compressed log to " << i_basename << ".*" << std::endl;
+  return ret;
+}
+
 bool DataLogger::clear()
 {
   suspendLogging();
@@ -459,6 +594,107 @@ void DataLogger::maxLength(unsigned int len)
   resumeLogging();
 }
 
+LoggerPortBase *DataLogger::findPort(const char *i_name)
+{
+  Guard guard(m_portsMutex);
+  for (unsigned int i=0; i<m_ports.size(); i++){
+    if (strcmp(m_ports[i]->name(), i_name) == 0) return m_ports[i];
+  }
+  return NULL;
+}
+
+bool DataLogger::getRange(const char *i_name, double i_from, double i_to,
+                          OpenHRP::DataLoggerService::LogSeries& o_data)
+{
+  LoggerPortBase *port = findPort(i_name);
+  if (!port || !port->store()){
+    std::cerr << "[" << m_profile.instance_name << "] can't read " << i_name << std::endl;
+    return false;
+  }
+  std::vector<double> times, values;
+  unsigned int width = 0;
+  bool ret = port->store()->range(i_from, i_to, port->maxLength(),
+                                  times, width, values);
+  o_data.width = width;
+  o_data.times.length(times.size());
+  if (times.size()) memcpy(o_data.times.get_buffer(), &times[0], sizeof(double)*times.size());
+  o_data.values.length(values.size());
+  if (values.size()) memcpy(o_data.values.get_buffer(), &values[0], sizeof(double)*values.size());
+  return ret;
+}
+
+bool DataLogger::getEnvelope(const char *i_name, double i_from, double i_to,
+                             unsigned int i_buckets,
+                             OpenHRP::DataLoggerService::LogEnvelope& o_data)
+{
+  LoggerPortBase *port = findPort(i_name);
+  if (!port || !port->store()){
+    std::cerr << "[" << m_profile.instance_name << "] can't read " << i_name << std::endl;
+    return false;
+  }
+  std::vector<double> times, mins, maxs;
+  unsigned int width = 0;
+  bool ret = port->store()->envelope(i_from, i_to, i_buckets,
+                                     port->maxLength(),
+                                     times, width, mins, maxs);
+  o_data.width = width;
+  o_data.times.length(times.size());
+  if (times.size()) memcpy(o_data.times.get_buffer(), &times[0], sizeof(double)*times.size());
+  o_data.mins.length(mins.size());
+  if (mins.size()) memcpy(o_data.mins.get_buffer(), &mins[0], sizeof(double)*mins.size());
+  o_data.maxs.length(maxs.size());
+  if (maxs.size()) memcpy(o_data.maxs.get_buffer(), &maxs[0], sizeof(double)*maxs.size());
+  return ret;
+}
+
+void DataLogger::compact()
+{
+  std::vector<LoggerPortBase *> ports;
+  {
+    Guard guard(m_portsMutex);
+    ports = m_ports;
+  }
+  for (unsigned int i=0; i<ports.size(); i++){
+    if (ports[i]->store()) ports[i]->store()->compact(ports[i]->maxLength());
+  }
+}
+
+LogCompactor::LogCompactor(DataLogger *i_logger) :
+  m_logger(i_logger), m_quit(false)
+{
+}
+
+void LogCompactor::start()
+{
+  m_quit = false;
+  activate();
+}
+
+void LogCompactor::stop()
+{
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_quit = true;
+    m_cond.notify_all();
+  }
+  wait();
+}
+
+int LogCompactor::svc()
+{
+  while (1){
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      if (m_quit) break;
+      // a chunk of 256 samples is filled in 0.256[s] at 1[kHz]
+      m_cond.timed_wait(lock, boost::posix_time::milliseconds(100));
+      if (m_quit) break;
+    }
+    m_logger->compact();
+  }
+  return 0;
+}
+
 extern "C"
 {
 
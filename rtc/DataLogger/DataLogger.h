@@ -20,7 +20,11 @@
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
 #include <rtm/idl/ExtendedDataTypesSkel.h>
+#include <coil/Task.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include "HRPDataTypes.hh"
+#include "ColumnStore.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -45,11 +49,36 @@ public:
     virtual void clear() = 0;
     virtual void dumpLog(std::ostream& os) = 0;
     virtual void log() = 0;
+    /**
+       \brief columnar store of the logged data
+       \return NULL if the data type can't be stored in columns
+     */
+    virtual ColumnStore *store() { return NULL; }
     void maxLength(unsigned int len) { m_maxLength = len; }
+    unsigned int maxLength() const { return m_maxLength; }
 protected:
     unsigned int m_maxLength;
 };
 
+class DataLogger;
+
+/**
+   \brief thread which compresses logged data periodically
+ */
+class LogCompactor : public coil::Task
+{
+public:
+    LogCompactor(DataLogger *i_logger);
+    void start();
+    void stop();
+    virtual int svc();
+private:
+    DataLogger *m_logger;
+    boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    bool m_quit;
+};
+
 /**
    \brief sample RT component which has one data input port and one data output port
  */
@@ -73,7 +102,7 @@ class DataLogger
 
   // The finalize action (on ALIVE->END transition)
   // formaer rtc_exiting_entry()
-  // virtual RTC::ReturnCode_t onFinalize();
+  virtual RTC::ReturnCode_t onFinalize();
 
   // The startup action when ExecutionContext startup
   // former rtc_starting_entry()
@@ -116,10 +145,17 @@ class DataLogger
   // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
   bool add(const char *i_type, const char *i_name);
   bool save(const char *i_basename);
+  bool saveCompressed(const char *i_basename);
   bool clear();
   void suspendLogging();
   void resumeLogging();
   void maxLength(unsigned int len);
+  bool getRange(const char *i_name, double i_from, double i_to,
+                OpenHRP::DataLoggerService::LogSeries& o_data);
+  bool getEnvelope(const char *i_name, double i_from, double i_to,
+                   unsigned int i_buckets,
+                   OpenHRP::DataLoggerService::LogEnvelope& o_data);
+  void compact();
 
   std::vector<LoggerPortBase *> m_ports;
 
@@ -160,8 +196,13 @@ class DataLogger
   // </rtc-template>
 
  private:
+  LoggerPortBase *findPort(const char *i_name);
+
   bool m_suspendFlag;
   coil::Mutex m_suspendFlagMutex;
+  // protects m_ports from threads other than the logging one
+  coil::Mutex m_portsMutex;
+  LogCompactor m_compactor;
   int dummy;
 };
 
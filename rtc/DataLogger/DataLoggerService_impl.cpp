@@ -19,6 +19,11 @@ CORBA::Boolean DataLoggerService_impl::save(const char *basename)
   return m_logger->save(basename);
 }
 
+CORBA::Boolean DataLoggerService_impl::saveCompressed(const char *basename)
+{
+  return m_logger->saveCompressed(basename);
+}
+
 CORBA::Boolean DataLoggerService_impl::clear()
 {
   return m_logger->clear();
@@ -29,4 +34,23 @@ void DataLoggerService_impl::maxLength(CORBA::ULong len)
   m_logger->maxLength(len);
 }
 
+CORBA::Boolean DataLoggerService_impl::getRange(const char *name,
+                                                CORBA::Double from,
+                                                CORBA::Double to,
+                                                OpenHRP::DataLoggerService::LogSeries_out data)
+{
+  data = new OpenHRP::DataLoggerService::LogSeries;
+  return m_logger->getRange(name, from, to, *data);
+}
+
+CORBA::Boolean DataLoggerService_impl::getEnvelope(const char *name,
+                                                   CORBA::Double from,
+                                                   CORBA::Double to,
+                                                   CORBA::ULong buckets,
+                                                   OpenHRP::DataLoggerService::LogEnvelope_out data)
+{
+  data = new OpenHRP::DataLoggerService::LogEnvelope;
+  return m_logger->getEnvelope(name, from, to, buckets, *data);
+}
+
 
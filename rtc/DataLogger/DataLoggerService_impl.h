@@ -19,8 +19,15 @@ public:
 
   CORBA::Boolean add(const char *type, const char *name);
   CORBA::Boolean save(const char *basename);
+  CORBA::Boolean saveCompressed(const char *basename);
   CORBA::Boolean clear();
   void maxLength(CORBA::ULong len);
+  CORBA::Boolean getRange(const char *name, CORBA::Double from,
+                          CORBA::Double to,
+                          OpenHRP::DataLoggerService::LogSeries_out data);
+  CORBA::Boolean getEnvelope(const char *name, CORBA::Double from,
+                             CORBA::Double to, CORBA::ULong buckets,
+                             OpenHRP::DataLoggerService::LogEnvelope_out data);
 private:
   DataLogger *m_logger;
 };
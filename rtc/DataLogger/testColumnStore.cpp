@@ -0,0 +1,116 @@
+/* -*- coding:utf-8-unix; mode:c++; -*- */
+
+#include "ColumnStore.h"
+/* samples */
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+class testColumnStore
+{
+protected:
+    unsigned int nsamples, nbuckets;
+    double t0, dt; /* [s] */
+    ColumnStore store;
+    // sample i is (i, -i) at t0 + i*dt
+    void fill (bool compact)
+    {
+        for (unsigned int i = 0; i < nsamples; i++) {
+            double v[2] = {(double)i, -(double)i};
+            store.append((int64_t)((t0 + i*dt)*1e9), v, 2);
+        }
+        if (compact) store.compact(nsamples);
+    };
+    bool check_envelope (double from, double to)
+    {
+        std::vector<double> times, mins, maxs;
+        unsigned int width;
+        if (!store.envelope(from, to, nbuckets, nsamples, times, width, mins, maxs)) {
+            std::cerr << "[testColumnStore]   no bucket in [" << from << ", " << to << "]" << std::endl;
+            return false;
+        }
+        std::cerr << "[testColumnStore]   [" << from << ", " << to << "] : " << times.size() << " buckets" << std::endl;
+        if (width != 2 || times.size() > nbuckets
+            || mins.size() != times.size()*2 || maxs.size() != times.size()*2) {
+            return false;
+        }
+        // every sample is in exactly one bucket and buckets are in order
+        double next = 0;
+        for (unsigned int b = 0; b < times.size(); b++) {
+            if (mins[b*2] != next || maxs[b*2+1] != -next || mins[b*2] > maxs[b*2]) {
+                std::cerr << "[testColumnStore]   bucket " << b << " starts at " << mins[b*2] << ", expected " << next << std::endl;
+                return false;
+            }
+            next = maxs[b*2] + 1;
+        }
+        return next == nsamples;
+    };
+public:
+    std::vector<std::string> arg_strs;
+    testColumnStore () : nsamples(5000), nbuckets(500), t0(1.791e9), dt(0.002) {};
+    bool test0 ()
+    {
+        std::cerr << "test0 : envelope of wall clock timestamps from time 0" << std::endl;
+        parse_params();
+        fill(true);
+        double tend = t0 + nsamples*dt;
+        // all samples fall into the last buckets
+        return check_envelope(0, 0) && check_envelope(0, 1e12)
+            && check_envelope(0, tend) && check_envelope(-1e12, 0);
+    };
+    bool test1 ()
+    {
+        std::cerr << "test1 : envelope of raw and compressed chunks" << std::endl;
+        parse_params();
+        fill(false);
+        if (!check_envelope(t0, 0) || !check_envelope(-(nsamples*dt), 0)) return false;
+        store.compact(nsamples);
+        return check_envelope(t0, 0) && check_envelope(-(nsamples*dt), 0);
+    };
+    void parse_params ()
+    {
+      for (unsigned int i = 0; i < arg_strs.size(); ++ i) {
+          if ( arg_strs[i]== "--samples" ) {
+              if (++i < arg_strs.size()) nsamples = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--buckets" ) {
+              if (++i < arg_strs.size()) nbuckets = atoi(arg_strs[i].c_str());
+          }
+      }
+      std::cerr << "[testColumnStore] params" << std::endl;
+      std::cerr << "[testColumnStore]   samples = " << nsamples << ", buckets = " << nbuckets << std::endl;
+    };
+};
+
+void print_usage ()
+{
+    std::cerr << "Usage : testColumnStore [test-name] [option]" << std::endl;
+    std::cerr << " [test-name] should be:" << std::endl;
+    std::cerr << "  --test0 : envelope of wall clock timestamps from time 0" << std::endl;
+    std::cerr << "  --test1 : envelope of raw and compressed chunks" << std::endl;
+    std::cerr << " [option] should be:" << std::endl;
+    std::cerr << "  --samples, --buckets" << std::endl;
+};
+
+int main(int argc, char* argv[])
+{
+    int ret = 0;
+    if (argc >= 2) {
+        testColumnStore tcs;
+        for (int i = 1; i < argc; ++ i) {
+            tcs.arg_strs.push_back(std::string(argv[i]));
+        }
+        if (std::string(argv[1]) == "--test0") {
+            ret = tcs.test0() ? 0 : 1;
+        } else if (std::string(argv[1]) == "--test1") {
+            ret = tcs.test1() ? 0 : 1;
+        } else {
+            print_usage();
+            ret = 1;
+        }
+    } else {
+        print_usage();
+        ret = 1;
+    }
+    return ret;
+}
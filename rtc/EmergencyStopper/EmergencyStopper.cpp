@@ -172,6 +172,8 @@ RTC::ReturnCode_t EmergencyStopper::onInitialize()
     m_stop_posture = new double[m_robot->numJoints()];
     m_stop_wrenches = new double[nforce*6];
     m_tmp_wrenches = new double[nforce*6];
+    m_input_posture_history.resize(m_robot->numJoints(), default_retrieve_time);
+    m_input_wrenches_history.resize(nforce*6, default_retrieve_time);
     m_interpolator = new interpolator(m_robot->numJoints(), recover_time_dt);
     m_interpolator->setName(std::string(m_profile.instance_name)+" interpolator");
     m_wrenches_interpolator = new interpolator(nforce*6, recover_time_dt);
@@ -272,20 +274,23 @@ RTC::ReturnCode_t EmergencyStopper::onExecute(RTC::UniqueId ec_id)
         // joint angle
         m_qRefIn.read();
         assert(m_qRef.data.length() == numJoints);
-        std::vector<double> current_posture;
-        for ( int i = 0; i < m_qRef.data.length(); i++ ) {
-            current_posture.push_back(m_qRef.data[i]);
+        unsigned int history_length = std::max(default_retrieve_time, 1);
+        if (m_input_posture_history.length() != history_length) {
+            // default_retrieve_time is changed by setEmergencyStopperParam()
+            m_input_posture_history.resize(numJoints, history_length);
+            m_input_wrenches_history.resize(m_wrenchesRef.size()*6, history_length);
         }
-        m_input_posture_queue.push(current_posture);
-        while (m_input_posture_queue.size() > default_retrieve_time) {
-            m_input_posture_queue.pop();
+        double *current_posture = m_input_posture_history.push();
+        for ( int i = 0; i < m_qRef.data.length(); i++ ) {
+            current_posture[i] = m_qRef.data[i];
         }
+        const double *oldest_posture = m_input_posture_history.oldest();
         if (!is_stop_mode) {
             for ( int i = 0; i < m_qRef.data.length(); i++ ) {
                 if (recover_time > 0) { // Until releasing is finished, do not use m_stop_posture in input queue because too large error.
                     m_stop_posture[i] = m_q.data[i];
                 } else {
-                    m_stop_posture[i] = m_input_posture_queue.front()[i];
+                    m_stop_posture[i] = oldest_posture[i];
                 }
             }
         }
@@ -295,23 +300,16 @@ RTC::ReturnCode_t EmergencyStopper::onExecute(RTC::UniqueId ec_id)
                 m_wrenchesIn[i]->read();
             }
         }
-        std::vector<double> current_wrench;
-        for ( int i= 0; i < m_wrenchesRef.size(); i++ ) {
-            for (int j = 0; j < 6; j++ ) {
-                current_wrench.push_back(m_wrenchesRef[i].data[j]);
-            }
-        }
-        m_input_wrenches_queue.push(current_wrench);
-        while (m_input_wrenches_queue.size() > default_retrieve_time) {
-            m_input_wrenches_queue.pop();
-        }
+        double *current_wrench = m_input_wrenches_history.push();
+        get_wrenches_array_from_data(m_wrenchesRef, current_wrench);
+        const double *oldest_wrench = m_input_wrenches_history.oldest();
         if (!is_stop_mode) {
             for ( int i= 0; i < m_wrenchesRef.size(); i++ ) {
                 for (int j = 0; j < 6; j++ ) {
                     if (recover_time > 0) {
                         m_stop_wrenches[i*6+j] = m_wrenches[i].data[j];
                     } else {
-                        m_stop_wrenches[i*6+j] = m_input_wrenches_queue.front()[i*6+j];
+                        m_stop_wrenches[i*6+j] = oldest_wrench[i*6+j];
                     }
                 }
             }
@@ -20,7 +20,7 @@
 #include <hrpModel/Body.h>
 #include "interpolator.h"
 #include "HRPDataTypes.hh"
-#include <queue>
+#include "PostureHistory.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -183,8 +183,8 @@ private:
     double *m_tmp_wrenches;
     interpolator* m_interpolator;
     interpolator* m_wrenches_interpolator;
-    std::queue<std::vector<double> > m_input_posture_queue;
-    std::queue<std::vector<double> > m_input_wrenches_queue;
+    PostureHistory m_input_posture_history;
+    PostureHistory m_input_wrenches_history;
     int emergency_stopper_beep_count, emergency_stopper_beep_freq;
     coil::Mutex m_mutex;
 };
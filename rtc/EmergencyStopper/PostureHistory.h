@@ -0,0 +1,76 @@
+// -*- C++ -*-
+#ifndef POSTURE_HISTORY_H
+#define POSTURE_HISTORY_H
+
+#include <vector>
+#include <algorithm>
+
+/**
+   \brief fixed length history of vectors
+
+   Memory is allocated only by the constructor and resize(), so push() can
+   be called in every control period. When the history is full, push()
+   overwrites the oldest vector.
+ */
+class PostureHistory
+{
+public:
+    PostureHistory(unsigned int i_dim=0, unsigned int i_length=1)
+        : m_dim(0), m_length(0), m_head(0), m_size(0)
+    {
+        resize(i_dim, i_length);
+    }
+    /**
+       \brief change dimension of vectors and the maximum number of vectors.
+       The newest vectors are kept if the dimension is not changed
+       \param i_length the maximum number of vectors, 1 is used if it is 0
+     */
+    void resize(unsigned int i_dim, unsigned int i_length)
+    {
+        if (i_length == 0) i_length = 1;
+        if (i_dim == m_dim && i_length == m_length) return;
+        std::vector<double> data(i_dim*i_length);
+        unsigned int n = i_dim == m_dim && m_dim ? std::min(m_size, i_length) : 0;
+        for (unsigned int i=0; i<n; i++){
+            unsigned int k = (m_head + m_size - n + i) % m_length;
+            std::copy(&m_data[k*m_dim], &m_data[k*m_dim] + m_dim, &data[i*i_dim]);
+        }
+        m_data.swap(data);
+        m_dim = i_dim;
+        m_length = i_length;
+        m_head = 0;
+        m_size = n;
+    }
+    void clear() { m_head = m_size = 0; }
+    unsigned int dimension() const { return m_dim; }
+    unsigned int length() const { return m_length; }
+    unsigned int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    /**
+       \brief append a vector
+       \return pointer to the slot of the new vector, which should be filled
+       by the caller
+     */
+    double *push()
+    {
+        double *slot = m_dim ? &m_data[((m_head + m_size) % m_length)*m_dim] : NULL;
+        if (m_size == m_length){
+            m_head = (m_head + 1) % m_length;
+        }else{
+            m_size++;
+        }
+        return slot;
+    }
+    /**
+       \brief the oldest vector, which must not be called when it is empty
+     */
+    const double *oldest() const
+    {
+        return m_dim ? &m_data[m_head*m_dim] : NULL;
+    }
+private:
+    unsigned int m_dim, m_length, m_head, m_size;
+    std::vector<double> m_data;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/* -*- coding:utf-8-unix; mode:c++; -*- */
+
+#include "PostureHistory.h"
+/* samples */
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <new>
+
+// count allocations to check that PostureHistory doesn't allocate memory in
+// steady state
+static unsigned long alloc_count = 0;
+
+void *operator new(size_t size)
+{
+    alloc_count++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw()
+{
+    free(p);
+}
+
+// used instead of the above by C++14 or later compilers
+void operator delete(void *p, size_t) throw()
+{
+    free(p);
+}
+
+class testPostureHistory
+{
+protected:
+    unsigned int dof, length, nloop;
+    PostureHistory history;
+    // reference implementation which was used by EmergencyStopper
+    std::queue<std::vector<double> > queue;
+    double value (unsigned int i, unsigned int j) { return i + j*0.001; };
+    bool push_and_compare (unsigned int i)
+    {
+        double *slot = history.push();
+        std::vector<double> v(dof);
+        for (unsigned int j = 0; j < dof; j++) {
+            slot[j] = v[j] = value(i, j);
+        }
+        queue.push(v);
+        while (queue.size() > length) queue.pop();
+        const double *oldest = history.oldest();
+        for (unsigned int j = 0; j < dof; j++) {
+            if (oldest[j] != queue.front()[j]) {
+                std::cerr << "[testPostureHistory] oldest posture differs at " << i << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+public:
+    std::vector<std::string> arg_strs;
+    testPostureHistory () : dof(30), length(500), nloop(2000) {};
+    bool test0 ()
+    {
+        std::cerr << "test0 : oldest posture and allocation in steady state" << std::endl;
+        parse_params();
+        history.resize(dof, length);
+        for (unsigned int i = 0; i < nloop; i++) {
+            if (!push_and_compare(i)) return false;
+        }
+        // steady state
+        unsigned long n = alloc_count;
+        for (unsigned int i = nloop; i < nloop*2; i++) {
+            double *slot = history.push();
+            for (unsigned int j = 0; j < dof; j++) slot[j] = value(i, j);
+            if (history.oldest()[0] != value(i-length+1, 0)) {
+                std::cerr << "[testPostureHistory] oldest posture differs at " << i << std::endl;
+                return false;
+            }
+        }
+        std::cerr << "[testPostureHistory]   allocations in steady state = " << alloc_count - n << std::endl;
+        return alloc_count == n;
+    };
+    bool test1 ()
+    {
+        std::cerr << "test1 : change length" << std::endl;
+        parse_params();
+        history.resize(dof, length);
+        unsigned int i = 0;
+        for (; i < nloop; i++) {
+            if (!push_and_compare(i)) return false;
+        }
+        // the newest vectors are kept as std::queue
+        length /= 3;
+        history.resize(dof, length);
+        for (; i < nloop*2; i++) {
+            if (!push_and_compare(i)) return false;
+        }
+        length *= 4;
+        history.resize(dof, length);
+        for (; i < nloop*3; i++) {
+            if (!push_and_compare(i)) return false;
+        }
+        return true;
+    };
+    void parse_params ()
+    {
+      for (unsigned int i = 0; i < arg_strs.size(); ++ i) {
+          if ( arg_strs[i]== "--dof" ) {
+              if (++i < arg_strs.size()) dof = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--length" ) {
+              if (++i < arg_strs.size()) length = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--loop" ) {
+              if (++i < arg_strs.size()) nloop = atoi(arg_strs[i].c_str());
+          }
+      }
+      std::cerr << "[testPostureHistory] params" << std::endl;
+      std::cerr << "[testPostureHistory]   dof = " << dof << ", length = " << length << ", loop = " << nloop << std::endl;
+    };
+};
+
+void print_usage ()
+{
+    std::cerr << "Usage : testPostureHistory [test-name] [option]" << std::endl;
+    std::cerr << " [test-name] should be:" << std::endl;
+    std::cerr << "  --test0 : oldest posture and allocation in steady state" << std::endl;
+    std::cerr << "  --test1 : change length" << std::endl;
+    std::cerr << " [option] should be:" << std::endl;
+    std::cerr << "  --dof, --length, --loop" << std::endl;
+};
+
+int main(int argc, char* argv[])
+{
+    int ret = 0;
+    if (argc >= 2) {
+        testPostureHistory tph;
+        for (int i = 1; i < argc; ++ i) {
+            tph.arg_strs.push_back(std::string(argv[i]));
+        }
+        if (std::string(argv[1]) == "--test0") {
+            ret = tph.test0() ? 0 : 1;
+        } else if (std::string(argv[1]) == "--test1") {
+            ret = tph.test1() ? 0 : 1;
+        } else {
+            print_usage();
+            ret = 1;
+        }
+    } else {
+        print_usage();
+        ret = 1;
+    }
+    return ret;
+}
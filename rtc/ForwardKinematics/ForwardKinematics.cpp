@@ -12,6 +12,7 @@
 
 #include "hrpModel/Link.h"
 #include "hrpModel/ModelLoaderUtil.h"
+#include "hrpUtil/Eigen3d.h"
 
 typedef coil::Guard<coil::Mutex> Guard;
 
@@ -46,7 +47,11 @@ ForwardKinematics::ForwardKinematics(RTC::Manager* manager)
     m_baseRpyRefIn("baseRpyRef", m_baseRpyRef),
     m_ForwardKinematicsServicePort("ForwardKinematicsService"),
     // </rtc-template>
-    dummy(0)
+    dummy(0),
+    m_refRevision(1),
+    m_actRevision(1),
+    m_refServiceRevision(0),
+    m_actServiceRevision(0)
 {
 }
 
@@ -111,8 +116,16 @@ RTC::ReturnCode_t ForwardKinematics::onInitialize()
     return RTC::RTC_ERROR;
   }
 
-  m_refLink = m_refBody->rootLink();
-  m_actLink = m_actBody->rootLink();
+  m_sensorSolved.resize(m_actBody->numLinks(), 0);
+  store(m_refBody, m_refRevision, m_refPosture);
+  store(m_actBody, m_actRevision, m_actPosture);
+
+  m_refServiceBody = hrp::BodyPtr(new hrp::Body(*m_refBody));
+  m_actServiceBody = hrp::BodyPtr(new hrp::Body(*m_actBody));
+  m_refLink = m_refServiceBody->rootLink();
+  m_actLink = m_actServiceBody->rootLink();
+  m_refSolved.resize(m_refBody->numLinks(), 0);
+  m_actSolved.resize(m_actBody->numLinks(), 0);
 
   return RTC::RTC_OK;
 }
@@ -166,15 +179,15 @@ RTC::ReturnCode_t ForwardKinematics::onExecute(RTC::UniqueId ec_id)
 {
   //std::cout << m_profile.instance_name<< ": onExecute(" << ec_id << ")" << std::endl;
 
-  coil::TimeValue tm(coil::gettimeofday());
-  m_tm.sec  = tm.sec();
-  m_tm.nsec = tm.usec() * 1000;
+  // link poses are computed on demand by service calls
+  unsigned int refRevision = m_refRevision, actRevision = m_actRevision;
 
   if (m_qIn.isNew()) {
       m_qIn.read();
       for (int i=0; i<m_actBody->numJoints(); i++){
           m_actBody->joint(i)->q = m_q.data[i];
       }
+      m_actRevision++;
   }
 
   if (m_sensorRpyIn.isNew()) {
@@ -183,6 +196,7 @@ RTC::ReturnCode_t ForwardKinematics::onExecute(RTC::UniqueId ec_id)
                                               m_sensorRpy.data.p,
                                               m_sensorRpy.data.y);
       if (m_sensorAttachedLink){
+        solve(m_sensorAttachedLink, m_sensorSolved, m_actRevision);
         hrp::Matrix33 sensor2base(m_sensorAttachedLink->R.transpose()*m_actBody->rootLink()->R);
 	hrp::Matrix33 baseR(sensorR*sensor2base);
 	// to prevent numerical error
@@ -193,6 +207,7 @@ RTC::ReturnCode_t ForwardKinematics::onExecute(RTC::UniqueId ec_id)
       }else{
 	m_actBody->rootLink()->R = sensorR;
       }
+      m_actRevision++;
   }
 
   if (m_qRefIn.isNew()) {
@@ -200,6 +215,7 @@ RTC::ReturnCode_t ForwardKinematics::onExecute(RTC::UniqueId ec_id)
       for (int i=0; i<m_refBody->numJoints(); i++){
           m_refBody->joint(i)->q = m_qRef.data[i];
       }
+      m_refRevision++;
   }
 
   if (m_basePosRefIn.isNew()){
@@ -208,6 +224,7 @@ RTC::ReturnCode_t ForwardKinematics::onExecute(RTC::UniqueId ec_id)
       root->p[0] = m_basePosRef.data.x;
       root->p[1] = m_basePosRef.data.y;
       root->p[2] = m_basePosRef.data.z;
+      m_refRevision++;
   }
 
   if (m_baseRpyRefIn.isNew()){
@@ -217,14 +234,15 @@ RTC::ReturnCode_t ForwardKinematics::onExecute(RTC::UniqueId ec_id)
       rpy[1] = m_baseRpyRef.data.p;
       rpy[2] = m_baseRpyRef.data.y;
       m_refBody->rootLink()->R = hrp::rotFromRpy(rpy);
-
+      m_refRevision++;
   }
 
-  {
-      Guard guard(m_bodyMutex);
-      m_refBody->calcForwardKinematics();
-      m_actBody->calcForwardKinematics();
-  }
+  coil::TimeValue tm(coil::gettimeofday());
+  Guard guard(m_bodyMutex);
+  m_tm.sec  = tm.sec();
+  m_tm.nsec = tm.usec() * 1000;
+  if (m_refRevision != refRevision) store(m_refBody, m_refRevision, m_refPosture);
+  if (m_actRevision != actRevision) store(m_actBody, m_actRevision, m_actPosture);
 
   return RTC::RTC_OK;
 }
@@ -264,74 +282,186 @@ RTC::ReturnCode_t ForwardKinematics::onRateChanged(RTC::UniqueId ec_id)
 }
 */
 
-::CORBA::Boolean ForwardKinematics::getReferencePose(const char* linkname, RTC::TimedDoubleSeq_out pose,const char* frame_name)
+void ForwardKinematics::solve(hrp::Link *l, std::vector<unsigned int>& solved,
+                              unsigned int revision)
 {
-    pose = new RTC::TimedDoubleSeq();
+    if (solved[l->index] == revision) return;
+    hrp::Link *parent = l->parent;
+    if (parent){
+        // same as Body::calcForwardKinematics() but only along the chain
+        solve(parent, solved, revision);
+        switch (l->jointType){
+        case hrp::Link::ROTATIONAL_JOINT:
+            l->R = parent->R * hrp::rodrigues(l->a, l->q);
+            l->p = parent->R * l->b + parent->p;
+            break;
+        case hrp::Link::SLIDE_JOINT:
+            l->p = parent->R * (l->b + l->q * l->d) + parent->p;
+            l->R = parent->R;
+            break;
+        default:
+            l->p = parent->R * l->b + parent->p;
+            l->R = parent->R;
+            break;
+        }
+    }
+    solved[l->index] = revision;
+}
+
+void ForwardKinematics::store(hrp::BodyPtr body, unsigned int revision,
+                              Posture& posture)
+{
+    posture.q.resize(body->numJoints());
+    for (int i=0; i<body->numJoints(); i++){
+        posture.q[i] = body->joint(i)->q;
+    }
+    posture.p = body->rootLink()->p;
+    posture.R = body->rootLink()->R;
+    posture.revision = revision;
+}
+
+void ForwardKinematics::load(const Posture& posture, hrp::BodyPtr body)
+{
+    for (int i=0; i<body->numJoints(); i++){
+        body->joint(i)->q = posture.q[i];
+    }
+    body->rootLink()->p = posture.p;
+    body->rootLink()->R = posture.R;
+}
+
+Time ForwardKinematics::fetch()
+{
+    // called while m_serviceMutex is locked. m_bodyMutex is held only to
+    // copy joint angles
     Guard guard(m_bodyMutex);
-    hrp::Link *l = m_refBody->link(linkname);
+    if (m_refPosture.revision != m_refServiceRevision){
+        load(m_refPosture, m_refServiceBody);
+        m_refServiceRevision = m_refPosture.revision;
+    }
+    if (m_actPosture.revision != m_actServiceRevision){
+        load(m_actPosture, m_actServiceBody);
+        m_actServiceRevision = m_actPosture.revision;
+    }
+    return m_tm;
+}
+
+bool ForwardKinematics::getPose(bool current, const char* linkname,
+                                hrp::Link *frame, CORBA::Double *pose)
+{
+    hrp::BodyPtr body = current ? m_actServiceBody : m_refServiceBody;
+    hrp::Link *l = body->link(linkname);
     if (!l) return false;
+    hrp::Vector3 p;
+    hrp::Matrix33 R;
+    if (current){
+        solve(l, m_actSolved, m_actServiceRevision);
+        p = l->p;
+        R = l->attitude();
+        if (!frame){
+            // the base link of the actual model coincides with that of the reference model
+            solve(m_refLink, m_refSolved, m_refServiceRevision);
+            solve(m_actLink, m_actSolved, m_actServiceRevision);
+            p += m_refLink->p - m_actLink->p;
+        }
+    }else{
+        solve(l, m_refSolved, m_refServiceRevision);
+        p = l->p;
+        R = l->attitude();
+    }
+    if (frame) {
+        solve(frame, current ? m_actSolved : m_refSolved,
+              current ? m_actServiceRevision : m_refServiceRevision);
+        p = frame->attitude().transpose() * ( p - frame->p );
+        R = frame->attitude().transpose() * R;
+    }
+    pose[ 0]=R(0,0);pose[ 1]=R(0,1);pose[ 2]=R(0,2);pose[ 3]=p[0];
+    pose[ 4]=R(1,0);pose[ 5]=R(1,1);pose[ 6]=R(1,2);pose[ 7]=p[1];
+    pose[ 8]=R(2,0);pose[ 9]=R(2,1);pose[10]=R(2,2);pose[11]=p[2];
+    pose[12]=0;     pose[13]=0;     pose[14]=0;     pose[15]=1;
+    return true;
+}
+
+::CORBA::Boolean ForwardKinematics::getReferencePose(const char* linkname, RTC::TimedDoubleSeq_out pose,const char* frame_name)
+{
+    pose = new RTC::TimedDoubleSeq();
+    Guard guard(m_serviceMutex);
+    Time tm = fetch();
     hrp::Link *f = NULL;
     if (frame_name) {
-        f = m_refBody->link(frame_name);
+        f = m_refServiceBody->link(frame_name);
         if (!f) {
             std::cerr << "[getReferencePose] ERROR Could not find frame_name = " << frame_name << std::endl;
             return false;
         }
     }
     std::cerr << "[getReferencePose] linkaname = " << linkname << ", frame_name = " << (frame_name?frame_name:"(null)") << std::endl;
-    hrp::Vector3 p = l->p;
-    hrp::Matrix33 R = l->attitude();
-    if (!!f) {
-        p = f->attitude().transpose() * ( p - f->p );
-        R = f->attitude().transpose() * R;
-    }
-    pose->tm = m_tm;
+    pose->tm = tm;
     pose->data.length(16);
-    pose->data[ 0]=R(0,0);pose->data[ 1]=R(0,1);pose->data[ 2]=R(0,2);pose->data[ 3]=p[0];
-    pose->data[ 4]=R(1,0);pose->data[ 5]=R(1,1);pose->data[ 6]=R(1,2);pose->data[ 7]=p[1];
-    pose->data[ 8]=R(2,0);pose->data[ 9]=R(2,1);pose->data[10]=R(2,2);pose->data[11]=p[2];
-    pose->data[12]=0;     pose->data[13]=0;     pose->data[14]=0;     pose->data[15]=1;
+    if (!getPose(false, linkname, f, pose->data.get_buffer())){
+        pose->data.length(0);
+        return false;
+    }
     return true;
 }
 
 ::CORBA::Boolean ForwardKinematics::getCurrentPose(const char* linkname, RTC::TimedDoubleSeq_out pose, const char* frame_name)
 {
     pose = new RTC::TimedDoubleSeq();
-    Guard guard(m_bodyMutex);
-    hrp::Link *l = m_actBody->link(linkname);
-    if (!l) return false;
+    Guard guard(m_serviceMutex);
+    Time tm = fetch();
     hrp::Link *f = NULL;
     if (frame_name) {
-        f = m_actBody->link(frame_name);
+        f = m_actServiceBody->link(frame_name);
         if (!f) {
             std::cerr << "[getCurrentPose] ERROR Could not find frame_name = " << frame_name << std::endl;
             return false;
         }
     }
     std::cerr << "[getCurrentPose] linkaname = " << linkname << ", frame_name = " << (frame_name?frame_name:"(null)") << std::endl;
-    hrp::Vector3 dp(m_refLink->p - m_actLink->p);
+    pose->tm = tm;
+    pose->data.length(16);
+    if (!getPose(true, linkname, f, pose->data.get_buffer())){
+        pose->data.length(0);
+        return false;
+    }
+    return true;
+}
 
-    hrp::Vector3 p(l->p + dp);
-    hrp::Matrix33 R = l->attitude();
-    if (!!f) {
-        p = f->attitude().transpose() * ( p - f->p);
-        R = f->attitude().transpose() * R;
+::CORBA::Boolean ForwardKinematics::getPoses(const OpenHRP::ForwardKinematicsService::StrSequence& linknames, const char* frame_name, OpenHRP::ForwardKinematicsService::ModelType model, RTC::TimedDoubleSeq_out poses)
+{
+    poses = new RTC::TimedDoubleSeq();
+    bool current = model == OpenHRP::ForwardKinematicsService::CURRENT;
+    Guard guard(m_serviceMutex);
+    Time tm = fetch();
+    hrp::Link *f = NULL;
+    if (frame_name[0] != '\0') {
+        f = (current ? m_actServiceBody : m_refServiceBody)->link(frame_name);
+        if (!f) {
+            std::cerr << "[getPoses] ERROR Could not find frame_name = " << frame_name << std::endl;
+            return false;
+        }
+    }
+    poses->tm = tm;
+    poses->data.length(linknames.length()*16);
+    for (unsigned int i=0; i<linknames.length(); i++){
+        if (!getPose(current, linknames[i], f, poses->data.get_buffer()+i*16)){
+            std::cerr << "[getPoses] ERROR Could not find linkname = " << linknames[i] << std::endl;
+            poses->data.length(0);
+            return false;
+        }
     }
-    pose->tm = m_tm;
-    pose->data.length(16);
-    pose->data[ 0]=R(0,0);pose->data[ 1]=R(0,1);pose->data[ 2]=R(0,2);pose->data[ 3]=p[0];
-    pose->data[ 4]=R(1,0);pose->data[ 5]=R(1,1);pose->data[ 6]=R(1,2);pose->data[ 7]=p[1];
-    pose->data[ 8]=R(2,0);pose->data[ 9]=R(2,1);pose->data[10]=R(2,2);pose->data[11]=p[2];
-    pose->data[12]=0;     pose->data[13]=0;     pose->data[14]=0;     pose->data[15]=1;
     return true;
 }
 
 ::CORBA::Boolean ForwardKinematics::getRelativeCurrentPosition(const char* linknameFrom, const char* linknameTo, const OpenHRP::ForwardKinematicsService::position target, OpenHRP::ForwardKinematicsService::position result)
 {
-    Guard guard(m_bodyMutex);
-    hrp::Link *from = m_actBody->link(linknameFrom);
-    hrp::Link *to = m_actBody->link(linknameTo);
+    Guard guard(m_serviceMutex);
+    fetch();
+    hrp::Link *from = m_actServiceBody->link(linknameFrom);
+    hrp::Link *to = m_actServiceBody->link(linknameTo);
     if (!from || !to) return false;
+    solve(from, m_actSolved, m_actServiceRevision);
+    solve(to, m_actSolved, m_actServiceRevision);
     hrp::Vector3 targetPrel(target[0], target[1], target[2]);
     hrp::Vector3 targetPabs(to->p+to->attitude()*targetPrel);
     hrp::Matrix33 Rt(from->attitude().transpose());
@@ -342,11 +472,11 @@ RTC::ReturnCode_t ForwardKinematics::onRateChanged(RTC::UniqueId ec_id)
 
 ::CORBA::Boolean ForwardKinematics::selectBaseLink(const char* linkname)
 {
-    Guard guard(m_bodyMutex);
-    hrp::Link *l = m_refBody->link(linkname);
+    Guard guard(m_serviceMutex);
+    hrp::Link *l = m_refServiceBody->link(linkname);
     if (!l) return false;
     m_refLink = l;
-    m_actLink = m_actBody->link(linkname);
+    m_actLink = m_actServiceBody->link(linkname);
     return true;
 }
 
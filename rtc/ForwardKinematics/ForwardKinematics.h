@@ -106,6 +106,7 @@ class ForwardKinematics
   ::CORBA::Boolean getCurrentPose(const char* linkname, RTC::TimedDoubleSeq_out pose, const char* frame_name);
   ::CORBA::Boolean getRelativeCurrentPosition(const char* linknameFrom, const char *linknameTo, const OpenHRP::ForwardKinematicsService::position target, OpenHRP::ForwardKinematicsService::position result);
   ::CORBA::Boolean selectBaseLink(const char* linkname);
+  ::CORBA::Boolean getPoses(const OpenHRP::ForwardKinematicsService::StrSequence& linknames, const char* frame_name, OpenHRP::ForwardKinematicsService::ModelType model, RTC::TimedDoubleSeq_out poses);
   
  protected:
   // Configuration variable declaration
@@ -152,12 +153,41 @@ class ForwardKinematics
   // </rtc-template>
 
  private:
+  // joint angles and the root pose of a model
+  struct Posture {
+    hrp::dvector q;
+    hrp::Vector3 p;
+    hrp::Matrix33 R;
+    unsigned int revision;
+  };
+  void solve(hrp::Link *l, std::vector<unsigned int>& solved,
+             unsigned int revision);
+  void store(hrp::BodyPtr body, unsigned int revision, Posture& posture);
+  void load(const Posture& posture, hrp::BodyPtr body);
+  Time fetch();
+  bool getPose(bool current, const char* linkname, hrp::Link *frame,
+               CORBA::Double *pose);
+
   int dummy;
+  // bodies updated by onExecute()
   hrp::BodyPtr m_refBody, m_actBody;
-  hrp::Link *m_refLink, *m_actLink, *m_sensorAttachedLink;
+  hrp::Link *m_sensorAttachedLink;
+  std::vector<unsigned int> m_sensorSolved;
+  unsigned int m_refRevision, m_actRevision;
+  std::string m_sensorAttachedLinkName;
+  // inputs passed from onExecute() to service calls, protected by m_bodyMutex
   coil::Mutex m_bodyMutex;
+  Posture m_refPosture, m_actPosture;
   Time m_tm;
-  std::string m_sensorAttachedLinkName;
+  // copies of bodies solved by service calls, protected by m_serviceMutex,
+  // so slow calls never block onExecute()
+  coil::Mutex m_serviceMutex;
+  hrp::BodyPtr m_refServiceBody, m_actServiceBody;
+  hrp::Link *m_refLink, *m_actLink;
+  unsigned int m_refServiceRevision, m_actServiceRevision;
+  // links whose poses are computed for the latest inputs are stamped with
+  // the revision of the inputs
+  std::vector<unsigned int> m_refSolved, m_actSolved;
 };
 
 
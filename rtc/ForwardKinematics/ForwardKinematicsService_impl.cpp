@@ -44,3 +44,8 @@ void ForwardKinematicsService_impl::setComp(ForwardKinematics *i_comp)
 {
     return m_comp->getRelativeCurrentPosition(linknameFrom, linknameTo, target, result);
 }
+
+::CORBA::Boolean ForwardKinematicsService_impl::getPoses(const OpenHRP::ForwardKinematicsService::StrSequence& linknames, const char* frame_name, OpenHRP::ForwardKinematicsService::ModelType model, RTC::TimedDoubleSeq_out poses)
+{
+    return m_comp->getPoses(linknames, frame_name, model, poses);
+}
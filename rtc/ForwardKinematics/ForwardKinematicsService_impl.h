@@ -26,6 +26,7 @@ public:
     ::CORBA::Boolean getReferencePose(const char* linkname, RTC::TimedDoubleSeq_out pose);
     ::CORBA::Boolean getCurrentPose(const char* linkname, RTC::TimedDoubleSeq_out pose);
     ::CORBA::Boolean getRelativeCurrentPosition(const char* linkname1, const char *linkname2, const OpenHRP::ForwardKinematicsService::position target, OpenHRP::ForwardKinematicsService::position result);
+    ::CORBA::Boolean getPoses(const OpenHRP::ForwardKinematicsService::StrSequence& linknames, const char* frame_name, OpenHRP::ForwardKinematicsService::ModelType model, RTC::TimedDoubleSeq_out poses);
 private:
     ForwardKinematics *m_comp;
 };
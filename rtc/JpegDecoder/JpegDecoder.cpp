@@ -7,9 +7,14 @@
  * $Id$
  */
 
-#include <cv.h>
-#include <highgui.h>
 #include "JpegDecoder.h"
+#ifdef USE_LIBJPEG
+extern "C" {
+#include <jerror.h>
+}
+#else
+#include <highgui.h>
+#endif
 
 // Module specification
 // <rtc-template block="module_spec">
@@ -45,6 +50,46 @@ JpegDecoder::~JpegDecoder()
 {
 }
 
+#ifdef USE_LIBJPEG
+namespace {
+  void errorExit(j_common_ptr cinfo)
+  {
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(((jmp_buf *)cinfo->client_data)[0], 1);
+  }
+
+  // compressed data is read from raw_data of the input directly
+  void initSource(j_decompress_ptr cinfo)
+  {
+  }
+
+  boolean fillInputBuffer(j_decompress_ptr cinfo)
+  {
+    // the data is truncated, so EOI is inserted as jdatasrc.c does
+    static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    cinfo->src->next_input_byte = eoi;
+    cinfo->src->bytes_in_buffer = 2;
+    return TRUE;
+  }
+
+  void skipInputData(j_decompress_ptr cinfo, long num_bytes)
+  {
+    if (num_bytes <= 0) return;
+    if ((size_t)num_bytes > cinfo->src->bytes_in_buffer){
+      fillInputBuffer(cinfo);
+    }else{
+      cinfo->src->next_input_byte += num_bytes;
+      cinfo->src->bytes_in_buffer -= num_bytes;
+    }
+  }
+
+  void termSource(j_decompress_ptr cinfo)
+  {
+  }
+};
+#endif
+
 
 
 RTC::ReturnCode_t JpegDecoder::onInitialize()
@@ -73,17 +118,25 @@ RTC::ReturnCode_t JpegDecoder::onInitialize()
 
   //RTC::Properties& prop = getProperties();
 
+#ifdef USE_LIBJPEG
+  m_cinfo.err = jpeg_std_error(&m_jerr.pub);
+  m_jerr.pub.error_exit = errorExit;
+  m_cinfo.client_data = &m_jerr.jmp;
+  jpeg_create_decompress(&m_cinfo);
+#endif
+
   return RTC::RTC_OK;
 }
 
-
-
-/*
 RTC::ReturnCode_t JpegDecoder::onFinalize()
 {
+#ifdef USE_LIBJPEG
+  jpeg_destroy_decompress(&m_cinfo);
+#endif
   return RTC::RTC_OK;
 }
-*/
+
+
 
 /*
 RTC::ReturnCode_t JpegDecoder::onStartup(RTC::UniqueId ec_id)
@@ -121,46 +174,84 @@ RTC::ReturnCode_t JpegDecoder::onExecute(RTC::UniqueId ec_id)
           return RTC::RTC_OK;
       }
 
-      Img::ImageData& idat = m_encoded.data.image;
-
-      std::vector<uchar>buf;
-      int len = idat.raw_data.length();
-      buf.resize(idat.raw_data.length());
-      memcpy(&buf[0], (void *)&(idat.raw_data[0]), len);
-
-      int flags = (idat.format == Img::CF_GRAY_JPEG) ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR;
-      cv::Mat image = cv::imdecode(cv::Mat(buf), flags);
-
-      if (idat.format == Img::CF_GRAY_JPEG){
-	m_decoded.data.image.format = Img::CF_GRAY;
-	m_decoded.data.image.raw_data.length(image.cols*image.rows);
-      }else{
-	m_decoded.data.image.format = Img::CF_RGB;
-	m_decoded.data.image.raw_data.length(image.cols*image.rows*3);
-      }
-      m_decoded.data.image.width = image.cols;
-      m_decoded.data.image.height = image.rows;
-      unsigned char *src = image.data;
-      unsigned char *dst = m_decoded.data.image.raw_data.get_buffer();
-      if (idat.format == Img::CF_GRAY_JPEG){
-	memcpy(dst, src, m_decoded.data.image.raw_data.length());
-      }else{
-	for (int i=0; i<image.rows; i++){
-          for (int j=0; j<image.cols; j++){
-	    // BGR -> RGB
-	    *dst++ = src[2];
-	    *dst++ = src[1];
-	    *dst++ = src[0];
-	    src+=3;
-          }
-	}
+      if (!decode(m_encoded.data.image, m_decoded.data.image)){
+          std::cerr << m_profile.instance_name << ": failed to decode"
+                    << std::endl;
+          return RTC::RTC_OK;
       }
+      m_decoded.tm = m_encoded.tm;
+      m_decoded.error_code = m_encoded.error_code;
 
       m_decodedOut.write();
   }
   return RTC::RTC_OK;
 }
 
+bool JpegDecoder::decode(const Img::ImageData& i_src, Img::ImageData& o_dst)
+{
+  int channels;
+  switch(i_src.format){
+  case Img::CF_RGB_JPEG:
+    channels = 3;
+    break;
+  case Img::CF_GRAY_JPEG:
+    channels = 1;
+    break;
+  default:
+    return false;
+  }
+
+#ifdef USE_LIBJPEG
+  // scanlines are written to raw_data of the output directly
+  struct jpeg_source_mgr src;
+  src.init_source = initSource;
+  src.fill_input_buffer = fillInputBuffer;
+  src.skip_input_data = skipInputData;
+  src.resync_to_restart = jpeg_resync_to_restart;
+  src.term_source = termSource;
+  src.next_input_byte = i_src.raw_data.get_buffer();
+  src.bytes_in_buffer = i_src.raw_data.length();
+  if (setjmp(m_jerr.jmp)){
+    jpeg_abort_decompress(&m_cinfo);
+    m_cinfo.src = NULL;
+    return false;
+  }
+  m_cinfo.src = &src;
+  jpeg_read_header(&m_cinfo, TRUE);
+  m_cinfo.out_color_space = channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+  jpeg_start_decompress(&m_cinfo);
+  o_dst.width = m_cinfo.output_width;
+  o_dst.height = m_cinfo.output_height;
+  o_dst.raw_data.length(o_dst.width*o_dst.height*channels);
+  unsigned char *raw = o_dst.raw_data.get_buffer();
+  while (m_cinfo.output_scanline < m_cinfo.output_height){
+    JSAMPROW row = raw + m_cinfo.output_scanline*o_dst.width*channels;
+    jpeg_read_scanlines(&m_cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&m_cinfo);
+  m_cinfo.src = NULL;
+#else
+  // the input is decoded without copying it
+  cv::Mat buf(1, i_src.raw_data.length(), CV_8U,
+              (void *)i_src.raw_data.get_buffer());
+  int flags = channels == 1 ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR;
+  cv::Mat image = cv::imdecode(buf, flags);
+  if (image.empty()) return false;
+  o_dst.width = image.cols;
+  o_dst.height = image.rows;
+  o_dst.raw_data.length(image.cols*image.rows*channels);
+  cv::Mat dst(image.rows, image.cols, image.type(),
+              o_dst.raw_data.get_buffer());
+  if (channels == 3){
+    cv::cvtColor(image, dst, CV_BGR2RGB);
+  }else{
+    image.copyTo(dst);
+  }
+#endif
+  o_dst.format = channels == 3 ? Img::CF_RGB : Img::CF_GRAY;
+  return true;
+}
+
 /*
 RTC::ReturnCode_t JpegDecoder::onAborting(RTC::UniqueId ec_id)
 {
@@ -17,6 +17,15 @@
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
 #include "Img.hh"
+#ifdef USE_LIBJPEG
+#include <stdio.h>
+#include <setjmp.h>
+extern "C" {
+#include <jpeglib.h>
+}
+#else
+#include <cv.h>
+#endif
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -53,7 +62,7 @@ class JpegDecoder
 
   // The finalize action (on ALIVE->END transition)
   // formaer rtc_exiting_entry()
-  // virtual RTC::ReturnCode_t onFinalize();
+  virtual RTC::ReturnCode_t onFinalize();
 
   // The startup action when ExecutionContext startup
   // former rtc_starting_entry()
@@ -134,6 +143,20 @@ class JpegDecoder
   // </rtc-template>
 
  private:
+  /**
+     \brief decode an image into o_dst, whose buffer is reused if it is
+     large enough
+     \return false if the format is not supported or decoding fails
+   */
+  bool decode(const Img::ImageData& i_src, Img::ImageData& o_dst);
+#ifdef USE_LIBJPEG
+  struct errorManager {
+    struct jpeg_error_mgr pub;
+    jmp_buf jmp;
+  };
+  struct jpeg_decompress_struct m_cinfo;
+  errorManager m_jerr;
+#endif
   int dummy;
 };
 
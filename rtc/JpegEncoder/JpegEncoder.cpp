@@ -7,9 +7,11 @@
  * $Id$
  */
 
-#include <cv.h>
-#include <highgui.h>
+#include <boost/bind.hpp>
 #include "JpegEncoder.h"
+#ifndef USE_LIBJPEG
+#include <highgui.h>
+#endif
 
 // Module specification
 // <rtc-template block="module_spec">
@@ -27,6 +29,7 @@ static const char* jpegdecoder_spec[] =
     "lang_type",         "compile",
     // Configuration variables
     "conf.default.quality", "95",
+    "conf.default.threaded", "0",
 
     ""
   };
@@ -39,14 +42,65 @@ JpegEncoder::JpegEncoder(RTC::Manager* manager)
     m_encodedOut("encoded", m_encoded),
     // </rtc-template>
     m_quality(95),
+    m_threaded(0),
+    m_worker(NULL),
+    m_busy(false), m_ready(false), m_quit(false),
     dummy(0)
 {
 }
 
 JpegEncoder::~JpegEncoder()
 {
+  stopWorker();
 }
 
+#ifdef USE_LIBJPEG
+namespace {
+  void errorExit(j_common_ptr cinfo)
+  {
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(((jmp_buf *)cinfo->client_data)[0], 1);
+  }
+
+  // compressed data is written to raw_data directly, which is extended when
+  // it is full. Its maximum length is kept across frames, so it is
+  // reallocated only when a frame is larger than all of the previous ones
+  struct destinationManager {
+    struct jpeg_destination_mgr pub;
+    Img::ImageData *image;
+  };
+
+  void initDestination(j_compress_ptr cinfo)
+  {
+    destinationManager *dest = (destinationManager *)cinfo->dest;
+    Img::ImageData& image = *dest->image;
+    CORBA::ULong len = image.raw_data.maximum();
+    if (len < 65536) len = 65536;
+    image.raw_data.length(len);
+    dest->pub.next_output_byte = image.raw_data.get_buffer();
+    dest->pub.free_in_buffer = len;
+  }
+
+  boolean emptyOutputBuffer(j_compress_ptr cinfo)
+  {
+    destinationManager *dest = (destinationManager *)cinfo->dest;
+    Img::ImageData& image = *dest->image;
+    CORBA::ULong len = image.raw_data.length();
+    image.raw_data.length(len*2);
+    dest->pub.next_output_byte = image.raw_data.get_buffer() + len;
+    dest->pub.free_in_buffer = len;
+    return TRUE;
+  }
+
+  void termDestination(j_compress_ptr cinfo)
+  {
+    destinationManager *dest = (destinationManager *)cinfo->dest;
+    Img::ImageData& image = *dest->image;
+    image.raw_data.length(image.raw_data.length() - dest->pub.free_in_buffer);
+  }
+};
+#endif
+
 
 
 RTC::ReturnCode_t JpegEncoder::onInitialize()
@@ -55,6 +109,7 @@ RTC::ReturnCode_t JpegEncoder::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("quality", m_quality, "95");
+  bindParameter("threaded", m_threaded, "0");
   
   // </rtc-template>
 
@@ -76,17 +131,26 @@ RTC::ReturnCode_t JpegEncoder::onInitialize()
 
   //RTC::Properties& prop = getProperties();
 
+#ifdef USE_LIBJPEG
+  m_cinfo.err = jpeg_std_error(&m_jerr.pub);
+  m_jerr.pub.error_exit = errorExit;
+  m_cinfo.client_data = &m_jerr.jmp;
+  jpeg_create_compress(&m_cinfo);
+#endif
+
   return RTC::RTC_OK;
 }
 
-
-
-/*
 RTC::ReturnCode_t JpegEncoder::onFinalize()
 {
+  stopWorker();
+#ifdef USE_LIBJPEG
+  jpeg_destroy_compress(&m_cinfo);
+#endif
   return RTC::RTC_OK;
 }
-*/
+
+
 
 /*
 RTC::ReturnCode_t JpegEncoder::onStartup(RTC::UniqueId ec_id)
@@ -105,63 +169,166 @@ RTC::ReturnCode_t JpegEncoder::onShutdown(RTC::UniqueId ec_id)
 RTC::ReturnCode_t JpegEncoder::onActivated(RTC::UniqueId ec_id)
 {
   std::cout << m_profile.instance_name<< ": onActivated(" << ec_id << ")" << std::endl;
+  if (m_threaded) startWorker();
   return RTC::RTC_OK;
 }
 
 RTC::ReturnCode_t JpegEncoder::onDeactivated(RTC::UniqueId ec_id)
 {
   std::cout << m_profile.instance_name<< ": onDeactivated(" << ec_id << ")" << std::endl;
+  stopWorker();
   return RTC::RTC_OK;
 }
 
 RTC::ReturnCode_t JpegEncoder::onExecute(RTC::UniqueId ec_id)
 {
     //std::cout << m_profile.instance_name<< ": onExecute(" << ec_id << ")" << std::endl;
-  if (m_decodedIn.isNew()){
+  if (!m_worker){
+    if (m_decodedIn.isNew()){
       m_decodedIn.read();
-
-      Img::ImageData& idat = m_decoded.data.image;
-      std::vector<uchar>buf;
-      std::vector<int> param = std::vector<int>(2);
-      param[0] = CV_IMWRITE_JPEG_QUALITY;
-      param[1] = m_quality;
-
-      switch(idat.format){
-      case Img::CF_RGB:
-	{
-	  // RGB -> BGR
-	  uchar r,g,b, *raw=idat.raw_data.get_buffer();
-	  for (int i=0; i<idat.raw_data.length(); i+=3, raw+=3){
-	    r = raw[0]; g = raw[1]; b = raw[2];
-	    raw[0] = b; raw[1] = g; raw[2] = r;
-	  }
-	  
-	  cv::Mat src(idat.height, idat.width, CV_8UC3, 
-		      idat.raw_data.get_buffer());
-	  imencode(".jpg", src, buf, param);
-	  m_encoded.data.image.format = Img::CF_RGB_JPEG;
-	}
-	break;
-      case Img::CF_GRAY:
-	{
-	  cv::Mat src(idat.height, idat.width, CV_8U, 
-		      idat.raw_data.get_buffer());
-	  imencode(".jpg", src, buf, param);
-	  m_encoded.data.image.format = Img::CF_GRAY_JPEG;
-	}
-	break;
+      if (encode(m_decoded.data.image, m_encoded.data.image)){
+        m_encoded.tm = m_decoded.tm;
+        m_encoded.error_code = m_decoded.error_code;
+        m_encodedOut.write();
       }
-      m_encoded.data.image.raw_data.length(buf.size());
-      unsigned char *dst = m_encoded.data.image.raw_data.get_buffer();
-      memcpy(dst, &buf[0], buf.size());
+    }
+    return RTC::RTC_OK;
+  }
+
+  // the result is published here to write the port only by this thread.
+  // An input image is dropped while the worker is encoding the last one
+  boost::mutex::scoped_lock lock(m_mutex);
+  if (m_ready){
+    m_encodedOut.write();
+    m_ready = false;
+  }
+  if (m_decodedIn.isNew()){
+    m_decodedIn.read();
+    if (!m_busy){
+      Img::ImageData& src = m_decoded.data.image;
+      Img::ImageData& dst = m_pending.data.image;
+      dst.width = src.width;
+      dst.height = src.height;
+      dst.format = src.format;
+      dst.raw_data.length(src.raw_data.length());
+      memcpy(dst.raw_data.get_buffer(), src.raw_data.get_buffer(),
+             src.raw_data.length());
+      m_pending.tm = m_decoded.tm;
+      m_pending.error_code = m_decoded.error_code;
+      m_busy = true;
+      m_cond.notify_one();
+    }
+  }
+  return RTC::RTC_OK;
+}
+
+bool JpegEncoder::encode(const Img::ImageData& i_src, Img::ImageData& o_dst)
+{
+  int channels;
+  switch(i_src.format){
+  case Img::CF_RGB:
+    channels = 3;
+    o_dst.format = Img::CF_RGB_JPEG;
+    break;
+  case Img::CF_GRAY:
+    channels = 1;
+    o_dst.format = Img::CF_GRAY_JPEG;
+    break;
+  default:
+    return false;
+  }
+  if (i_src.raw_data.length() < (CORBA::ULong)(i_src.width*i_src.height*channels)){
+    return false;
+  }
+  o_dst.width = i_src.width;
+  o_dst.height = i_src.height;
+
+#ifdef USE_LIBJPEG
+  // RGB pixels are given to libjpeg as they are
+  destinationManager dest;
+  dest.pub.init_destination = initDestination;
+  dest.pub.empty_output_buffer = emptyOutputBuffer;
+  dest.pub.term_destination = termDestination;
+  dest.image = &o_dst;
+  if (setjmp(m_jerr.jmp)){
+    jpeg_abort_compress(&m_cinfo);
+    return false;
+  }
+  m_cinfo.dest = &dest.pub;
+  m_cinfo.image_width = i_src.width;
+  m_cinfo.image_height = i_src.height;
+  m_cinfo.input_components = channels;
+  m_cinfo.in_color_space = channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+  jpeg_set_defaults(&m_cinfo);
+  jpeg_set_quality(&m_cinfo, m_quality, TRUE);
+  jpeg_start_compress(&m_cinfo, TRUE);
+  const unsigned char *raw = i_src.raw_data.get_buffer();
+  while (m_cinfo.next_scanline < m_cinfo.image_height){
+    JSAMPROW row = (JSAMPROW)(raw + m_cinfo.next_scanline*i_src.width*channels);
+    jpeg_write_scanlines(&m_cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&m_cinfo);
+  m_cinfo.dest = NULL;
+#else
+  std::vector<int> param = std::vector<int>(2);
+  param[0] = CV_IMWRITE_JPEG_QUALITY;
+  param[1] = m_quality;
+  // the input image is not modified since it may be shared with others
+  cv::Mat src(i_src.height, i_src.width, channels == 3 ? CV_8UC3 : CV_8U,
+              (void *)i_src.raw_data.get_buffer());
+  if (channels == 3){
+    cv::cvtColor(src, m_bgr, CV_RGB2BGR);
+    imencode(".jpg", m_bgr, m_buf, param);
+  }else{
+    imencode(".jpg", src, m_buf, param);
+  }
+  o_dst.raw_data.length(m_buf.size());
+  memcpy(o_dst.raw_data.get_buffer(), &m_buf[0], m_buf.size());
+#endif
 
 #if 0
-      std::cout << "JpegEncoder:" << idat.raw_data.length() << "->"
-		<< m_encoded.data.image.raw_data.length() << std::endl;
+  std::cout << "JpegEncoder:" << i_src.raw_data.length() << "->"
+            << o_dst.raw_data.length() << std::endl;
 #endif
-      m_encodedOut.write();
+  return true;
+}
+
+void JpegEncoder::worker()
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  while (1){
+    while (!m_busy && !m_quit) m_cond.wait(lock);
+    if (m_quit) break;
+    lock.unlock();
+    bool ok = encode(m_pending.data.image, m_encoded.data.image);
+    lock.lock();
+    if (ok){
+      m_encoded.tm = m_pending.tm;
+      m_encoded.error_code = m_pending.error_code;
+      m_ready = true;
+    }
+    m_busy = false;
   }
-  return RTC::RTC_OK;
+}
+
+void JpegEncoder::startWorker()
+{
+  if (m_worker) return;
+  m_busy = m_ready = m_quit = false;
+  m_worker = new boost::thread(boost::bind(&JpegEncoder::worker, this));
+}
+
+void JpegEncoder::stopWorker()
+{
+  if (!m_worker) return;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_quit = true;
+    m_cond.notify_one();
+  }
+  m_worker->join();
+  delete m_worker;
+  m_worker = NULL;
 }
 
 /*
@@ -17,6 +17,18 @@
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
 #include "Img.hh"
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#ifdef USE_LIBJPEG
+#include <stdio.h>
+#include <setjmp.h>
+extern "C" {
+#include <jpeglib.h>
+}
+#else
+#include <cv.h>
+#endif
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -53,7 +65,7 @@ class JpegEncoder
 
   // The finalize action (on ALIVE->END transition)
   // formaer rtc_exiting_entry()
-  // virtual RTC::ReturnCode_t onFinalize();
+  virtual RTC::ReturnCode_t onFinalize();
 
   // The startup action when ExecutionContext startup
   // former rtc_starting_entry()
@@ -134,7 +146,35 @@ class JpegEncoder
   // </rtc-template>
 
  private:
+  /**
+     \brief encode an image. Buffer of o_dst is reused if it is large enough
+     \return false if the format is not supported or encoding fails
+   */
+  bool encode(const Img::ImageData& i_src, Img::ImageData& o_dst);
+  void worker();
+  void startWorker();
+  void stopWorker();
+
   int m_quality;
+  // encode images by a worker thread instead of the execution context
+  int m_threaded;
+#ifdef USE_LIBJPEG
+  struct errorManager {
+    struct jpeg_error_mgr pub;
+    jmp_buf jmp;
+  };
+  struct jpeg_compress_struct m_cinfo;
+  errorManager m_jerr;
+#else
+  cv::Mat m_bgr;
+  std::vector<uchar> m_buf;
+#endif
+  // an image passed to the worker, which writes its result to m_encoded
+  Img::TimedCameraImage m_pending;
+  boost::thread *m_worker;
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+  bool m_busy, m_ready, m_quit;
   int dummy;
 };
 
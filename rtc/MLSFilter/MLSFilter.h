@@ -16,7 +16,10 @@
 #include <rtm/DataInPort.h>
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
 #include "pointcloud.hh"
+#include "MLSSmoother.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -133,8 +136,16 @@ class MLSFilter
   // </rtc-template>
 
  private:
+  void filterPCL();
+  void filterNative(unsigned int i_npoint);
+  pcl::PointCloud<pcl::PointXYZ>::Ptr m_cloud, m_cloudFiltered;
+  MLSSmoother m_smoother;
   int dummy;
   double m_radius;
+  int m_usePCL, m_threads, m_debugLevel;
+  // statistics for debugLevel
+  unsigned long long m_npoints;
+  double m_elapsed, m_tReport;
 };
 
 
@@ -0,0 +1,249 @@
+// -*- C++ -*-
+/*!
+ * @file  MLSSmoother.cpp
+ * @brief moving least squares smoothing based on a reusable voxel hash
+ */
+#include <cmath>
+#include <cstring>
+#include <boost/bind.hpp>
+#include <Eigen/Dense>
+#include "MLSSmoother.h"
+
+// cell indices are packed into 21 bits each
+#define INDEX_BITS   21
+#define INDEX_OFFSET (1<<(INDEX_BITS-1))
+#define INDEX_MASK   ((1ULL<<INDEX_BITS)-1)
+#define INVALID_KEY  (~0ULL)
+#define MIN_TABLE_SIZE 1024
+
+static inline unsigned int slotOf(unsigned long long i_key)
+{
+    unsigned long long h = i_key*0x9E3779B97F4A7C15ULL;
+    return (unsigned int)(h ^ (h >> 31));
+}
+
+MLSSmoother::MLSSmoother() :
+    m_radius(0.03), m_nthreads(1), m_mask(0),
+    m_points(NULL), m_npoints(0), m_pointStep(16), m_colored(false),
+    m_output(NULL), m_stage(KEYS)
+{
+    m_neighbors.resize(1);
+}
+
+void MLSSmoother::setRadius(double i_radius)
+{
+    m_radius = i_radius;
+}
+
+void MLSSmoother::setNumThreads(int i_nthreads)
+{
+    if (i_nthreads < 1) i_nthreads = 1;
+    m_pool.setNumThreads(i_nthreads);
+    m_nthreads = i_nthreads;
+    m_neighbors.resize(m_nthreads);
+}
+
+void MLSSmoother::run(int i_part)
+{
+    switch(m_stage){
+    case KEYS: computeKeys(i_part); break;
+    case FIT:  fit(i_part); break;
+    }
+}
+
+void MLSSmoother::dispatch(Stage i_stage)
+{
+    m_stage = i_stage;
+    m_pool.run(boost::bind(&MLSSmoother::run, this, _1),
+               m_npoints >= (unsigned int)m_nthreads);
+}
+
+void MLSSmoother::computeKeys(int i_part)
+{
+    unsigned int begin = (unsigned long long)m_npoints*i_part/m_nthreads;
+    unsigned int end = (unsigned long long)m_npoints*(i_part+1)/m_nthreads;
+    const float limit = INDEX_OFFSET - 1;
+    const float inv = 1.0/m_radius;
+    const unsigned char *ptr = m_points + (size_t)begin*m_pointStep;
+    for (unsigned int i=begin; i<end; i++, ptr+=m_pointStep){
+        const float *p = (const float *)ptr;
+        float fx = p[0]*inv, fy = p[1]*inv, fz = p[2]*inv;
+        // comparisons with NaN are false, so NaNs are rejected here too
+        if (!(fabsf(fx) < limit && fabsf(fy) < limit && fabsf(fz) < limit)){
+            m_keys[i] = INVALID_KEY;
+            continue;
+        }
+        unsigned long long ix = (long long)floorf(fx) + INDEX_OFFSET;
+        unsigned long long iy = (long long)floorf(fy) + INDEX_OFFSET;
+        unsigned long long iz = (long long)floorf(fz) + INDEX_OFFSET;
+        m_keys[i] = (ix << (2*INDEX_BITS)) | (iy << INDEX_BITS) | iz;
+    }
+}
+
+int MLSSmoother::findCell(unsigned long long i_key) const
+{
+    unsigned int s = slotOf(i_key) & m_mask;
+    while (m_table[s] >= 0){
+        if (m_cells[m_table[s]].key == i_key) return m_table[s];
+        s = (s+1) & m_mask;
+    }
+    return -1;
+}
+
+void MLSSmoother::buildGrid()
+{
+    // keep the load factor below 1/2 even if all points are in their own
+    // cells
+    unsigned int size = MIN_TABLE_SIZE;
+    while (size < m_npoints*2) size *= 2;
+    if (m_table.size() < size) m_table.resize(size);
+    m_mask = m_table.size() - 1;
+    for (unsigned int i=0; i<m_table.size(); i++) m_table[i] = -1;
+
+    m_cells.clear();
+    for (unsigned int i=0; i<m_npoints; i++){
+        unsigned long long key = m_keys[i];
+        if (key == INVALID_KEY) continue;
+        unsigned int s = slotOf(key) & m_mask;
+        while (m_table[s] >= 0 && m_cells[m_table[s]].key != key){
+            s = (s+1) & m_mask;
+        }
+        if (m_table[s] < 0){
+            m_table[s] = m_cells.size();
+            Cell c = {key, 0, 0};
+            m_cells.push_back(c);
+        }
+        m_cellOf[i] = m_table[s];
+        m_cells[m_table[s]].count++;
+    }
+    // points are sorted by cells
+    unsigned int start = 0;
+    for (unsigned int i=0; i<m_cells.size(); i++){
+        m_cells[i].start = start;
+        start += m_cells[i].count;
+        m_cells[i].count = 0;
+    }
+    for (unsigned int i=0; i<m_npoints; i++){
+        if (m_keys[i] == INVALID_KEY) continue;
+        Cell& c = m_cells[m_cellOf[i]];
+        m_sorted[c.start + c.count++] = i;
+    }
+}
+
+void MLSSmoother::fit(int i_part)
+{
+    unsigned int begin = (unsigned long long)m_npoints*i_part/m_nthreads;
+    unsigned int end = (unsigned long long)m_npoints*(i_part+1)/m_nthreads;
+    const double r2 = m_radius*m_radius;
+    std::vector<double>& nb = m_neighbors[i_part];
+    for (unsigned int i=begin; i<end; i++){
+        m_valid[i] = 0;
+        unsigned long long key = m_keys[i];
+        if (key == INVALID_KEY) continue;
+        const float *p = (const float *)(m_points + (size_t)i*m_pointStep);
+
+        // neighbors in 27 cells around the point
+        nb.clear();
+        unsigned long long ix = key >> (2*INDEX_BITS);
+        unsigned long long iy = (key >> INDEX_BITS) & INDEX_MASK;
+        unsigned long long iz = key & INDEX_MASK;
+        for (int dx=-1; dx<=1; dx++){
+            for (int dy=-1; dy<=1; dy++){
+                for (int dz=-1; dz<=1; dz++){
+                    unsigned long long k = ((ix+dx) << (2*INDEX_BITS))
+                        | ((iy+dy) << INDEX_BITS) | (iz+dz);
+                    int c = findCell(k);
+                    if (c < 0) continue;
+                    const Cell& cell = m_cells[c];
+                    for (unsigned int j=0; j<cell.count; j++){
+                        const float *q = (const float *)(m_points + (size_t)m_sorted[cell.start+j]*m_pointStep);
+                        double ddx = q[0]-p[0], ddy = q[1]-p[1], ddz = q[2]-p[2];
+                        if (ddx*ddx + ddy*ddy + ddz*ddz > r2) continue;
+                        nb.push_back(q[0]);
+                        nb.push_back(q[1]);
+                        nb.push_back(q[2]);
+                    }
+                }
+            }
+        }
+        unsigned int k = nb.size()/3;
+        if (k < 3) continue;
+
+        // plane fitted to neighbors
+        Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+        Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+        for (unsigned int j=0; j<k; j++){
+            Eigen::Vector3d q(nb[j*3], nb[j*3+1], nb[j*3+2]);
+            mean += q;
+            cov += q*q.transpose();
+        }
+        mean /= k;
+        cov = cov/k - mean*mean.transpose();
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> es;
+        es.computeDirect(cov);
+        Eigen::Vector3d normal = es.eigenvectors().col(0);
+        Eigen::Vector3d pt(p[0], p[1], p[2]);
+        pt -= (pt - mean).dot(normal)*normal;
+
+        // second order polynomial of height over the plane
+        if (k >= 6){
+            Eigen::Vector3d vAxis = normal.unitOrthogonal();
+            Eigen::Vector3d uAxis = normal.cross(vAxis);
+            Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Zero();
+            Eigen::Matrix<double, 6, 1> b = Eigen::Matrix<double, 6, 1>::Zero();
+            for (unsigned int j=0; j<k; j++){
+                Eigen::Vector3d d = Eigen::Vector3d(nb[j*3], nb[j*3+1], nb[j*3+2]) - pt;
+                double w = exp(-d.squaredNorm()/r2);
+                double u = d.dot(uAxis), v = d.dot(vAxis), f = d.dot(normal);
+                Eigen::Matrix<double, 6, 1> t;
+                t << 1, v, v*v, u, u*v, u*u;
+                A.noalias() += w*t*t.transpose();
+                b += w*f*t;
+            }
+            Eigen::LLT<Eigen::Matrix<double, 6, 6> > llt(A);
+            if (llt.info() == Eigen::Success){
+                Eigen::Matrix<double, 6, 1> c = llt.solve(b);
+                pt += c[0]*normal;
+            }
+        }
+
+        float *out = m_output + (size_t)i*4;
+        out[0] = pt[0]; out[1] = pt[1]; out[2] = pt[2];
+        if (m_colored){
+            memcpy(out+3, p+3, 4);
+        }else{
+            out[3] = 0;
+        }
+        m_valid[i] = 1;
+    }
+}
+
+unsigned int MLSSmoother::filter(const unsigned char *i_points,
+                                 unsigned int i_npoints,
+                                 unsigned int i_pointStep,
+                                 bool i_colored, float *o_points)
+{
+    if (!i_npoints) return 0;
+    m_points = i_points;
+    m_npoints = i_npoints;
+    m_pointStep = i_pointStep;
+    m_colored = i_colored;
+    m_output = o_points;
+    m_keys.resize(i_npoints);
+    m_cellOf.resize(i_npoints);
+    m_sorted.resize(i_npoints);
+    m_valid.resize(i_npoints);
+
+    dispatch(KEYS);
+    buildGrid();
+    dispatch(FIT);
+
+    // points are written at their indices, so pack them
+    unsigned int n = 0;
+    for (unsigned int i=0; i<i_npoints; i++){
+        if (!m_valid[i]) continue;
+        if (n != i) memcpy(o_points + (size_t)n*4, o_points + (size_t)i*4, 16);
+        n++;
+    }
+    return n;
+}
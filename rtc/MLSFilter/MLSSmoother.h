@@ -0,0 +1,85 @@
+// -*- C++ -*-
+/*!
+ * @file  MLSSmoother.h
+ * @brief moving least squares smoothing based on a reusable voxel hash
+ */
+#ifndef MLS_SMOOTHER_H
+#define MLS_SMOOTHER_H
+
+#include <vector>
+#include "util/WorkerPool.h"
+
+/**
+   \brief move each point onto a second order polynomial surface fitted to
+   its neighbors as pcl::MovingLeastSquares does with setPolynomialFit(true)
+
+   Points are 16 byte or larger records which start with float x, y and z.
+   When colored, the word at offset 12 (rgb) is copied as it is. Points
+   with NaN or too large coordinates and points which have fewer than 3
+   neighbors are dropped.
+
+   Neighbors are found in a hash grid whose cells are as large as the
+   search radius, so only 27 cells are visited for each point. Fits run in
+   parallel over chunks of points. The grid and buffers are kept across
+   calls and only grow, so no allocation occurs in steady state.
+ */
+class MLSSmoother
+{
+public:
+    MLSSmoother();
+    /**
+       \brief set the radius to find neighbors[m]
+     */
+    void setRadius(double i_radius);
+    /**
+       \brief set the number of threads including the calling thread
+     */
+    void setNumThreads(int i_nthreads);
+    int numThreads() const { return m_nthreads; }
+    /**
+       \brief smooth points
+       \param i_points input points
+       \param i_npoints the number of input points
+       \param i_pointStep size of an input point[byte]
+       \param i_colored copy rgb if true
+       \param o_points output buffer for 16 byte points. It must be able to
+       store i_npoints points
+       \return the number of output points
+     */
+    unsigned int filter(const unsigned char *i_points, unsigned int i_npoints,
+                        unsigned int i_pointStep, bool i_colored,
+                        float *o_points);
+private:
+    enum Stage { KEYS, FIT };
+    struct Cell {
+        unsigned long long key;
+        unsigned int start, count;
+    };
+    void run(int i_part);
+    void dispatch(Stage i_stage);
+    void computeKeys(int i_part);
+    void buildGrid();
+    int findCell(unsigned long long i_key) const;
+    void fit(int i_part);
+
+    double m_radius;
+    int m_nthreads;
+    std::vector<unsigned long long> m_keys;
+    std::vector<Cell> m_cells;
+    std::vector<int> m_table;       ///< indices of cells, -1 if empty
+    unsigned int m_mask;
+    std::vector<unsigned int> m_cellOf, m_sorted;
+    std::vector<unsigned char> m_valid;
+    std::vector<std::vector<double> > m_neighbors; ///< buffer per thread
+
+    // arguments of the current call and the current stage
+    const unsigned char *m_points;
+    unsigned int m_npoints, m_pointStep;
+    bool m_colored;
+    float *m_output;
+    Stage m_stage;
+
+    WorkerPool m_pool;
+};
+
+#endif // MLS_SMOOTHER_H
@@ -0,0 +1,296 @@
+/* -*- coding:utf-8-unix; mode:c++; -*- */
+
+#include "MLSSmoother.h"
+/* samples */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <sys/time.h>
+
+class testMLSSmoother
+{
+protected:
+    double radius; /* [m] */
+    double noise; /* [m] */
+    unsigned int npoints;
+    int nthreads, nloop;
+    std::string pcd;
+    std::vector<float> input, output;
+    double uniform (double min, double max) { return min + (max-min)*rand()/(double)RAND_MAX; };
+    double surface (double x, double y) { return 0.1*sin(2*x)*cos(2*y); };
+    void gen_points ()
+    {
+        // wavy surface with noise along z in a square of 1.5[m]
+        input.resize(npoints*4);
+        srand(0);
+        for (unsigned int i = 0; i < npoints; i++) {
+            float *p = &input[i*4];
+            p[0] = uniform(-0.75, 0.75); p[1] = uniform(-0.75, 0.75);
+            p[2] = surface(p[0], p[1]) + uniform(-noise, noise);
+            p[3] = 0;
+        }
+    };
+    void add_point (std::vector<float>& io_points, float x, float y, float z)
+    {
+        io_points.push_back(x); io_points.push_back(y); io_points.push_back(z); io_points.push_back(0);
+    };
+    // ascii or binary PCD file whose first fields are float x, y and z
+    bool load_pcd (const std::string& filename)
+    {
+        std::ifstream ifs(filename.c_str(), std::ios::binary);
+        if (!ifs) {
+            std::cerr << "[testMLSSmoother]   can't open " << filename << std::endl;
+            return false;
+        }
+        std::string line, data;
+        unsigned int nfields = 0, step = 0, n = 0;
+        while (std::getline(ifs, line)) {
+            std::istringstream iss(line);
+            std::string key;
+            iss >> key;
+            if (key == "FIELDS") {
+                std::string f;
+                while (iss >> f) nfields++;
+            } else if (key == "SIZE") {
+                unsigned int s;
+                while (iss >> s) step += s;
+            } else if (key == "POINTS") {
+                iss >> n;
+            } else if (key == "DATA") {
+                iss >> data;
+                break;
+            }
+        }
+        input.resize(n*4);
+        for (unsigned int i = 0; i < n; i++) {
+            float *p = &input[i*4];
+            if (data == "ascii") {
+                std::getline(ifs, line);
+                std::istringstream iss(line);
+                iss >> p[0] >> p[1] >> p[2];
+            } else if (data == "binary") {
+                std::vector<char> buf(step);
+                ifs.read(&buf[0], step);
+                memcpy(p, &buf[0], 12);
+            } else {
+                std::cerr << "[testMLSSmoother]   unsupported data type " << data << std::endl;
+                return false;
+            }
+            p[3] = 0;
+        }
+        if (!ifs || nfields < 3) {
+            std::cerr << "[testMLSSmoother]   failed to read " << filename << std::endl;
+            return false;
+        }
+        return true;
+    };
+    unsigned int smooth (MLSSmoother& smoother)
+    {
+        output.resize(input.size());
+        unsigned int n = 0;
+        struct timeval t1, t2;
+        gettimeofday(&t1, NULL);
+        for (int i = 0; i < nloop; i++) {
+            n = smoother.filter((const unsigned char *)&input[0], input.size()/4, 16, false, &output[0]);
+        }
+        gettimeofday(&t2, NULL);
+        double dt = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec)/1e6;
+        std::cerr << "[testMLSSmoother]   " << input.size()/4 << " -> " << n << " points, "
+                  << input.size()/4*nloop/dt << " [points/s]" << std::endl;
+        return n;
+    };
+    double rms_error (const std::vector<float>& points, unsigned int n)
+    {
+        double e = 0;
+        unsigned int m = 0;
+        for (unsigned int i = 0; i < n; i++) {
+            const float *p = &points[i*4];
+            // away from the border where the fit is one-sided
+            if (std::isnan(p[0]) || std::isnan(p[1]) || std::isnan(p[2])
+                || fabs(p[0]) > 0.75 - radius || fabs(p[1]) > 0.75 - radius) continue;
+            double d = p[2] - surface(p[0], p[1]);
+            e += d*d;
+            m++;
+        }
+        return m ? sqrt(e/m) : 0;
+    };
+public:
+    std::vector<std::string> arg_strs;
+    testMLSSmoother () : radius(0.03), noise(0.005), npoints(50000), nthreads(1), nloop(5) {};
+    bool test0 ()
+    {
+        std::cerr << "test0 : noisy wavy surface" << std::endl;
+        parse_params();
+        if (!pcd.empty()) return test_pcd();
+        gen_points();
+        MLSSmoother smoother;
+        smoother.setRadius(radius);
+        smoother.setNumThreads(nthreads);
+        unsigned int n = smooth(smoother);
+        double e1 = rms_error(input, npoints), e2 = rms_error(output, n);
+        std::cerr << "[testMLSSmoother]   rms error " << e1 << " -> " << e2 << " [m]" << std::endl;
+        // all points have enough neighbors
+        if (n != npoints) {
+            std::cerr << "[testMLSSmoother]   expected " << npoints << " points" << std::endl;
+            return false;
+        }
+        return e2 < e1*0.5;
+    };
+    bool test1 ()
+    {
+        std::cerr << "test1 : points on a slope" << std::endl;
+        parse_params();
+        // a polynomial surface fits a plane exactly, so points stay there
+        input.clear();
+        srand(0);
+        for (unsigned int i = 0; i < npoints/10; i++) {
+            double x = uniform(-0.25, 0.25), y = uniform(-0.25, 0.25);
+            add_point(input, x, y, 0.3*x - 0.2*y + 0.1);
+        }
+        MLSSmoother smoother;
+        smoother.setRadius(radius);
+        smoother.setNumThreads(nthreads);
+        unsigned int n = smooth(smoother);
+        if (n != input.size()/4) return false;
+        for (unsigned int i = 0; i < n*4; i++) {
+            if (fabs(output[i] - input[i]) > 1e-5) {
+                std::cerr << "[testMLSSmoother]   point " << i/4 << " moved" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+    bool test2 ()
+    {
+        std::cerr << "test2 : isolated and invalid points" << std::endl;
+        parse_params();
+        input.clear();
+        srand(0);
+        // a patch, whose rgb are kept
+        for (int i = 0; i < 1000; i++) {
+            add_point(input, uniform(0, 0.2), uniform(0, 0.2), 0);
+            ((unsigned char *)&input[i*4+3])[0] = i%256;
+        }
+        // points without enough neighbors
+        add_point(input, 1, 1, 1);
+        add_point(input, -1, 0, 0);
+        add_point(input, -1 + radius*0.5, 0, 0);
+        // points which can't be put into the grid
+        float nan = std::numeric_limits<float>::quiet_NaN();
+        add_point(input, nan, 0.1, 0);
+        add_point(input, 0.1, 0.1, nan);
+        add_point(input, 1e9, 0.1, 0);
+        MLSSmoother smoother;
+        smoother.setRadius(radius);
+        smoother.setNumThreads(nthreads);
+        output.resize(input.size());
+        unsigned int n = smoother.filter((const unsigned char *)&input[0], input.size()/4, 16, true, &output[0]);
+        if (n != 1000) {
+            std::cerr << "[testMLSSmoother]   " << n << " points are kept" << std::endl;
+            return false;
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            if (((unsigned char *)&output[i*4+3])[0] != i%256 || fabs(output[i*4+2]) > 1e-5) {
+                std::cerr << "[testMLSSmoother]   point " << i << " is not kept" << std::endl;
+                return false;
+            }
+        }
+        // no point is valid
+        return smoother.filter((const unsigned char *)&input[4000], 6, 16, true, &output[0]) == 0
+            && smoother.filter(NULL, 0, 16, true, &output[0]) == 0;
+    };
+    bool test3 ()
+    {
+        std::cerr << "test3 : threads" << std::endl;
+        parse_params();
+        gen_points();
+        MLSSmoother smoother;
+        smoother.setRadius(radius);
+        unsigned int n1 = smooth(smoother);
+        std::vector<float> output1(output);
+        // each point is fitted by one thread, so the same results
+        for (int i = 2; i <= 4; i++) {
+            smoother.setNumThreads(i);
+            unsigned int n2 = smooth(smoother);
+            if (n1 != n2 || memcmp(&output1[0], &output[0], n1*16) != 0) {
+                std::cerr << "[testMLSSmoother]   results differ with " << i << " threads" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+    // throughput on a recorded point cloud
+    bool test_pcd ()
+    {
+        if (!load_pcd(pcd)) return false;
+        MLSSmoother smoother;
+        smoother.setRadius(radius);
+        smoother.setNumThreads(nthreads);
+        smooth(smoother);
+        return true;
+    };
+    void parse_params ()
+    {
+      for (unsigned int i = 0; i < arg_strs.size(); ++ i) {
+          if ( arg_strs[i]== "--radius" ) {
+              if (++i < arg_strs.size()) radius = atof(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--noise" ) {
+              if (++i < arg_strs.size()) noise = atof(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--points" ) {
+              if (++i < arg_strs.size()) npoints = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--threads" ) {
+              if (++i < arg_strs.size()) nthreads = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--loop" ) {
+              if (++i < arg_strs.size()) nloop = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--pcd" ) {
+              if (++i < arg_strs.size()) pcd = arg_strs[i];
+          }
+      }
+      std::cerr << "[testMLSSmoother] params" << std::endl;
+      std::cerr << "[testMLSSmoother]   radius = " << radius << "[m], noise = " << noise << "[m], points = " << npoints << ", threads = " << nthreads << std::endl;
+    };
+};
+
+void print_usage ()
+{
+    std::cerr << "Usage : testMLSSmoother [option]" << std::endl;
+    std::cerr << " [option] should be:" << std::endl;
+    std::cerr << "  --test0 : noisy wavy surface" << std::endl;
+    std::cerr << "  --test0 --pcd file : throughput on a PCD file" << std::endl;
+    std::cerr << "  --test1 : points on a slope" << std::endl;
+    std::cerr << "  --test2 : isolated and invalid points" << std::endl;
+    std::cerr << "  --test3 : threads" << std::endl;
+};
+
+int main(int argc, char* argv[])
+{
+    int ret = 0;
+    if (argc >= 2) {
+        testMLSSmoother tms;
+        for (int i = 1; i < argc; ++ i) {
+            tms.arg_strs.push_back(std::string(argv[i]));
+        }
+        if (std::string(argv[1]) == "--test0") {
+            if (!tms.test0()) ret = 1;
+        } else if (std::string(argv[1]) == "--test1") {
+            if (!tms.test1()) ret = 1;
+        } else if (std::string(argv[1]) == "--test2") {
+            if (!tms.test2()) ret = 1;
+        } else if (std::string(argv[1]) == "--test3") {
+            if (!tms.test3()) ret = 1;
+        } else {
+            print_usage();
+            ret = 1;
+        }
+    } else {
+        print_usage();
+        ret = 1;
+    }
+    return ret;
+}
@@ -8,11 +8,13 @@
  */
 
 #include <rtm/CorbaNaming.h>
+#include <coil/Time.h>
 #include <GL/gl.h>
 #include "IrrModel.h"
 #include <math.h>
 #include <hrpModel/ModelLoaderUtil.h>
 #include "OGMap3DViewer.h"
+#include "VoxelMesh.h"
 
 using namespace irr;
 using namespace core;
@@ -39,87 +41,10 @@ public:
 
         m_box.reset(m_vertices[0]);
         for (int i=1; i<8; i++) m_box.addInternalPoint(m_vertices[i]);
-
-        // vertex indices of cube
-        m_cubeIndices[ 0] = 0; m_cubeIndices[ 1] = 1; m_cubeIndices[ 2] = 2;
-        m_cubeIndices[ 3] = 2; m_cubeIndices[ 4] = 3; m_cubeIndices[ 5] = 0;
-
-        m_cubeIndices[ 6] = 4; m_cubeIndices[ 7] = 5; m_cubeIndices[ 8] = 6;
-        m_cubeIndices[ 9] = 6; m_cubeIndices[10] = 7; m_cubeIndices[11] = 4;
-
-        m_cubeIndices[12] = 8; m_cubeIndices[13] = 9; m_cubeIndices[14] = 10;
-        m_cubeIndices[15] = 10; m_cubeIndices[16] = 11; m_cubeIndices[17] = 8;
-
-        m_cubeIndices[18] = 12; m_cubeIndices[19] = 13; m_cubeIndices[20] = 14;
-        m_cubeIndices[21] = 14; m_cubeIndices[22] = 15; m_cubeIndices[23] = 12;
-
-        m_cubeIndices[24] = 16; m_cubeIndices[25] = 17; m_cubeIndices[26] = 18;
-        m_cubeIndices[27] = 18; m_cubeIndices[28] = 19; m_cubeIndices[29] = 16;
-
-        m_cubeIndices[30] = 20; m_cubeIndices[31] = 21; m_cubeIndices[32] = 22;
-        m_cubeIndices[33] = 22; m_cubeIndices[34] = 23; m_cubeIndices[35] = 20;
     }
 
-    void setMap(OpenHRP::OGMap3D *i_map) { m_map = i_map; }
-
-    void setupCubeVertices(double i_res){
-        SColor white(0xff, 0xff, 0xff, 0xff);
-        // +z
-        m_cubeVerts[0] = S3DVertex(-i_res/2, -i_res/2, i_res/2,
-                                   0,0,1, white,0,0);
-        m_cubeVerts[1] = S3DVertex( i_res/2, -i_res/2, i_res/2,
-                                   0,0,1, white,0,0);
-        m_cubeVerts[2] = S3DVertex( i_res/2,  i_res/2, i_res/2,
-                                   0,0,1, white,0,0);
-        m_cubeVerts[3] = S3DVertex(-i_res/2,  i_res/2, i_res/2,
-                                   0,0,1, white,0,0);
-        // -z
-        m_cubeVerts[4] = S3DVertex(-i_res/2,  i_res/2, -i_res/2,
-                                   0,0,-1, white,0,0);
-        m_cubeVerts[5] = S3DVertex( i_res/2,  i_res/2, -i_res/2,
-                                   0,0,-1, white,0,0);
-        m_cubeVerts[6] = S3DVertex( i_res/2, -i_res/2, -i_res/2,
-                                   0,0,-1, white,0,0);
-        m_cubeVerts[7] = S3DVertex(-i_res/2, -i_res/2, -i_res/2,
-                                   0,0,-1, white,0,0);
-        // +x
-        m_cubeVerts[8] = S3DVertex(i_res/2, -i_res/2,  i_res/2,
-                                   1,0,0, white,0,0);
-        m_cubeVerts[9] = S3DVertex(i_res/2, -i_res/2, -i_res/2,
-                                   1,0,0, white,0,0);
-        m_cubeVerts[10] = S3DVertex(i_res/2,  i_res/2, -i_res/2,
-                                   1,0,0, white,0,0);
-        m_cubeVerts[11] = S3DVertex(i_res/2,  i_res/2,  i_res/2,
-                                   1,0,0, white,0,0);
-        // -x
-        m_cubeVerts[12] = S3DVertex(-i_res/2,  i_res/2,  i_res/2,
-                                   -1,0,0, white,0,0);
-        m_cubeVerts[13] = S3DVertex(-i_res/2,  i_res/2, -i_res/2,
-                                   -1,0,0, white,0,0);
-        m_cubeVerts[14] = S3DVertex(-i_res/2, -i_res/2, -i_res/2,
-                                   -1,0,0, white,0,0);
-        m_cubeVerts[15] = S3DVertex(-i_res/2, -i_res/2,  i_res/2,
-                                    -1,0,0, white,0,0);
-        // +y
-        m_cubeVerts[16] = S3DVertex(i_res/2, i_res/2,  i_res/2,
-                                   0,1,0, white,0,0);
-        m_cubeVerts[17] = S3DVertex(i_res/2, i_res/2, -i_res/2,
-                                   0,1,0, white,0,0);
-        m_cubeVerts[18] = S3DVertex(-i_res/2,i_res/2, -i_res/2,
-                                   0,1,0, white,0,0);
-        m_cubeVerts[19] = S3DVertex(-i_res/2,i_res/2,  i_res/2,
-                                   0,1,0, white,0,0);
-        // -y
-        m_cubeVerts[20] = S3DVertex(-i_res/2,-i_res/2,  i_res/2,
-                                   0,-1,0, white,0,0);
-        m_cubeVerts[21] = S3DVertex(-i_res/2,-i_res/2, -i_res/2,
-                                   0,-1,0, white,0,0);
-        m_cubeVerts[22] = S3DVertex(i_res/2, -i_res/2, -i_res/2,
-                                   0,-1,0, white,0,0);
-        m_cubeVerts[23] = S3DVertex(i_res/2, -i_res/2,  i_res/2,
-                                   0,-1,0, white,0,0);
+    void setMap(VoxelMesh *i_map) { m_map = i_map; }
 
-    }
     virtual void OnRegisterSceneNode(){
         if (IsVisible)
             SceneManager->registerNodeForRendering(this);
@@ -147,39 +72,13 @@ public:
         driver->draw3DLine(m_vertices[2], m_vertices[6]);
         driver->draw3DLine(m_vertices[3], m_vertices[7]);
 
-        if (!m_map) return;
-        setupCubeVertices(m_map->resolution);
-        double res = m_map->resolution;
-        int rank=0;
-	int nxny = m_map->nx*m_map->ny;
-
-        for (int i=0; i<m_map->nx; i++){
-            m[12] = m_map->pos.x + i*res;
-            for (int j=0; j<m_map->ny; j++){
-                m[13] = -(m_map->pos.y + j*res);
-                for (int k=0; k<m_map->nz; k++){
-                    m[14] = m_map->pos.z + k*res;
-                    unsigned char p = m_map->cells[rank++]; 
-                    if (p != OpenHRP::gridUnknown 
-                        && p != OpenHRP::gridEmpty){
-                        driver->setTransform(ETS_WORLD, m);
-                        driver->drawIndexedTriangleList(m_cubeVerts, 24,
-                                                        m_cubeIndices, 12);
-                    }
-                }
-
-            }
-
-        }
+        if (m_map) m_map->render(driver);
     }
     virtual const aabbox3d<f32>& getBoundingBox() const { return m_box; }
 private:
     irr::core::aabbox3d<f32> m_box;
     vector3df m_vertices[8];
-    S3DVertex m_tileVerts[4], m_cubeVerts[24];
-    u16 m_tileIndices[4], m_cubeIndices[36];
-    float m_scale[3], m_origin[3];
-    OpenHRP::OGMap3D* m_map;
+    VoxelMesh *m_map;
 };
 
 // Module specification
@@ -205,6 +104,8 @@ static const char* nullcomponent_spec[] =
     "conf.default.xOrigin", "0",
     "conf.default.yOrigin", "-2",
     "conf.default.zOrigin", "0",
+    "conf.default.incremental", "1",
+    "conf.default.debugLevel", "0",
 
     ""
   };
@@ -223,14 +124,20 @@ OGMap3DViewer::OGMap3DViewer(RTC::Manager* manager)
     m_generateImageSequence(false),
     m_body(NULL),
     m_imageCount(0),
-    m_ogmap(NULL),
+    m_voxelMesh(NULL),
+    m_hasMap(false),
+    m_revision(0),
+    m_debugLevel(0),
     m_generateMovie(false),
     m_isGeneratingMovie(false)
 {
+  m_region.pos.x = m_region.pos.y = m_region.pos.z = 0;
+  m_region.size.l = m_region.size.w = m_region.size.h = 0;
 }
 
 OGMap3DViewer::~OGMap3DViewer()
 {
+  delete m_voxelMesh;
 }
 
 
@@ -248,6 +155,8 @@ RTC::ReturnCode_t OGMap3DViewer::onInitialize()
   bindParameter("xOrigin",      m_xOrigin, "0");
   bindParameter("yOrigin",      m_yOrigin, "-2");
   bindParameter("zOrigin",      m_zOrigin, "0");
+  bindParameter("incremental",  m_incremental, "1");
+  bindParameter("debugLevel",   m_debugLevel, "0");
   
   // </rtc-template>
 
@@ -368,6 +277,8 @@ RTC::ReturnCode_t OGMap3DViewer::onExecute(RTC::UniqueId ec_id)
         double size[] = {m_xSize, m_ySize, m_zSize};
         ISceneManager *smgr = scene->getSceneManager();
         m_mapNode = new CMapSceneNode(smgr->getRootSceneNode(), smgr, -1, origin, size);
+        m_voxelMesh = new VoxelMesh();
+        m_mapNode->setMap(m_voxelMesh);
         
         m_isopen = true;
     }
@@ -380,18 +291,21 @@ RTC::ReturnCode_t OGMap3DViewer::onExecute(RTC::UniqueId ec_id)
     region.size.w = m_ySize;
     region.size.h = m_zSize;
 
-    if (m_ogmap){
-        delete m_ogmap;
-        m_ogmap = NULL;
-    }
     if (!CORBA::is_nil(m_OGMap3DService.getObject())){
         try{
-            m_ogmap = m_OGMap3DService->getOGMap3D(region);
+            updateMap(region);
         }catch(CORBA::SystemException& ex){
             // provider is not activated
+            m_hasMap = false;
         }
     }
-    m_mapNode->setMap(m_ogmap);
+    coil::TimeValue t1(coil::gettimeofday());
+    int nchunks = m_voxelMesh->update();
+    if (m_debugLevel > 0 && nchunks > 0){
+        coil::TimeValue dt = coil::gettimeofday() - t1;
+        std::cout << "OGMap3DViewer: " << nchunks << " chunks are rebuilt in "
+                  << dt.sec()*1e3+dt.usec()/1e3 << "[ms]" << std::endl;
+    }
     
     GLscene *scene = GLscene::getInstance();
     GLcamera *camera=scene->getCamera();
@@ -447,6 +361,55 @@ RTC::ReturnCode_t OGMap3DViewer::onExecute(RTC::UniqueId ec_id)
     return RTC::RTC_OK;
 }
 
+void OGMap3DViewer::updateMap(const OpenHRP::AABB& region)
+{
+    if (region.pos.x != m_region.pos.x || region.pos.y != m_region.pos.y
+        || region.pos.z != m_region.pos.z || region.size.l != m_region.size.l
+        || region.size.w != m_region.size.w
+        || region.size.h != m_region.size.h){
+        // changes are computed for the new region only
+        m_region = region;
+        m_hasMap = false;
+    }
+    if (m_incremental){
+        try{
+            if (m_hasMap){
+                OpenHRP::OGMap3DChanges_var changes
+                    = m_OGMap3DService->getOGMap3DChanges(region, m_revision);
+                if (changes->revision == m_revision) return;
+                if (changes->complete
+                    && m_voxelMesh->applyChanges(changes.in())){
+                    if (m_debugLevel > 0){
+                        std::cout << "OGMap3DViewer: revision " << m_revision
+                                  << " -> " << changes->revision << ", "
+                                  << changes->cells.length()
+                                  << " changed cells" << std::endl;
+                    }
+                    m_revision = changes->revision;
+                    return;
+                }
+            }
+            OpenHRP::OGMap3DRLE_var map = m_OGMap3DService->getOGMap3DRLE(region);
+            m_hasMap = m_voxelMesh->setMap(map.in());
+            if (!m_hasMap){
+                std::cerr << m_profile.instance_name
+                          << ": malformed run-length encoded map" << std::endl;
+            }
+            m_revision = map->revision;
+            return;
+        }catch(CORBA::BAD_OPERATION& ex){
+            // provider doesn't support incremental updates
+            std::cerr << m_profile.instance_name
+                      << ": incremental update is not supported by the provider"
+                      << std::endl;
+            m_incremental = false;
+            m_hasMap = false;
+        }
+    }
+    OpenHRP::OGMap3D_var map = m_OGMap3DService->getOGMap3D(region);
+    m_voxelMesh->setMap(map.in());
+}
+
 /*
 RTC::ReturnCode_t OGMap3DViewer::onAborting(RTC::UniqueId ec_id)
 {
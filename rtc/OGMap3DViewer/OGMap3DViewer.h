@@ -24,6 +24,7 @@
 
 class GLbody;
 class CMapSceneNode;
+class VoxelMesh;
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -145,6 +146,8 @@ class OGMap3DViewer
   // </rtc-template>
 
  private:
+  void updateMap(const OpenHRP::AABB& region);
+
   int dummy;
   bool m_isopen;
   double m_xSize, m_ySize, m_zSize;
@@ -154,7 +157,11 @@ class OGMap3DViewer
   unsigned int m_imageCount;
   bool m_generateMovie, m_isGeneratingMovie;
   CMapSceneNode *m_mapNode;
-  OpenHRP::OGMap3D *m_ogmap;
+  VoxelMesh *m_voxelMesh;
+  bool m_incremental, m_hasMap;
+  unsigned long m_revision;
+  OpenHRP::AABB m_region;
+  int m_debugLevel;
   CvVideoWriter *m_videoWriter;
   IplImage *m_cvImage;
 };
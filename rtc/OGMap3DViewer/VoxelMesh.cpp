@@ -0,0 +1,279 @@
+#include <cmath>
+#include <cstring>
+#include "VoxelMesh.h"
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// key of the voxel at the origin of OctoMap
+#define KEY_OFFSET 32768
+
+VoxelMesh::VoxelMesh() : m_resolution(0)
+{
+    for (int i=0; i<3; i++){
+        m_pos[i] = 0;
+        m_n[i] = m_nchunks[i] = 0;
+    }
+    m_mask.resize(CHUNK_SIZE*CHUNK_SIZE);
+}
+
+VoxelMesh::~VoxelMesh()
+{
+    clearChunks();
+}
+
+void VoxelMesh::clearChunks()
+{
+    for (unsigned int i=0; i<m_chunks.size(); i++) m_chunks[i]->drop();
+    m_chunks.clear();
+    m_dirty.clear();
+}
+
+bool VoxelMesh::occupied(int i, int j, int k) const
+{
+    if (i < 0 || i >= m_n[0] || j < 0 || j >= m_n[1] || k < 0 || k >= m_n[2]){
+        return false;
+    }
+    unsigned char v = m_cells[(i*m_n[1] + j)*m_n[2] + k];
+    return v != OpenHRP::gridUnknown && v != OpenHRP::gridEmpty;
+}
+
+void VoxelMesh::markDirty(int i, int j, int k)
+{
+    // faces of neighbors may appear or disappear too
+    static const int offsets[7][3] = {{0,0,0},
+                                      {-1,0,0}, {1,0,0},
+                                      {0,-1,0}, {0,1,0},
+                                      {0,0,-1}, {0,0,1}};
+    for (int n=0; n<7; n++){
+        int c[] = {i+offsets[n][0], j+offsets[n][1], k+offsets[n][2]};
+        if (c[0] < 0 || c[0] >= m_n[0] || c[1] < 0 || c[1] >= m_n[1]
+            || c[2] < 0 || c[2] >= m_n[2]) continue;
+        int ci = c[0]/CHUNK_SIZE, cj = c[1]/CHUNK_SIZE, ck = c[2]/CHUNK_SIZE;
+        m_dirty[(ci*m_nchunks[1] + cj)*m_nchunks[2] + ck] = true;
+    }
+}
+
+void VoxelMesh::setMap(double i_resolution, const RTC::Point3D& i_pos,
+                       int i_nx, int i_ny, int i_nz,
+                       const unsigned char *i_cells)
+{
+    int n[] = {i_nx, i_ny, i_nz};
+    double pos[] = {i_pos.x, i_pos.y, i_pos.z};
+    bool resized = i_resolution != m_resolution;
+    for (int i=0; i<3; i++){
+        if (n[i] != m_n[i] || pos[i] != m_pos[i]) resized = true;
+    }
+    unsigned int ncells = i_nx*i_ny*i_nz;
+    if (resized){
+        clearChunks();
+        m_resolution = i_resolution;
+        for (int i=0; i<3; i++){
+            m_n[i] = n[i];
+            m_pos[i] = pos[i];
+            m_nchunks[i] = (n[i] + CHUNK_SIZE - 1)/CHUNK_SIZE;
+        }
+        m_cells.assign(i_cells, i_cells + ncells);
+        unsigned int nchunks = m_nchunks[0]*m_nchunks[1]*m_nchunks[2];
+        for (unsigned int i=0; i<nchunks; i++){
+            SMeshBuffer *mb = new SMeshBuffer();
+            mb->Material.BackfaceCulling = false;
+            mb->setHardwareMappingHint(EHM_STATIC);
+            m_chunks.push_back(mb);
+        }
+        m_dirty.assign(nchunks, true);
+        return;
+    }
+    unsigned int rank = 0;
+    for (int i=0; i<m_n[0]; i++){
+        for (int j=0; j<m_n[1]; j++){
+            for (int k=0; k<m_n[2]; k++, rank++){
+                if (m_cells[rank] != i_cells[rank]){
+                    m_cells[rank] = i_cells[rank];
+                    markDirty(i, j, k);
+                }
+            }
+        }
+    }
+}
+
+void VoxelMesh::setMap(const OpenHRP::OGMap3D& i_map)
+{
+    setMap(i_map.resolution, i_map.pos, i_map.nx, i_map.ny, i_map.nz,
+           i_map.cells.get_buffer());
+}
+
+bool VoxelMesh::setMap(const OpenHRP::OGMap3DRLE& i_map)
+{
+    unsigned int ncells = i_map.nx*i_map.ny*i_map.nz;
+    m_decoded.resize(ncells);
+    const unsigned char *runs = i_map.runs.get_buffer();
+    unsigned int len = i_map.runs.length(), pos = 0, rank = 0;
+    while (pos < len){
+        unsigned char v = runs[pos++];
+        unsigned int run = 0, shift = 0;
+        unsigned char b;
+        do {
+            if (pos >= len || shift > 28) return false;
+            b = runs[pos++];
+            run |= (b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        run++;
+        if (rank + run > ncells) return false;
+        memset(&m_decoded[rank], v, run);
+        rank += run;
+    }
+    if (rank != ncells) return false;
+    setMap(i_map.resolution, i_map.pos, i_map.nx, i_map.ny, i_map.nz,
+           ncells ? &m_decoded[0] : NULL);
+    return true;
+}
+
+bool VoxelMesh::applyChanges(const OpenHRP::OGMap3DChanges& i_changes)
+{
+    if (i_changes.resolution != m_resolution) return false;
+    int key0[3];
+    for (int i=0; i<3; i++){
+        key0[i] = (int)floor(m_pos[i]/m_resolution) + KEY_OFFSET;
+    }
+    bool ret = true;
+    for (unsigned int n=0; n<i_changes.cells.length(); n++){
+        int c[3];
+        bool inside = true;
+        for (int i=0; i<3; i++){
+            c[i] = (int)i_changes.keys[n*3+i] - key0[i];
+            if (c[i] < 0 || c[i] >= m_n[i]) inside = false;
+        }
+        if (!inside){
+            // the map has grown out of the grid
+            ret = false;
+            continue;
+        }
+        unsigned char& cell = m_cells[(c[0]*m_n[1] + c[1])*m_n[2] + c[2]];
+        if (cell != i_changes.cells[n]){
+            cell = i_changes.cells[n];
+            markDirty(c[0], c[1], c[2]);
+        }
+    }
+    return ret;
+}
+
+int VoxelMesh::update()
+{
+    int n = 0;
+    for (unsigned int i=0; i<m_chunks.size(); i++){
+        if (!m_dirty[i]) continue;
+        buildChunk(i);
+        m_dirty[i] = false;
+        n++;
+    }
+    return n;
+}
+
+void VoxelMesh::addQuad(SMeshBuffer *io_mb, int i_axis, int i_sign,
+                        int i_slice, int i_u, int i_nu, int i_v, int i_nv)
+{
+    if (io_mb->Vertices.size() + 4 > 0xffff) return;
+    int u = (i_axis+1)%3, v = (i_axis+2)%3;
+    double u0 = m_pos[u] + (i_u - 0.5)*m_resolution;
+    double v0 = m_pos[v] + (i_v - 0.5)*m_resolution;
+    double u1 = u0 + i_nu*m_resolution, v1 = v0 + i_nv*m_resolution;
+    double us[] = {u0, u1, u1, u0}, vs[] = {v0, v0, v1, v1};
+    double p[3], n[] = {0, 0, 0};
+    p[i_axis] = m_pos[i_axis] + (i_slice + 0.5*i_sign)*m_resolution;
+    n[i_axis] = i_sign;
+    SColor white(0xff, 0xff, 0xff, 0xff);
+    u16 base = io_mb->Vertices.size();
+    for (int i=0; i<4; i++){
+        p[u] = us[i]; p[v] = vs[i];
+        // y axis is flipped in the scene
+        io_mb->Vertices.push_back(S3DVertex(p[0], -p[1], p[2],
+                                            n[0], -n[1], n[2], white, 0, 0));
+    }
+    io_mb->Indices.push_back(base);
+    io_mb->Indices.push_back(base+1);
+    io_mb->Indices.push_back(base+2);
+    io_mb->Indices.push_back(base+2);
+    io_mb->Indices.push_back(base+3);
+    io_mb->Indices.push_back(base);
+}
+
+void VoxelMesh::buildChunk(int i_chunk)
+{
+    SMeshBuffer *mb = m_chunks[i_chunk];
+    // arrays keep their capacities
+    mb->Vertices.set_used(0);
+    mb->Indices.set_used(0);
+
+    int cidx[] = {i_chunk/(m_nchunks[1]*m_nchunks[2]),
+                  (i_chunk/m_nchunks[2])%m_nchunks[1],
+                  i_chunk%m_nchunks[2]};
+    int lo[3], hi[3];
+    for (int i=0; i<3; i++){
+        lo[i] = cidx[i]*CHUNK_SIZE;
+        hi[i] = lo[i] + CHUNK_SIZE;
+        if (hi[i] > m_n[i]) hi[i] = m_n[i];
+    }
+    for (int d=0; d<3; d++){
+        int u = (d+1)%3, v = (d+2)%3;
+        int nu = hi[u] - lo[u], nv = hi[v] - lo[v];
+        for (int s=-1; s<=1; s+=2){
+            for (int x=lo[d]; x<hi[d]; x++){
+                // faces of occupied voxels which are not hidden by neighbors
+                int c[3];
+                c[d] = x;
+                for (int a=0; a<nu; a++){
+                    c[u] = lo[u] + a;
+                    for (int b=0; b<nv; b++){
+                        c[v] = lo[v] + b;
+                        bool face = occupied(c[0], c[1], c[2]);
+                        if (face){
+                            int nb[] = {c[0], c[1], c[2]};
+                            nb[d] += s;
+                            face = !occupied(nb[0], nb[1], nb[2]);
+                        }
+                        m_mask[a*CHUNK_SIZE+b] = face;
+                    }
+                }
+                // merge faces into rectangles
+                for (int a=0; a<nu; a++){
+                    for (int b=0; b<nv; ){
+                        if (!m_mask[a*CHUNK_SIZE+b]){
+                            b++;
+                            continue;
+                        }
+                        int w = 1;
+                        while (b+w < nv && m_mask[a*CHUNK_SIZE+b+w]) w++;
+                        int h = 1;
+                        while (a+h < nu){
+                            int e = 0;
+                            while (e < w && m_mask[(a+h)*CHUNK_SIZE+b+e]) e++;
+                            if (e < w) break;
+                            h++;
+                        }
+                        for (int da=0; da<h; da++){
+                            memset(&m_mask[(a+da)*CHUNK_SIZE+b], 0, w);
+                        }
+                        addQuad(mb, d, s, x, lo[u]+a, h, lo[v]+b, w);
+                        b += w;
+                    }
+                }
+            }
+        }
+    }
+    mb->recalculateBoundingBox();
+    mb->setDirty();
+}
+
+void VoxelMesh::render(IVideoDriver *i_driver)
+{
+    for (unsigned int i=0; i<m_chunks.size(); i++){
+        SMeshBuffer *mb = m_chunks[i];
+        if (!mb->Indices.size()) continue;
+        i_driver->setMaterial(mb->Material);
+        i_driver->drawMeshBuffer(mb);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef __VOXEL_MESH_H__
+#define __VOXEL_MESH_H__
+
+#include <vector>
+#include <irrlicht/irrlicht.h>
+#include "OGMap3DService.hh"
+
+/**
+   \brief triangle mesh of occupied voxels
+
+   The grid is divided into chunks of CHUNK_SIZE^3 voxels and each chunk has
+   its own mesh buffer. Faces between occupied voxels are not generated and
+   coplanar faces of adjacent voxels are merged into rectangles(greedy
+   meshing). Only chunks which contain modified voxels are rebuilt.
+ */
+class VoxelMesh
+{
+public:
+    enum { CHUNK_SIZE = 16 };
+    VoxelMesh();
+    ~VoxelMesh();
+    /**
+       \brief set voxels. Chunks whose voxels are modified are marked dirty
+       unless the grid is resized or moved
+     */
+    void setMap(double i_resolution, const RTC::Point3D& i_pos,
+                int i_nx, int i_ny, int i_nz, const unsigned char *i_cells);
+    void setMap(const OpenHRP::OGMap3D& i_map);
+    /**
+       \brief set voxels given in run-length encoding
+       \return false if runs are malformed
+     */
+    bool setMap(const OpenHRP::OGMap3DRLE& i_map);
+    /**
+       \brief update voxels
+       \return false if a voxel is out of the grid. The whole map must be
+       set again in this case
+     */
+    bool applyChanges(const OpenHRP::OGMap3DChanges& i_changes);
+    /**
+       \brief rebuild dirty chunks
+       \return the number of rebuilt chunks
+     */
+    int update();
+    void render(irr::video::IVideoDriver *i_driver);
+    bool empty() const { return m_cells.empty(); }
+private:
+    bool occupied(int i, int j, int k) const;
+    void markDirty(int i, int j, int k);
+    void buildChunk(int i_chunk);
+    void addQuad(irr::scene::SMeshBuffer *io_mb, int i_axis, int i_sign,
+                 int i_slice, int i_u, int i_nu, int i_v, int i_nv);
+    void clearChunks();
+
+    double m_resolution, m_pos[3];
+    int m_n[3], m_nchunks[3];
+    std::vector<unsigned char> m_cells, m_decoded;
+    std::vector<irr::scene::SMeshBuffer *> m_chunks;
+    std::vector<bool> m_dirty;
+    std::vector<unsigned char> m_mask;
+};
+
+#endif
@@ -0,0 +1,384 @@
+// -*- C++ -*-
+/*!
+ * @file  MapUpdater.cpp
+ * @brief worker thread which integrates scans into an occupancy grid map
+ */
+#include <iostream>
+#include "MapUpdater.h"
+
+typedef coil::Guard<coil::Mutex> Guard;
+
+MapUpdater::MapUpdater(coil::Mutex& i_mapMutex) :
+    m_map(NULL), m_mapMutex(i_mapMutex), m_resolution(0), m_debugLevel(0),
+    m_queueSize(1), m_policy(DROP_OLDEST),
+    m_snapshotInterval(0), m_quit(false), m_historyReset(true),
+    m_mirror(NULL),
+    m_revision(0), m_dirty(false), m_tPublish(0),
+    m_historySize(0), m_historyBase(0)
+{
+    resetStatistics();
+}
+
+MapUpdater::~MapUpdater()
+{
+    stop();
+    for (unsigned int i=0; i<m_pool.size(); i++) delete m_pool[i];
+}
+
+void MapUpdater::setup(unsigned int i_queueSize, const std::string& i_policy,
+                       double i_snapshotInterval, unsigned int i_historySize)
+{
+    boost::mutex::scoped_lock lock(m_queueMutex);
+    m_queueSize = i_queueSize > 0 ? i_queueSize : 1;
+    if (i_policy == "dropNewest"){
+        m_policy = DROP_NEWEST;
+    }else if (i_policy == "merge"){
+        m_policy = MERGE;
+    }else{
+        if (i_policy != "dropOldest"){
+            std::cerr << "MapUpdater: unknown policy(" << i_policy
+                      << "), dropOldest is used" << std::endl;
+        }
+        m_policy = DROP_OLDEST;
+    }
+    m_snapshotInterval = i_snapshotInterval;
+    m_historySize = i_historySize;
+}
+
+void MapUpdater::start(octomap::OcTree *i_map)
+{
+    m_map = i_map;
+    m_resolution = m_map->getResolution();
+    m_quit = false;
+    {
+        Guard guard(m_mapMutex);
+        m_pendingKeys.clear();
+        m_historyReset = true;
+    }
+    publish();
+    activate();
+}
+
+void MapUpdater::stop()
+{
+    {
+        boost::mutex::scoped_lock lock(m_queueMutex);
+        m_quit = true;
+        m_cond.notify_one();
+    }
+    wait();
+    {
+        boost::mutex::scoped_lock lock(m_queueMutex);
+        while (!m_queue.empty()){
+            recycle(m_queue.front());
+            m_queue.pop_front();
+        }
+    }
+    Snapshot old;
+    {
+        Guard guard(m_snapshotMutex);
+        old = m_snapshot;
+        m_snapshot.reset();
+        m_dirty = false;
+    }
+    {
+        Guard guard(m_publishMutex);
+        delete m_mirror;
+        m_mirror = NULL;
+    }
+    m_map = NULL;
+}
+
+Scan *MapUpdater::acquire()
+{
+    boost::mutex::scoped_lock lock(m_queueMutex);
+    if (m_pool.empty()) return new Scan;
+    Scan *scan = m_pool.back();
+    m_pool.pop_back();
+    return scan;
+}
+
+void MapUpdater::recycle(Scan *i_scan)
+{
+    // points and flags keep their capacities for the next scan
+    i_scan->points.clear();
+    i_scan->occupied.clear();
+    m_pool.push_back(i_scan);
+}
+
+void MapUpdater::push(Scan *i_scan)
+{
+    i_scan->stamp = coil::gettimeofday();
+    boost::mutex::scoped_lock lock(m_queueMutex);
+    m_received++;
+    if (m_queue.size() >= m_queueSize){
+        if (m_policy == DROP_NEWEST){
+            m_dropped++;
+            recycle(i_scan);
+            return;
+        }
+        if (m_policy == MERGE && merge(m_queue.back(), i_scan)){
+            m_merged++;
+            recycle(i_scan);
+            return;
+        }
+        recycle(m_queue.front());
+        m_queue.pop_front();
+        m_dropped++;
+    }
+    m_queue.push_back(i_scan);
+    m_cond.notify_one();
+}
+
+void MapUpdater::toWorld(Scan *io_scan)
+{
+    io_scan->points.transform(io_scan->frame);
+    io_scan->sensor = io_scan->frame.transform(io_scan->sensor);
+    io_scan->frame = octomap::pose6d();
+}
+
+bool MapUpdater::merge(Scan *io_dst, Scan *i_src)
+{
+    if (io_dst->type != i_src->type) return false;
+    if (io_dst->type == Scan::RAYS){
+        // rays must be cast from (almost) the same origin
+        octomap::point3d d = io_dst->frame.transform(io_dst->sensor)
+            - i_src->frame.transform(i_src->sensor);
+        if (d.norm() >= m_resolution) return false;
+    }
+    toWorld(io_dst);
+    toWorld(i_src);
+    io_dst->points.push_back(i_src->points);
+    io_dst->occupied.insert(io_dst->occupied.end(),
+                            i_src->occupied.begin(), i_src->occupied.end());
+    return true;
+}
+
+void MapUpdater::integrate(Scan *i_scan)
+{
+    coil::TimeValue t1(coil::gettimeofday());
+    {
+        // same as insertPointCloud() except that updated keys are recorded
+        toWorld(i_scan);
+        Guard guard(m_mapMutex);
+        if (i_scan->type == Scan::RAYS){
+            m_map->computeUpdate(i_scan->points, i_scan->sensor,
+                                 m_freeCells, m_occupiedCells, -1);
+            octomap::KeySet::iterator it;
+            for (it=m_freeCells.begin(); it!=m_freeCells.end(); it++){
+                m_map->updateNode(*it, false, false);
+                m_pendingKeys.insert(*it);
+            }
+            for (it=m_occupiedCells.begin(); it!=m_occupiedCells.end(); it++){
+                m_map->updateNode(*it, true, false);
+                m_pendingKeys.insert(*it);
+            }
+        }else{
+            octomap::OcTreeKey key;
+            for (unsigned int i=0; i<i_scan->points.size(); i++){
+                if (!m_map->coordToKeyChecked(i_scan->points.getPoint(i), key)){
+                    continue;
+                }
+                m_map->updateNode(key, i_scan->occupied[i], false);
+                m_pendingKeys.insert(key);
+            }
+        }
+        Guard sguard(m_snapshotMutex);
+        m_dirty = true;
+    }
+    coil::TimeValue t2(coil::gettimeofday());
+    double latency = (double)(t2 - i_scan->stamp);
+    double tm = (double)(t2 - t1);
+    if (m_debugLevel > 0){
+        std::cout << "MapUpdater::integrate() : " << i_scan->points.size()
+                  << " points, " << tm*1e3 << "[ms], latency = "
+                  << latency*1e3 << "[ms]" << std::endl;
+    }
+
+    boost::mutex::scoped_lock lock(m_queueMutex);
+    m_integrated++;
+    m_lastLatency = latency;
+    m_sumLatency += latency;
+    if (latency > m_maxLatency) m_maxLatency = latency;
+    m_lastIntegrationTime = tm;
+    m_sumIntegrationTime += tm;
+    recycle(i_scan);
+}
+
+void MapUpdater::publish()
+{
+    // snapshots must be published in the order they are copied
+    Guard pguard(m_publishMutex);
+    std::vector<octomap::OcTreeKey> keys;
+    bool reset;
+    {
+        Guard guard(m_mapMutex);
+        {
+            Guard sguard(m_snapshotMutex);
+            m_dirty = false;
+        }
+        keys.assign(m_pendingKeys.begin(), m_pendingKeys.end());
+        m_pendingKeys.clear();
+        reset = m_historyReset;
+        m_historyReset = false;
+        // only updated voxels are copied while integration is blocked
+        if (reset || !m_mirror){
+            delete m_mirror;
+            m_mirror = new octomap::OcTree(*m_map);
+        }else{
+            for (unsigned int i=0; i<keys.size(); i++){
+                octomap::OcTreeNode *node = m_map->search(keys[i]);
+                if (node){
+                    m_mirror->setNodeValue(keys[i], node->getLogOdds(), false);
+                }else{
+                    m_mirror->deleteNode(keys[i]);
+                }
+            }
+        }
+    }
+    octomap::OcTree *copy = new octomap::OcTree(*m_mirror);
+    Snapshot old;
+    {
+        Guard guard(m_snapshotMutex);
+        old = m_snapshot;
+        m_snapshot = Snapshot(copy);
+        m_revision++;
+        if (reset || m_historySize == 0){
+            m_history.clear();
+            m_historyBase = m_revision;
+        }else{
+            m_history.push_back(Change());
+            m_history.back().revision = m_revision;
+            m_history.back().keys.swap(keys);
+            while (m_history.size() > m_historySize){
+                m_historyBase = m_history.front().revision;
+                m_history.pop_front();
+            }
+        }
+        m_tPublish = (double)coil::gettimeofday();
+    }
+    // the old snapshot is destroyed here unless a client still reads it
+}
+
+bool MapUpdater::changes(unsigned int i_revision, Snapshot& o_snapshot,
+                         unsigned int& o_revision,
+                         std::vector<octomap::OcTreeKey>& o_keys)
+{
+    Guard guard(m_snapshotMutex);
+    o_snapshot = m_snapshot;
+    o_revision = m_revision;
+    o_keys.clear();
+    if (!m_snapshot || i_revision < m_historyBase || i_revision > m_revision){
+        return false;
+    }
+    octomap::KeySet keys;
+    for (unsigned int i=0; i<m_history.size(); i++){
+        const Change& c = m_history[i];
+        if (c.revision <= i_revision) continue;
+        keys.insert(c.keys.begin(), c.keys.end());
+    }
+    o_keys.assign(keys.begin(), keys.end());
+    return true;
+}
+
+bool MapUpdater::timeToPublish(double& o_wait)
+{
+    Guard guard(m_snapshotMutex);
+    if (!m_dirty) return false;
+    o_wait = m_tPublish + m_snapshotInterval - (double)coil::gettimeofday();
+    return true;
+}
+
+int MapUpdater::svc()
+{
+    double remaining;
+    while (1){
+        Scan *scan = NULL;
+        {
+            boost::mutex::scoped_lock lock(m_queueMutex);
+            while (!m_quit && m_queue.empty()){
+                if (!timeToPublish(remaining)){
+                    m_cond.wait(lock);
+                }else if (remaining > 0){
+                    m_cond.timed_wait(lock, boost::posix_time::microseconds(
+                                          (long)(remaining*1e6) + 1));
+                }else{
+                    break;
+                }
+            }
+            if (m_quit) break;
+            if (!m_queue.empty()){
+                scan = m_queue.front();
+                m_queue.pop_front();
+            }
+        }
+        if (scan) integrate(scan);
+        if (timeToPublish(remaining) && remaining <= 0) publish();
+    }
+    return 0;
+}
+
+void MapUpdater::clear()
+{
+    {
+        boost::mutex::scoped_lock lock(m_queueMutex);
+        while (!m_queue.empty()){
+            recycle(m_queue.front());
+            m_queue.pop_front();
+        }
+        resetStatistics();
+    }
+    {
+        Guard guard(m_mapMutex);
+        m_map->clear();
+        m_pendingKeys.clear();
+        m_historyReset = true;
+    }
+    publish();
+}
+
+MapUpdater::Snapshot MapUpdater::snapshot()
+{
+    Guard guard(m_snapshotMutex);
+    return m_snapshot;
+}
+
+MapUpdater::Snapshot MapUpdater::snapshot(unsigned int& o_revision)
+{
+    Guard guard(m_snapshotMutex);
+    o_revision = m_revision;
+    return m_snapshot;
+}
+
+unsigned int MapUpdater::revision()
+{
+    Guard guard(m_snapshotMutex);
+    return m_revision;
+}
+
+void MapUpdater::resetStatistics()
+{
+    m_received = m_dropped = m_merged = m_integrated = 0;
+    m_lastLatency = m_sumLatency = m_maxLatency = 0;
+    m_lastIntegrationTime = m_sumIntegrationTime = 0;
+}
+
+void MapUpdater::getStatistics(OpenHRP::OGMap3DStatistics& o_stat)
+{
+    {
+        boost::mutex::scoped_lock lock(m_queueMutex);
+        o_stat.queueLength = m_queue.size();
+        o_stat.queueSize = m_queueSize;
+        o_stat.received = m_received;
+        o_stat.dropped = m_dropped;
+        o_stat.merged = m_merged;
+        o_stat.integrated = m_integrated;
+        o_stat.lastLatency = m_lastLatency;
+        o_stat.avgLatency = m_integrated ? m_sumLatency/m_integrated : 0;
+        o_stat.maxLatency = m_maxLatency;
+        o_stat.lastIntegrationTime = m_lastIntegrationTime;
+        o_stat.avgIntegrationTime
+            = m_integrated ? m_sumIntegrationTime/m_integrated : 0;
+    }
+    o_stat.revision = revision();
+}
@@ -0,0 +1,173 @@
+// -*- C++ -*-
+/*!
+ * @file  MapUpdater.h
+ * @brief worker thread which integrates scans into an occupancy grid map
+ */
+#ifndef MAP_UPDATER_H
+#define MAP_UPDATER_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <coil/Task.h>
+#include <coil/Mutex.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <coil/Time.h>
+#include <octomap/octomap.h>
+#include "OGMap3DService.hh"
+
+/**
+   \brief a scan waiting for integration
+ */
+struct Scan
+{
+    enum Type {
+        RAYS,   ///< points are end points of rays cast from sensor
+        VOXELS  ///< points update voxels directly by occupied flags
+    };
+    Type type;
+    octomap::Pointcloud points;
+    std::vector<bool> occupied;
+    octomap::point3d sensor;     ///< sensor origin in frame
+    octomap::pose6d frame;       ///< pose of the frame where points are given
+    coil::TimeValue stamp;       ///< time when the oldest merged scan was queued
+};
+
+/**
+   \brief integrate scans into a map in a dedicated thread
+
+   Scans are kept in a bounded queue. When the queue is full, the oldest
+   scan is dropped, the new scan is dropped or the new scan is merged into
+   the newest queued one according to the policy. Merged rays are cast in
+   one call of insertPointCloud(), so each voxel is updated once per merged
+   scan. Rays are merged only when the sensor has moved less than the map
+   resolution; otherwise the oldest scan is dropped.
+
+   Clients read a copy of the map which is published at most once per
+   snapshot interval, so they never wait for integration. The updater keeps
+   a mirror of the map, into which voxels updated since the last snapshot
+   are copied while the map is locked. A snapshot is a deep copy of the
+   mirror made without locking the map, so integration is blocked only for
+   the updated voxels, but each snapshot still costs time proportional to
+   the size of the map and the mirror doubles its memory.
+ */
+class MapUpdater : public coil::Task
+{
+public:
+    enum Policy { DROP_OLDEST, DROP_NEWEST, MERGE };
+    typedef boost::shared_ptr<const octomap::OcTree> Snapshot;
+
+    /**
+       \param i_mapMutex mutex which protects the map while it is updated
+     */
+    MapUpdater(coil::Mutex& i_mapMutex);
+    ~MapUpdater();
+    /**
+       \brief publish the first snapshot and start the thread
+       \param i_map map to be updated. It is shared with the caller and
+       must be accessed while locking the map mutex
+     */
+    void start(octomap::OcTree *i_map);
+    /**
+       \brief stop the thread and discard queued scans and the snapshot
+     */
+    void stop();
+    /**
+       \brief set parameters of the queue
+       \param i_queueSize maximum number of queued scans
+       \param i_policy policy applied when the queue is full. One of
+       "dropOldest", "dropNewest" and "merge"
+       \param i_snapshotInterval minimum interval of publishing snapshots[s]
+       \param i_historySize the number of revisions whose changed voxels
+       are kept for changes()
+     */
+    void setup(unsigned int i_queueSize, const std::string& i_policy,
+               double i_snapshotInterval, unsigned int i_historySize);
+    void setDebugLevel(int i_level) { m_debugLevel = i_level; }
+    /**
+       \brief get an empty scan to be filled and passed to push()
+     */
+    Scan *acquire();
+    /**
+       \brief queue a scan. The scan is owned by the updater afterwards
+     */
+    void push(Scan *i_scan);
+    /**
+       \brief discard queued scans, clear the map and publish it
+     */
+    void clear();
+    /**
+       \brief get the latest snapshot of the map
+     */
+    Snapshot snapshot();
+    Snapshot snapshot(unsigned int& o_revision);
+    /**
+       \brief revision of the latest snapshot. It is incremented every time
+       a snapshot is published
+     */
+    unsigned int revision();
+    /**
+       \brief get keys of voxels which were updated after a revision
+       \param i_revision revision which the caller already has
+       \param o_snapshot the latest snapshot
+       \param o_revision revision of o_snapshot
+       \param o_keys keys of updated voxels
+       \return false if updates after i_revision are not kept
+     */
+    bool changes(unsigned int i_revision, Snapshot& o_snapshot,
+                 unsigned int& o_revision,
+                 std::vector<octomap::OcTreeKey>& o_keys);
+    void getStatistics(OpenHRP::OGMap3DStatistics& o_stat);
+    virtual int svc();
+private:
+    void recycle(Scan *i_scan);
+    void resetStatistics();
+    bool timeToPublish(double& o_wait);
+    bool merge(Scan *io_dst, Scan *i_src);
+    void toWorld(Scan *io_scan);
+    void integrate(Scan *i_scan);
+    void publish();
+
+    octomap::OcTree *m_map;
+    coil::Mutex& m_mapMutex;
+    double m_resolution;
+    int m_debugLevel;
+
+    // queue
+    boost::mutex m_queueMutex;
+    boost::condition_variable m_cond;
+    std::deque<Scan *> m_queue;
+    std::vector<Scan *> m_pool;
+    unsigned int m_queueSize;
+    Policy m_policy;
+    double m_snapshotInterval;
+    bool m_quit;
+
+    // keys updated after the latest snapshot, protected by m_mapMutex
+    octomap::KeySet m_pendingKeys, m_freeCells, m_occupiedCells;
+    bool m_historyReset;
+
+    // snapshot. Lock m_mapMutex first when both are locked
+    coil::Mutex m_publishMutex;
+    octomap::OcTree *m_mirror; ///< protected by m_publishMutex
+    coil::Mutex m_snapshotMutex;
+    Snapshot m_snapshot;
+    unsigned int m_revision;
+    bool m_dirty;
+    double m_tPublish;
+    struct Change {
+        unsigned int revision;
+        std::vector<octomap::OcTreeKey> keys;
+    };
+    std::deque<Change> m_history;
+    unsigned int m_historySize, m_historyBase;
+
+    // statistics, protected by m_queueMutex
+    unsigned long m_received, m_dropped, m_merged, m_integrated;
+    double m_lastLatency, m_sumLatency, m_maxLatency;
+    double m_lastIntegrationTime, m_sumIntegrationTime;
+};
+
+#endif // MAP_UPDATER_H
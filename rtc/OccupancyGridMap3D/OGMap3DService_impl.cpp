@@ -17,6 +17,16 @@ OpenHRP::OGMap3D* OGMap3DService_impl::getOGMap3D(const OpenHRP::AABB& region)
     return m_comp->getOGMap3D(region);
 }
 
+OpenHRP::OGMap3DRLE* OGMap3DService_impl::getOGMap3DRLE(const OpenHRP::AABB& region)
+{
+    return m_comp->getOGMap3DRLE(region);
+}
+
+OpenHRP::OGMap3DChanges* OGMap3DService_impl::getOGMap3DChanges(const OpenHRP::AABB& region, CORBA::ULong revision)
+{
+    return m_comp->getOGMap3DChanges(region, revision);
+}
+
 void OGMap3DService_impl::save(const char *filename)
 {
     m_comp->save(filename);
@@ -26,3 +36,10 @@ void OGMap3DService_impl::clear()
 {
     m_comp->clear();
 }
+
+OpenHRP::OGMap3DStatistics* OGMap3DService_impl::getStatistics()
+{
+    OpenHRP::OGMap3DStatistics *stat = new OpenHRP::OGMap3DStatistics;
+    m_comp->getStatistics(*stat);
+    return stat;
+}
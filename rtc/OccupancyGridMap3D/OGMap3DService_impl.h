@@ -22,8 +22,11 @@ public:
   virtual ~OGMap3DService_impl();
 
   OpenHRP::OGMap3D* getOGMap3D(const OpenHRP::AABB& region);
+  OpenHRP::OGMap3DRLE* getOGMap3DRLE(const OpenHRP::AABB& region);
+  OpenHRP::OGMap3DChanges* getOGMap3DChanges(const OpenHRP::AABB& region, CORBA::ULong revision);
   void save(const char *filename);
   void clear();
+  OpenHRP::OGMap3DStatistics* getStatistics();
 
 private:
   OccupancyGridMap3D *m_comp;
@@ -7,7 +7,10 @@
  * $Id$
  */
 
+#include <cmath>
+#include <cstring>
 #include "OccupancyGridMap3D.h"
+#include "MapUpdater.h"
 #include "hrpUtil/Eigen3d.h"
 #include <octomap/octomap.h>
 
@@ -45,6 +48,10 @@ static const char* occupancygridmap3d_spec[] =
     "conf.default.initialMap", "",
     "conf.default.knownMap", "",
     "conf.default.debugLevel", "0",
+    "conf.default.queueSize", "2",
+    "conf.default.queuePolicy", "dropOldest",
+    "conf.default.snapshotInterval", "0.1",
+    "conf.default.changeHistory", "30",
     ""
   };
 // </rtc-template>
@@ -62,13 +69,15 @@ OccupancyGridMap3D::OccupancyGridMap3D(RTC::Manager* manager)
     // </rtc-template>
     m_service0(this),
     m_map(NULL),
-    m_knownMap(NULL),
+    m_updater(NULL),
+    m_revision(0),
     dummy(0)
 {
 }
 
 OccupancyGridMap3D::~OccupancyGridMap3D()
 {
+  delete m_updater;
 }
 
 
@@ -83,6 +92,10 @@ RTC::ReturnCode_t OccupancyGridMap3D::onInitialize()
   bindParameter("initialMap", m_initialMap, "");
   bindParameter("knownMap", m_knownMapPath, "");
   bindParameter("debugLevel", m_debugLevel, "0");
+  bindParameter("queueSize", m_queueSize, "2");
+  bindParameter("queuePolicy", m_queuePolicy, "dropOldest");
+  bindParameter("snapshotInterval", m_snapshotInterval, "0.1");
+  bindParameter("changeHistory", m_changeHistory, "30");
   
   // </rtc-template>
 
@@ -129,6 +142,8 @@ RTC::ReturnCode_t OccupancyGridMap3D::onInitialize()
   m_sensorPos.data.z = 0;
 
   m_updateSignal.data = 0;
+
+  m_updater = new MapUpdater(m_mutex);
  
   return RTC::RTC_OK;
 }
@@ -159,11 +174,14 @@ RTC::ReturnCode_t OccupancyGridMap3D::onActivated(RTC::UniqueId ec_id)
 {
   std::cout << m_profile.instance_name<< ": onActivated(" << ec_id << ")" << std::endl;
 
-  Guard guard(m_mutex);
   if (m_knownMapPath != ""){
-      m_knownMap = new OcTree(m_cwd+m_knownMapPath);
+      KnownMap known(new OcTree(m_cwd+m_knownMapPath));
+      Guard guard(m_mutex);
+      m_knownMap = known;
   }
 
+  // m_mutex is not locked since the map is not shared with m_updater yet
+
   if (m_initialMap != ""){
     // Working directories of threads which calls onInitialize() and onActivate() are different on MacOS
     // Assume path of initial map is given by a relative path to working directory of the thread which calls onInitialize()
@@ -171,7 +189,6 @@ RTC::ReturnCode_t OccupancyGridMap3D::onActivated(RTC::UniqueId ec_id)
   }else{
     m_map = new OcTree(m_resolution);
   }
-  m_updateOut.write();
 
   if(KDEBUG){
     std::cout << m_profile.instance_name << ": initial tree depth = " << m_map->getTreeDepth() << std::endl;
@@ -192,15 +209,25 @@ RTC::ReturnCode_t OccupancyGridMap3D::onActivated(RTC::UniqueId ec_id)
     }
   }
 
+  m_updater->setup(m_queueSize, m_queuePolicy, m_snapshotInterval,
+                   m_changeHistory);
+  m_updater->setDebugLevel(m_debugLevel);
+  m_updater->start(m_map);
+  m_revision = m_updater->revision();
+  m_updateOut.write();
+
   return RTC::RTC_OK;
 }
 
 RTC::ReturnCode_t OccupancyGridMap3D::onDeactivated(RTC::UniqueId ec_id)
 {
   std::cout << m_profile.instance_name<< ": onDeactivated(" << ec_id << ")" << std::endl;
+  m_updater->stop();
   Guard guard(m_mutex);
   delete m_map;
-  if (m_knownMap) delete m_knownMap;
+  m_map = NULL;
+  // queries which are running keep their own references
+  m_knownMap.reset();
   return RTC::RTC_OK;
 }
 
@@ -218,222 +245,74 @@ RTC::ReturnCode_t OccupancyGridMap3D::onExecute(RTC::UniqueId ec_id)
         return RTC::RTC_OK;
     }
 
+    // scans are integrated by m_updater in another thread
     while (m_rangeIn.isNew()){
         m_rangeIn.read();
-        Guard guard(m_mutex);
-        Pointcloud cloud;
-        for (unsigned int i=0; i<m_range.ranges.length(); i++){
-            double th = m_range.config.minAngle + i*m_range.config.angularRes;
-            double d = m_range.ranges[i];
-            if (d==0) continue;
-            cloud.push_back(point3d(-d*sin(th), 0, -d*cos(th)));
+        Scan *scan = m_updater->acquire();
+        scan->type = Scan::RAYS;
+        // rays are given in the sensor frame
+        unsigned int n = m_range.ranges.length();
+        m_projector.setup(m_range.config.minAngle, m_range.config.angularRes, n);
+        if (m_rays.size() < n*3) m_rays.resize(n*3);
+        unsigned int npoint = n ? m_projector.project(m_range.ranges.get_buffer(),
+                                                      hrp::Vector3::Zero(),
+                                                      hrp::Matrix33::Identity(),
+                                                      &m_rays[0], 3) : 0;
+        for (unsigned int i=0; i<npoint; i++){
+            const float *ray = &m_rays[i*3];
+            scan->points.push_back(point3d(ray[0], ray[1], ray[2]));
         }
-        point3d sensor(0,0,0);
+        scan->sensor = point3d(0,0,0);
         Pose3D &pose = m_range.geometry.geometry.pose;
-        pose6d frame(pose.position.x,
-                     pose.position.y,
-                     pose.position.z, 
-                     pose.orientation.r,
-                     pose.orientation.p,
-                     pose.orientation.y);
-        m_map->insertPointCloud(cloud, sensor, frame);
+        scan->frame = pose6d(pose.position.x,
+                             pose.position.y,
+                             pose.position.z, 
+                             pose.orientation.r,
+                             pose.orientation.p,
+                             pose.orientation.y);
+        m_updater->push(scan);
     }
 
     if (m_cloudIn.isNew()){
         while (m_cloudIn.isNew()) m_cloudIn.read();
         while (m_poseIn.isNew())  m_poseIn.read();
         while (m_sensorPosIn.isNew())  m_sensorPosIn.read();
-        Guard guard(m_mutex);
         float *ptr = (float *)m_cloud.data.get_buffer();
+        Scan::Type type;
         if (strcmp(m_cloud.type, "xyz")==0 
             || strcmp(m_cloud.type, "xyzrgb")==0){
-            Pointcloud cloud;
-            for (unsigned int i=0; i<m_cloud.data.length()/16; i++, ptr+=4){
-                if (isnan(ptr[0])) continue;
-                cloud.push_back(point3d(ptr[0],ptr[1],ptr[2]));
-            }
-            point3d sensor(m_sensorPos.data.x,
-                           m_sensorPos.data.y,
-                           m_sensorPos.data.z);
-            pose6d frame(m_pose.data.position.x,
-                         m_pose.data.position.y,
-                         m_pose.data.position.z, 
-                         m_pose.data.orientation.r,
-                         m_pose.data.orientation.p,
-                         m_pose.data.orientation.y);
-            m_map->insertPointCloud(cloud, sensor, frame);
+            type = Scan::RAYS;
         }else if (strcmp(m_cloud.type, "xyzv")==0){
-            hrp::Matrix33 R;
-            hrp::Vector3 p;
-            p[0] = m_pose.data.position.x; 
-            p[1] = m_pose.data.position.y; 
-            p[2] = m_pose.data.position.z; 
-            R = hrp::rotFromRpy(m_pose.data.orientation.r,
-                                m_pose.data.orientation.p,
-                                m_pose.data.orientation.y);
-            int ocnum = 0;
-            int emnum = 0;
-#if KDEBUG
-	    point3d pp1,pp2,pp3,pp4,pp5;
-	    //	    pp1.x() = 0.1; //0.05;
-	    //	    pp1.y() = 2.2; //2.15;
-	    //	    pp1.z() = 1.4; //1.45;
-	    pp1.x() = -0.35;
-	    pp1.y() = 2.9;
-	    pp1.z() = 0.5;
-	    pp2.x() = -0.45; //-0.45;
-	    pp2.y() = 2.9; //2.95;
-	    pp2.z() = 0.5; //0.55;
-	    pp3.x() = -0.55; //-0.55;
-	    pp3.y() = 2.9; //2.95;
-	    pp3.z() = 0.5; //0.55;
-	    pp4.x() = -0.65; //-0.45;
-	    pp4.y() = 2.9; //3.05;
-	    pp4.z() = 0.5; //0.55;
-	    pp5.x() = -0.75; //-0.55;
-	    pp5.y() = 2.9; //3.05;
-	    pp5.z() = 0.5; //0.55;
-	    OcTreeNode *result1 = m_map->search(pp1);
-	    OcTreeKey result1_key;
-	    m_map->genKey(pp1, result1_key);
-	    OcTreeNode *result2 = m_map->search(pp2);
-	    OcTreeKey result2_key;
-	    m_map->genKey(pp2, result2_key);
-	    OcTreeNode *result3 = m_map->search(pp3);
-	    OcTreeKey result3_key;
-	    m_map->genKey(pp3, result3_key);
-	    OcTreeNode *result4 = m_map->search(pp4);
-	    OcTreeKey result4_key;
-	    m_map->genKey(pp4, result4_key);
-	    OcTreeNode *result5 = m_map->search(pp5);
-	    OcTreeKey result5_key;
-	    m_map->genKey(pp5, result5_key);
-	    double prob1,prob2,prob3,prob4,prob5;
-	    if (result1){
-	      prob1 = result1->getOccupancy();
-	      std::cout << m_profile.instance_name << ": " << pp1 << " original prob = " << prob1 << std::endl;
-	      std::cout << m_profile.instance_name << ": " << pp1 << " key = " << result1_key[0] << " " << result1_key[1] << " " << result1_key[2] << std::endl;
-	    }
-	    else
-	      std::cout << m_profile.instance_name << ": " << pp1 << " can not be searched." << std::endl;
-	    if (result2){
-	      prob2 = result2->getOccupancy();
-	      std::cout << m_profile.instance_name << ": " << pp2 << " original prob = " << prob2 << std::endl;
-	      std::cout << m_profile.instance_name << ": " << pp2 << " key = " << result2_key[0] << " " << result2_key[1] << " " << result2_key[2] << std::endl;
-	    }
-	    else
-	      std::cout << m_profile.instance_name << ": " << pp2 << " can not be searched." << std::endl;
-	    if (result3){
-	      prob3 = result3->getOccupancy();
-	      std::cout << m_profile.instance_name << ": " << pp3 << " original prob = " << prob3 << std::endl;
-	      std::cout << m_profile.instance_name << ": " << pp3 << " key = " << result3_key[0] << " " << result3_key[1] << " " << result3_key[2] << std::endl;
-	    }
-	    else
-	      std::cout << m_profile.instance_name << ": " << pp3 << " can not be searched." << std::endl;
-	    if (result4){
-	      prob4 = result4->getOccupancy();
-	      std::cout << m_profile.instance_name << ": " << pp4 << " original prob = " << prob4 << std::endl;
-	      std::cout << m_profile.instance_name << ": " << pp4 << " key = " << result4_key[0] << " " << result4_key[1] << " " << result4_key[2] << std::endl;
-	    }
-	    else
-	      std::cout << m_profile.instance_name << ": " << pp4 << " can not be searched." << std::endl;
-	    if (result5){
-	      prob5 = result5->getOccupancy();
-	      std::cout << m_profile.instance_name << ": " << pp5 << " original prob = " << prob5 << std::endl;
-	      std::cout << m_profile.instance_name << ": " << pp5 << " key = " << result5_key[0] << " " << result5_key[1] << " " << result5_key[2] << std::endl;
-	    }
-	    else
-	      std::cout << m_profile.instance_name << ": " << pp5 << " can not be searched." << std::endl;
-
-	    OcTreeNode *result;
-	    OcTreeKey result_key;
-	    double prob;
-	    point3d pp;
-	    pp.z() = 0.5;
-	    for(int i=0; i<5; i++){
-	      pp.x() = -0.3 - 0.1*i;
-	      for(int j=0; j<5; j++){
-		pp.y() = 2.8 + 0.1*j;
-		result = m_map->search(pp);
-		m_map->genKey(pp, result_key);
-		if(result){
-		  prob = result->getOccupancy();
-		  std::cout << m_profile.instance_name << ": " << pp << " original prob = " << prob << std::endl;
-		  std::cout << m_profile.instance_name << ": " << pp << " key = " << result_key[0] << " " << result_key[1] << " " << result_key[2] << std::endl;
-		}
-		else
-		  std::cout << m_profile.instance_name << ": " << pp << " can not be searched." << std::endl;
-	      }
-	    }
-#endif
-            for (unsigned int i=0; i<m_cloud.data.length()/16; i++, ptr+=4){
-                if (isnan(ptr[0])) continue;
-                hrp::Vector3 peye(ptr[0],ptr[1],ptr[2]);
-                hrp::Vector3 pworld(R*peye+p);
-                point3d pog(pworld[0],pworld[1],pworld[2]);
-#if KDEBUG
-		OcTreeNode *target_node; // 121023
-		OcTreeKey target_key; // 121023
-		if((pworld[0]>(pp1.x()-0.1)&&pworld[0]<pp1.x()&&pworld[1]>pp1.y()&&pworld[1]<(pp1.y()+0.1)&&pworld[2]>pp1.z()&&pworld[2]<(pp1.z()+0.1)) ||
-		   (pworld[0]>(pp2.x()-0.1)&&pworld[0]<pp2.x()&&pworld[1]>pp2.y()&&pworld[1]<(pp2.y()+0.1)&&pworld[2]>pp2.z()&&pworld[2]<(pp2.z()+0.1)) ||
-		   (pworld[0]>(pp3.x()-0.1)&&pworld[0]<pp3.x()&&pworld[1]>pp3.y()&&pworld[1]<(pp3.y()+0.1)&&pworld[2]>pp3.z()&&pworld[2]<(pp3.z()+0.1))){
-		  target_node = m_map->search(pog); // 121023
-		  m_map->genKey(pog, target_key); // 121023
-		  if (target_node){
-		    double beforeprob = target_node->getOccupancy();
-		    std::cout << m_profile.instance_name << ": " << pog << " before prob = " << beforeprob << std::endl;
-		    std::cout << m_profile.instance_name << ": " << pog << " key = " << target_key[0] << " " << target_key[1] << " " << target_key[2] << std::endl;
-		  }
-		  else
-		    std::cout << m_profile.instance_name << ": " << pog << " can not be searched." << std::endl;
-		}
-#endif
-		//                m_map->updateNode(pog, ptr[3]>0.0?true:false, false);
-		OcTreeNode *updated_node = m_map->updateNode(pog, ptr[3]>0.0?true:false, false); // 121023
-#if KDEBUG
-#if 0
-		std::cout << m_profile.instance_name << ": tree depth = " << m_map->getTreeDepth() << std::endl;
-		std::cout << m_profile.instance_name << ": tree size = " << m_map->size() << std::endl;
-#endif
-		if((pworld[0]>(pp1.x()-0.1)&&pworld[0]<pp1.x()&&pworld[1]>pp1.y()&&pworld[1]<(pp1.y()+0.1)&&pworld[2]>pp1.z()&&pworld[2]<(pp1.z()+0.1)) ||
-		   (pworld[0]>(pp2.x()-0.1)&&pworld[0]<pp2.x()&&pworld[1]>pp2.y()&&pworld[1]<(pp2.y()+0.1)&&pworld[2]>pp2.z()&&pworld[2]<(pp2.z()+0.1)) ||
-		   (pworld[0]>(pp3.x()-0.1)&&pworld[0]<pp3.x()&&pworld[1]>pp3.y()&&pworld[1]<(pp3.y()+0.1)&&pworld[2]>pp3.z()&&pworld[2]<(pp3.z()+0.1))){
-		  target_node = m_map->search(pog); // 121023
-		  m_map->genKey(pog, target_key); // 121023
-		  if (target_node){
-		    double afterprob = target_node->getOccupancy();
-		    std::cout << m_profile.instance_name << ": " << pog << " after prob = " << afterprob << std::endl;
-		  }
-		  if (updated_node){
-		    double updatedprob = updated_node->getOccupancy();
-		    std::cout << m_profile.instance_name << ": " << pog << " updated prob = " << updatedprob << std::endl;
-		  }
-		  //		}
-		result2 = m_map->search(pp2);
-		m_map->genKey(pp2, result2_key);
-		if (result2){
-		  double newprob = result2->getOccupancy();
-		  //		  if(newprob != prob){ // wrong
-		  //		  if(!(abs(newprob - prob) < 0.0001)){ // wrong
-		  //		  if(!(fabs(newprob - prob2) < 0.0001)){ // correct 121023
-		    std::cout << m_profile.instance_name << ": " << pp2 << " updated prob = " << newprob << " by " << pog << " prob = " << prob2 << std::endl;
-		    std::cout << m_profile.instance_name << ": " << pp2 << " key = " << result2_key[0] << " " << result2_key[1] << " " << result2_key[2] << std::endl;
-		    std::cout << m_profile.instance_name << ": " << pp2 << " hasChildren = " << result2->hasChildren() << std::endl;
-		    prob2 = newprob;
-		    //		  }
-		}
-		else
-		  std::cout << m_profile.instance_name << ": " << pp2 << " can not be searched." << std::endl;
-		}
-#endif
-                ptr[3]>0.0?ocnum++:emnum++;
-            }
-            if(KDEBUG) std::cout << m_profile.instance_name << ": " << ocnum << " " << emnum << " " << p << std::endl;
+            type = Scan::VOXELS;
         }else{
             std::cout << "point type(" << m_cloud.type 
                       << ") is not supported" << std::endl;
             return RTC::RTC_ERROR;
         }
+        Scan *scan = m_updater->acquire();
+        scan->type = type;
+        for (unsigned int i=0; i<m_cloud.data.length()/16; i++, ptr+=4){
+            if (isnan(ptr[0])) continue;
+            scan->points.push_back(point3d(ptr[0],ptr[1],ptr[2]));
+            // the 4th value of xyzv is positive if the voxel is occupied
+            if (type == Scan::VOXELS) scan->occupied.push_back(ptr[3]>0.0);
+        }
+        scan->sensor = point3d(m_sensorPos.data.x,
+                               m_sensorPos.data.y,
+                               m_sensorPos.data.z);
+        scan->frame = pose6d(m_pose.data.position.x,
+                             m_pose.data.position.y,
+                             m_pose.data.position.z, 
+                             m_pose.data.orientation.r,
+                             m_pose.data.orientation.p,
+                             m_pose.data.orientation.y);
+        m_updater->push(scan);
+    }
+
+    // notify clients when a new snapshot is published
+    unsigned int revision = m_updater->revision();
+    if (revision != m_revision){
+        m_revision = revision;
         m_updateOut.write();
     }
 
@@ -482,29 +361,28 @@ RTC::ReturnCode_t OccupancyGridMap3D::onRateChanged(RTC::UniqueId ec_id)
 }
 */
 
-OpenHRP::OGMap3D* OccupancyGridMap3D::getOGMap3D(const OpenHRP::AABB& region)
+// compute a grid which covers both the region and the maps
+template <class T>
+static void setupGrid(const OcTree *i_tree, const OcTree *i_knownMap,
+                      const OpenHRP::AABB& i_region, T& o_map)
 {
-    Guard guard(m_mutex);
-    coil::TimeValue t1(coil::gettimeofday());
-
-    OpenHRP::OGMap3D *map = new OpenHRP::OGMap3D;
-    double size = m_map->getResolution();
-    map->resolution = size;
+    double size = i_tree->getResolution();
+    o_map.resolution = size;
 
     double min[3];
-    m_map->getMetricMin(min[0],min[1],min[2]);
+    i_tree->getMetricMin(min[0],min[1],min[2]);
     double max[3];
-    m_map->getMetricMax(max[0],max[1],max[2]);
+    i_tree->getMetricMax(max[0],max[1],max[2]);
     for (int i=0; i<3; i++){
         min[i] -= size; 
         max[i] += size; 
     }
 
-    if (m_knownMap){
+    if (i_knownMap){
         double kmin[3];
-        m_knownMap->getMetricMin(kmin[0],kmin[1],kmin[2]);
+        i_knownMap->getMetricMin(kmin[0],kmin[1],kmin[2]);
         double kmax[3];
-        m_knownMap->getMetricMax(kmax[0],kmax[1],kmax[2]);
+        i_knownMap->getMetricMax(kmax[0],kmax[1],kmax[2]);
         for (int i=0; i<3; i++){
             kmin[i] -= size; 
             kmax[i] += size; 
@@ -515,13 +393,13 @@ OpenHRP::OGMap3D* OccupancyGridMap3D::getOGMap3D(const OpenHRP::AABB& region)
     }
 
     double s[3];
-    s[0] = region.pos.x;
-    s[1] = region.pos.y;
-    s[2] = region.pos.z;
+    s[0] = i_region.pos.x;
+    s[1] = i_region.pos.y;
+    s[2] = i_region.pos.z;
     double e[3];
-    e[0] = region.pos.x + region.size.l;
-    e[1] = region.pos.y + region.size.w;
-    e[2] = region.pos.z + region.size.h;
+    e[0] = i_region.pos.x + i_region.size.l;
+    e[1] = i_region.pos.y + i_region.size.w;
+    e[2] = i_region.pos.z + i_region.size.h;
     double l[3];
     
     for (int i=0; i<3; i++){
@@ -535,75 +413,106 @@ OpenHRP::OGMap3D* OccupancyGridMap3D::getOGMap3D(const OpenHRP::AABB& region)
     }
 
 #ifdef USE_ONLY_GRIDS
-    map->pos.x = ((int)(s[0]/size))*size;
-    map->pos.y = ((int)(s[1]/size))*size;
-    map->pos.z = ((int)(s[2]/size))*size;
+    o_map.pos.x = ((int)(s[0]/size))*size;
+    o_map.pos.y = ((int)(s[1]/size))*size;
+    o_map.pos.z = ((int)(s[2]/size))*size;
 #else
-#if 0
-    map->pos.x = s[0];
-    map->pos.y = s[1];
-    map->pos.z = s[2];
-    if(KDEBUG){
-      std::cout << m_profile.instance_name << ": pos = " << map->pos.x << " " << map->pos.y << " " << map->pos.z << " " << std::endl;
-      map->pos.x += size/2.0;
-      map->pos.y += size/2.0;
-      map->pos.z += size/2.0;
-    }
-#endif      
-    map->pos.x = ((int)(s[0]/size)+0.5)*size; // 121024
-    map->pos.y = ((int)(s[1]/size)+0.5)*size; // 121024
-    map->pos.z = ((int)(s[2]/size)+0.5)*size; // 121024
+    o_map.pos.x = ((int)(s[0]/size)+0.5)*size; // 121024
+    o_map.pos.y = ((int)(s[1]/size)+0.5)*size; // 121024
+    o_map.pos.z = ((int)(s[2]/size)+0.5)*size; // 121024
 #endif
-    map->nx = l[0]/size;
-    map->ny = l[1]/size;
-    map->nz = l[2]/size;
-    int rank=0;
-    point3d p;
-    map->cells.length(map->nx*map->ny*map->nz);
-    {
-        int no=0, ne=0, nu=0;
-        //Guard guard(m_mutex);
-        for (int i=0; i<map->nx; i++){
-            p.x() = map->pos.x + i*size;
-            for (int j=0; j<map->ny; j++){
-                p.y() = map->pos.y + j*size;
-                for (int k=0; k<map->nz; k++){
-                    p.z() = map->pos.z + k*size;
-                    OcTreeNode *result = m_map->search(p);
-		    //                    if (result){
-                    if (result && !(result->hasChildren())){ // 121023
-                        double prob = result->getOccupancy();
-                        if (prob >= m_occupiedThd){
-                            map->cells[rank] = prob*0xfe;
-                            no++;
-			    //			    if(KDEBUG) std::cout << m_profile.instance_name << ": output " << p << " " << prob << std::endl;
-                        }else{
-                            map->cells[rank] = OpenHRP::gridEmpty;
-                            ne++;
-                        }
-                        //printf("%6.3f %6.3f %6.3f:%d\n", p.x(), p.y(), p.z(),map->cells[rank-1]);
-                    }else{
-                        map->cells[rank] = OpenHRP::gridUnknown;
-                        nu++;
-                    }
-                    if (m_knownMap){
-                        OcTreeNode *result = m_knownMap->search(p);
-                        if (result){
-                            double prob = result->getOccupancy();
-                            if (prob >= m_occupiedThd){
-                                map->cells[rank] = prob*0xfe;
-                            }
-                        }
-                    }
-                    rank++;
-                }
+    o_map.nx = l[0]/size;
+    o_map.ny = l[1]/size;
+    o_map.nz = l[2]/size;
+}
+
+static inline unsigned char cellValue(double i_prob, double i_occupiedThd)
+{
+    return i_prob >= i_occupiedThd ? i_prob*0xfe : OpenHRP::gridEmpty;
+}
+
+// paint cells whose centers are inside leaves of i_tree
+static void paintLeaves(const OcTree *i_tree, double i_occupiedThd,
+                        bool i_occupiedOnly, double i_size,
+                        const double i_pos[3], const int i_n[3],
+                        unsigned char *o_cells)
+{
+    point3d bmin(i_pos[0], i_pos[1], i_pos[2]);
+    point3d bmax(i_pos[0] + (i_n[0]-1)*i_size,
+                 i_pos[1] + (i_n[1]-1)*i_size,
+                 i_pos[2] + (i_n[2]-1)*i_size);
+    for (OcTree::leaf_bbx_iterator it = i_tree->begin_leafs_bbx(bmin, bmax),
+             end = i_tree->end_leafs_bbx(); it != end; ++it){
+        double prob = it->getOccupancy();
+        if (i_occupiedOnly && prob < i_occupiedThd) continue;
+        unsigned char v = cellValue(prob, i_occupiedThd);
+        point3d c = it.getCoordinate();
+        double half = it.getSize()/2;
+        int lo[3], hi[3];
+        bool inside = true;
+        for (int d=0; d<3; d++){
+            // centers of cells are in the middle of voxels of the tree
+            lo[d] = ceil((c(d) - half - i_pos[d])/i_size);
+            hi[d] = ceil((c(d) + half - i_pos[d])/i_size) - 1;
+            if (lo[d] < 0) lo[d] = 0;
+            if (hi[d] >= i_n[d]) hi[d] = i_n[d] - 1;
+            if (lo[d] > hi[d]) inside = false;
+        }
+        if (!inside) continue;
+        for (int i=lo[0]; i<=hi[0]; i++){
+            for (int j=lo[1]; j<=hi[1]; j++){
+                memset(o_cells + (i*i_n[1] + j)*i_n[2] + lo[2], v,
+                       hi[2] - lo[2] + 1);
             }
         }
-#if 0
-        std::cout << "occupied/empty/unknown = " << no << "/" << ne << "/" 
-                  << nu << std::endl;
-#endif
     }
+}
+
+// the known map is deleted by onDeactivated(), so queries take a reference
+// to it under the lock and walk it without locking
+OccupancyGridMap3D::KnownMap OccupancyGridMap3D::knownMap()
+{
+    Guard guard(m_mutex);
+    return m_knownMap;
+}
+
+void OccupancyGridMap3D::rasterize(const OcTree *i_tree,
+                                   const OcTree *i_knownMap, double i_size,
+                                   const RTC::Point3D& i_pos,
+                                   int i_nx, int i_ny, int i_nz,
+                                   unsigned char *o_cells)
+{
+    memset(o_cells, OpenHRP::gridUnknown, i_nx*i_ny*i_nz);
+    if (!i_nx || !i_ny || !i_nz) return;
+    double pos[] = {i_pos.x, i_pos.y, i_pos.z};
+    int n[] = {i_nx, i_ny, i_nz};
+    // paint whole leaves instead of searching the tree for each cell
+    paintLeaves(i_tree, m_occupiedThd, false, i_size, pos, n, o_cells);
+    if (i_knownMap){
+        paintLeaves(i_knownMap, m_occupiedThd, true, i_size, pos, n, o_cells);
+    }
+}
+
+OpenHRP::OGMap3D* OccupancyGridMap3D::getOGMap3D(const OpenHRP::AABB& region)
+{
+    coil::TimeValue t1(coil::gettimeofday());
+
+    // the snapshot is never modified, so it is read without locking
+    MapUpdater::Snapshot snapshot = m_updater->snapshot();
+    KnownMap known = knownMap();
+    const OcTree *tree = snapshot.get();
+    OpenHRP::OGMap3D *map = new OpenHRP::OGMap3D;
+    if (!tree){
+        map->resolution = m_resolution;
+        map->pos.x = map->pos.y = map->pos.z = 0;
+        map->nx = map->ny = map->nz = 0;
+        return map;
+    }
+    setupGrid(tree, known.get(), region, *map);
+    map->cells.length(map->nx*map->ny*map->nz);
+    rasterize(tree, known.get(), map->resolution, map->pos,
+              map->nx, map->ny, map->nz, map->cells.get_buffer());
+
     coil::TimeValue t2(coil::gettimeofday());
     if (m_debugLevel > 0){
         coil::TimeValue dt = t2-t1;
@@ -614,6 +523,113 @@ OpenHRP::OGMap3D* OccupancyGridMap3D::getOGMap3D(const OpenHRP::AABB& region)
     return map;
 }
 
+// encode cells as pairs of a state and (length of the run - 1) in LEB128
+static void encodeRLE(const unsigned char *i_cells, unsigned int i_n,
+                      RTC::OGMapCells& o_runs)
+{
+    unsigned int len = 0;
+    for (int pass=0; pass<2; pass++){
+        unsigned char *ptr = pass ? o_runs.get_buffer() : NULL;
+        len = 0;
+        for (unsigned int i=0; i<i_n; ){
+            unsigned int j = i+1;
+            while (j < i_n && i_cells[j] == i_cells[i]) j++;
+            if (ptr) ptr[len] = i_cells[i];
+            len++;
+            unsigned int run = j - i - 1;
+            do {
+                unsigned char b = run & 0x7f;
+                run >>= 7;
+                if (run) b |= 0x80;
+                if (ptr) ptr[len] = b;
+                len++;
+            } while (run);
+            i = j;
+        }
+        if (!pass) o_runs.length(len);
+    }
+}
+
+OpenHRP::OGMap3DRLE* OccupancyGridMap3D::getOGMap3DRLE(const OpenHRP::AABB& region)
+{
+    coil::TimeValue t1(coil::gettimeofday());
+
+    unsigned int revision;
+    MapUpdater::Snapshot snapshot = m_updater->snapshot(revision);
+    KnownMap known = knownMap();
+    const OcTree *tree = snapshot.get();
+    OpenHRP::OGMap3DRLE *map = new OpenHRP::OGMap3DRLE;
+    map->revision = revision;
+    if (!tree){
+        map->resolution = m_resolution;
+        map->pos.x = map->pos.y = map->pos.z = 0;
+        map->nx = map->ny = map->nz = 0;
+        return map;
+    }
+    setupGrid(tree, known.get(), region, *map);
+    std::vector<unsigned char> cells(map->nx*map->ny*map->nz);
+    if (!cells.empty()){
+        rasterize(tree, known.get(), map->resolution, map->pos,
+                  map->nx, map->ny, map->nz, &cells[0]);
+        encodeRLE(&cells[0], cells.size(), map->runs);
+    }
+
+    coil::TimeValue t2(coil::gettimeofday());
+    if (m_debugLevel > 0){
+        coil::TimeValue dt = t2-t1;
+        std::cout << "OccupancyGridMap3D::getOGMap3DRLE() : " 
+                  << dt.sec()*1e3+dt.usec()/1e3 << "[ms], "
+                  << cells.size() << " cells -> " << map->runs.length()
+                  << "[bytes]" << std::endl;
+    }
+
+    return map;
+}
+
+OpenHRP::OGMap3DChanges* OccupancyGridMap3D::getOGMap3DChanges(const OpenHRP::AABB& region, CORBA::ULong revision)
+{
+    unsigned int latest;
+    MapUpdater::Snapshot snapshot;
+    std::vector<octomap::OcTreeKey> keys;
+    OpenHRP::OGMap3DChanges *changes = new OpenHRP::OGMap3DChanges;
+    changes->complete = m_updater->changes(revision, snapshot, latest, keys);
+    changes->revision = latest;
+    const OcTree *tree = snapshot.get();
+    KnownMap known = knownMap();
+    changes->resolution = tree ? tree->getResolution() : m_resolution;
+    if (!changes->complete) return changes;
+
+    double s[] = {region.pos.x, region.pos.y, region.pos.z};
+    double e[] = {s[0] + region.size.l, s[1] + region.size.w,
+                  s[2] + region.size.h};
+    changes->keys.length(keys.size()*3);
+    changes->cells.length(keys.size());
+    unsigned int n = 0;
+    for (unsigned int i=0; i<keys.size(); i++){
+        const octomap::OcTreeKey& key = keys[i];
+        point3d p = tree->keyToCoord(key);
+        if (p.x() < s[0] || p.x() > e[0] || p.y() < s[1] || p.y() > e[1]
+            || p.z() < s[2] || p.z() > e[2]) continue;
+        unsigned char v = OpenHRP::gridUnknown;
+        OcTreeNode *node = tree->search(key);
+        if (node && !node->hasChildren()){
+            v = cellValue(node->getOccupancy(), m_occupiedThd);
+        }
+        if (known){
+            OcTreeNode *knownNode = known->search(p);
+            if (knownNode && knownNode->getOccupancy() >= m_occupiedThd){
+                v = cellValue(knownNode->getOccupancy(), m_occupiedThd);
+            }
+        }
+        for (int j=0; j<3; j++) changes->keys[n*3+j] = key[j];
+        changes->cells[n] = v;
+        n++;
+    }
+    changes->keys.length(n*3);
+    changes->cells.length(n);
+    return changes;
+}
+
 void OccupancyGridMap3D::save(const char *filename)
 {
     Guard guard(m_mutex);
@@ -622,9 +638,13 @@ void OccupancyGridMap3D::save(const char *filename)
 
 void OccupancyGridMap3D::clear()
 {
-    Guard guard(m_mutex);
-    m_map->clear();
-    m_updateOut.write();
+    // updateSignal is written by onExecute() when the cleared map is published
+    m_updater->clear();
+}
+
+void OccupancyGridMap3D::getStatistics(OpenHRP::OGMap3DStatistics& o_stat)
+{
+    m_updater->getStatistics(o_stat);
 }
 
 extern "C"
@@ -18,10 +18,13 @@
 #include <rtm/idl/BasicDataTypeSkel.h>
 #include <rtm/idl/InterfaceDataTypes.hh>
 #include "pointcloud.hh"
+#include "util/RangeProjector.h"
+#include <boost/shared_ptr.hpp>
 
 namespace octomap{
     class OcTree;
 };
+class MapUpdater;
 
 
 // Service implementation headers
@@ -104,8 +107,11 @@ class OccupancyGridMap3D
   // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
 
   OpenHRP::OGMap3D* getOGMap3D(const OpenHRP::AABB& region);
+  OpenHRP::OGMap3DRLE* getOGMap3DRLE(const OpenHRP::AABB& region);
+  OpenHRP::OGMap3DChanges* getOGMap3DChanges(const OpenHRP::AABB& region, CORBA::ULong revision);
   void save(const char *filename);
   void clear();
+  void getStatistics(OpenHRP::OGMap3DStatistics& o_stat);
 
  protected:
   // Configuration variable declaration
@@ -155,13 +161,29 @@ class OccupancyGridMap3D
   // </rtc-template>
 
  private:
-  octomap::OcTree *m_map, *m_knownMap;
+  typedef boost::shared_ptr<const octomap::OcTree> KnownMap;
+  KnownMap knownMap();
+  void rasterize(const octomap::OcTree *i_tree,
+                 const octomap::OcTree *i_knownMap, double i_size,
+                 const RTC::Point3D& i_pos, int i_nx, int i_ny, int i_nz,
+                 unsigned char *o_cells);
+
+  octomap::OcTree *m_map;
+  KnownMap m_knownMap; ///< guarded by m_mutex
   double m_occupiedThd, m_resolution;
   std::string m_initialMap;
   std::string m_knownMapPath;
   std::string m_cwd;
   coil::Mutex m_mutex;
   int m_debugLevel;
+  MapUpdater *m_updater;
+  RangeProjector m_projector;
+  std::vector<float> m_rays;
+  unsigned int m_revision;
+  unsigned int m_queueSize;
+  std::string m_queuePolicy;
+  double m_snapshotInterval;
+  unsigned int m_changeHistory;
   int dummy;
 };
 
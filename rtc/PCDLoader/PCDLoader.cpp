@@ -12,6 +12,7 @@
 #include <pcl/filters/statistical_outlier_removal.h>
 #include "PCDLoader.h"
 #include "pointcloud.hh"
+#include "util/PCLUtil.h"
 
 // Module specification
 // <rtc-template block="module_spec">
@@ -38,6 +39,7 @@ PCDLoader::PCDLoader(RTC::Manager* manager)
     // <rtc-template block="initializer">
     m_cloudOut("cloud", m_cloud),
     // </rtc-template>
+    m_pclCloud(new pcl::PointCloud<pcl::PointXYZ>),
     dummy(0)
 {
 }
@@ -74,23 +76,7 @@ RTC::ReturnCode_t PCDLoader::onInitialize()
   RTC::Properties& prop = getProperties();
 
   m_cloud.height = 1;
-  m_cloud.type = "xyz";
-  m_cloud.fields.length(3);
-  m_cloud.fields[0].name = "x";
-  m_cloud.fields[0].offset = 0;
-  m_cloud.fields[0].data_type = PointCloudTypes::FLOAT32;
-  m_cloud.fields[0].count = 4;
-  m_cloud.fields[1].name = "y";
-  m_cloud.fields[1].offset = 4;
-  m_cloud.fields[1].data_type = PointCloudTypes::FLOAT32;
-  m_cloud.fields[1].count = 4;
-  m_cloud.fields[2].name = "z";
-  m_cloud.fields[2].offset = 8;
-  m_cloud.fields[2].data_type = PointCloudTypes::FLOAT32;
-  m_cloud.fields[2].count = 4;
-  m_cloud.is_bigendian = false;
-  m_cloud.point_step = 16;
-  m_cloud.is_dense = true;
+  setupPointCloudFields(m_cloud);
 
   return RTC::RTC_OK;
 }
@@ -137,23 +123,10 @@ RTC::ReturnCode_t PCDLoader::onExecute(RTC::UniqueId ec_id)
   std::string filename;
   std::cin >> filename;
   
-  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-
   pcl::PCDReader reader;
-  reader.read (filename, *cloud);
-  int npoint = cloud->points.size();
-  m_cloud.width = npoint;
-  m_cloud.height = 1;
-  m_cloud.data.length(npoint*m_cloud.point_step);
-  m_cloud.row_step = m_cloud.data.length();
-  float *ptr = (float *)m_cloud.data.get_buffer();
-  std::cout << "npoint = " << npoint << std::endl;
-  for (int i=0; i<npoint; i++){
-    ptr[0] = cloud->points[i].x;
-    ptr[1] = cloud->points[i].y;
-    ptr[2] = cloud->points[i].z;
-    ptr += 4;
-  }
+  reader.read (filename, *m_pclCloud);
+  std::cout << "npoint = " << m_pclCloud->points.size() << std::endl;
+  wrapPCL(*m_pclCloud, m_cloud);
 
   m_cloudOut.write();
 
@@ -16,6 +16,8 @@
 #include <rtm/DataInPort.h>
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
 #include "pointcloud.hh"
 
 // Service implementation headers
@@ -131,6 +133,7 @@ class PCDLoader
   // </rtc-template>
 
  private:
+  pcl::PointCloud<pcl::PointXYZ>::Ptr m_pclCloud;
   int dummy;
 };
 
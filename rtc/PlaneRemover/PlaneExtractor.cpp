@@ -0,0 +1,330 @@
+// -*- C++ -*-
+/*!
+ * @file  PlaneExtractor.cpp
+ * @brief multi-plane extraction by parallel RANSAC
+ */
+#include <cmath>
+#include <algorithm>
+#include <sys/time.h>
+#include <boost/bind.hpp>
+#include "PlaneExtractor.h"
+
+// probability that at least one hypothesis is drawn only from inliers
+#define RANSAC_PROBABILITY 0.99
+// a plane of the last call is taken without sampling if it keeps this
+// ratio of its inliers
+#define LAST_PLANE_RATIO 0.9
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1e6;
+}
+
+/**
+   \brief eigenvector of the smallest eigenvalue of a symmetric 3x3 matrix
+   by Jacobi rotations
+ */
+static void smallestEigenvector(double a[3][3], double o_v[3])
+{
+    double v[3][3] = {{1,0,0},{0,1,0},{0,0,1}};
+    for (int sweep=0; sweep<50; sweep++){
+        double off = a[0][1]*a[0][1] + a[0][2]*a[0][2] + a[1][2]*a[1][2];
+        if (off < 1e-30) break;
+        for (int p=0; p<2; p++){
+            for (int q=p+1; q<3; q++){
+                if (a[p][q] == 0) continue;
+                double theta = (a[q][q] - a[p][p])/(2*a[p][q]);
+                double t = (theta >= 0 ? 1 : -1)
+                    /(fabs(theta) + sqrt(theta*theta + 1));
+                double c = 1/sqrt(t*t + 1), s = t*c;
+                for (int k=0; k<3; k++){
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c*akp - s*akq;
+                    a[k][q] = s*akp + c*akq;
+                }
+                for (int k=0; k<3; k++){
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c*apk - s*aqk;
+                    a[q][k] = s*apk + c*aqk;
+                }
+                for (int k=0; k<3; k++){
+                    double vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c*vkp - s*vkq;
+                    v[k][q] = s*vkp + c*vkq;
+                }
+            }
+        }
+    }
+    int m = 0;
+    if (a[1][1] < a[m][m]) m = 1;
+    if (a[2][2] < a[m][m]) m = 2;
+    for (int k=0; k<3; k++) o_v[k] = v[k][m];
+}
+
+PlaneExtractor::PlaneExtractor() :
+    m_distThd(0.02), m_minInliers(500), m_maxIterations(50),
+    m_useLastPlanes(false), m_rand(1), m_nthreads(1),
+    m_points(NULL), m_pointStep(16), m_nremaining(0), m_stage(EVALUATE),
+    m_nhyps(0)
+{
+    setSeed(0);
+}
+
+void PlaneExtractor::setSeed(unsigned int i_seed)
+{
+    // the state of xorshift must not be zero
+    m_rand = i_seed*2654435761u + 1;
+    if (!m_rand) m_rand = 1;
+}
+
+unsigned int PlaneExtractor::random()
+{
+    m_rand ^= m_rand << 13;
+    m_rand ^= m_rand >> 17;
+    m_rand ^= m_rand << 5;
+    return m_rand;
+}
+
+void PlaneExtractor::setNumThreads(int i_nthreads)
+{
+    if (i_nthreads < 1) i_nthreads = 1;
+    m_pool.setNumThreads(i_nthreads);
+    m_nthreads = i_nthreads;
+}
+
+void PlaneExtractor::run(int i_part)
+{
+    switch(m_stage){
+    case EVALUATE: evaluate(i_part); break;
+    case FIT:      fit(i_part); break;
+    case MARK:     mark(i_part); break;
+    }
+}
+
+void PlaneExtractor::dispatch(Stage i_stage)
+{
+    m_stage = i_stage;
+    m_pool.run(boost::bind(&PlaneExtractor::run, this, _1),
+               m_nremaining >= (unsigned int)m_nthreads);
+}
+
+void PlaneExtractor::evaluate(int i_part)
+{
+    unsigned int begin = (unsigned long long)m_nremaining*i_part/m_nthreads;
+    unsigned int end = (unsigned long long)m_nremaining*(i_part+1)/m_nthreads;
+    const unsigned int nhyps = m_nhyps;
+    const float thd = m_distThd;
+    float coef[BATCH][4];
+    unsigned int count[BATCH];
+    for (unsigned int h=0; h<nhyps; h++){
+        for (int k=0; k<4; k++) coef[h][k] = m_hyps[h].coef[k];
+        count[h] = 0;
+    }
+    for (unsigned int i=begin; i<end; i++){
+        const float *p = (const float *)(m_points + (size_t)m_remaining[i]*m_pointStep);
+        for (unsigned int h=0; h<nhyps; h++){
+            float d = coef[h][0]*p[0] + coef[h][1]*p[1] + coef[h][2]*p[2]
+                + coef[h][3];
+            count[h] += fabsf(d) <= thd;
+        }
+    }
+    for (unsigned int h=0; h<nhyps; h++) m_counts[i_part*BATCH+h] = count[h];
+}
+
+void PlaneExtractor::fit(int i_part)
+{
+    unsigned int begin = (unsigned long long)m_nremaining*i_part/m_nthreads;
+    unsigned int end = (unsigned long long)m_nremaining*(i_part+1)/m_nthreads;
+    const float *coef = m_hyps[0].coef;
+    const float thd = m_distThd;
+    Moments m = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    for (unsigned int i=begin; i<end; i++){
+        const float *p = (const float *)(m_points + (size_t)m_remaining[i]*m_pointStep);
+        float d = coef[0]*p[0] + coef[1]*p[1] + coef[2]*p[2] + coef[3];
+        if (!(fabsf(d) <= thd)) continue;
+        double x = p[0], y = p[1], z = p[2];
+        m.n++;
+        m.x += x; m.y += y; m.z += z;
+        m.xx += x*x; m.xy += x*y; m.xz += x*z;
+        m.yy += y*y; m.yz += y*z; m.zz += z*z;
+    }
+    m_moments[i_part] = m;
+}
+
+void PlaneExtractor::mark(int i_part)
+{
+    unsigned int begin = (unsigned long long)m_nremaining*i_part/m_nthreads;
+    unsigned int end = (unsigned long long)m_nremaining*(i_part+1)/m_nthreads;
+    const float *coef = m_hyps[0].coef;
+    const float thd = m_distThd;
+    unsigned int count = 0;
+    for (unsigned int i=begin; i<end; i++){
+        const float *p = (const float *)(m_points + (size_t)m_remaining[i]*m_pointStep);
+        float d = coef[0]*p[0] + coef[1]*p[1] + coef[2]*p[2] + coef[3];
+        m_mask[i] = fabsf(d) <= thd;
+        count += m_mask[i];
+    }
+    m_counts[i_part*BATCH] = count;
+}
+
+bool PlaneExtractor::sample(Hypothesis& o_hyp)
+{
+    unsigned int i0 = random() % m_nremaining;
+    unsigned int i1 = random() % m_nremaining;
+    unsigned int i2 = random() % m_nremaining;
+    if (i0 == i1 || i1 == i2 || i2 == i0) return false;
+    const float *p0 = (const float *)(m_points + (size_t)m_remaining[i0]*m_pointStep);
+    const float *p1 = (const float *)(m_points + (size_t)m_remaining[i1]*m_pointStep);
+    const float *p2 = (const float *)(m_points + (size_t)m_remaining[i2]*m_pointStep);
+    double u[3], v[3], n[3];
+    for (int k=0; k<3; k++){
+        u[k] = p1[k] - p0[k];
+        v[k] = p2[k] - p0[k];
+    }
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+    double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    // collinear points
+    if (len < 1e-12) return false;
+    for (int k=0; k<3; k++) o_hyp.coef[k] = n[k]/len;
+    o_hyp.coef[3] = -(o_hyp.coef[0]*p0[0] + o_hyp.coef[1]*p0[1]
+                      + o_hyp.coef[2]*p0[2]);
+    return true;
+}
+
+bool PlaneExtractor::extractPlane(Plane& o_plane)
+{
+    Hypothesis best;
+    unsigned int nbest = 0, iterations = 0, nseeds = 0;
+    double needed = m_maxIterations;
+    if (m_useLastPlanes){
+        nseeds = std::min<size_t>(m_lastPlanes.size(), BATCH);
+    }
+    for (bool first = true; iterations < needed && iterations < m_maxIterations;
+         first = false){
+        m_nhyps = 0;
+        bool seeded = first && nseeds > 0;
+        if (seeded){
+            // the first batch consists of planes of the last call
+            for (unsigned int i=0; i<nseeds; i++){
+                for (int k=0; k<4; k++){
+                    m_hyps[m_nhyps].coef[k] = m_lastPlanes[i].coef[k];
+                }
+                m_nhyps++;
+            }
+        }else{
+            while (m_nhyps < BATCH && iterations < m_maxIterations){
+                iterations++;
+                if (sample(m_hyps[m_nhyps])) m_nhyps++;
+            }
+        }
+        if (!m_nhyps) break;
+        dispatch(EVALUATE);
+        int ibest = -1;
+        for (unsigned int h=0; h<m_nhyps; h++){
+            unsigned int n = 0;
+            for (int i=0; i<m_nthreads; i++) n += m_counts[i*BATCH+h];
+            if (n > nbest){
+                nbest = n;
+                best = m_hyps[h];
+                ibest = h;
+            }
+        }
+        if (seeded){
+            if (ibest >= 0 && nbest >= m_minInliers
+                && nbest >= m_lastPlanes[ibest].inliers*LAST_PLANE_RATIO) break;
+            continue;
+        }
+        // adaptive termination as pcl::RandomSampleConsensus does
+        if (nbest){
+            double w = (double)nbest/m_nremaining;
+            double p = w*w*w;
+            if (p >= 1){
+                needed = 0;
+            }else if (p > 0){
+                needed = log(1 - RANSAC_PROBABILITY)/log(1 - p);
+            }
+        }
+    }
+    o_plane.hypotheses = iterations + nseeds;
+    if (nbest < m_minInliers || nbest < 3) return false;
+
+    // refine the plane by least squares
+    m_hyps[0] = best;
+    dispatch(FIT);
+    Moments m = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    for (int i=0; i<m_nthreads; i++){
+        const Moments& mi = m_moments[i];
+        m.n += mi.n;
+        m.x += mi.x; m.y += mi.y; m.z += mi.z;
+        m.xx += mi.xx; m.xy += mi.xy; m.xz += mi.xz;
+        m.yy += mi.yy; m.yz += mi.yz; m.zz += mi.zz;
+    }
+    double c[3] = {m.x/m.n, m.y/m.n, m.z/m.n};
+    double cov[3][3];
+    cov[0][0] = m.xx/m.n - c[0]*c[0];
+    cov[0][1] = cov[1][0] = m.xy/m.n - c[0]*c[1];
+    cov[0][2] = cov[2][0] = m.xz/m.n - c[0]*c[2];
+    cov[1][1] = m.yy/m.n - c[1]*c[1];
+    cov[1][2] = cov[2][1] = m.yz/m.n - c[1]*c[2];
+    cov[2][2] = m.zz/m.n - c[2]*c[2];
+    double n[3];
+    smallestEigenvector(cov, n);
+    for (int k=0; k<3; k++) m_hyps[0].coef[k] = n[k];
+    m_hyps[0].coef[3] = -(n[0]*c[0] + n[1]*c[1] + n[2]*c[2]);
+
+    dispatch(MARK);
+    unsigned int ninliers = 0;
+    for (int i=0; i<m_nthreads; i++) ninliers += m_counts[i*BATCH];
+    if (ninliers < nbest){
+        // the refinement made it worse
+        m_hyps[0] = best;
+        dispatch(MARK);
+        ninliers = nbest;
+    }
+    for (int k=0; k<4; k++) o_plane.coef[k] = m_hyps[0].coef[k];
+    o_plane.inliers = ninliers;
+    if (ninliers < m_minInliers) return false;
+
+    // drop inliers from the list of remaining points
+    unsigned int j = 0;
+    for (unsigned int i=0; i<m_nremaining; i++){
+        if (!m_mask[i]) m_remaining[j++] = m_remaining[i];
+    }
+    m_nremaining = j;
+    return true;
+}
+
+unsigned int PlaneExtractor::extract(const unsigned char *i_points,
+                                     unsigned int i_npoints,
+                                     unsigned int i_pointStep)
+{
+    m_points = i_points;
+    m_pointStep = i_pointStep;
+    m_planes.clear();
+    m_remaining.resize(i_npoints);
+    m_mask.resize(i_npoints);
+    m_counts.resize(m_nthreads*BATCH);
+    m_moments.resize(m_nthreads);
+
+    m_nremaining = 0;
+    const unsigned char *ptr = i_points;
+    for (unsigned int i=0; i<i_npoints; i++, ptr+=i_pointStep){
+        const float *p = (const float *)ptr;
+        if (std::isnan(p[0]) || std::isnan(p[1]) || std::isnan(p[2])) continue;
+        m_remaining[m_nremaining++] = i;
+    }
+
+    while (m_nremaining >= 3 && m_nremaining >= m_minInliers){
+        Plane plane;
+        double t1 = now();
+        if (!extractPlane(plane)) break;
+        plane.time = now() - t1;
+        m_planes.push_back(plane);
+    }
+    m_lastPlanes = m_planes;
+    return m_nremaining;
+}
@@ -0,0 +1,123 @@
+// -*- C++ -*-
+/*!
+ * @file  PlaneExtractor.h
+ * @brief multi-plane extraction by parallel RANSAC
+ */
+#ifndef PLANE_EXTRACTOR_H
+#define PLANE_EXTRACTOR_H
+
+#include <vector>
+#include "util/WorkerPool.h"
+
+/**
+   \brief extract planes one after another by RANSAC and keep points which
+   don't belong to any of them
+
+   Points are 16 byte or larger records which start with float x, y and z.
+   Points with NaN are skipped. Remaining points are kept as a list of
+   indices, and inliers of an extracted plane are flagged in a mask and
+   dropped from the list, so points are never copied.
+
+   Hypotheses are sampled by the calling thread with a seeded generator and
+   evaluated in batches. Each thread counts inliers of all hypotheses in a
+   batch over its own chunk of points, so results don't depend on the
+   number of threads. The best hypothesis is refined by least squares and
+   its inliers are selected again as pcl::SACSegmentation does with
+   setOptimizeCoefficients(true). Planes of the last call can be tried as
+   the first hypotheses of each plane. Buffers are kept across calls and
+   only grow, so no allocation occurs in steady state.
+ */
+class PlaneExtractor
+{
+public:
+    struct Plane {
+        float coef[4];       ///< a, b, c and d of ax+by+cz+d=0, |(a,b,c)|=1
+        unsigned int inliers;
+        unsigned int hypotheses; ///< the number of evaluated hypotheses
+        double time;         ///< time to extract the plane[s]
+    };
+    PlaneExtractor();
+    /**
+       \brief set the maximum distance of inliers from a plane[m]
+     */
+    void setDistanceThreshold(double i_thd) { m_distThd = i_thd; }
+    /**
+       \brief stop when the best plane has fewer inliers than this
+     */
+    void setMinInliers(unsigned int i_n) { m_minInliers = i_n; }
+    /**
+       \brief set the maximum number of hypotheses for a plane
+     */
+    void setMaxIterations(unsigned int i_n) { m_maxIterations = i_n; }
+    /**
+       \brief try planes extracted by the last call first if true
+     */
+    void setUseLastPlanes(bool i_flag) { m_useLastPlanes = i_flag; }
+    /**
+       \brief reset the random number generator
+     */
+    void setSeed(unsigned int i_seed);
+    /**
+       \brief set the number of threads including the calling thread
+     */
+    void setNumThreads(int i_nthreads);
+    int numThreads() const { return m_nthreads; }
+    /**
+       \brief extract planes
+       \param i_points input points
+       \param i_npoints the number of input points
+       \param i_pointStep size of an input point[byte]
+       \return the number of remaining points
+     */
+    unsigned int extract(const unsigned char *i_points, unsigned int i_npoints,
+                         unsigned int i_pointStep);
+    /**
+       \brief indices of remaining points in ascending order
+     */
+    const unsigned int *remaining() const {
+        return m_remaining.empty() ? NULL : &m_remaining[0];
+    }
+    /**
+       \brief planes extracted by the last call in the order of extraction
+     */
+    const std::vector<Plane>& planes() const { return m_planes; }
+private:
+    enum { BATCH = 16 };
+    enum Stage { EVALUATE, FIT, MARK };
+    struct Hypothesis {
+        float coef[4];
+    };
+    struct Moments {
+        double n, x, y, z, xx, xy, xz, yy, yz, zz;
+    };
+    unsigned int random();
+    bool sample(Hypothesis& o_hyp);
+    bool extractPlane(Plane& o_plane);
+    void dispatch(Stage i_stage);
+    void run(int i_part);
+    void evaluate(int i_part);
+    void fit(int i_part);
+    void mark(int i_part);
+
+    double m_distThd;
+    unsigned int m_minInliers, m_maxIterations;
+    bool m_useLastPlanes;
+    unsigned int m_rand;
+    int m_nthreads;
+    std::vector<unsigned int> m_remaining;
+    std::vector<unsigned char> m_mask;
+    std::vector<Plane> m_planes, m_lastPlanes;
+
+    // arguments of the current call and the current stage
+    const unsigned char *m_points;
+    unsigned int m_pointStep, m_nremaining;
+    Stage m_stage;
+    Hypothesis m_hyps[BATCH];
+    unsigned int m_nhyps;
+    std::vector<unsigned int> m_counts;   ///< BATCH counters per thread
+    std::vector<Moments> m_moments;       ///< moments per thread
+
+    WorkerPool m_pool;
+};
+
+#endif // PLANE_EXTRACTOR_H
@@ -13,6 +13,8 @@
 #include <pcl/filters/extract_indices.h>
 #include "PlaneRemover.h"
 #include "pointcloud.hh"
+#include <cstring>
+#include "util/PCLUtil.h"
 
 // Module specification
 // <rtc-template block="module_spec">
@@ -31,6 +33,11 @@ static const char* spec[] =
     // Configuration variables
     "conf.default.distanceThd", "0.02",
     "conf.default.pointNumThd", "500",
+    "conf.default.usePCL", "1",
+    "conf.default.threads", "1",
+    "conf.default.maxIterations", "50",
+    "conf.default.useLastPlanes", "0",
+    "conf.default.debugLevel", "0",
 
     ""
   };
@@ -42,7 +49,10 @@ PlaneRemover::PlaneRemover(RTC::Manager* manager)
     m_originalIn("original", m_original),
     m_filteredOut("filtered", m_filtered),
     // </rtc-template>
-    dummy(0)
+    m_cloud(new pcl::PointCloud<pcl::PointXYZ>),
+    m_cloudFiltered(new pcl::PointCloud<pcl::PointXYZ>),
+    dummy(0),
+    m_nframes(0), m_elapsed(0), m_tReport(0)
 {
 }
 
@@ -59,6 +69,11 @@ RTC::ReturnCode_t PlaneRemover::onInitialize()
   // Bind variables and configuration variable
   bindParameter("distanceThd", m_distThd, "0.02");
   bindParameter("pointNumThd", m_pointNumThd, "500");
+  bindParameter("usePCL", m_usePCL, "1");
+  bindParameter("threads", m_threads, "1");
+  bindParameter("maxIterations", m_maxIterations, "50");
+  bindParameter("useLastPlanes", m_useLastPlanes, "0");
+  bindParameter("debugLevel", m_debugLevel, "0");
   
   // </rtc-template>
 
@@ -81,23 +96,7 @@ RTC::ReturnCode_t PlaneRemover::onInitialize()
   RTC::Properties& prop = getProperties();
 
   m_filtered.height = 1;
-  m_filtered.type = "xyz";
-  m_filtered.fields.length(3);
-  m_filtered.fields[0].name = "x";
-  m_filtered.fields[0].offset = 0;
-  m_filtered.fields[0].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[0].count = 4;
-  m_filtered.fields[1].name = "y";
-  m_filtered.fields[1].offset = 4;
-  m_filtered.fields[1].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[1].count = 4;
-  m_filtered.fields[2].name = "z";
-  m_filtered.fields[2].offset = 8;
-  m_filtered.fields[2].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[2].count = 4;
-  m_filtered.is_bigendian = false;
-  m_filtered.point_step = 16;
-  m_filtered.is_dense = true;
+  setupPointCloudFields(m_filtered);
 
   return RTC::RTC_OK;
 }
@@ -144,65 +143,125 @@ RTC::ReturnCode_t PlaneRemover::onExecute(RTC::UniqueId ec_id)
   if (m_originalIn.isNew()){
     m_originalIn.read();
 
-    // CORBA -> PCL
-    pcl::PointCloud<pcl::PointXYZ>::Ptr original (new pcl::PointCloud<pcl::PointXYZ>);
-    original->points.resize(m_original.width*m_original.height);
-    float *src = (float *)m_original.data.get_buffer();
-    for (int i=0; i<original->points.size(); i++){
-      original->points[i].x = src[0];
-      original->points[i].y = src[1];
-      original->points[i].z = src[2];
-      src += 4;
+    coil::TimeValue t1(coil::gettimeofday());
+    unsigned int npoint = m_original.point_step
+      ? m_original.data.length()/m_original.point_step : 0;
+    if (m_usePCL){
+      removePCL();
+    }else{
+      removeNative(npoint);
     }
+    coil::TimeValue t2(coil::gettimeofday());
+
+    if (m_debugLevel > 0){
+      // report time per frame averaged over about one second and time of
+      // each plane of the last frame
+      coil::TimeValue dt = t2-t1;
+      m_nframes++;
+      m_elapsed += dt.sec()+dt.usec()/1e6;
+      if ((double)t2 - m_tReport > 1.0 || m_debugLevel > 1){
+        m_tReport = (double)t2;
+        std::cout << m_profile.instance_name << ": "
+                  << npoint << " -> " << m_filtered.width << " points, "
+                  << m_elapsed/m_nframes*1e3 << "[ms/frame]" << std::endl;
+        if (!m_usePCL){
+          const std::vector<PlaneExtractor::Plane>& planes = m_extractor.planes();
+          for (unsigned int i=0; i<planes.size(); i++){
+            const PlaneExtractor::Plane& p = planes[i];
+            std::cout << m_profile.instance_name << ":   plane" << i << " ("
+                      << p.coef[0] << ", " << p.coef[1] << ", " << p.coef[2]
+                      << ", " << p.coef[3] << "), " << p.inliers
+                      << " points, " << p.hypotheses << " hypotheses, "
+                      << p.time*1e3 << "[ms]" << std::endl;
+          }
+        }
+        m_nframes = 0;
+        m_elapsed = 0;
+      }
+    }
+
+    m_filteredOut.write();
+  }
+
+  return RTC::RTC_OK;
+}
 
-    // PROCESSING
-
-    pcl::ModelCoefficients::Ptr coefficients (new pcl::ModelCoefficients);
-    pcl::PointIndices::Ptr inliers (new pcl::PointIndices);
-    // Create the segmentation object
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
-    // Optional
-    seg.setOptimizeCoefficients (true);
-    // Mandatory
-    seg.setModelType (pcl::SACMODEL_PLANE);
-    seg.setMethodType (pcl::SAC_RANSAC);
-    seg.setDistanceThreshold (m_distThd);
+void PlaneRemover::removePCL()
+{
+  // CORBA -> PCL
+  // clouds are reused to avoid allocation
+  pcl::PointCloud<pcl::PointXYZ>::Ptr original = m_cloud;
+  toPCL(m_original, *original);
+
+  // PROCESSING
+
+  pcl::ModelCoefficients::Ptr coefficients (new pcl::ModelCoefficients);
+  pcl::PointIndices::Ptr inliers (new pcl::PointIndices);
+  // Create the segmentation object
+  pcl::SACSegmentation<pcl::PointXYZ> seg;
+  // Optional
+  seg.setOptimizeCoefficients (true);
+  // Mandatory
+  seg.setModelType (pcl::SACMODEL_PLANE);
+  seg.setMethodType (pcl::SAC_RANSAC);
+  seg.setDistanceThreshold (m_distThd);
   
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = original;
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_f(new pcl::PointCloud<pcl::PointXYZ>);
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = original;
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_f = m_cloudFiltered;
   
-    pcl::ExtractIndices<pcl::PointXYZ> extract;
+  pcl::ExtractIndices<pcl::PointXYZ> extract;
   
-    while(1){
-      seg.setInputCloud (cloud);
-      seg.segment (*inliers, *coefficients);
+  while(1){
+    seg.setInputCloud (cloud);
+    seg.segment (*inliers, *coefficients);
     
-      if (inliers->indices.size () < m_pointNumThd) break;
+    if (inliers->indices.size () < m_pointNumThd) break;
     
-      extract.setInputCloud( cloud );
-      extract.setIndices( inliers );
-      extract.setNegative( true );
-      extract.filter( *cloud_f );
-      cloud = cloud_f;
-    }
+    extract.setInputCloud( cloud );
+    extract.setIndices( inliers );
+    extract.setNegative( true );
+    extract.filter( *cloud_f );
+    cloud = cloud_f;
+  }
 
-    //std::cout << "PLaneRemover: original = " << original->points.size() << ", filtered = " << cloud->points.size() << ", thd=" << m_distThd << std::endl;
-
-    // PCL -> CORBA
-    m_filtered.width = cloud->points.size();
-    m_filtered.row_step = m_filtered.point_step*m_filtered.width;
-    m_filtered.data.length(m_filtered.height*m_filtered.row_step);
-    float *dst = (float *)m_filtered.data.get_buffer();
-    for (int i=0; i<cloud->points.size(); i++){
-      dst[0] = cloud->points[i].x;
-      dst[1] = cloud->points[i].y;
-      dst[2] = cloud->points[i].z;
-      dst += 4;
-    }
-    m_filteredOut.write();
+  //std::cout << "PLaneRemover: original = " << original->points.size() << ", filtered = " << cloud->points.size() << ", thd=" << m_distThd << std::endl;
+
+  // PCL -> CORBA
+  if (strcmp(m_filtered.type, "xyz") != 0) setupPointCloudFields(m_filtered);
+  wrapPCL(*cloud, m_filtered);
+}
+
+void PlaneRemover::removeNative(unsigned int i_npoint)
+{
+  bool colored = strcmp(m_original.type, "xyzrgb") == 0
+    && m_original.point_step >= 16;
+  if (strcmp(m_filtered.type, colored ? "xyzrgb" : "xyz") != 0){
+    setupPointCloudFields(m_filtered, colored);
   }
 
-  return RTC::RTC_OK;
+  m_extractor.setDistanceThreshold(m_distThd);
+  m_extractor.setMinInliers((unsigned int)m_pointNumThd);
+  m_extractor.setMaxIterations(m_maxIterations);
+  m_extractor.setUseLastPlanes(m_useLastPlanes);
+  m_extractor.setNumThreads(m_threads);
+  const unsigned char *src = m_original.data.get_buffer();
+  unsigned int n = m_extractor.extract(src, i_npoint, m_original.point_step);
+
+  // detach a buffer which was wrapped by wrapPCL(). The capacity is kept
+  // across frames
+  if (!m_filtered.data.release()) m_filtered.data.replace(0, 0, NULL, false);
+  m_filtered.width = n;
+  m_filtered.height = 1;
+  m_filtered.row_step = m_filtered.point_step*n;
+  m_filtered.data.length(m_filtered.row_step);
+  const unsigned int *indices = m_extractor.remaining();
+  float *dst = (float *)m_filtered.data.get_buffer();
+  for (unsigned int i=0; i<n; i++, dst+=4){
+    const float *p = (const float *)(src + (size_t)indices[i]*m_original.point_step);
+    dst[0] = p[0]; dst[1] = p[1]; dst[2] = p[2];
+    // rgb of xyzrgb or zero
+    dst[3] = colored ? p[3] : 0;
+  }
 }
 
 /*
@@ -16,7 +16,10 @@
 #include <rtm/DataInPort.h>
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
 #include "pointcloud.hh"
+#include "PlaneExtractor.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -133,9 +136,17 @@ class PlaneRemover
   // </rtc-template>
 
  private:
+  void removePCL();
+  void removeNative(unsigned int i_npoint);
+  pcl::PointCloud<pcl::PointXYZ>::Ptr m_cloud, m_cloudFiltered;
+  PlaneExtractor m_extractor;
   double m_distThd;
   double m_pointNumThd;
+  int m_usePCL, m_threads, m_maxIterations, m_useLastPlanes, m_debugLevel;
   int dummy;
+  // statistics for debugLevel
+  unsigned int m_nframes;
+  double m_elapsed, m_tReport;
 };
 
 
@@ -0,0 +1,245 @@
+/* -*- coding:utf-8-unix; mode:c++; -*- */
+
+#include "PlaneExtractor.h"
+/* samples */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <vector>
+#include <sys/time.h>
+
+class testPlaneExtractor
+{
+protected:
+    double thd; /* [m] */
+    unsigned int npoints, nclutter;
+    int nthreads, nloop;
+    std::vector<float> input;
+    // floor(z=0), wall(x=1.5) and table(z=0.7)
+    float truth[3][4];
+    unsigned int ninliers[3];
+    double uniform (double min, double max) { return min + (max-min)*rand()/(double)RAND_MAX; };
+    void gen_points (double floor = 0)
+    {
+        float planes[3][4] = {{0,0,1,-(float)floor}, {1,0,0,-1.5}, {0,0,1,-0.7}};
+        for (int i = 0; i < 3; i++) for (int j = 0; j < 4; j++) truth[i][j] = planes[i][j];
+        for (int i = 0; i < 3; i++) ninliers[i] = 0;
+        input.resize((npoints+nclutter)*4);
+        srand(0);
+        for (unsigned int i = 0; i < npoints; i++) {
+            float *p = &input[i*4];
+            double noise = uniform(-thd*0.25, thd*0.25);
+            int k;
+            if (i < npoints/2) {
+                p[0] = uniform(-1.5, 1.5); p[1] = uniform(-1.5, 1.5); p[2] = floor + noise; k = 0;
+            } else if (i < npoints*4/5) {
+                p[0] = 1.5 + noise; p[1] = uniform(-1.5, 1.5); p[2] = uniform(0.1, 1.5); k = 1;
+            } else {
+                p[0] = uniform(0, 0.5); p[1] = uniform(0, 0.5); p[2] = 0.7 + noise; k = 2;
+            }
+            p[3] = 0;
+            // the upper part of the wall is out of range of the sensor
+            if (k == 1 && p[2] > 1.4) p[2] = std::numeric_limits<float>::quiet_NaN();
+            else ninliers[k]++;
+        }
+        // clutter above the floor and away from the wall and the table
+        for (unsigned int i = npoints; i < npoints+nclutter; i++) {
+            float *p = &input[i*4];
+            p[0] = uniform(-1.0, 1.0); p[1] = uniform(-1.0, -0.2); p[2] = uniform(0.2, 0.6);
+            p[3] = 0;
+        }
+    };
+    bool find_planes (PlaneExtractor& extractor, unsigned int& o_nremaining)
+    {
+        struct timeval t1, t2;
+        gettimeofday(&t1, NULL);
+        for (int i = 0; i < nloop; i++) {
+            o_nremaining = extractor.extract((const unsigned char *)&input[0], input.size()/4, 16);
+        }
+        gettimeofday(&t2, NULL);
+        double dt = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec)/1e6;
+        const std::vector<PlaneExtractor::Plane>& planes = extractor.planes();
+        std::cerr << "[testPlaneExtractor]   " << input.size()/4 << " -> " << o_nremaining << " points, "
+                  << planes.size() << " planes, " << dt/nloop*1e3 << " [ms/frame]" << std::endl;
+        for (unsigned int i = 0; i < planes.size(); i++) {
+            const PlaneExtractor::Plane& pl = planes[i];
+            std::cerr << "[testPlaneExtractor]     " << pl.coef[0] << " " << pl.coef[1] << " " << pl.coef[2] << " " << pl.coef[3]
+                      << ", " << pl.inliers << " inliers, " << pl.hypotheses << " hypotheses, " << pl.time*1e3 << " [ms]" << std::endl;
+        }
+        if (planes.size() != 3) return false;
+        for (int j = 0; j < 3; j++) {
+            bool found = false;
+            for (unsigned int i = 0; i < planes.size(); i++) {
+                const float *c = planes[i].coef;
+                double s = c[0]*truth[j][0] + c[1]*truth[j][1] + c[2]*truth[j][2];
+                double d = s > 0 ? c[3] - truth[j][3] : -c[3] - truth[j][3];
+                if (fabs(s) > cos(1.0*M_PI/180) && fabs(d) < thd*0.25
+                    && planes[i].inliers == ninliers[j]) found = true;
+            }
+            if (!found) {
+                std::cerr << "[testPlaneExtractor]   plane " << j << " with " << ninliers[j] << " inliers is not found" << std::endl;
+                return false;
+            }
+        }
+        // all clutter points remain in order
+        const unsigned int *remaining = extractor.remaining();
+        if (o_nremaining != nclutter) {
+            std::cerr << "[testPlaneExtractor]   expected " << nclutter << " points" << std::endl;
+            return false;
+        }
+        for (unsigned int i = 0; i < o_nremaining; i++) {
+            if (remaining[i] != npoints+i) {
+                std::cerr << "[testPlaneExtractor]   unexpected point " << remaining[i] << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+public:
+    std::vector<std::string> arg_strs;
+    testPlaneExtractor () : thd(0.02), npoints(100000), nclutter(2000), nthreads(1), nloop(10) {};
+    bool test0 ()
+    {
+        std::cerr << "test0 : floor, wall and table" << std::endl;
+        parse_params();
+        gen_points();
+        PlaneExtractor extractor;
+        extractor.setDistanceThreshold(thd);
+        extractor.setMinInliers(500);
+        extractor.setNumThreads(nthreads);
+        unsigned int n;
+        return find_planes(extractor, n);
+    };
+    bool test1 ()
+    {
+        std::cerr << "test1 : threads" << std::endl;
+        parse_params();
+        gen_points();
+        PlaneExtractor extractor;
+        extractor.setDistanceThreshold(thd);
+        extractor.setMinInliers(500);
+        extractor.setSeed(1);
+        unsigned int n;
+        if (!find_planes(extractor, n)) return false;
+        std::vector<PlaneExtractor::Plane> planes1 = extractor.planes();
+        // hypotheses are sampled by the calling thread, so the same planes
+        // are found in the same order
+        for (int i = 2; i <= 4; i++) {
+            extractor.setNumThreads(i);
+            extractor.setSeed(1);
+            if (!find_planes(extractor, n)) return false;
+            const std::vector<PlaneExtractor::Plane>& planes2 = extractor.planes();
+            for (unsigned int j = 0; j < planes1.size(); j++) {
+                if (planes1[j].hypotheses != planes2[j].hypotheses
+                    || memcmp(planes1[j].coef, planes2[j].coef, sizeof(planes1[j].coef)) != 0) {
+                    std::cerr << "[testPlaneExtractor]   results differ with " << i << " threads" << std::endl;
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    bool test2 ()
+    {
+        std::cerr << "test2 : planes of the last frame" << std::endl;
+        parse_params();
+        gen_points();
+        PlaneExtractor extractor;
+        extractor.setDistanceThreshold(thd);
+        extractor.setMinInliers(500);
+        extractor.setUseLastPlanes(true);
+        unsigned int n;
+        if (!find_planes(extractor, n)) return false;
+        // planes of the last frame are good hypotheses
+        if (!find_planes(extractor, n)) return false;
+        unsigned int h = 0;
+        for (unsigned int i = 0; i < extractor.planes().size(); i++) h += extractor.planes()[i].hypotheses;
+        std::cerr << "[testPlaneExtractor]   " << h << " hypotheses with last planes" << std::endl;
+        if (h > 3*(16+3)) return false;
+        // the floor moved by more than the threshold is found again
+        gen_points(thd*2.5);
+        return find_planes(extractor, n);
+    };
+    bool test3 ()
+    {
+        std::cerr << "test3 : no plane" << std::endl;
+        parse_params();
+        PlaneExtractor extractor;
+        extractor.setDistanceThreshold(thd);
+        extractor.setMinInliers(500);
+        extractor.setNumThreads(nthreads);
+        // scattered points
+        input.resize(nclutter*4);
+        srand(0);
+        for (unsigned int i = 0; i < nclutter; i++) {
+            float *p = &input[i*4];
+            p[0] = uniform(0, 1); p[1] = uniform(0, 1); p[2] = uniform(0, 1); p[3] = 0;
+        }
+        input[2] = std::numeric_limits<float>::quiet_NaN();
+        unsigned int n = extractor.extract((const unsigned char *)&input[0], nclutter, 16);
+        if (!extractor.planes().empty() || n != nclutter-1 || extractor.remaining()[0] != 1) {
+            std::cerr << "[testPlaneExtractor]   " << extractor.planes().size() << " planes in scattered points" << std::endl;
+            return false;
+        }
+        // too few points to make a hypothesis
+        extractor.setMinInliers(0);
+        if (extractor.extract((const unsigned char *)&input[0], 3, 16) != 2 || !extractor.planes().empty()) return false;
+        return extractor.extract(NULL, 0, 16) == 0 && extractor.planes().empty();
+    };
+    void parse_params ()
+    {
+      for (unsigned int i = 0; i < arg_strs.size(); ++ i) {
+          if ( arg_strs[i]== "--thd" ) {
+              if (++i < arg_strs.size()) thd = atof(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--points" ) {
+              if (++i < arg_strs.size()) npoints = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--threads" ) {
+              if (++i < arg_strs.size()) nthreads = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--loop" ) {
+              if (++i < arg_strs.size()) nloop = atoi(arg_strs[i].c_str());
+          }
+      }
+      std::cerr << "[testPlaneExtractor] params" << std::endl;
+      std::cerr << "[testPlaneExtractor]   thd = " << thd << "[m], points = " << npoints << ", threads = " << nthreads << std::endl;
+    };
+};
+
+void print_usage ()
+{
+    std::cerr << "Usage : testPlaneExtractor [option]" << std::endl;
+    std::cerr << " [option] should be:" << std::endl;
+    std::cerr << "  --test0 : floor, wall and table" << std::endl;
+    std::cerr << "  --test1 : threads" << std::endl;
+    std::cerr << "  --test2 : planes of the last frame" << std::endl;
+    std::cerr << "  --test3 : no plane" << std::endl;
+};
+
+int main(int argc, char* argv[])
+{
+    int ret = 0;
+    if (argc >= 2) {
+        testPlaneExtractor tpe;
+        for (int i = 1; i < argc; ++ i) {
+            tpe.arg_strs.push_back(std::string(argv[i]));
+        }
+        if (std::string(argv[1]) == "--test0") {
+            if (!tpe.test0()) ret = 1;
+        } else if (std::string(argv[1]) == "--test1") {
+            if (!tpe.test1()) ret = 1;
+        } else if (std::string(argv[1]) == "--test2") {
+            if (!tpe.test2()) ret = 1;
+        } else if (std::string(argv[1]) == "--test3") {
+            if (!tpe.test3()) ret = 1;
+        } else {
+            print_usage();
+            ret = 1;
+        }
+    } else {
+        print_usage();
+        ret = 1;
+    }
+    return ret;
+}
@@ -0,0 +1,365 @@
+// -*- C++ -*-
+/*!
+ * @file  PreprocessImage.cpp
+ * @brief image preprocessing component
+ * $Date$
+ *
+ * $Id$
+ */
+
+#include <cmath>
+#include <sstream>
+#include "util/VectorConvert.h"
+#include "PreprocessImage.h"
+
+// Module specification
+// <rtc-template block="module_spec">
+static const char* preprocessimage_spec[] =
+  {
+    "implementation_id", "PreprocessImage",
+    "type_name",         "PreprocessImage",
+    "description",       "image preprocessing component",
+    "version",           HRPSYS_PACKAGE_VERSION,
+    "vendor",            "AIST",
+    "category",          "example",
+    "activity_type",     "DataFlowComponent",
+    "max_instance",      "10",
+    "language",          "C++",
+    "lang_type",         "compile",
+    // Configuration variables
+    "conf.default.roi", "0,0,0,0",
+    "conf.default.scale", "1.0",
+    "conf.default.gray", "0",
+
+    ""
+  };
+// </rtc-template>
+
+PreprocessImage::PreprocessImage(RTC::Manager* manager)
+  : RTC::DataFlowComponentBase(manager),
+    // <rtc-template block="initializer">
+    m_originalIn("original",  m_original),
+    m_preprocessedOut("preprocessed", m_preprocessed),
+    // </rtc-template>
+    m_scale(1.0), m_gray(0),
+    m_srcWidth(0), m_srcHeight(0), m_srcChannels(0), m_tableScale(0),
+    m_width(0), m_height(0),
+    dummy(0)
+{
+}
+
+PreprocessImage::~PreprocessImage()
+{
+}
+
+
+
+RTC::ReturnCode_t PreprocessImage::onInitialize()
+{
+  std::cout << m_profile.instance_name << ": onInitialize()" << std::endl;
+  // <rtc-template block="bind_config">
+  // Bind variables and configuration variable
+  bindParameter("roi", m_roi, "0,0,0,0");
+  bindParameter("scale", m_scale, "1.0");
+  bindParameter("gray", m_gray, "0");
+  
+  // </rtc-template>
+
+  // Registration: InPort/OutPort/Service
+  // <rtc-template block="registration">
+  // Set InPort buffers
+  addInPort("original", m_originalIn);
+
+  // Set OutPort buffer
+  addOutPort("preprocessed", m_preprocessedOut);
+  
+  // Set service provider to Ports
+  
+  // Set service consumers to Ports
+  
+  // Set CORBA Service Ports
+  
+  // </rtc-template>
+
+  RTC::Properties& prop = getProperties();
+
+  // each level of the pyramid is a half size of the previous one
+  int levels = 0;
+  coil::stringTo(levels, prop["pyramid_levels"].c_str());
+  if (levels < 0) levels = 0;
+  m_pyramid.resize(levels);
+  m_pyramidOut.resize(levels);
+  for (int i=0; i<levels; i++){
+    std::ostringstream os;
+    os << "pyramid" << i+1;
+    m_pyramidOut[i] = new OutPort<Img::TimedCameraImage>(os.str().c_str(),
+                                                         m_pyramid[i]);
+    registerOutPort(os.str().c_str(), *m_pyramidOut[i]);
+  }
+
+  return RTC::RTC_OK;
+}
+
+
+
+RTC::ReturnCode_t PreprocessImage::onFinalize()
+{
+  for (unsigned int i=0; i<m_pyramidOut.size(); i++){
+    delete m_pyramidOut[i];
+  }
+  m_pyramidOut.clear();
+  return RTC::RTC_OK;
+}
+
+/*
+RTC::ReturnCode_t PreprocessImage::onStartup(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t PreprocessImage::onShutdown(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+RTC::ReturnCode_t PreprocessImage::onActivated(RTC::UniqueId ec_id)
+{
+  std::cout << m_profile.instance_name<< ": onActivated(" << ec_id << ")" << std::endl;
+  return RTC::RTC_OK;
+}
+
+RTC::ReturnCode_t PreprocessImage::onDeactivated(RTC::UniqueId ec_id)
+{
+  std::cout << m_profile.instance_name<< ": onDeactivated(" << ec_id << ")" << std::endl;
+  return RTC::RTC_OK;
+}
+
+RTC::ReturnCode_t PreprocessImage::onExecute(RTC::UniqueId ec_id)
+{
+    //std::cout << m_profile.instance_name<< ": onExecute(" << ec_id << ")" << std::endl;
+  if (m_originalIn.isNew()){
+      m_originalIn.read();
+
+      Img::ImageData& idat = m_original.data.image;
+      if (!setup(idat)) return RTC::RTC_OK;
+
+      // pixels are written to the buffer of the output port directly,
+      // which is reallocated only when the image gets larger
+      Img::ImageData& odat = m_preprocessed.data.image;
+      int nchannels = (m_srcChannels == 1 || m_gray) ? 1 : 3;
+      odat.width = m_width;
+      odat.height = m_height;
+      odat.format = nchannels == 1 ? Img::CF_GRAY : Img::CF_RGB;
+      odat.raw_data.length(m_width*m_height*nchannels);
+      unsigned char *dst = odat.raw_data.get_buffer();
+      if (m_srcChannels == 1){
+        resizeRows<1, false>(idat, dst);
+      }else if (m_gray){
+        resizeRows<3, true>(idat, dst);
+      }else{
+        resizeRows<3, false>(idat, dst);
+      }
+      m_preprocessed.tm = m_original.tm;
+      m_preprocessed.data.captured_time = m_original.data.captured_time;
+      m_preprocessed.error_code = m_original.error_code;
+      m_preprocessedOut.write();
+
+      for (unsigned int i=0; i<m_pyramid.size(); i++){
+        const Img::TimedCameraImage& prev = i == 0 ? m_preprocessed : m_pyramid[i-1];
+        if (prev.data.image.width < 2 || prev.data.image.height < 2) break;
+        halve(prev.data.image, m_pyramid[i].data.image);
+        m_pyramid[i].tm = m_preprocessed.tm;
+        m_pyramid[i].data.captured_time = m_preprocessed.data.captured_time;
+        m_pyramid[i].error_code = m_preprocessed.error_code;
+        m_pyramidOut[i]->write();
+      }
+  }
+  return RTC::RTC_OK;
+}
+
+namespace {
+  enum { FRAC_BITS = 8, FRAC_ONE = 1 << FRAC_BITS };
+
+  // positions of source pixels along an axis as cvResize does with
+  // CV_INTER_LINEAR. Offsets are indices of pixels
+  void computeTable(int i_begin, int i_len, int i_dstLen, double i_scale,
+                    std::vector<int>& o_ofs,
+                    std::vector<unsigned short>& o_frac)
+  {
+    o_ofs.resize(i_dstLen*2);
+    o_frac.resize(i_dstLen);
+    for (int i=0; i<i_dstLen; i++){
+      double x = (i + 0.5)/i_scale - 0.5;
+      int f = (int)floor(x*FRAC_ONE + 0.5);
+      int x0 = f >> FRAC_BITS;
+      f &= FRAC_ONE-1;
+      if (x0 < 0){
+        x0 = 0; f = 0;
+      }
+      if (x0 >= i_len-1){
+        x0 = i_len-1; f = 0;
+      }
+      o_ofs[i*2] = i_begin + x0;
+      o_ofs[i*2+1] = i_begin + (x0 < i_len-1 ? x0+1 : x0);
+      o_frac[i] = f;
+    }
+  }
+};
+
+bool PreprocessImage::setup(const Img::ImageData& i_src)
+{
+  int channels = i_src.format == Img::CF_GRAY ? 1 : 3;
+  if (i_src.format != Img::CF_GRAY && i_src.format != Img::CF_RGB){
+    return false;
+  }
+  if (i_src.raw_data.length() < (CORBA::ULong)(i_src.width*i_src.height*channels)){
+    return false;
+  }
+  if (i_src.width == m_srcWidth && i_src.height == m_srcHeight
+      && channels == m_srcChannels && m_roi == m_tableRoi
+      && m_scale == m_tableScale){
+    return m_width > 0;
+  }
+
+  m_srcWidth = i_src.width;
+  m_srcHeight = i_src.height;
+  m_srcChannels = channels;
+  m_tableRoi = m_roi;
+  m_tableScale = m_scale;
+  m_width = m_height = 0;
+
+  int x = 0, y = 0, w = 0, h = 0;
+  if (m_roi.size() == 4){
+    x = m_roi[0]; y = m_roi[1]; w = m_roi[2]; h = m_roi[3];
+  }else if (!m_roi.empty()){
+    std::cerr << m_profile.instance_name
+              << ": roi must be x, y, width and height" << std::endl;
+    return false;
+  }
+  if (w == 0) w = i_src.width - x;
+  if (h == 0) h = i_src.height - y;
+  if (x < 0 || y < 0 || w <= 0 || h <= 0
+      || x + w > i_src.width || y + h > i_src.height || m_scale <= 0){
+    std::cerr << m_profile.instance_name << ": invalid roi or scale"
+              << std::endl;
+    return false;
+  }
+  int dw = (int)(w*m_scale), dh = (int)(h*m_scale);
+  if (dw <= 0 || dh <= 0) return false;
+
+  computeTable(x, w, dw, m_scale, m_xofs, m_xfrac);
+  computeTable(y, h, dh, m_scale, m_yofs, m_yfrac);
+  for (unsigned int i=0; i<m_xofs.size(); i++) m_xofs[i] *= channels;
+  for (unsigned int i=0; i<m_yofs.size(); i++) m_yofs[i] *= i_src.width*channels;
+  m_width = dw;
+  m_height = dh;
+  return true;
+}
+
+template <int N, bool GRAY>
+void PreprocessImage::resizeRows(const Img::ImageData& i_src,
+                                 unsigned char *o_dst)
+{
+  const unsigned char *src = i_src.raw_data.get_buffer();
+  for (int y=0; y<m_height; y++){
+    const unsigned char *r0 = src + m_yofs[y*2], *r1 = src + m_yofs[y*2+1];
+    unsigned int fy = m_yfrac[y];
+    for (int x=0; x<m_width; x++){
+      int a = m_xofs[x*2], b = m_xofs[x*2+1];
+      unsigned int fx = m_xfrac[x];
+      // weights of 4 neighbors, whose sum is FRAC_ONE*FRAC_ONE
+      unsigned int w11 = fx*fy;
+      unsigned int w10 = (fx << FRAC_BITS) - w11;
+      unsigned int w01 = (fy << FRAC_BITS) - w11;
+      unsigned int w00 = FRAC_ONE*FRAC_ONE - w10 - w01 - w11;
+      unsigned int v[N];
+      for (int c=0; c<N; c++){
+        v[c] = r0[a+c]*w00 + r0[b+c]*w10 + r1[a+c]*w01 + r1[b+c]*w11;
+      }
+      if (GRAY){
+        // Y = 0.299R + 0.587G + 0.114B with 8 bit coefficients
+        *o_dst++ = (v[0]*77 + v[1]*150 + v[2]*29 + (1 << (3*FRAC_BITS-1)))
+          >> (3*FRAC_BITS);
+      }else{
+        for (int c=0; c<N; c++){
+          *o_dst++ = (v[c] + (1 << (2*FRAC_BITS-1))) >> (2*FRAC_BITS);
+        }
+      }
+    }
+  }
+}
+
+void PreprocessImage::halve(const Img::ImageData& i_src, Img::ImageData& o_dst)
+{
+  int n = i_src.format == Img::CF_GRAY ? 1 : 3;
+  int w = i_src.width/2, h = i_src.height/2, step = i_src.width*n;
+  o_dst.width = w;
+  o_dst.height = h;
+  o_dst.format = i_src.format;
+  o_dst.raw_data.length(w*h*n);
+  const unsigned char *src = i_src.raw_data.get_buffer();
+  unsigned char *dst = o_dst.raw_data.get_buffer();
+  for (int y=0; y<h; y++){
+    const unsigned char *r0 = src + y*2*step, *r1 = r0 + step;
+    for (int x=0; x<w; x++, r0+=n, r1+=n){
+      for (int c=0; c<n; c++, r0++, r1++){
+        *dst++ = (r0[0] + r0[n] + r1[0] + r1[n] + 2) >> 2;
+      }
+    }
+  }
+}
+
+/*
+RTC::ReturnCode_t PreprocessImage::onAborting(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t PreprocessImage::onError(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t PreprocessImage::onReset(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t PreprocessImage::onStateUpdate(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t PreprocessImage::onRateChanged(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+
+extern "C"
+{
+
+  void PreprocessImageInit(RTC::Manager* manager)
+  {
+    RTC::Properties profile(preprocessimage_spec);
+    manager->registerFactory(profile,
+                             RTC::Create<PreprocessImage>,
+                             RTC::Delete<PreprocessImage>);
+  }
+
+};
+
+
@@ -0,0 +1,173 @@
+// -*- C++ -*-
+/*!
+ * @file  PreprocessImage.h
+ * @brief image preprocessing component
+ * @date  $Date$
+ *
+ * $Id$
+ */
+
+#ifndef PREPROCESS_IMAGE_H
+#define PREPROCESS_IMAGE_H
+
+#include <rtm/Manager.h>
+#include <rtm/DataFlowComponentBase.h>
+#include <rtm/CorbaPort.h>
+#include <rtm/DataInPort.h>
+#include <rtm/DataOutPort.h>
+#include <rtm/idl/BasicDataTypeSkel.h>
+#include <vector>
+#include "Img.hh"
+
+// Service implementation headers
+// <rtc-template block="service_impl_h">
+
+// </rtc-template>
+
+// Service Consumer stub headers
+// <rtc-template block="consumer_stub_h">
+
+// </rtc-template>
+
+using namespace RTC;
+
+/**
+   \brief RT component which crops, resizes and converts an input image to
+   grayscale in one pass, and optionally outputs an image pyramid
+ */
+class PreprocessImage
+  : public RTC::DataFlowComponentBase
+{
+ public:
+  /**
+     \brief Constructor
+     \param manager pointer to the Manager
+  */
+  PreprocessImage(RTC::Manager* manager);
+  /**
+     \brief Destructor
+  */
+  virtual ~PreprocessImage();
+
+  // The initialize action (on CREATED->ALIVE transition)
+  // formaer rtc_init_entry()
+  virtual RTC::ReturnCode_t onInitialize();
+
+  // The finalize action (on ALIVE->END transition)
+  // formaer rtc_exiting_entry()
+  virtual RTC::ReturnCode_t onFinalize();
+
+  // The startup action when ExecutionContext startup
+  // former rtc_starting_entry()
+  // virtual RTC::ReturnCode_t onStartup(RTC::UniqueId ec_id);
+
+  // The shutdown action when ExecutionContext stop
+  // former rtc_stopping_entry()
+  // virtual RTC::ReturnCode_t onShutdown(RTC::UniqueId ec_id);
+
+  // The activated action (Active state entry action)
+  // former rtc_active_entry()
+  virtual RTC::ReturnCode_t onActivated(RTC::UniqueId ec_id);
+
+  // The deactivated action (Active state exit action)
+  // former rtc_active_exit()
+  virtual RTC::ReturnCode_t onDeactivated(RTC::UniqueId ec_id);
+
+  // The execution action that is invoked periodically
+  // former rtc_active_do()
+  virtual RTC::ReturnCode_t onExecute(RTC::UniqueId ec_id);
+
+  // The aborting action when main logic error occurred.
+  // former rtc_aborting_entry()
+  // virtual RTC::ReturnCode_t onAborting(RTC::UniqueId ec_id);
+
+  // The error action in ERROR state
+  // former rtc_error_do()
+  // virtual RTC::ReturnCode_t onError(RTC::UniqueId ec_id);
+
+  // The reset action that is invoked resetting
+  // This is same but different the former rtc_init_entry()
+  // virtual RTC::ReturnCode_t onReset(RTC::UniqueId ec_id);
+
+  // The state update action that is invoked after onExecute() action
+  // no corresponding operation exists in OpenRTm-aist-0.2.0
+  // virtual RTC::ReturnCode_t onStateUpdate(RTC::UniqueId ec_id);
+
+  // The action that is invoked when execution context's rate is changed
+  // no corresponding operation exists in OpenRTm-aist-0.2.0
+  // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
+
+
+ protected:
+  // Configuration variable declaration
+  // <rtc-template block="config_declare">
+  
+  // </rtc-template>
+
+  Img::TimedCameraImage m_original;
+
+  // DataInPort declaration
+  // <rtc-template block="inport_declare">
+  InPort<Img::TimedCameraImage> m_originalIn;
+  
+  // </rtc-template>
+
+  Img::TimedCameraImage m_preprocessed;
+  std::vector<Img::TimedCameraImage> m_pyramid;
+
+  // DataOutPort declaration
+  // <rtc-template block="outport_declare">
+  OutPort<Img::TimedCameraImage> m_preprocessedOut;
+  std::vector<OutPort<Img::TimedCameraImage> *> m_pyramidOut;
+  
+  // </rtc-template>
+
+  // CORBA Port declaration
+  // <rtc-template block="corbaport_declare">
+  
+  // </rtc-template>
+
+  // Service declaration
+  // <rtc-template block="service_declare">
+  
+  // </rtc-template>
+
+  // Consumer declaration
+  // <rtc-template block="consumer_declare">
+  
+  // </rtc-template>
+
+ private:
+  /**
+     \brief compute positions of source pixels of the output image
+     \return false if the region of interest is out of the input image
+   */
+  bool setup(const Img::ImageData& i_src);
+  template <int N, bool GRAY>
+  void resizeRows(const Img::ImageData& i_src, unsigned char *o_dst);
+  void halve(const Img::ImageData& i_src, Img::ImageData& o_dst);
+
+  // region of interest(x, y, width, height). width and height of 0 mean
+  // the whole image
+  std::vector<int> m_roi;
+  double m_scale;
+  int m_gray;
+  // parameters with which the tables are computed
+  int m_srcWidth, m_srcHeight, m_srcChannels;
+  std::vector<int> m_tableRoi;
+  double m_tableScale;
+  int m_width, m_height;
+  // offsets of two neighboring source pixels and 8 bit fraction of the
+  // position for each column and row of the output image
+  std::vector<int> m_xofs, m_yofs;
+  std::vector<unsigned short> m_xfrac, m_yfrac;
+  int dummy;
+};
+
+
+extern "C"
+{
+  void PreprocessImageInit(RTC::Manager* manager);
+};
+
+#endif // PREPROCESS_IMAGE_H
@@ -8,6 +8,7 @@
  */
 
 #include <math.h>
+#include <algorithm>
 #include <hrpUtil/Eigen3d.h>
 #include "Range2PointCloud.h"
 
@@ -135,43 +136,40 @@ RTC::ReturnCode_t Range2PointCloud::onExecute(RTC::UniqueId ec_id)
     //std::cout << m_profile.instance_name<< ": onExecute(" << ec_id << ")" << std::endl;
   if (!m_rangeIn.isNew()) return RTC::RTC_OK;
 
-  m_cloud.width = 0;
-  int npoint=0;
+  unsigned int npoint=0;
   int nlines=0;
   while (m_rangeIn.isNew()){
     nlines++;
     m_rangeIn.read();
-    m_cloud.width += m_range.ranges.length();
-    m_cloud.row_step = m_cloud.point_step*m_cloud.width;
-    m_cloud.data.length(m_cloud.row_step);// shrinked later
+    unsigned int n = m_range.ranges.length();
+    // the capacity grows by doubling and is kept across executions, so
+    // the buffer is reallocated only when more scans than ever are queued
+    unsigned int len = (npoint+n)*m_cloud.point_step;
+    if (m_cloud.data.length() < len){
+      if (len > m_cloud.data.maximum()){
+        len = std::max(len, (unsigned int)m_cloud.data.maximum()*2);
+      }
+      m_cloud.data.length(len); // shrinked later
+    }
     // range -> point cloud
+    m_projector.setup(m_range.config.minAngle, m_range.config.angularRes, n);
     float *ptr = (float *)m_cloud.data.get_buffer() + npoint*4;
     Pose3D &pose = m_range.geometry.geometry.pose;
-    hrp::Vector3 relP, absP, sensorP(pose.position.x,
-				     pose.position.y,
-				     pose.position.z);
+    hrp::Vector3 sensorP(pose.position.x,
+                         pose.position.y,
+                         pose.position.z);
     hrp::Matrix33 sensorR = hrp::rotFromRpy(pose.orientation.r,
 					    pose.orientation.p,
 					    pose.orientation.y);
-    for (unsigned int i=0; i<m_range.ranges.length(); i++){
-      double th = m_range.config.minAngle + i*m_range.config.angularRes;
-      double d = m_range.ranges[i];
-      if (d==0) continue;
-      relP << -d*sin(th), 0, -d*cos(th);
-      absP = sensorP + sensorR*relP;
-      ptr[0] = absP[0];
-      ptr[1] = absP[1];
-      ptr[2] = absP[2];
-      //std::cout << "(" << i << "," << ptr[2] << "," << d << ")" << std::endl;
-      ptr+=4;
-      npoint++;
-    }
+    npoint += m_projector.project(m_range.ranges.get_buffer(),
+                                  sensorP, sensorR, ptr);
   }
 #if 0
   std::cout << "Range2PointCloud: processed " << nlines << " lines, " 
 	    << npoint << " points" << std::endl;
 #endif
   m_cloud.width = npoint;
+  m_cloud.row_step = m_cloud.point_step*m_cloud.width;
   m_cloud.data.length(npoint*m_cloud.point_step);
   m_cloudOut.write();
 
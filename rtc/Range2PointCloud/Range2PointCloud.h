@@ -18,6 +18,7 @@
 #include <rtm/idl/BasicDataTypeSkel.h>
 #include <rtm/idl/InterfaceDataTypes.hh>
 #include "pointcloud.hh"
+#include "util/RangeProjector.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -134,6 +135,7 @@ class Range2PointCloud
   // </rtc-template>
 
  private:
+  RangeProjector m_projector;
   int dummy;
 };
 
@@ -29,6 +29,7 @@ static const char* removeforcesensorlinkoffset_spec[] =
     "lang_type",         "compile",
     // Configuration variables
     "conf.default.debugLevel", "0",
+    "conf.default.useKinematicsCache", "0",
     ""
   };
 // </rtc-template>
@@ -40,7 +41,9 @@ RemoveForceSensorLinkOffset::RemoveForceSensorLinkOffset(RTC::Manager* manager)
     m_rpyIn("rpy", m_rpy),
     m_RemoveForceSensorLinkOffsetServicePort("RemoveForceSensorLinkOffsetService"),
     // </rtc-template>
-    m_debugLevel(0)
+    m_debugLevel(0),
+    m_useKinematicsCache(false),
+    m_kinematicsCache(NULL)
 {
   m_service0.rmfsoff(this);
 }
@@ -57,6 +60,7 @@ RTC::ReturnCode_t RemoveForceSensorLinkOffset::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("debugLevel", m_debugLevel, "0");
+  bindParameter("useKinematicsCache", m_useKinematicsCache, "0");
   
   // </rtc-template>
 
@@ -97,6 +101,7 @@ RTC::ReturnCode_t RemoveForceSensorLinkOffset::onInitialize()
       std::cerr << "[" << m_profile.instance_name << "] failed to load model[" << prop["model"] << "]" << std::endl;
       return RTC::RTC_ERROR;
   }
+  m_kinematicsCacheKey = prop["model"];
 
   int nforce = m_robot->numSensors(hrp::Sensor::FORCE);
   m_force.resize(nforce);
@@ -138,6 +143,10 @@ RTC::ReturnCode_t RemoveForceSensorLinkOffset::onShutdown(RTC::UniqueId ec_id)
 RTC::ReturnCode_t RemoveForceSensorLinkOffset::onActivated(RTC::UniqueId ec_id)
 {
   std::cerr << "[" << m_profile.instance_name<< "] onActivated(" << ec_id << ")" << std::endl;
+  // a copy of the body is registered only when the cache is enabled
+  if (m_useKinematicsCache && !m_kinematicsCache && !m_kinematicsCacheKey.empty()){
+    m_kinematicsCache = KinematicsCache::attach(m_kinematicsCacheKey, m_robot);
+  }
   return RTC::RTC_OK;
 }
 
@@ -172,7 +181,11 @@ RTC::ReturnCode_t RemoveForceSensorLinkOffset::onExecute(RTC::UniqueId ec_id)
     }
     //
     updateRootLinkPosRot(rpy);
-    m_robot->calcForwardKinematics();
+    if (m_useKinematicsCache && m_kinematicsCache){
+      m_kinematicsCache->calcForwardKinematics(m_robot);
+    }else{
+      m_robot->calcForwardKinematics();
+    }
     for (unsigned int i=0; i<m_forceIn.size(); i++){
       if ( m_force[i].data.length()==6 ) {
         std::string sensor_name = m_forceIn[i]->name();
@@ -21,6 +21,7 @@
 #include <hrpModel/Link.h>
 #include <hrpModel/JointPath.h>
 #include <hrpUtil/EigenTypes.h>
+#include "util/KinematicsCache.h"
 
 #include "RemoveForceSensorLinkOffsetService_impl.h"
 #include "../ImpedanceController/RatsMatrix.h"
@@ -171,6 +172,9 @@ class RemoveForceSensorLinkOffset
   double m_dt;
   hrp::BodyPtr m_robot;
   unsigned int m_debugLevel;
+  bool m_useKinematicsCache;
+  KinematicsCache *m_kinematicsCache;
+  std::string m_kinematicsCacheKey;
 };
 
 
@@ -37,6 +37,9 @@ static const char* robothardware_spec[] =
     "conf.default.fzLimitRatio", "2.0",
     "conf.default.servoErrorLimit", ",",
     "conf.default.jointAccelerationLimit", "0",
+    "conf.default.telemetry", "",
+    "conf.default.telemetryMulticast", "",
+    "conf.default.telemetryInterval", "1",
 
     ""
   };
@@ -46,6 +49,7 @@ RobotHardware::RobotHardware(RTC::Manager* manager)
   : RTC::DataFlowComponentBase(manager),
     // <rtc-template block="initializer">
     m_isDemoMode(0),
+    m_telemetryInterval(1),
     m_qRefIn("qRef", m_qRef),
     m_dqRefIn("dqRef", m_dqRef),
     m_tauRefIn("tauRef", m_tauRef),
@@ -57,7 +61,9 @@ RobotHardware::RobotHardware(RTC::Manager* manager)
     m_emergencySignalOut("emergencySignal", m_emergencySignal),
     m_RobotHardwareServicePort("RobotHardwareService"),
     // </rtc-template>
-	dummy(0)
+	dummy(0),
+    m_telemetryChanged(true),
+    m_telemetryCount(0)
 {
 }
 
@@ -168,12 +174,20 @@ RTC::ReturnCode_t RobotHardware::onInitialize()
       registerOutPort(s->name.c_str(), *m_forceOut[i]);
   }
 
+  setupTelemetry();
+
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("isDemoMode", m_isDemoMode, "0");  
   bindParameter("servoErrorLimit", m_robot->m_servoErrorLimit, ",");
   bindParameter("fzLimitRatio", m_robot->m_fzLimitRatio, "2");
   bindParameter("jointAccelerationLimit", m_robot->m_accLimit, "0");
+  bindParameter("telemetry", m_telemetry, "");
+  bindParameter("telemetryMulticast", m_telemetryMulticast, "");
+  bindParameter("telemetryInterval", m_telemetryInterval, "1");
+  // the stream is reopened only when the configuration is updated
+  addConfigurationSetNameListener(ON_UPDATE_CONFIG_SET,
+                                  new ConfigUpdateFlag(m_telemetryChanged));
 
   // </rtc-template>
 
@@ -333,9 +347,70 @@ RTC::ReturnCode_t RobotHardware::onExecute(RTC::UniqueId ec_id)
       m_forceOut[i]->write();
   }
 
+  publishTelemetry(tm);
+
   return RTC::RTC_OK;
 }
 
+void RobotHardware::setupTelemetry()
+{
+  // the same fields as RobotHardwareService::RobotState
+  int n = m_robot->numJoints();
+  m_tlmAngle = m_telemetryPublisher.addField("angle", TELEMETRY_DOUBLE, n);
+  m_tlmCommand = m_telemetryPublisher.addField("command", TELEMETRY_DOUBLE, n);
+  m_tlmTorque = m_telemetryPublisher.addField("torque", TELEMETRY_DOUBLE, n);
+  // extra servo states are not included
+  m_tlmServoState = m_telemetryPublisher.addField("servoState", TELEMETRY_INT32, n);
+  m_tlmRateGyro = m_telemetryPublisher.addField("rateGyro", TELEMETRY_DOUBLE,
+                                                 m_rate.size()*3);
+  m_tlmAccel = m_telemetryPublisher.addField("accel", TELEMETRY_DOUBLE,
+                                              m_acc.size()*3);
+  m_tlmForce = m_telemetryPublisher.addField("force", TELEMETRY_DOUBLE,
+                                              m_force.size()*6);
+  // voltage and current
+  m_tlmPower = m_telemetryPublisher.addField("power", TELEMETRY_DOUBLE, 2);
+}
+
+void RobotHardware::publishTelemetry(const Time& tm)
+{
+  if (m_telemetryChanged){
+    m_telemetryChanged = false;
+    m_telemetryPublisher.configure(m_telemetry, m_telemetryMulticast);
+  }
+  if (!m_telemetryPublisher.ready()
+      || m_telemetryInterval <= 0
+      || (m_telemetryCount++)%m_telemetryInterval) return;
+
+  int n = m_robot->numJoints();
+  memcpy(m_telemetryPublisher.doubles(m_tlmAngle), m_q.data.get_buffer(),
+         sizeof(double)*n);
+  m_robot->readJointCommands(m_telemetryPublisher.doubles(m_tlmCommand));
+  memcpy(m_telemetryPublisher.doubles(m_tlmTorque), m_tau.data.get_buffer(),
+         sizeof(double)*n);
+  int32_t *servoState = m_telemetryPublisher.ints(m_tlmServoState);
+  for (int i=0; i<n; i++) servoState[i] = m_servoState.data[i][0];
+  double *rate = m_telemetryPublisher.doubles(m_tlmRateGyro);
+  for (unsigned int i=0; i<m_rate.size(); i++){
+      rate[i*3  ] = m_rate[i].data.avx;
+      rate[i*3+1] = m_rate[i].data.avy;
+      rate[i*3+2] = m_rate[i].data.avz;
+  }
+  double *acc = m_telemetryPublisher.doubles(m_tlmAccel);
+  for (unsigned int i=0; i<m_acc.size(); i++){
+      acc[i*3  ] = m_acc[i].data.ax;
+      acc[i*3+1] = m_acc[i].data.ay;
+      acc[i*3+2] = m_acc[i].data.az;
+  }
+  double *force = m_telemetryPublisher.doubles(m_tlmForce);
+  for (unsigned int i=0; i<m_force.size(); i++){
+      memcpy(force+i*6, m_force[i].data.get_buffer(), sizeof(double)*6);
+  }
+  double *power = m_telemetryPublisher.doubles(m_tlmPower);
+  m_robot->readPowerStatus(power[0], power[1]);
+
+  m_telemetryPublisher.publish(tm.sec + tm.nsec*1e-9);
+}
+
 /*
 RTC::ReturnCode_t RobotHardware::onAborting(RTC::UniqueId ec_id)
 {
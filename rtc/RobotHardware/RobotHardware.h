@@ -20,6 +20,8 @@
 #include "HRPDataTypes.hh"
 
 #include <hrpModel/Body.h>
+#include "util/Telemetry.h"
+#include "util/ConfigUpdateFlag.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -106,6 +108,8 @@ class RobotHardware
   // Configuration variable declaration
   // <rtc-template block="config_declare">
   int m_isDemoMode;  
+  std::string m_telemetry, m_telemetryMulticast;
+  int m_telemetryInterval;
   
   // </rtc-template>
 
@@ -194,8 +198,16 @@ class RobotHardware
   // </rtc-template>
 
  private:
+  void setupTelemetry();
+  void publishTelemetry(const Time& tm);
+
   int dummy;
   boost::shared_ptr<robot> m_robot;
+  TelemetryPublisher m_telemetryPublisher;
+  bool m_telemetryChanged;
+  unsigned long m_telemetryCount;
+  int m_tlmAngle, m_tlmCommand, m_tlmTorque, m_tlmServoState;
+  int m_tlmRateGyro, m_tlmAccel, m_tlmForce, m_tlmPower;
 };
 
 
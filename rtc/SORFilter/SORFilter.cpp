@@ -12,6 +12,7 @@
 #include <pcl/filters/statistical_outlier_removal.h>
 #include "SORFilter.h"
 #include "pointcloud.hh"
+#include "util/PCLUtil.h"
 
 // Module specification
 // <rtc-template block="module_spec">
@@ -41,6 +42,8 @@ SORFilter::SORFilter(RTC::Manager* manager)
     m_originalIn("original", m_original),
     m_filteredOut("filtered", m_filtered),
     // </rtc-template>
+    m_cloud(new pcl::PointCloud<pcl::PointXYZ>),
+    m_cloudFiltered(new pcl::PointCloud<pcl::PointXYZ>),
     dummy(0)
 {
 }
@@ -80,23 +83,7 @@ RTC::ReturnCode_t SORFilter::onInitialize()
   RTC::Properties& prop = getProperties();
 
   m_filtered.height = 1;
-  m_filtered.type = "xyz";
-  m_filtered.fields.length(3);
-  m_filtered.fields[0].name = "x";
-  m_filtered.fields[0].offset = 0;
-  m_filtered.fields[0].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[0].count = 4;
-  m_filtered.fields[1].name = "y";
-  m_filtered.fields[1].offset = 4;
-  m_filtered.fields[1].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[1].count = 4;
-  m_filtered.fields[2].name = "z";
-  m_filtered.fields[2].offset = 8;
-  m_filtered.fields[2].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[2].count = 4;
-  m_filtered.is_bigendian = false;
-  m_filtered.point_step = 16;
-  m_filtered.is_dense = true;
+  setupPointCloudFields(m_filtered);
 
   return RTC::RTC_OK;
 }
@@ -143,17 +130,11 @@ RTC::ReturnCode_t SORFilter::onExecute(RTC::UniqueId ec_id)
   if (m_originalIn.isNew()){
     m_originalIn.read();
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-
-    cloud->points.resize(m_original.width*m_original.height);
-    float *src = (float *)m_original.data.get_buffer();
-    for (int i=0; i<cloud->points.size(); i++){
-      cloud->points[i].x = src[0];
-      cloud->points[i].y = src[1];
-      cloud->points[i].z = src[2];
-      src += 4;
-    }
+    // clouds are reused to avoid allocation
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = m_cloud;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered = m_cloudFiltered;
+
+    toPCL(m_original, *cloud);
     
     pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
     sor.setInputCloud (cloud);
@@ -161,16 +142,7 @@ RTC::ReturnCode_t SORFilter::onExecute(RTC::UniqueId ec_id)
     sor.setStddevMulThresh (m_stddevMulThresh);
     sor.filter (*cloud_filtered);
 
-    m_filtered.width = cloud_filtered->points.size();
-    m_filtered.row_step = m_filtered.point_step*m_filtered.width;
-    m_filtered.data.length(m_filtered.height*m_filtered.row_step);
-    float *dst = (float *)m_filtered.data.get_buffer();
-    for (int i=0; i<cloud_filtered->points.size(); i++){
-      dst[0] = cloud_filtered->points[i].x;
-      dst[1] = cloud_filtered->points[i].y;
-      dst[2] = cloud_filtered->points[i].z;
-      dst += 4;
-    }
+    wrapPCL(*cloud_filtered, m_filtered);
     m_filteredOut.write();
   }
 
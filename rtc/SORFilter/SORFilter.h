@@ -16,6 +16,8 @@
 #include <rtm/DataInPort.h>
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
 #include "pointcloud.hh"
 
 // Service implementation headers
@@ -133,6 +135,7 @@ class SORFilter
   // </rtc-template>
 
  private:
+  pcl::PointCloud<pcl::PointXYZ>::Ptr m_cloud, m_cloudFiltered;
   int dummy;
   int m_meanK;
   double m_stddevMulThresh;
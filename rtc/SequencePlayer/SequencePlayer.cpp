@@ -161,6 +161,13 @@ RTC::ReturnCode_t SequencePlayer::onInitialize()
     }
 
     m_seq = new seqplay(dof, dt, nforce, optional_data_dim);
+    if (prop.hasKey("seq_spline_buffer_length")) {
+      unsigned int len = 0;
+      coil::stringTo(len, prop["seq_spline_buffer_length"].c_str());
+      if (!m_seq->setSplineBufferLength(len)) {
+        std::cerr << "[" << m_profile.instance_name << "] invalid seq_spline_buffer_length " << prop["seq_spline_buffer_length"] << std::endl;
+      }
+    }
 
     m_qInit.data.length(dof);
     for (unsigned int i=0; i<dof; i++) m_qInit.data[i] = 0.0;
@@ -507,6 +514,138 @@ bool SequencePlayer::setJointAnglesSequenceFull(const OpenHRP::dSequenceSequence
     return m_seq->setJointAnglesSequenceFull(v_jvss, v_vels, v_torques, v_poss, v_rpys, v_accs, v_zmps, v_wrenches, v_optionals, v_tms);
 }
 
+bool SequencePlayer::previewJointAnglesSequenceFull(const OpenHRP::dSequenceSequence& i_jvss, const OpenHRP::dSequenceSequence& i_vels, const OpenHRP::dSequenceSequence& i_torques, const OpenHRP::dSequenceSequence& i_poss, const OpenHRP::dSequenceSequence& i_rpys, const OpenHRP::dSequenceSequence& i_accs, const OpenHRP::dSequenceSequence& i_zmps, const OpenHRP::dSequenceSequence& i_wrenches, const OpenHRP::dSequenceSequence& i_optionals, const dSequence& i_tms, double i_period, OpenHRP::SequencePlayerService::TrajectoryPreview& o_preview)
+{
+    if ( m_debugLevel > 0 ) {
+        std::cerr << __PRETTY_FUNCTION__ << std::endl;
+    }
+    int dof = m_robot->numJoints();
+    // the sequence is evaluated by another player, which starts from the
+    // current state of m_seq
+    seqplay preview(dof, dt, m_wrenches.size(), optional_data_dim);
+    {
+        Guard guard(m_mutex);
+        preview.copyState(*m_seq);
+        if (m_seq->isEmpty()){
+            if (m_qInit.data.length() == 0){
+                std::cerr << "can't determine initial posture" << std::endl;
+                return false;
+            }
+            setInitialValues(&preview, 0);
+        }
+    }
+
+    std::vector<const double*> v_jvss, v_vels, v_torques, v_poss, v_rpys, v_accs, v_zmps, v_wrenches, v_optionals;
+    std::vector<double> v_tms;
+    double total = 0;
+    for ( int i = 0; i < i_jvss.length(); i++ ) v_jvss.push_back(i_jvss[i].get_buffer());
+    for ( int i = 0; i < i_vels.length(); i++ ) v_vels.push_back(i_vels[i].get_buffer());
+    for ( int i = 0; i < i_torques.length(); i++ ) v_torques.push_back(i_torques[i].get_buffer());
+    for ( int i = 0; i < i_poss.length(); i++ ) v_poss.push_back(i_poss[i].get_buffer());
+    for ( int i = 0; i < i_rpys.length(); i++ ) v_rpys.push_back(i_rpys[i].get_buffer());
+    for ( int i = 0; i < i_accs.length(); i++ ) v_accs.push_back(i_accs[i].get_buffer());
+    for ( int i = 0; i < i_zmps.length(); i++ ) v_zmps.push_back(i_zmps[i].get_buffer());
+    for ( int i = 0; i < i_wrenches.length(); i++ ) v_wrenches.push_back(i_wrenches[i].get_buffer());
+    for ( int i = 0; i < i_optionals.length(); i++ ) v_optionals.push_back(i_optionals[i].get_buffer());
+    for ( int i = 0; i < i_tms.length();  i++ ) {
+        v_tms.push_back(i_tms[i]);
+        total += i_tms[i];
+    }
+    if (!preview.setJointAnglesSequenceFull(v_jvss, v_vels, v_torques, v_poss, v_rpys, v_accs, v_zmps, v_wrenches, v_optionals, v_tms)) return false;
+
+    // values are sampled every step control periods
+    unsigned int step = i_period > dt ? (unsigned int)(i_period/dt + 0.5) : 1;
+    unsigned int len = (unsigned int)(total/dt)/step + 2;
+    o_preview.dt = dt*step;
+    o_preview.q.length(len);
+    o_preview.dq.length(len);
+    o_preview.ddq.length(len);
+    o_preview.zmp.length(len);
+    o_preview.basePos.length(len);
+    o_preview.baseRpy.length(len);
+    double q[dof], dq[dof], ddq[dof], zmp[3], acc[3], pos[3], rpy[3], tq[dof], wrenches[6*m_wrenches.size()], optional[optional_data_dim];
+    unsigned int n = 0;
+    for (unsigned int i=0; !preview.isEmpty(); i++){
+        preview.get(q, dq, ddq, zmp, acc, pos, rpy, tq, wrenches, optional);
+        if (i % step) continue;
+        if (n == len){
+            len *= 2;
+            o_preview.q.length(len);
+            o_preview.dq.length(len);
+            o_preview.ddq.length(len);
+            o_preview.zmp.length(len);
+            o_preview.basePos.length(len);
+            o_preview.baseRpy.length(len);
+        }
+        o_preview.q[n].length(dof);
+        o_preview.dq[n].length(dof);
+        o_preview.ddq[n].length(dof);
+        for (int j=0; j<dof; j++){
+            o_preview.q[n][j] = q[j];
+            o_preview.dq[n][j] = dq[j];
+            o_preview.ddq[n][j] = ddq[j];
+        }
+        o_preview.zmp[n].length(3);
+        o_preview.basePos[n].length(3);
+        o_preview.baseRpy[n].length(3);
+        for (int j=0; j<3; j++){
+            o_preview.zmp[n][j] = zmp[j];
+            o_preview.basePos[n][j] = pos[j];
+            o_preview.baseRpy[n][j] = rpy[j];
+        }
+        n++;
+    }
+    o_preview.q.length(n);
+    o_preview.dq.length(n);
+    o_preview.ddq.length(n);
+    o_preview.zmp.length(n);
+    o_preview.basePos.length(n);
+    o_preview.baseRpy.length(n);
+    return true;
+}
+
+int SequencePlayer::pushSplineSegments(const OpenHRP::SequencePlayerService::SplineSegmentSequence& i_segments)
+{
+    if ( m_debugLevel > 0 ) {
+        std::cerr << __PRETTY_FUNCTION__ << std::endl;
+    }
+    Guard guard(m_mutex);
+
+    if (!setInitialState()) return -1;
+    if (i_segments.length() && !m_seq->isSplineSegmentAccepted()){
+        std::cerr << "[" << m_profile.instance_name << "] joint angles are being interpolated, segments are rejected" << std::endl;
+        return -2;
+    }
+
+    int n = 0;
+    for (unsigned int i=0; i<i_segments.length(); i++){
+        const OpenHRP::SequencePlayerService::SplineSegment& s = i_segments[i];
+        const double *coeffs[splineStream::NCHANNEL] = {
+            s.jvs.get_buffer(),
+            s.basePos.length() ? s.basePos.get_buffer() : NULL,
+            s.baseRpy.length() ? s.baseRpy.get_buffer() : NULL,
+            s.zmp.length() ? s.zmp.get_buffer() : NULL};
+        if (!m_seq->pushSplineSegment(s.duration, s.order, coeffs)) break;
+        n++;
+    }
+    return n;
+}
+
+unsigned int SequencePlayer::getSplineBufferSpace()
+{
+    Guard guard(m_mutex);
+    return m_seq->splineBufferSpace();
+}
+
+void SequencePlayer::clearSplineSegments()
+{
+    if ( m_debugLevel > 0 ) {
+        std::cerr << __PRETTY_FUNCTION__ << std::endl;
+    }
+    Guard guard(m_mutex);
+    m_seq->clearSplineSegments();
+}
+
 bool SequencePlayer::setBasePos(const double *pos, double tm)
 {
     if ( m_debugLevel > 0 ) {
@@ -685,7 +824,7 @@ bool SequencePlayer::setInitialState(double tm)
         std::cerr << "can't determine initial posture" << std::endl;
         return false;
     }else{
-        m_seq->setJointAngles(m_qInit.data.get_buffer(), tm);
+        setInitialValues(m_seq, tm);
         for (int i=0; i<m_robot->numJoints(); i++){
             Link *l = m_robot->joint(i);
             l->q = m_qInit.data[i];
@@ -697,22 +836,29 @@ bool SequencePlayer::setInitialState(double tm)
         root->p << m_basePosInit.data.x,
             m_basePosInit.data.y,
             m_basePosInit.data.z;
-        m_seq->setBasePos(root->p.data(), tm);
-
-        double rpy[] = {m_baseRpyInit.data.r,
-                        m_baseRpyInit.data.p,
-                        m_baseRpyInit.data.y};
-        m_seq->setBaseRpy(rpy, tm);
-        calcRotFromRpy(root->R, rpy[0], rpy[1], rpy[2]);
-
-        double zmp[] = {m_zmpRefInit.data.x, m_zmpRefInit.data.y, m_zmpRefInit.data.z};
-        m_seq->setZmp(zmp, tm);
-        double zero[] = {0,0,0};
-        m_seq->setBaseAcc(zero, tm);
+        calcRotFromRpy(root->R, m_baseRpyInit.data.r, m_baseRpyInit.data.p,
+                       m_baseRpyInit.data.y);
         return true;
     }
 }
 
+void SequencePlayer::setInitialValues(seqplay *i_seq, double tm)
+{
+    i_seq->setJointAngles(m_qInit.data.get_buffer(), tm);
+    double pos[] = {m_basePosInit.data.x,
+                    m_basePosInit.data.y,
+                    m_basePosInit.data.z};
+    i_seq->setBasePos(pos, tm);
+    double rpy[] = {m_baseRpyInit.data.r,
+                    m_baseRpyInit.data.p,
+                    m_baseRpyInit.data.y};
+    i_seq->setBaseRpy(rpy, tm);
+    double zmp[] = {m_zmpRefInit.data.x, m_zmpRefInit.data.y, m_zmpRefInit.data.z};
+    i_seq->setZmp(zmp, tm);
+    double zero[] = {0,0,0};
+    i_seq->setBaseAcc(zero, tm);
+}
+
 void SequencePlayer::playPattern(const dSequenceSequence& pos, const dSequenceSequence& rpy, const dSequenceSequence& zmp, const dSequence& tm)
 {
     if ( m_debugLevel > 0 ) {
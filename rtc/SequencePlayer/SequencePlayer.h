@@ -101,7 +101,11 @@ class SequencePlayer
   bool setJointAngles(const double *angles, const bool *mask, double tm);
   bool setJointAnglesSequence(const OpenHRP::dSequenceSequence angless, const OpenHRP::bSequence& mask, const OpenHRP::dSequence& times);
   bool setJointAnglesSequenceFull(const OpenHRP::dSequenceSequence i_jvss, const OpenHRP::dSequenceSequence i_vels, const OpenHRP::dSequenceSequence i_torques, const OpenHRP::dSequenceSequence i_poss, const OpenHRP::dSequenceSequence i_rpys, const OpenHRP::dSequenceSequence i_accs, const OpenHRP::dSequenceSequence i_zmps, const OpenHRP::dSequenceSequence i_wrenches, const OpenHRP::dSequenceSequence i_optionals, const dSequence i_tms);
+  bool previewJointAnglesSequenceFull(const OpenHRP::dSequenceSequence& i_jvss, const OpenHRP::dSequenceSequence& i_vels, const OpenHRP::dSequenceSequence& i_torques, const OpenHRP::dSequenceSequence& i_poss, const OpenHRP::dSequenceSequence& i_rpys, const OpenHRP::dSequenceSequence& i_accs, const OpenHRP::dSequenceSequence& i_zmps, const OpenHRP::dSequenceSequence& i_wrenches, const OpenHRP::dSequenceSequence& i_optionals, const dSequence& i_tms, double i_period, OpenHRP::SequencePlayerService::TrajectoryPreview& o_preview);
   bool clearJointAngles();
+  int pushSplineSegments(const OpenHRP::SequencePlayerService::SplineSegmentSequence& i_segments);
+  unsigned int getSplineBufferSpace();
+  void clearSplineSegments();
   bool setBasePos(const double *pos, double tm);
   bool setBaseRpy(const double *rpy, double tm);
   bool setZmp(const double *zmp, double tm);
@@ -179,6 +183,8 @@ class SequencePlayer
   // </rtc-template>
 
  private:
+  void setInitialValues(seqplay *i_seq, double tm);
+
   seqplay *m_seq;
   bool m_clearFlag, m_waitFlag;
   boost::interprocess::interprocess_semaphore m_waitSem;
@@ -75,7 +75,7 @@ CORBA::Boolean SequencePlayerService_impl::setJointAnglesSequenceWithMask(const
   return m_player->setJointAnglesSequence(jvss, mask, tms);
 }
 
-CORBA::Boolean SequencePlayerService_impl::setJointAnglesSequenceFull(const dSequenceSequence& jvss, const dSequenceSequence& vels, const dSequenceSequence& torques, const dSequenceSequence& poss, const dSequenceSequence& rpys, const dSequenceSequence& accs, const dSequenceSequence& zmps, const dSequenceSequence& wrenches, const dSequenceSequence& optionals, const dSequence &tms)
+bool SequencePlayerService_impl::checkSequenceFull(const dSequenceSequence& jvss, const dSequenceSequence& vels, const dSequenceSequence& torques, const dSequenceSequence& poss, const dSequenceSequence& rpys, const dSequenceSequence& accs, const dSequenceSequence& zmps, const dSequenceSequence& wrenches, const dSequenceSequence& optionals, const dSequence &tms)
 {
   if (jvss.length() <= 0) {
       std::cerr << __PRETTY_FUNCTION__ << " num of joint angles sequence is invalid:" << jvss.length() << " > 0" << std::endl;
@@ -85,6 +85,18 @@ CORBA::Boolean SequencePlayerService_impl::setJointAnglesSequenceFull(const dSeq
       std::cerr << __PRETTY_FUNCTION__ << " length of joint angles sequence and time sequence differ, joint angle:" << jvss.length() << ", time:" << tms.length() << std::endl;
       return false;
   }
+  double total = 0;
+  for (unsigned int i = 0; i < tms.length(); i++) {
+      if (!(tms[i] >= 0)) {
+          std::cerr << __PRETTY_FUNCTION__ << " time sequence is invalid, time[" << i << "]:" << tms[i] << " >= 0" << std::endl;
+          return false;
+      }
+      total += tms[i];
+  }
+  if (!(total > 0)) {
+      std::cerr << __PRETTY_FUNCTION__ << " total time of sequence is invalid:" << total << " > 0" << std::endl;
+      return false;
+  }
   const dSequence& jvs = jvss[0];
   if (jvs.length() != (unsigned int)(m_player->robot()->numJoints())) {
       std::cerr << __PRETTY_FUNCTION__ << " num of joint is differ, input:" << jvs.length() << ", robot:" << (unsigned int)(m_player->robot()->numJoints()) << std::endl;
@@ -179,9 +191,56 @@ CORBA::Boolean SequencePlayerService_impl::setJointAnglesSequenceFull(const dSeq
       //const dSequence& optional = optionasl[0];
   }
 
+  return true;
+}
+
+CORBA::Boolean SequencePlayerService_impl::setJointAnglesSequenceFull(const dSequenceSequence& jvss, const dSequenceSequence& vels, const dSequenceSequence& torques, const dSequenceSequence& poss, const dSequenceSequence& rpys, const dSequenceSequence& accs, const dSequenceSequence& zmps, const dSequenceSequence& wrenches, const dSequenceSequence& optionals, const dSequence &tms)
+{
+  if (!checkSequenceFull(jvss, vels, torques, poss, rpys, accs, zmps, wrenches, optionals, tms)) return false;
   return m_player->setJointAnglesSequenceFull(jvss, vels, torques, poss, rpys, accs, zmps, wrenches, optionals, tms);
 }
 
+CORBA::Boolean SequencePlayerService_impl::previewJointAnglesSequenceFull(const dSequenceSequence& jvss, const dSequenceSequence& vels, const dSequenceSequence& torques, const dSequenceSequence& poss, const dSequenceSequence& rpys, const dSequenceSequence& accs, const dSequenceSequence& zmps, const dSequenceSequence& wrenches, const dSequenceSequence& optionals, const dSequence &tms, CORBA::Double period, OpenHRP::SequencePlayerService::TrajectoryPreview_out preview)
+{
+  preview = new OpenHRP::SequencePlayerService::TrajectoryPreview;
+  if (!checkSequenceFull(jvss, vels, torques, poss, rpys, accs, zmps, wrenches, optionals, tms)) return false;
+  return m_player->previewJointAnglesSequenceFull(jvss, vels, torques, poss, rpys, accs, zmps, wrenches, optionals, tms, period, *preview);
+}
+
+CORBA::Long SequencePlayerService_impl::pushSplineSegments(const OpenHRP::SequencePlayerService::SplineSegmentSequence& segments)
+{
+  unsigned int dof = m_player->robot()->numJoints();
+  for (unsigned int i=0; i<segments.length(); i++){
+      const OpenHRP::SequencePlayerService::SplineSegment& s = segments[i];
+      unsigned int n = s.order + 1;
+      if (s.order > splineStream::MAX_ORDER || s.duration <= 0) {
+          std::cerr << __PRETTY_FUNCTION__ << " invalid segment[" << i << "], order:" << s.order << ", duration:" << s.duration << std::endl;
+          return -1;
+      }
+      if (s.jvs.length() != dof*n) {
+          std::cerr << __PRETTY_FUNCTION__ << " num of coefficients of joint angles is differ, segment[" << i << "]:" << s.jvs.length() << ", expected:" << dof*n << std::endl;
+          return -1;
+      }
+      if ((s.basePos.length() && s.basePos.length() != 3*n)
+          || (s.baseRpy.length() && s.baseRpy.length() != 3*n)
+          || (s.zmp.length() && s.zmp.length() != 3*n)) {
+          std::cerr << __PRETTY_FUNCTION__ << " num of coefficients of base pos, rpy or zmp is differ, segment[" << i << "], expected:" << 3*n << std::endl;
+          return -1;
+      }
+  }
+  return m_player->pushSplineSegments(segments);
+}
+
+CORBA::ULong SequencePlayerService_impl::getSplineBufferSpace()
+{
+  return m_player->getSplineBufferSpace();
+}
+
+void SequencePlayerService_impl::clearSplineSegments()
+{
+  m_player->clearSplineSegments();
+}
+
 CORBA::Boolean SequencePlayerService_impl::setJointAngle(const char *jname, CORBA::Double jv, CORBA::Double tm)
 {
     BodyPtr r = m_player->robot();
@@ -21,7 +21,11 @@ public:
   CORBA::Boolean setJointAnglesSequence(const dSequenceSequence& jvs, const dSequence &tms);
   CORBA::Boolean setJointAnglesSequenceWithMask(const dSequenceSequence& jvs, const bSequence& mask, const dSequence &tms);
   CORBA::Boolean setJointAnglesSequenceFull(const dSequenceSequence& jvss, const dSequenceSequence& vels, const dSequenceSequence& torques, const dSequenceSequence& poss, const dSequenceSequence& rpys, const dSequenceSequence& accs, const dSequenceSequence& zmps, const dSequenceSequence& wrenches, const dSequenceSequence& optionals, const dSequence &tms);
+  CORBA::Boolean previewJointAnglesSequenceFull(const dSequenceSequence& jvss, const dSequenceSequence& vels, const dSequenceSequence& torques, const dSequenceSequence& poss, const dSequenceSequence& rpys, const dSequenceSequence& accs, const dSequenceSequence& zmps, const dSequenceSequence& wrenches, const dSequenceSequence& optionals, const dSequence &tms, CORBA::Double period, OpenHRP::SequencePlayerService::TrajectoryPreview_out preview);
   CORBA::Boolean clearJointAngles();
+  CORBA::Long pushSplineSegments(const OpenHRP::SequencePlayerService::SplineSegmentSequence& segments);
+  CORBA::ULong getSplineBufferSpace();
+  void clearSplineSegments();
   CORBA::Boolean setJointAngles(const dSequence& jvs, CORBA::Double tm);
   CORBA::Boolean setJointAnglesWithMask(const dSequence& jvs, const bSequence& mask, CORBA::Double tm);
   CORBA::Boolean setJointAngle(const char *jname, CORBA::Double jv, CORBA::Double tm);
@@ -49,6 +53,8 @@ public:
   //
   void player(SequencePlayer *i_player);
   SequencePlayer *m_player;
+private:
+  bool checkSequenceFull(const dSequenceSequence& jvss, const dSequenceSequence& vels, const dSequenceSequence& torques, const dSequenceSequence& poss, const dSequenceSequence& rpys, const dSequenceSequence& accs, const dSequenceSequence& zmps, const dSequenceSequence& wrenches, const dSequenceSequence& optionals, const dSequence &tms);
 };				 
 
 #endif
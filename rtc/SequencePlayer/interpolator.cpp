@@ -51,6 +51,8 @@ interpolator::~interpolator()
 
 void interpolator::clear()
 {
+  // the current goal is discarded too, otherwise it never becomes empty
+  remain_t = 0;
   while (!isEmpty()){
     pop();
   }
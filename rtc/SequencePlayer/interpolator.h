@@ -50,6 +50,7 @@ public:
   double remain_time();
   double calc_interpolation_time(const double *g);
   bool setInterpolationMode (interpolation_mode i_mode_);
+  interpolation_mode getInterpolationMode() const { return imode; }
   // Set goal
   //   If online=true, user can get and interpolate value through get() function.
   void setGoal(const double *gx, const double *gv, double time,
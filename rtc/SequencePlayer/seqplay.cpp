@@ -8,6 +8,7 @@
 
 seqplay::seqplay(unsigned int i_dof, double i_dt, unsigned int i_fnum, unsigned int optional_data_dim) : m_dof(i_dof)
 {
+    m_stream = new splineStream(i_dof, i_dt, 64);
     interpolators[Q] = new interpolator(i_dof, i_dt);
     interpolators[ZMP] = new interpolator(3, i_dt);
     interpolators[ACC] = new interpolator(3, i_dt);
@@ -50,6 +51,7 @@ seqplay::~seqplay()
 	for (unsigned int i=0; i<NINTERPOLATOR; i++){
 		delete interpolators[i];
 	}
+	delete m_stream;
 }
 
 #if 0 // TODO
@@ -102,6 +104,7 @@ void seqplay::goInitial(double tm)
 
 bool seqplay::isEmpty() const
 {
+	if (!m_stream->isEmpty()) return false;
 	for (unsigned int i=0; i<NINTERPOLATOR; i++){
 		if (!interpolators[i]->isEmpty()) return false;
 	}
@@ -262,6 +265,7 @@ void seqplay::playPattern(std::vector<const double*> pos, std::vector<const doub
 
 void seqplay::clear(double i_timeLimit)
 {
+	m_stream->clear();
 	tick_t t1 = get_tick();
 	while (!isEmpty()){
 		if (i_timeLimit > 0 
@@ -354,8 +358,15 @@ void seqplay::pop_back()
 void seqplay::get(double *o_q, double *o_zmp, double *o_accel,
 				  double *o_basePos, double *o_baseRpy, double *o_tq, double *o_wrenches, double *o_optional_data)
 {
-	double v[m_dof];
-	interpolators[Q]->get(o_q, v);
+	get(o_q, NULL, NULL, o_zmp, o_accel, o_basePos, o_baseRpy, o_tq, o_wrenches, o_optional_data);
+}
+
+void seqplay::get(double *o_q, double *o_dq, double *o_ddq, double *o_zmp, double *o_accel,
+				  double *o_basePos, double *o_baseRpy, double *o_tq, double *o_wrenches, double *o_optional_data)
+{
+	double dq[m_dof];
+	double *v = o_dq ? o_dq : dq;
+	interpolators[Q]->get(o_q, v, o_ddq);
 	std::map<std::string, groupInterpolator *>::iterator it;
 	for (it=groupInterpolators.begin(); it!=groupInterpolators.end();){
 		groupInterpolator *gi = it->second;
@@ -376,6 +387,64 @@ void seqplay::get(double *o_q, double *o_zmp, double *o_accel,
 	interpolators[TQ]->get(o_tq);
 	interpolators[WRENCHES]->get(o_wrenches);
 	interpolators[OPTIONAL_DATA]->get(o_optional_data);
+
+	double *x[splineStream::NCHANNEL] = {o_q, o_basePos, o_baseRpy, o_zmp};
+	bool given[splineStream::NCHANNEL];
+	if (m_stream->get(x, v, o_ddq, given)){
+		// the last values are kept after the stream runs out
+		if (given[splineStream::Q]) interpolators[Q]->set(o_q);
+		if (given[splineStream::P]) interpolators[P]->set(o_basePos);
+		if (given[splineStream::RPY]) interpolators[RPY]->set(o_baseRpy);
+		if (given[splineStream::ZMP]) interpolators[ZMP]->set(o_zmp);
+	}
+}
+
+bool seqplay::pushSplineSegment(double i_duration, unsigned int i_order, const double *i_coeffs[splineStream::NCHANNEL])
+{
+	if (!isSplineSegmentAccepted()){
+		std::cerr << "[pushSplineSegment] joint angles are being interpolated" << std::endl;
+		return false;
+	}
+	return m_stream->push(i_duration, i_order, i_coeffs);
+}
+
+bool seqplay::isSplineSegmentAccepted() const
+{
+	return !m_stream->isEmpty() || interpolators[Q]->isEmpty();
+}
+
+unsigned int seqplay::splineBufferSpace() const
+{
+	return m_stream->space();
+}
+
+void seqplay::clearSplineSegments()
+{
+	m_stream->clear();
+}
+
+bool seqplay::setSplineBufferLength(unsigned int i_len)
+{
+	if (!m_stream->isEmpty() || i_len == 0) return false;
+	splineStream *s = new splineStream(m_dof, interpolators[Q]->deltaT(), i_len);
+	delete m_stream;
+	m_stream = s;
+	return true;
+}
+
+void seqplay::copyState(seqplay& i_seq)
+{
+	for (unsigned int i=0; i<NINTERPOLATOR; i++){
+		interpolator *src = i_seq.interpolators[i], *dst = interpolators[i];
+		int dim = dst->dimension();
+		double x[dim], v[dim], a[dim];
+		src->get(x, v, a, false);
+		dst->setInterpolationMode(src->getInterpolationMode());
+		dst->clear();
+		dst->set(x, v);
+		// the same value as the first one of i_seq
+		dst->push(x, v, a, true);
+	}
 }
 
 void seqplay::go(const double *i_q, const double *i_zmp, const double *i_acc,
@@ -686,7 +755,7 @@ bool seqplay::setJointAnglesSequenceFull(std::vector<const double*> i_pos, std::
 	interpolators[ACC]->push(bacc, dummy_3, dummy_3, true);
 	int fnum = interpolators[WRENCHES]->dimension()/6, optional_data_dim = interpolators[OPTIONAL_DATA]->dimension();
 	double zmp[3], wrench[6*fnum], dummy_fnum[6*fnum], optional[optional_data_dim], dummy_optional[optional_data_dim];
-	for (unsigned int j = 0; j < 6*fnum; j++) { dummy_dof[j] = 0.0; }
+	for (unsigned int j = 0; j < 6*fnum; j++) { dummy_fnum[j] = 0.0; }
 	for (unsigned int j = 0; j < optional_data_dim; j++) { dummy_optional[j] = 0.0; }
 	interpolators[ZMP]->get(zmp, false);
 	interpolators[ZMP]->set(zmp);
@@ -735,14 +804,15 @@ bool seqplay::setJointAnglesSequenceFull(std::vector<const double*> i_pos, std::
 			}
 		}
 
+		// current values are kept if sequences are not given
 		interpolators[Q]->setGoal(i_pos[i], v, i_tm[i], false);
-		interpolators[TQ]->setGoal(i_torques[i], i_tm[i], false);
-		interpolators[P]->setGoal(i_bpos[i], i_tm[i], false);
-		interpolators[RPY]->setGoal(i_brpy[i], i_tm[i], false);
-		interpolators[ACC]->setGoal(i_bacc[i], i_tm[i], false);
-		interpolators[ZMP]->setGoal(i_zmps[i], i_tm[i], false);
-		interpolators[WRENCHES]->setGoal(i_wrenches[i], i_tm[i], false);
-		interpolators[OPTIONAL_DATA]->setGoal(i_optionals[i], i_tm[i], false);
+		interpolators[TQ]->setGoal(i_torques.empty() ? torque : i_torques[i], i_tm[i], false);
+		interpolators[P]->setGoal(i_bpos.empty() ? bpos : i_bpos[i], i_tm[i], false);
+		interpolators[RPY]->setGoal(i_brpy.empty() ? brpy : i_brpy[i], i_tm[i], false);
+		interpolators[ACC]->setGoal(i_bacc.empty() ? bacc : i_bacc[i], i_tm[i], false);
+		interpolators[ZMP]->setGoal(i_zmps.empty() ? zmp : i_zmps[i], i_tm[i], false);
+		interpolators[WRENCHES]->setGoal(i_wrenches.empty() ? wrench : i_wrenches[i], i_tm[i], false);
+		interpolators[OPTIONAL_DATA]->setGoal(i_optionals.empty() ? optional : i_optionals[i], i_tm[i], false);
 		do{
 			double tm = i_tm[i], tm_tmp;
 			interpolators[Q]->interpolate(i_tm[i]);
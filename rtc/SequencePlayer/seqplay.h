@@ -6,6 +6,7 @@
 #include <map>
 #include <hrpUtil/EigenTypes.h>
 #include "interpolator.h"
+#include "splineStream.h"
 #include "timeUtil.h"
 
 using namespace hrp;
@@ -48,6 +49,12 @@ public:
     void clear(double i_timeLimit=0);
     void get(double *o_q, double *o_zmp, double *o_accel,
 	     double *o_basePos, double *o_baseRpy, double *o_tq, double *o_wrenches, double *o_optional_data);
+    // o_dq and o_ddq can be NULL
+    void get(double *o_q, double *o_dq, double *o_ddq, double *o_zmp, double *o_accel,
+	     double *o_basePos, double *o_baseRpy, double *o_tq, double *o_wrenches, double *o_optional_data);
+    // start from the current values of i_seq to evaluate sequences offline.
+    // Both players must have the same dimensions. Joint groups are not copied
+    void copyState(seqplay& i_seq);
     void go(const double *i_q, const double *i_zmp, const double *i_acc,
             const double *i_p, const double *i_rpy, const double *i_tq, const double *i_wrenches, const double *i_optional_data, double i_time, 
             bool immediate=true);
@@ -58,6 +65,17 @@ public:
             double i_time, bool immediate=true);
     void sync();
     bool setInterpolationMode(interpolator::interpolation_mode i_mode_);
+    //
+    // see splineStream::push(), coefficients of channels are given in the
+    // order of joint angles, base position, base RPY and ZMP
+    bool pushSplineSegment(double i_duration, unsigned int i_order, const double *i_coeffs[splineStream::NCHANNEL]);
+    // segments are not accepted while joint angles are interpolated by
+    // other methods
+    bool isSplineSegmentAccepted() const;
+    unsigned int splineBufferSpace() const;
+    void clearSplineSegments();
+    // the buffer can be resized only when it is empty
+    bool setSplineBufferLength(unsigned int i_len);
 private:
     class groupInterpolator{
     public:
@@ -145,6 +163,7 @@ private:
     enum {Q, ZMP, ACC, P, RPY, TQ, WRENCHES, OPTIONAL_DATA, NINTERPOLATOR};
     interpolator *interpolators[NINTERPOLATOR];
     std::map<std::string, groupInterpolator *> groupInterpolators; 
+    splineStream *m_stream;
     int debug_level, m_dof;
 };
 
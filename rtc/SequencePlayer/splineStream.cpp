@@ -0,0 +1,84 @@
+#include <cstring>
+#include "splineStream.h"
+
+splineStream::splineStream(unsigned int i_dof, double i_dt,
+                           unsigned int i_capacity)
+    : m_dof(i_dof), m_dt(i_dt), m_segments(i_capacity), m_head(0),
+      m_size(0), m_time(0)
+{
+    for (unsigned int i=0; i<m_segments.size(); i++){
+        for (int c=0; c<NCHANNEL; c++){
+            m_segments[i].coeffs[c].resize(dimension(c)*(MAX_ORDER+1));
+        }
+    }
+}
+
+bool splineStream::push(double i_duration, unsigned int i_order,
+                        const double *i_coeffs[NCHANNEL])
+{
+    if (m_size == capacity() || i_order > MAX_ORDER || i_duration <= 0){
+        return false;
+    }
+    segment& s = m_segments[(m_head + m_size) % capacity()];
+    s.duration = i_duration;
+    s.order = i_order;
+    for (int c=0; c<NCHANNEL; c++){
+        s.given[c] = i_coeffs[c] != NULL;
+        if (s.given[c]){
+            memcpy(&s.coeffs[c][0], i_coeffs[c],
+                   sizeof(double)*dimension(c)*(i_order+1));
+        }
+    }
+    if (m_size == 0) m_time = 0;
+    m_size++;
+    return true;
+}
+
+bool splineStream::get(double *o_x[NCHANNEL], double *o_dq, double *o_ddq,
+                       bool o_given[NCHANNEL])
+{
+#define EPS 1e-6
+    if (m_size == 0) return false;
+    m_time += m_dt;
+    // move to the segment which includes m_time
+    while (m_size > 1 && m_time > m_segments[m_head].duration + EPS){
+        m_time -= m_segments[m_head].duration;
+        m_head = (m_head + 1) % capacity();
+        m_size--;
+    }
+    const segment& s = m_segments[m_head];
+    bool last = m_time >= s.duration - EPS;
+    // the last segment is evaluated at its end when the buffer runs out
+    double t = last ? s.duration : m_time;
+    unsigned int n = s.order + 1;
+    for (int c=0; c<NCHANNEL; c++){
+        o_given[c] = s.given[c];
+        if (!s.given[c]) continue;
+        for (unsigned int i=0; i<dimension(c); i++){
+            // Horner's method
+            const double *k = &s.coeffs[c][i*n];
+            double x = 0, v = 0, a = 0;
+            for (int j=s.order; j>=0; j--){
+                a = a*t + 2*v;
+                v = v*t + x;
+                x = x*t + k[j];
+            }
+            o_x[c][i] = x;
+            if (c == Q){
+                if (o_dq) o_dq[i] = v;
+                if (o_ddq) o_ddq[i] = a;
+            }
+        }
+    }
+    if (last && m_size == 1){
+        m_head = (m_head + 1) % capacity();
+        m_size = 0;
+    }
+    return true;
+}
+
+void splineStream::clear()
+{
+    m_head = m_size = 0;
+    m_time = 0;
+}
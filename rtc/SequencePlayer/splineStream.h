@@ -0,0 +1,64 @@
+#ifndef __SPLINE_STREAM_H__
+#define __SPLINE_STREAM_H__
+
+#include <vector>
+
+/**
+   \brief bounded buffer of polynomial segments evaluated every control period
+
+   A segment gives polynomials of joint angles and optionally base position,
+   base RPY and ZMP over its duration. Coefficients of an element are stored
+   from the lowest order, i.e. x(t) = c0 + c1 t + ... + cn t^n where t is
+   time from the start of the segment. Memory of segments is allocated when
+   the buffer is created, so push() and get() don't allocate memory.
+ */
+class splineStream
+{
+public:
+    enum { MAX_ORDER = 5 };
+    enum { Q, P, RPY, ZMP, NCHANNEL };
+    splineStream(unsigned int i_dof, double i_dt, unsigned int i_capacity);
+    unsigned int capacity() const { return m_segments.size(); }
+    unsigned int size() const { return m_size; }
+    unsigned int space() const { return capacity() - m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    /**
+       \brief append a segment
+       \param i_coeffs i_coeffs[c] is coefficients of channel c, dimension of
+       the channel x (i_order+1) values, or NULL if the channel isn't given
+       \return false if the buffer is full or the segment is invalid
+     */
+    bool push(double i_duration, unsigned int i_order,
+              const double *i_coeffs[NCHANNEL]);
+    /**
+       \brief advance time by a control period and evaluate the current
+       segment. Segments whose end has passed are removed
+       \param o_x o_x[c] receives values of channel c if it is given by the
+       segment, o_dq and o_ddq can be NULL
+       \param o_given o_given[c] is set to true if channel c is given
+       \return false if there is no segment
+     */
+    bool get(double *o_x[NCHANNEL], double *o_dq, double *o_ddq,
+             bool o_given[NCHANNEL]);
+    void clear();
+private:
+    struct segment
+    {
+        double duration;
+        unsigned int order;
+        bool given[NCHANNEL];
+        std::vector<double> coeffs[NCHANNEL];
+    };
+    unsigned int dimension(int i_channel) const {
+        return i_channel == Q ? m_dof : 3;
+    }
+
+    unsigned int m_dof;
+    double m_dt;
+    std::vector<segment> m_segments;
+    unsigned int m_head, m_size;
+    // time from the start of the first segment
+    double m_time;
+};
+
+#endif
@@ -27,6 +27,9 @@ static const char* stateholder_spec[] =
     "language",          "C++",
     "lang_type",         "compile",
     // Configuration variables
+    "conf.default.telemetry", "",
+    "conf.default.telemetryMulticast", "",
+    "conf.default.telemetryInterval", "1",
 
     ""
   };
@@ -35,6 +38,7 @@ static const char* stateholder_spec[] =
 StateHolder::StateHolder(RTC::Manager* manager)
   : RTC::DataFlowComponentBase(manager),
     // <rtc-template block="initializer">
+    m_telemetryInterval(1),
     m_currentQIn("currentQIn", m_currentQ),
     m_qIn("qIn", m_q),
     m_tqIn("tqIn", m_tq),
@@ -56,6 +60,9 @@ StateHolder::StateHolder(RTC::Manager* manager)
     m_timeCount(0),
     m_waitSem(0),
     m_timeSem(0),
+    m_telemetryJoints(0),
+    m_telemetryChanged(true),
+    m_telemetryCount(0),
     dummy(0)
 {
 
@@ -76,6 +83,12 @@ RTC::ReturnCode_t StateHolder::onInitialize()
   std::cerr << "[" << m_profile.instance_name << "] onInitialize()" << std::endl;
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
+  bindParameter("telemetry", m_telemetry, "");
+  bindParameter("telemetryMulticast", m_telemetryMulticast, "");
+  bindParameter("telemetryInterval", m_telemetryInterval, "1");
+  // the stream is reopened only when the configuration is updated
+  addConfigurationSetNameListener(ON_UPDATE_CONFIG_SET,
+                                  new ConfigUpdateFlag(m_telemetryChanged));
   
   // </rtc-template>
 
@@ -180,6 +193,13 @@ RTC::ReturnCode_t StateHolder::onInitialize()
     registerOutPort(std::string(fsensor_names[i]+"Out").c_str(), *m_wrenchesOut[i]);
   }
 
+  // the same fields as StateHolderService::Command
+  for (unsigned int i=0; i<lis->length(); i++){
+    if (lis[i].jointId >= 0) m_telemetryJoints++;
+  }
+  m_tlmJointRefs = m_telemetryPublisher.addField("jointRefs", TELEMETRY_DOUBLE, m_telemetryJoints);
+  m_tlmBaseTransform = m_telemetryPublisher.addField("baseTransform", TELEMETRY_DOUBLE, 12);
+  m_tlmZmp = m_telemetryPublisher.addField("zmp", TELEMETRY_DOUBLE, 3);
   
   return RTC::RTC_OK;
 }
@@ -319,6 +339,8 @@ RTC::ReturnCode_t StateHolder::onExecute(RTC::UniqueId ec_id)
       m_wrenchesOut[i]->write();
     }
 
+    publishTelemetry(tm);
+
     if (m_timeCount > 0){
         m_timeCount--;
         if (m_timeCount == 0) m_timeSem.post();
@@ -327,6 +349,26 @@ RTC::ReturnCode_t StateHolder::onExecute(RTC::UniqueId ec_id)
     return RTC::RTC_OK;
 }
 
+void StateHolder::publishTelemetry(const RTC::Time& tm)
+{
+    if (m_telemetryChanged){
+        m_telemetryChanged = false;
+        m_telemetryPublisher.configure(m_telemetry, m_telemetryMulticast);
+    }
+    if (!m_telemetryPublisher.ready()
+        || m_telemetryInterval <= 0
+        || (m_telemetryCount++)%m_telemetryInterval
+        || m_q.data.length() != m_telemetryJoints) return;
+
+    memcpy(m_telemetryPublisher.doubles(m_tlmJointRefs), m_q.data.get_buffer(),
+           sizeof(double)*m_telemetryJoints);
+    memcpy(m_telemetryPublisher.doubles(m_tlmBaseTransform),
+           m_baseTform.data.get_buffer(), sizeof(double)*12);
+    double *zmp = m_telemetryPublisher.doubles(m_tlmZmp);
+    zmp[0] = m_zmp.data.x; zmp[1] = m_zmp.data.y; zmp[2] = m_zmp.data.z;
+    m_telemetryPublisher.publish(tm.sec + tm.nsec*1e-9);
+}
+
 /*
 RTC::ReturnCode_t StateHolder::onAborting(RTC::UniqueId ec_id)
 {
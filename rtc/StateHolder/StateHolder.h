@@ -18,6 +18,8 @@
 #include <rtm/DataOutPort.h>
 #include <rtm/idl/BasicDataTypeSkel.h>
 #include <rtm/idl/ExtendedDataTypesSkel.h>
+#include "util/Telemetry.h"
+#include "util/ConfigUpdateFlag.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -104,6 +106,8 @@ class StateHolder
  protected:
   // Configuration variable declaration
   // <rtc-template block="config_declare">
+  std::string m_telemetry, m_telemetryMulticast;
+  int m_telemetryInterval;
   
   // </rtc-template>
   TimedDoubleSeq m_currentQ;
@@ -164,10 +168,17 @@ class StateHolder
   // </rtc-template>
 
  private:
+  void publishTelemetry(const RTC::Time& tm);
+
   int m_timeCount;
   boost::interprocess::interprocess_semaphore m_waitSem, m_timeSem;
   bool m_requestGoActual;
   double m_dt;
+  TelemetryPublisher m_telemetryPublisher;
+  unsigned int m_telemetryJoints;
+  bool m_telemetryChanged;
+  unsigned long m_telemetryCount;
+  int m_tlmJointRefs, m_tlmBaseTransform, m_tlmZmp;
   int dummy;
 };
 
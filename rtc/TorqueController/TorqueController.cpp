@@ -32,6 +32,7 @@ static const char* torquecontroller_spec[] =
   "lang_type",         "compile",
   // Configuration variables
   "conf.default.debugLevel", "0",
+  "conf.default.useKinematicsCache", "0",
   ""
 };
 // </rtc-template>
@@ -47,7 +48,9 @@ TorqueController::TorqueController(RTC::Manager* manager)
     m_qCurrentInIn("qCurrent", m_qCurrentIn),
     m_qRefOutOut("q", m_qRefOut),
     m_TorqueControllerServicePort("TorqueControllerService"),
-    m_debugLevel(0)
+    m_debugLevel(0),
+    m_useKinematicsCache(false),
+    m_kinematicsCache(NULL)
 {
   m_service0.torque_controller(this);
 }
@@ -64,6 +67,7 @@ RTC::ReturnCode_t TorqueController::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("debugLevel", m_debugLevel, "0");
+  bindParameter("useKinematicsCache", m_useKinematicsCache, "0");
   
   // </rtc-template>
 
@@ -110,6 +114,9 @@ RTC::ReturnCode_t TorqueController::onInitialize()
     std::cerr << "[" << m_profile.instance_name << "] failed to load model[" << prop["model"] << "]"
               << std::endl;
   }
+  if (m_robot->numLinks() > 0){
+    m_kinematicsCacheKey = prop["model"];
+  }
   // make torque controller settings
   coil::vstring motorTorqueControllerParamsFromConf = coil::split(prop["torque_controller_params"], ",");
   // make controlle type map
@@ -251,6 +258,10 @@ RTC::ReturnCode_t TorqueController::onShutdown(RTC::UniqueId ec_id)
 RTC::ReturnCode_t TorqueController::onActivated(RTC::UniqueId ec_id)
 {
   std::cerr << "[" << m_profile.instance_name<< "] onActivated(" << ec_id << ")" << std::endl;
+  // a copy of the body is registered only when the cache is enabled
+  if (m_useKinematicsCache && !m_kinematicsCache && !m_kinematicsCacheKey.empty()){
+    m_kinematicsCache = KinematicsCache::attach(m_kinematicsCacheKey, m_robot);
+  }
   return RTC::RTC_OK;
 }
 
@@ -288,7 +299,11 @@ RTC::ReturnCode_t TorqueController::onExecute(RTC::UniqueId ec_id)
       for ( int i = 0; i < m_robot->numJoints(); i++ ){
         m_robot->joint(i)->q = m_qCurrentIn.data[i];
       }
-      m_robot->calcForwardKinematics();   
+      if (m_useKinematicsCache && m_kinematicsCache){
+        m_kinematicsCache->calcForwardKinematics(m_robot);
+      }else{
+        m_robot->calcForwardKinematics();
+      }
 
       // calculate dq by torque controller
       executeTorqueControl(dq);
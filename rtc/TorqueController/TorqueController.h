@@ -20,6 +20,7 @@
 #include <hrpModel/Body.h>
 #include <hrpModel/Link.h>
 #include <hrpModel/JointPath.h>
+#include "util/KinematicsCache.h"
 
 #include "MotorTorqueController.h"
 
@@ -161,6 +162,9 @@ protected:
 private:
   double m_dt;
   unsigned int m_debugLevel;
+  bool m_useKinematicsCache;
+  KinematicsCache *m_kinematicsCache;
+  std::string m_kinematicsCacheKey;
   long long m_loop;
   hrp::BodyPtr m_robot;
   std::vector<MotorTorqueController> m_motorTorqueControllers;
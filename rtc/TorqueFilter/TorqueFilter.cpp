@@ -30,6 +30,7 @@ static const char* torquefilter_spec[] =
   "lang_type",         "compile",
   // Configuration variables
   "conf.default.debugLevel", "0",
+  "conf.default.useKinematicsCache", "0",
   ""
 };
 
@@ -56,6 +57,8 @@ TorqueFilter::TorqueFilter(RTC::Manager* manager)
     m_tauOutOut("tauOut", m_tauOut),
     // </rtc-template>
     m_debugLevel(0),
+    m_useKinematicsCache(false),
+    m_kinematicsCache(NULL),
     m_is_gravity_compensation(false)
 {
 }
@@ -70,6 +73,7 @@ RTC::ReturnCode_t TorqueFilter::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("debugLevel", m_debugLevel, "0");
+  bindParameter("useKinematicsCache", m_useKinematicsCache, "0");
   
   // </rtc-template>
 
@@ -110,6 +114,7 @@ RTC::ReturnCode_t TorqueFilter::onInitialize()
               << m_profile.instance_name << std::endl;
     return RTC::RTC_ERROR;
   }
+  m_kinematicsCacheKey = prop["model"];
 
   // init outport
   m_tauOut.data.length(m_robot->numJoints());
@@ -231,6 +236,10 @@ RTC::ReturnCode_t TorqueFilter::onInitialize()
 RTC::ReturnCode_t TorqueFilter::onActivated(RTC::UniqueId ec_id)
 {
   std::cerr << "[" << m_profile.instance_name<< "] onActivated(" << ec_id << ")" << std::endl;
+  // a copy of the body is registered only when the cache is enabled
+  if (m_useKinematicsCache && !m_kinematicsCache && !m_kinematicsCacheKey.empty()){
+    m_kinematicsCache = KinematicsCache::attach(m_kinematicsCacheKey, m_robot);
+  }
   return RTC::RTC_OK;
 }
 
@@ -268,9 +277,13 @@ RTC::ReturnCode_t TorqueFilter::onExecute(RTC::UniqueId ec_id)
       for ( int i = 0; i < m_robot->numJoints(); i++ ){
         m_robot->joint(i)->q = m_qCurrent.data[i];
       }
-      m_robot->calcForwardKinematics();
-      m_robot->calcCM();
-      m_robot->rootLink()->calcSubMassCM();
+      if (m_useKinematicsCache && m_kinematicsCache){
+        m_kinematicsCache->calcForwardKinematics(m_robot);
+      }else{
+        m_robot->calcForwardKinematics();
+        m_robot->calcCM();
+        m_robot->rootLink()->calcSubMassCM();
+      }
      
       // calc gravity compensation of each joints
       hrp::Vector3 g(0, 0, 9.8);
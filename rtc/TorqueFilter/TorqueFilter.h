@@ -20,6 +20,7 @@
 #include <hrpModel/Body.h>
 #include <hrpModel/Link.h>
 #include <hrpModel/JointPath.h>
+#include "util/KinematicsCache.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -146,6 +147,9 @@ class TorqueFilter
   double m_dt;
   hrp::BodyPtr m_robot;
   unsigned int m_debugLevel;
+  bool m_useKinematicsCache;
+  KinematicsCache *m_kinematicsCache;
+  std::string m_kinematicsCacheKey;
   std::vector<double> m_torque_offset;
   std::vector<IIRFilter> m_filters;
   bool m_is_gravity_compensation;
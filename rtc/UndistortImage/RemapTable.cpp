@@ -0,0 +1,103 @@
+// -*- C++ -*-
+/*!
+ * @file  RemapTable.cpp
+ * @brief precomputed fixed-point remap table
+ */
+#include <cmath>
+#include <boost/bind.hpp>
+#include "RemapTable.h"
+
+RemapTable::RemapTable()
+    : m_width(0), m_height(0), m_nthreads(1),
+      m_src(NULL), m_dst(NULL), m_channels(0)
+{
+}
+
+void RemapTable::build(const float *i_mapx, const float *i_mapy,
+                       int i_width, int i_height)
+{
+    m_width = i_width;
+    m_height = i_height;
+    m_table.resize(i_width*i_height);
+    for (int i=0; i<i_width*i_height; i++){
+        Entry& e = m_table[i];
+        float x = i_mapx[i], y = i_mapy[i];
+        if (!(x >= 0 && y >= 0 && x <= i_width-1 && y <= i_height-1)
+            || i_width < 2 || i_height < 2){
+            e.offset = -1;
+            e.fx = e.fy = 0;
+            continue;
+        }
+        int fx = (int)floor(x*FRAC_ONE + 0.5);
+        int fy = (int)floor(y*FRAC_ONE + 0.5);
+        int x0 = fx >> FRAC_BITS, y0 = fy >> FRAC_BITS;
+        fx &= FRAC_ONE-1;
+        fy &= FRAC_ONE-1;
+        // keep the bottom-right neighbor inside of the image
+        if (x0 >= i_width-1){ x0 = i_width-2; fx = FRAC_ONE; }
+        if (y0 >= i_height-1){ y0 = i_height-2; fy = FRAC_ONE; }
+        e.offset = y0*i_width + x0;
+        e.fx = fx;
+        e.fy = fy;
+    }
+}
+
+void RemapTable::clear()
+{
+    m_table.clear();
+    m_width = m_height = 0;
+}
+
+void RemapTable::setNumThreads(int i_nthreads)
+{
+    if (i_nthreads < 1) i_nthreads = 1;
+    m_pool.setNumThreads(i_nthreads);
+    m_nthreads = i_nthreads;
+}
+
+void RemapTable::run(int i_part)
+{
+    int begin = m_height*i_part/m_nthreads;
+    int end = m_height*(i_part+1)/m_nthreads;
+    if (m_channels == 3){
+        remapRows<3>(begin, end);
+    }else{
+        remapRows<1>(begin, end);
+    }
+}
+
+template <int N>
+void RemapTable::remapRows(int i_begin, int i_end)
+{
+    const int step = m_width*N;
+    const Entry *e = &m_table[i_begin*m_width];
+    unsigned char *dst = m_dst + i_begin*step;
+    for (int i=i_begin*m_width; i<i_end*m_width; i++, e++, dst+=N){
+        if (e->offset < 0){
+            for (int c=0; c<N; c++) dst[c] = 0;
+            continue;
+        }
+        const unsigned char *p = m_src + e->offset*N;
+        // weights of 4 neighbors, whose sum is FRAC_ONE*FRAC_ONE
+        unsigned int w11 = e->fx*e->fy;
+        unsigned int w10 = (e->fx << FRAC_BITS) - w11;
+        unsigned int w01 = (e->fy << FRAC_BITS) - w11;
+        unsigned int w00 = FRAC_ONE*FRAC_ONE - w10 - w01 - w11;
+        for (int c=0; c<N; c++){
+            unsigned int v = p[c]*w00 + p[c+N]*w10
+                + p[c+step]*w01 + p[c+step+N]*w11;
+            dst[c] = (v + (1 << (2*FRAC_BITS-1))) >> (2*FRAC_BITS);
+        }
+    }
+}
+
+void RemapTable::remap(const unsigned char *i_src, unsigned char *o_dst,
+                       int i_channels)
+{
+    if (m_table.empty()) return;
+    m_src = i_src;
+    m_dst = o_dst;
+    m_channels = i_channels;
+    m_pool.run(boost::bind(&RemapTable::run, this, _1),
+               m_height >= m_nthreads);
+}
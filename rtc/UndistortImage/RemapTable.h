@@ -0,0 +1,72 @@
+// -*- C++ -*-
+/*!
+ * @file  RemapTable.h
+ * @brief precomputed fixed-point remap table
+ */
+#ifndef REMAP_TABLE_H
+#define REMAP_TABLE_H
+
+#include <vector>
+#include "util/WorkerPool.h"
+
+/**
+   \brief remap images with bilinear interpolation using a precomputed table
+
+   The table holds, for each destination pixel, the offset of the top-left
+   source pixel and 8 bit fractions of the position. Channels are
+   interpolated independently, so RGB and BGR images are handled in the
+   same way. Rows are split across threads. No memory is allocated by
+   remap().
+ */
+class RemapTable
+{
+public:
+    RemapTable();
+    /**
+       \brief build the table
+       \param i_mapx, i_mapy source coordinates of destination pixels, as
+       given by cvInitUndistortMap()
+       \param i_width, i_height size of images
+     */
+    void build(const float *i_mapx, const float *i_mapy,
+               int i_width, int i_height);
+    void clear();
+    bool isBuilt(int i_width, int i_height) const {
+        return !m_table.empty() && i_width == m_width && i_height == m_height;
+    }
+    /**
+       \brief set the number of threads including the calling thread
+     */
+    void setNumThreads(int i_nthreads);
+    /**
+       \brief remap an image. Destination pixels whose source is outside of
+       the image are filled with 0
+       \param i_src source image
+       \param o_dst destination image, which must not overlap i_src
+       \param i_channels the number of channels, 1 or 3
+     */
+    void remap(const unsigned char *i_src, unsigned char *o_dst,
+               int i_channels);
+private:
+    enum { FRAC_BITS = 8, FRAC_ONE = 1 << FRAC_BITS };
+    struct Entry {
+        int offset;  ///< offset of the top-left source pixel, -1 if outside
+        unsigned short fx, fy;
+    };
+    template <int N>
+    void remapRows(int i_begin, int i_end);
+    void run(int i_part);
+
+    int m_width, m_height;
+    std::vector<Entry> m_table;
+    int m_nthreads;
+
+    // arguments of the current call
+    const unsigned char *m_src;
+    unsigned char *m_dst;
+    int m_channels;
+
+    WorkerPool m_pool;
+};
+
+#endif // REMAP_TABLE_H
@@ -8,6 +8,7 @@
  */
 
 #include "UndistortImage.h"
+#include <coil/Time.h>
 
 // Module specification
 // <rtc-template block="module_spec">
@@ -25,6 +26,8 @@ static const char* cameraimageviewercomponent_spec[] =
     "lang_type",         "compile",
     // Configuration variables
     "conf.default.calibFile", "camera.xml",
+    "conf.default.threads", "1",
+    "conf.default.debugLevel", "0",
 
     ""
 };
@@ -34,11 +37,13 @@ UndistortImage::UndistortImage(RTC::Manager* manager)
     : RTC::DataFlowComponentBase(manager),
       // <rtc-template block="initializer">
       m_imageIn("imageIn", m_image),
-      m_imageOut("imageOut", m_image),
+      m_imageOut("imageOut", m_undistorted),
       // </rtc-template>
-      m_cvImage(NULL),
       m_intrinsic(NULL),
       m_distortion(NULL),
+      m_nframes(0),
+      m_elapsed(0),
+      m_tReport(0),
       dummy(0)
 {
 }
@@ -55,6 +60,8 @@ RTC::ReturnCode_t UndistortImage::onInitialize()
     // <rtc-template block="bind_config">
     // Bind variables and configuration variable
     bindParameter("calibFile", m_calibFile, "camera.xml");
+    bindParameter("threads", m_threads, "1");
+    bindParameter("debugLevel", m_debugLevel, "0");
   
     // </rtc-template>
 
@@ -118,6 +125,15 @@ RTC::ReturnCode_t UndistortImage::onActivated(RTC::UniqueId ec_id)
     param = cvGetFileNodeByName (fs, NULL, "distortion");
     m_distortion = (CvMat *) cvRead (fs, param);
     cvReleaseFileStorage (&fs);
+    if (!m_intrinsic || !m_distortion){
+        std::cerr << m_profile.instance_name << ": can't read intrinsic or distortion from "
+                  << m_calibFile << std::endl;
+        if (m_intrinsic) cvReleaseMat (&m_intrinsic);
+        if (m_distortion) cvReleaseMat (&m_distortion);
+        return RTC::RTC_ERROR;
+    }
+    // the calibration may be changed
+    m_table.clear();
 
     return RTC::RTC_OK;
 }
@@ -125,10 +141,6 @@ RTC::ReturnCode_t UndistortImage::onActivated(RTC::UniqueId ec_id)
 RTC::ReturnCode_t UndistortImage::onDeactivated(RTC::UniqueId ec_id)
 {
     std::cout << m_profile.instance_name<< ": onDeactivated(" << ec_id << ")" << std::endl;
-    if (m_cvImage) {
-        cvReleaseImage(&m_cvImage);
-        m_cvImage = NULL;
-    }
     if (m_intrinsic) cvReleaseMat (&m_intrinsic);
     if (m_distortion) cvReleaseMat (&m_distortion);
     
@@ -143,83 +155,83 @@ RTC::ReturnCode_t UndistortImage::onExecute(RTC::UniqueId ec_id)
 
     m_imageIn.read();
 
-    if (m_cvImage && (m_image.data.image.width != m_cvImage->width 
-                      || m_image.data.image.height != m_cvImage->height)){
-        cvReleaseImage(&m_cvImage);
-        m_cvImage = NULL;
-    }
-
-    if (!m_cvImage){
-        switch (m_image.data.image.format){
-        case Img::CF_RGB:
-            m_cvImage = cvCreateImage(cvSize(m_image.data.image.width,
-                                             m_image.data.image.height),
-                                      IPL_DEPTH_8U, 3);
-            break;
-        case Img::CF_GRAY:
-            m_cvImage = cvCreateImage(cvSize(m_image.data.image.width,
-                                             m_image.data.image.height),
-                                      IPL_DEPTH_8U, 1);
-            break;
-        default:
-            std::cerr << "unsupported color format(" 
-                      << m_image.data.image.format << ")" << std::endl;
-            return RTC::RTC_ERROR;
-        }
-    }
-    switch(m_image.data.image.format){
+    const Img::ImageData& in = m_image.data.image;
+    int channels;
+    switch (in.format){
     case Img::CF_RGB:
-        {
-            // RGB -> BGR
-            char *dst = m_cvImage->imageData;
-            for (int i=0; i<m_image.data.image.raw_data.length(); i+=3){
-                dst[i  ] = m_image.data.image.raw_data[i+2]; 
-                dst[i+1] = m_image.data.image.raw_data[i+1]; 
-                dst[i+2] = m_image.data.image.raw_data[i  ]; 
-            }
-            break;
-        }
+        channels = 3;
+        break;
     case Img::CF_GRAY:
-        memcpy(m_cvImage->imageData, 
-               m_image.data.image.raw_data.get_buffer(),
-               m_image.data.image.raw_data.length());
+        channels = 1;
         break;
     default:
-        break;
+        std::cerr << "unsupported color format(" 
+                  << in.format << ")" << std::endl;
+        return RTC::RTC_ERROR;
+    }
+    if (in.raw_data.length() != (unsigned int)in.width*in.height*channels){
+        std::cerr << m_profile.instance_name << ": size of image is wrong" << std::endl;
+        return RTC::RTC_OK;
     }
-    
-    
-    IplImage *dst_img = cvCloneImage (m_cvImage);
-    cvUndistort2 (m_cvImage, dst_img, m_intrinsic, m_distortion);
 
-    switch(m_image.data.image.format){
-    case Img::CF_RGB:
-        {
-            // BGR -> RGB
-            char *src = dst_img->imageData;
-            for (int i=0; i<m_image.data.image.raw_data.length(); i+=3){
-                m_image.data.image.raw_data[i+2] = src[i  ]; 
-                m_image.data.image.raw_data[i+1] = src[i+1]; 
-                m_image.data.image.raw_data[i  ] = src[i+2]; 
-            }
-            break;
-        }
-    case Img::CF_GRAY:
-        memcpy(m_image.data.image.raw_data.get_buffer(),
-               dst_img->imageData,
-               m_image.data.image.raw_data.length());
-        break;
-    default:
-        break;
+    coil::TimeValue t1(coil::gettimeofday());
+    // the table depends on the calibration and the resolution
+    if (!m_table.isBuilt(in.width, in.height)
+        && !buildTable(in.width, in.height)){
+        return RTC::RTC_ERROR;
     }
 
-    cvReleaseImage (&dst_img);
+    m_undistorted.tm = m_image.tm;
+    m_undistorted.error_code = m_image.error_code;
+    m_undistorted.data.captured_time = m_image.data.captured_time;
+    m_undistorted.data.intrinsic = m_image.data.intrinsic;
+    m_undistorted.data.extrinsic = m_image.data.extrinsic;
+    Img::ImageData& out = m_undistorted.data.image;
+    out.width = in.width;
+    out.height = in.height;
+    out.format = in.format;
+    // the buffer is reallocated only when the size is changed
+    out.raw_data.length(in.raw_data.length());
+
+    // channels are interpolated independently, so RGB can be remapped
+    // without conversion to BGR
+    m_table.setNumThreads(m_threads);
+    m_table.remap(in.raw_data.get_buffer(), out.raw_data.get_buffer(),
+                  channels);
+    coil::TimeValue t2(coil::gettimeofday());
+
+    if (m_debugLevel > 0){
+        // report cost per frame averaged over about one second
+        coil::TimeValue dt = t2-t1;
+        m_nframes++;
+        m_elapsed += dt.sec()+dt.usec()/1e6;
+        if ((double)t2 - m_tReport > 1.0 || m_debugLevel > 1){
+            m_tReport = (double)t2;
+            std::cout << m_profile.instance_name << ": "
+                      << in.width << "x" << in.height << ", "
+                      << m_elapsed/m_nframes*1e3 << "[ms/frame]" << std::endl;
+            m_nframes = 0;
+            m_elapsed = 0;
+        }
+    }
 
     m_imageOut.write();
 
     return RTC::RTC_OK;
 }
 
+bool UndistortImage::buildTable(int i_width, int i_height)
+{
+    if (!m_intrinsic || !m_distortion) return false;
+    CvMat *mapx = cvCreateMat(i_height, i_width, CV_32FC1);
+    CvMat *mapy = cvCreateMat(i_height, i_width, CV_32FC1);
+    cvInitUndistortMap(m_intrinsic, m_distortion, mapx, mapy);
+    m_table.build(mapx->data.fl, mapy->data.fl, i_width, i_height);
+    cvReleaseMat(&mapx);
+    cvReleaseMat(&mapy);
+    return true;
+}
+
 /*
   RTC::ReturnCode_t UndistortImage::onAborting(RTC::UniqueId ec_id)
   {
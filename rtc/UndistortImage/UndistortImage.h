@@ -19,6 +19,7 @@
 #include <cv.h>
 #include <highgui.h>
 #include "Img.hh"
+#include "RemapTable.h"
 
 // Service implementation headers
 // <rtc-template block="service_impl_h">
@@ -114,6 +115,7 @@ class UndistortImage
 
   // DataOutPort declaration
   // <rtc-template block="outport_declare">
+  Img::TimedCameraImage m_undistorted;
   OutPort<Img::TimedCameraImage> m_imageOut;
   
   // </rtc-template>
@@ -134,9 +136,14 @@ class UndistortImage
   // </rtc-template>
 
  private:
-    IplImage* m_cvImage;
+    bool buildTable(int i_width, int i_height);
+
     std::string m_calibFile;
+    int m_threads, m_debugLevel;
     CvMat *m_intrinsic, *m_distortion;
+    RemapTable m_table;
+    unsigned int m_nframes;
+    double m_elapsed, m_tReport;
     int dummy;
 };
 
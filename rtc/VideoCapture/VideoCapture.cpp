@@ -8,8 +8,12 @@
  */
 
 #include "util/VectorConvert.h"
+#include <cmath>
 #include "VideoCapture.h"
 
+// frame rate of synthetic and file sources[Hz]
+#define SOURCE_FRAME_RATE 30
+
 // Module specification
 // <rtc-template block="module_spec">
 static const char* videocapture_spec[] =
@@ -30,6 +34,9 @@ static const char* videocapture_spec[] =
     "conf.default.width", "640",
     "conf.default.height", "480",
     "conf.default.frameRate", "1",
+    "conf.default.source", "v4l",
+    "conf.default.syncTolerance", "0.01",
+    "conf.default.debugLevel", "0",
 
     ""
   };
@@ -64,6 +71,9 @@ RTC::ReturnCode_t VideoCapture::onInitialize()
   bindParameter("width", m_width, "640");
   bindParameter("height", m_height, "480");
   bindParameter("frameRate", m_frameRate, "1");
+  bindParameter("source", m_source, "v4l");
+  bindParameter("syncTolerance", m_syncTolerance, "0.01");
+  bindParameter("debugLevel", m_debugLevel, "0");
   
   // </rtc-template>
 
@@ -122,24 +132,49 @@ RTC::ReturnCode_t VideoCapture::onActivated(RTC::UniqueId ec_id)
     m_mode = SLEEP;
   }
 
-  if (m_devIds.size() == 1){
-    std::cout << "** devId:" << m_devIds[0] << std::endl;
-    v4l_capture *cam = new v4l_capture ();
-    if (cam->init(m_width, m_height, m_devIds[0]) != 0) return RTC::RTC_ERROR;
-    m_cameras.push_back (cam);
+  for (unsigned int i = 0; i < m_devIds.size (); i++)
+    {
+      v4l_capture *cam = new v4l_capture ();
+      int ret;
+      if (m_source == "synthetic"){
+	ret = cam->initSynthetic(m_width, m_height, SOURCE_FRAME_RATE);
+      }else if (m_source != "v4l"){
+	ret = cam->initFile(m_width, m_height, m_source, SOURCE_FRAME_RATE);
+      }else{
+	std::cout << "** devId:" << m_devIds[i] << std::endl;
+	ret = cam->init(m_width, m_height, m_devIds[i]);
+      }
+      if (ret != 0){
+	delete cam;
+	onDeactivated(ec_id);
+	return RTC::RTC_ERROR;
+      }
+      m_cameras.push_back (cam);
+    }
+  m_seqs.assign(m_cameras.size(), 0);
+  m_times.resize(m_cameras.size()*v4l_capture::HISTORY);
+  m_frameSeqs.resize(m_cameras.size()*v4l_capture::HISTORY);
+  m_counts.resize(m_cameras.size());
+  m_selected.resize(m_cameras.size());
+  m_latency.assign(m_cameras.size(), 0);
+  m_captured.assign(m_cameras.size(), 0);
+  m_lastSkew = 0;
+  m_skew = m_maxSkew = 0;
+  m_npublished = m_nunmatched = 0;
+  m_tReport = m_tOld;
+
+  if (m_cameras.size() == 1){
+    v4l_capture *cam = m_cameras[0];
     m_CameraImage.data.image.format = Img::CF_RGB;
     m_CameraImage.data.image.width = cam->getWidth ();
     m_CameraImage.data.image.height = cam->getHeight ();
     m_CameraImage.data.image.raw_data.length (cam->getWidth () * cam->getHeight () * 3);
   }else{
-    m_MultiCameraImages.data.image_seq.length (m_devIds.size ());
+    m_MultiCameraImages.data.image_seq.length (m_cameras.size ());
     m_MultiCameraImages.data.camera_set_id = 0;
-    for (unsigned int i = 0; i < m_devIds.size (); i++)
+    for (unsigned int i = 0; i < m_cameras.size (); i++)
       {
-	std::cout << "** devId:" << m_devIds[i] << std::endl;
-	v4l_capture *cam = new v4l_capture ();
-	cam->init(m_width, m_height, m_devIds[i]);
-	m_cameras.push_back (cam);
+	v4l_capture *cam = m_cameras[i];
 	m_MultiCameraImages.data.image_seq[i].image.format = Img::CF_RGB;
 	m_MultiCameraImages.data.image_seq[i].image.width = cam->getWidth ();
 	m_MultiCameraImages.data.image_seq[i].image.height = cam->getHeight ();
@@ -163,46 +198,170 @@ RTC::ReturnCode_t VideoCapture::onDeactivated(RTC::UniqueId ec_id)
 RTC::ReturnCode_t VideoCapture::onExecute(RTC::UniqueId ec_id)
 {
   //std::cout << m_profile.instance_name<< ": onExecute(" << ec_id << ")" << std::endl;
-  capture();
 
+  // frames are captured by threads of cameras, so only the newest frame
+  // is copied when it is published
   double tNew = (double)(coil::gettimeofday());
   double dt = (double)(tNew - m_tOld);
-  if (dt > 1.0/m_frameRate){
-    m_tOld = tNew;
-  }else{
-    return RTC::RTC_OK;
-  }
+  if (dt <= 1.0/m_frameRate) return RTC::RTC_OK;
 
   if (m_mode == SLEEP) return RTC::RTC_OK;
 
+  // wait for the next frame if no frame is captured after the last one
+  if (!capture()) return RTC::RTC_OK;
+  m_tOld = tNew;
+
   if (m_cameras.size() == 1){
     m_CameraImageOut.write();
   }else{
     m_MultiCameraImagesOut.write();
   }
+  if (m_debugLevel > 0) report((double)(coil::gettimeofday()));
 
   if (m_mode == ONESHOT) m_mode = SLEEP;
 
   return RTC::RTC_OK;
 }
 
-void VideoCapture::capture()
+namespace {
+  void setTime(RTC::Time& o_tm, double i_t)
+  {
+    o_tm.sec = (unsigned long)i_t;
+    o_tm.nsec = (unsigned long)((i_t - o_tm.sec)*1e9);
+  }
+}
+
+bool VideoCapture::capture()
 {
   if (m_cameras.size() == 1){
+    double tm;
+    if (!m_cameras[0]->getLatest(m_CameraImage.data.image.raw_data.get_buffer(),
+                                 tm, m_seqs[0])){
+      return false;
+    }
+    m_captured[0] = tm;
+    m_lastSkew = 0;
     m_CameraImage.error_code = 0;
-    uchar *imgFrom = m_cameras[0]->capture();
-    memcpy(m_CameraImage.data.image.raw_data.get_buffer(), imgFrom,
-	   m_CameraImage.data.image.raw_data.length() * sizeof(uchar));
-    return;
-  }else{
-    m_MultiCameraImages.error_code = 0;
+    setTime(m_CameraImage.tm, tm);
+    m_CameraImage.data.captured_time = m_CameraImage.tm;
+    return true;
+  }else if (m_syncTolerance <= 0){
+    // the newest frames of cameras
+    bool updated = false, first = true;
+    double tmin = 0, tmax = 0;
     for (unsigned int i = 0; i < m_cameras.size (); i++)
       {
-	uchar *imgFrom = m_cameras[i]->capture();
-	memcpy (m_MultiCameraImages.data.image_seq[i].image.raw_data.get_buffer(), imgFrom,
-		m_MultiCameraImages.data.image_seq[i].image.raw_data.length() * sizeof (uchar));
+	Img::CameraImage& image = m_MultiCameraImages.data.image_seq[i];
+	double tm;
+	if (m_cameras[i]->getLatest(image.image.raw_data.get_buffer(),
+				    tm, m_seqs[i])){
+	  setTime(image.captured_time, tm);
+	  m_captured[i] = tm;
+	  updated = true;
+	}
+	// cameras which haven't delivered a frame yet
+	if (m_captured[i] == 0) continue;
+	if (first || m_captured[i] < tmin) tmin = m_captured[i];
+	if (first || m_captured[i] > tmax) tmax = m_captured[i];
+	first = false;
       }
+    if (!updated) return false;
+    m_MultiCameraImages.error_code = 0;
+    setTime(m_MultiCameraImages.tm, tmax);
+    m_lastSkew = tmax - tmin;
+    return true;
+  }else{
+    return captureSynchronized();
+  }
+}
+
+bool VideoCapture::captureSynchronized()
+{
+  const unsigned int H = v4l_capture::HISTORY;
+  unsigned int ncam = m_cameras.size();
+  if (!ncam) return false;
+  for (unsigned int i = 0; i < ncam; i++){
+    m_counts[i] = m_cameras[i]->getTimes(&m_times[i*H], &m_frameSeqs[i*H]);
+    if (!m_counts[i]) return false;
+  }
+  // frames of the first camera from the newest one. Each of the others is
+  // matched to its frame which is captured at the nearest time
+  for (unsigned int k = 0; k < m_counts[0]; k++){
+    if (m_frameSeqs[k] <= m_seqs[0]) break;
+    double t0 = m_times[k];
+    double tmin = t0, tmax = t0;
+    m_selected[0] = m_frameSeqs[k];
+    bool matched = true;
+    for (unsigned int i = 1; i < ncam && matched; i++){
+      int best = -1;
+      for (unsigned int j = 0; j < m_counts[i]; j++){
+	if (m_frameSeqs[i*H+j] <= m_seqs[i]) break;
+	if (best < 0 || fabs(m_times[i*H+j] - t0) < fabs(m_times[i*H+best] - t0)){
+	  best = j;
+	}
+      }
+      if (best < 0){
+	matched = false;
+	break;
+      }
+      double t = m_times[i*H+best];
+      if (t < tmin) tmin = t;
+      if (t > tmax) tmax = t;
+      m_selected[i] = m_frameSeqs[i*H+best];
+      matched = tmax - tmin <= m_syncTolerance;
+    }
+    if (!matched) continue;
+
+    for (unsigned int i = 0; i < ncam; i++){
+      Img::CameraImage& image = m_MultiCameraImages.data.image_seq[i];
+      // a frame may be overwritten by the capture thread meanwhile
+      if (!m_cameras[i]->getFrame(m_selected[i],
+				  image.image.raw_data.get_buffer(),
+				  m_captured[i])){
+	return false;
+      }
+      setTime(image.captured_time, m_captured[i]);
+    }
+    for (unsigned int i = 0; i < ncam; i++) m_seqs[i] = m_selected[i];
+    m_MultiCameraImages.error_code = 0;
+    setTime(m_MultiCameraImages.tm, tmax);
+    m_lastSkew = tmax - tmin;
+    return true;
+  }
+  m_nunmatched++;
+  return false;
+}
+
+void VideoCapture::report(double i_tNow)
+{
+  // latency from dequeue to publication and skew between cameras,
+  // averaged over about one second
+  m_npublished++;
+  for (unsigned int i = 0; i < m_cameras.size(); i++){
+    m_latency[i] += i_tNow - m_captured[i];
+  }
+  m_skew += m_lastSkew;
+  if (m_lastSkew > m_maxSkew) m_maxSkew = m_lastSkew;
+  if (i_tNow - m_tReport < 1.0 && m_debugLevel <= 1) return;
+
+  m_tReport = i_tNow;
+  std::cout << m_profile.instance_name << ": latency[ms] =";
+  for (unsigned int i = 0; i < m_cameras.size(); i++){
+    std::cout << " " << m_latency[i]/m_npublished*1e3;
+    m_latency[i] = 0;
+  }
+  std::cout << ", conversion[ms] =";
+  for (unsigned int i = 0; i < m_cameras.size(); i++){
+    std::cout << " " << m_cameras[i]->getConvertTime()*1e3;
+  }
+  if (m_cameras.size() > 1){
+    std::cout << ", skew[ms] = " << m_skew/m_npublished*1e3
+              << "(max " << m_maxSkew*1e3 << "), unmatched = "
+              << m_nunmatched;
   }
+  std::cout << std::endl;
+  m_npublished = m_nunmatched = 0;
+  m_skew = m_maxSkew = 0;
 }
 
 /*
@@ -97,7 +97,7 @@ class VideoCapture
   // no corresponding operation exists in OpenRTm-aist-0.2.0
   // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
 
-    void capture();
+    bool capture();
   void take_one_frame();
   void start_continuous();
   void stop_continuous();
@@ -140,11 +140,28 @@ class VideoCapture
   // </rtc-template>
 
  private:
+  bool captureSynchronized();
+  void report(double i_tNow);
   typedef enum {SLEEP, ONESHOT, CONTINUOUS} mode;
   mode m_mode;
   std::string m_initialMode;
   std::vector<int> m_devIds;
   std::vector < v4l_capture * > m_cameras;
+  // sequence numbers of the last frames of cameras
+  std::vector < unsigned int > m_seqs;
+  std::string m_source;
+  // tolerance of difference of times when frames are captured[s]
+  double m_syncTolerance;
+  int m_debugLevel;
+  // buffers to match frames of cameras
+  std::vector < double > m_times;
+  std::vector < unsigned int > m_frameSeqs, m_counts, m_selected;
+  // times when published frames were captured
+  std::vector < double > m_captured;
+  // statistics reported when debugLevel > 0
+  std::vector < double > m_latency;
+  double m_lastSkew, m_skew, m_maxSkew, m_tReport;
+  unsigned int m_npublished, m_nunmatched;
   int m_width, m_height, m_frameRate;
   double m_tOld;
 };
@@ -1,22 +1,75 @@
 #include <cstdio>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <algorithm>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <boost/bind.hpp>
 
 #include "camera.h"
 
+namespace {
+  double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1e6;
+  }
+
+  // saturation table, y + (difference of color) is in [-277, 533]
+  const int SAT_OFFSET = 384;
+  struct SaturationTable
+  {
+    uchar values[1024];
+    SaturationTable()
+    {
+      for (int i = 0; i < 1024; i++) {
+        values[i] = std::min(std::max(i - SAT_OFFSET, 0), 255);
+      }
+    }
+  } saturation;
+}
+
+void yuyv2rgb(const uchar *i_yuyv, uchar *o_rgb, unsigned int i_npixels)
+{
+  // ITU-R BT.601 coefficients in 16 bit fixed point
+  const int RV = 91881, GU = 22554, GV = 46802, BU = 116130;
+  const int HALF = 1 << 15;
+  const uchar *sat = saturation.values + SAT_OFFSET;
+  for (unsigned int i = 0; i < i_npixels; i += 2, i_yuyv += 4, o_rgb += 6) {
+    int y0 = i_yuyv[0], u = i_yuyv[1] - 128;
+    int y1 = i_yuyv[2], v = i_yuyv[3] - 128;
+    int dr = (RV * v + HALF) >> 16;
+    int dg = (GU * u + GV * v + HALF) >> 16;
+    int db = (BU * u + HALF) >> 16;
+    o_rgb[0] = sat[y0 + dr];
+    o_rgb[1] = sat[y0 - dg];
+    o_rgb[2] = sat[y0 + db];
+    o_rgb[3] = sat[y1 + dr];
+    o_rgb[4] = sat[y1 - dg];
+    o_rgb[5] = sat[y1 + db];
+  }
+}
+
 /* raw camera member functions */
 v4l_capture::v4l_capture()
   : dev_name(""), fd(-1), width(640), height(480),
-    buffers(NULL), n_buffers(0)
+    buffers(NULL), n_buffers(0), mem_period(0),
+    convert_time(0), ready_seq(0), frame_seq(0),
+    n_converted(0), thread(NULL), quit(false)
 {};
 
 v4l_capture::~v4l_capture()
 {
-  stop_capturing();
-  uninit_device();
-  close_device();
+  stop_thread();
+  if (fd != -1) {
+    stop_capturing();
+    uninit_device();
+    close_device();
+  }
 };
 
 int
@@ -25,15 +78,199 @@ v4l_capture::init(size_t _width, size_t _height, unsigned int devId)
   width = _width;
   height = _height;
   if (!init_all(width, height, devId)) return -1;
-  frame = cv::Mat(height, width, CV_8UC3);
+  start_thread();
   return 0;
 }
 
+int
+v4l_capture::initSynthetic(size_t _width, size_t _height, double _fps)
+{
+  width = _width;
+  height = _height;
+  // moving color bars
+  const unsigned int n = 8;
+  mem_frames.resize(n);
+  for (unsigned int k = 0; k < n; k++) {
+    std::vector<uchar>& f = mem_frames[k];
+    f.resize(width * height * 2);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x += 2) {
+        uchar *p = &f[(y * width + x) * 2];
+        int bar = ((x + k * width / n) % width) * 8 / width;
+        p[0] = p[2] = (y * 255 / height + bar * 16) & 0xff;
+        p[1] = bar * 32;
+        p[3] = 255 - bar * 32;
+      }
+    }
+  }
+  mem_period = 1.0 / _fps;
+  start_thread();
+  return 0;
+}
+
+int
+v4l_capture::initFile(size_t _width, size_t _height,
+                      const std::string& _filename, double _fps)
+{
+  width = _width;
+  height = _height;
+  std::ifstream ifs(_filename.c_str(), std::ios::in | std::ios::binary);
+  if (!ifs.is_open()) {
+    fprintf(stderr, "Cannot open '%s'\n", _filename.c_str());
+    return -1;
+  }
+  mem_frames.clear();
+  std::vector<uchar> f(width * height * 2);
+  while (ifs.read((char *)&f[0], f.size())) {
+    mem_frames.push_back(f);
+  }
+  if (mem_frames.empty()) {
+    fprintf(stderr, "No frame of %dx%d in '%s'\n", width, height,
+            _filename.c_str());
+    return -1;
+  }
+  mem_period = 1.0 / _fps;
+  start_thread();
+  return 0;
+}
+
+void
+v4l_capture::start_thread()
+{
+  back.resize(width * height * 3);
+  for (int i = 0; i < HISTORY; i++) {
+    history[i].resize(width * height * 3);
+    history_time[i] = 0;
+  }
+  frame.resize(width * height * 3);
+  quit = false;
+  thread = new boost::thread(boost::bind(&v4l_capture::capture_loop, this));
+}
+
+void
+v4l_capture::stop_thread()
+{
+  if (!thread) return;
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    quit = true;
+  }
+  thread->join();
+  delete thread;
+  thread = NULL;
+}
+
+bool
+v4l_capture::quitting()
+{
+  boost::mutex::scoped_lock lock(mutex);
+  return quit;
+}
+
+void
+v4l_capture::capture_loop()
+{
+  unsigned int k = 0;
+  double next = now();
+  while (!quitting()) {
+    if (mem_frames.empty()) {
+      if (!read_frame()) break;
+    } else {
+      // keep the frame rate
+      next += mem_period;
+      double dt = next - now();
+      if (dt > 0) {
+        usleep(dt * 1e6);
+      } else {
+        next = now();
+      }
+      read_mem_frame(k++ % mem_frames.size());
+    }
+  }
+  // wake up capture()
+  boost::mutex::scoped_lock lock(mutex);
+  quit = true;
+  cond.notify_all();
+}
+
+void
+v4l_capture::publish(const uchar *yuyv, double tm)
+{
+  double t1 = now();
+  yuyv2rgb(yuyv, &back[0], width * height);
+  double t2 = now();
+  boost::mutex::scoped_lock lock(mutex);
+  ready_seq++;
+  back.swap(history[ready_seq % HISTORY]);
+  history_time[ready_seq % HISTORY] = tm;
+  convert_time += t2 - t1;
+  n_converted++;
+  cond.notify_all();
+}
+
+bool
+v4l_capture::read_mem_frame(unsigned int i)
+{
+  publish(&mem_frames[i][0], now());
+  return true;
+}
+
 uchar *
 v4l_capture::capture ()
 {
-  write_img(frame.data);
-  return frame.data;
+  boost::mutex::scoped_lock lock(mutex);
+  while (ready_seq == frame_seq && !quit) cond.wait(lock);
+  if (ready_seq == frame_seq) return NULL;
+  memcpy(&frame[0], &history[ready_seq % HISTORY][0], frame.size());
+  frame_seq = ready_seq;
+  return &frame[0];
+}
+
+bool
+v4l_capture::getLatest (uchar *o_rgb, double &o_tm, unsigned int &io_seq)
+{
+  boost::mutex::scoped_lock lock(mutex);
+  if (ready_seq == io_seq) return false;
+  const std::vector<uchar>& ready = history[ready_seq % HISTORY];
+  memcpy(o_rgb, &ready[0], ready.size());
+  o_tm = history_time[ready_seq % HISTORY];
+  io_seq = ready_seq;
+  return true;
+}
+
+unsigned int
+v4l_capture::getTimes (double *o_times, unsigned int *o_seqs)
+{
+  boost::mutex::scoped_lock lock(mutex);
+  unsigned int n = 0;
+  for (unsigned int seq = ready_seq; seq > 0 && n < HISTORY; seq--, n++) {
+    o_times[n] = history_time[seq % HISTORY];
+    o_seqs[n] = seq;
+  }
+  return n;
+}
+
+bool
+v4l_capture::getFrame (unsigned int i_seq, uchar *o_rgb, double &o_tm)
+{
+  boost::mutex::scoped_lock lock(mutex);
+  if (i_seq == 0 || i_seq > ready_seq || i_seq + HISTORY <= ready_seq) {
+    return false;
+  }
+  const std::vector<uchar>& f = history[i_seq % HISTORY];
+  memcpy(o_rgb, &f[0], f.size());
+  o_tm = history_time[i_seq % HISTORY];
+  return true;
+}
+
+double
+v4l_capture::getConvertTime ()
+{
+  boost::mutex::scoped_lock lock(mutex);
+  double t = n_converted ? convert_time / n_converted : 0;
+  convert_time = 0;
+  n_converted = 0;
+  return t;
 }
 
 
@@ -82,37 +319,23 @@ void v4l_capture::close_device(void)
   fd = -1;
 }
 
-void v4l_capture::write_img(uchar* ret)
+bool v4l_capture::read_frame(void)
 {
-  read_frame();
-
-  for (int i = 0; i < width * height; i += 2) {
-    int y, r, g, b;
-    int u, v;
-    y = ((unsigned char *) buffers[0].start)[i * 2];
-    u = ((unsigned char *) buffers[0].start)[i * 2 + 1] - 128;
-    v = ((unsigned char *) buffers[0].start)[i * 2 + 3] - 128;
-
-    r = y + 1.40200 * v;
-    g = y - 0.71414 * v - 0.34414 * u;
-    b = y + 1.77200 * u;
-    ret[i * 3 + 0] = (unsigned char) (std::min(std::max(r, 0), 255));
-    ret[i * 3 + 1] = (unsigned char) (std::min(std::max(g, 0), 255));
-    ret[i * 3 + 2] = (unsigned char) (std::min(std::max(b, 0), 255));
-
-    y = ((unsigned char *) buffers[0].start)[(i + 1) * 2];
-
-    r = y + 1.40200 * v;
-    g = y - 0.71414 * v - 0.34414 * u;
-    b = y + 1.77200 * u;
-    ret[(i + 1) * 3 + 0] = (unsigned char) (std::min(std::max(r, 0), 255));
-    ret[(i + 1) * 3 + 1] = (unsigned char) (std::min(std::max(g, 0), 255));
-    ret[(i + 1) * 3 + 2] = (unsigned char) (std::min(std::max(b, 0), 255));
+  // wait for a frame with timeout to check quit
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(fd, &fds);
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = 100000;
+  int r = select(fd + 1, &fds, NULL, NULL, &tv);
+  if (r == -1) {
+    if (errno == EINTR) return true;
+    perror("select");
+    return false;
   }
-}
+  if (r == 0) return true;
 
-void v4l_capture::read_frame(void)
-{
   struct v4l2_buffer buf;
 
   memset (&(buf), 0, sizeof (buf));
@@ -121,15 +344,21 @@ void v4l_capture::read_frame(void)
   buf.memory = V4L2_MEMORY_MMAP;
 
   if (ioctl(fd, VIDIOC_DQBUF, &buf) == -1) {
+    if (errno == EAGAIN) return true;
     perror("VIDIOC_DQBUF");
-    exit(EXIT_FAILURE);
+    return false;
   }
+  double tm = now();
   assert(buf.index < n_buffers);
 
+  publish((const uchar *)buffers[buf.index].start, tm);
+
+  // the other buffers are kept queued while this one is converted
   if (ioctl(fd, VIDIOC_QBUF, &buf) == -1) {
     perror("VIDIOC_QBUF");
-    exit(EXIT_FAILURE);
+    return false;
   }
+  return true;
 }
 
 void v4l_capture::init_mmap(void)
@@ -6,19 +6,51 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/**
+   \brief convert YUYV(YUV 4:2:2) pixels to RGB with integer arithmetic
+   \param i_npixels the number of pixels, which must be even
+ */
+void yuyv2rgb(const uchar *i_yuyv, uchar *o_rgb, unsigned int i_npixels);
 
 /* v4l2 capture class */
+/*
+  Frames are dequeued, converted to RGB and then queued again by a capture
+  thread, so several buffers are kept queued in the driver. The newest
+  converted frame is given to the caller with the time when it was
+  dequeued. Instead of a device, frames in memory, which are generated or
+  read from a file, can be used to run without a camera.
+*/
 class v4l_capture
 {
+ public:
+  // the number of the newest frames which are kept
+  enum { HISTORY = 4 };
+ private:
   typedef struct _buffer {
     void *start;
     size_t length;
   } buffer;
-  cv::Mat frame;
   std::string dev_name;
   int fd, width, height;
   buffer *buffers;
   unsigned int n_buffers;
+  // frames in memory and their period[s]
+  std::vector<std::vector<uchar> > mem_frames;
+  double mem_period;
+  // frame being written by the capture thread and the newest frames. A
+  // frame whose sequence number is seq is stored in history[seq%HISTORY]
+  std::vector<uchar> back, history[HISTORY], frame;
+  double history_time[HISTORY], convert_time;
+  unsigned int ready_seq, frame_seq, n_converted;
+  boost::mutex mutex;
+  boost::condition_variable cond;
+  boost::thread *thread;
+  bool quit;
   bool open_device();
   void init_device();
   void init_mmap();
@@ -27,14 +59,60 @@ class v4l_capture
   void uninit_device();
   void uninit_mmap();
   void close_device();
-  void read_frame(void);
-  void write_img(uchar * ret);
+  bool read_frame(void);
+  bool read_mem_frame(unsigned int i);
+  void publish(const uchar *yuyv, double tm);
+  void capture_loop();
+  bool quitting();
+  void start_thread();
+  void stop_thread();
   bool init_all(size_t _width, size_t _height, unsigned int _devId);
  public:
   v4l_capture();
   ~v4l_capture();
+  /**
+     \brief wait for a new frame
+     \return pointer to the RGB image, which is valid until the next call
+   */
   uchar *capture ();
+  /**
+     \brief copy the newest frame if it is newer than the last one
+     \param o_rgb buffer of width*height*3 bytes
+     \param o_tm time when the frame was dequeued[s]
+     \param io_seq sequence number of the last frame, which is updated
+     \return true if a new frame is copied
+   */
+  bool getLatest (uchar *o_rgb, double &o_tm, unsigned int &io_seq);
+  /**
+     \brief get times of frames kept in the history to find frames which
+     are captured at the same time by cameras
+     \param o_times times when frames were dequeued[s], from the newest one
+     \param o_seqs sequence numbers of frames
+     \return the number of frames, HISTORY at most
+   */
+  unsigned int getTimes (double *o_times, unsigned int *o_seqs);
+  /**
+     \brief copy a frame in the history
+     \param i_seq sequence number given by getTimes()
+     \return false if the frame is already overwritten
+   */
+  bool getFrame (unsigned int i_seq, uchar *o_rgb, double &o_tm);
+  /**
+     \brief average time to convert a frame[s], which is reset by this call
+   */
+  double getConvertTime ();
   int getHeight ();
   int getWidth ();
   int init (size_t _width, size_t _height, unsigned int devId);
+  /**
+     \brief use generated frames instead of a device
+     \param _fps frame rate[Hz]
+   */
+  int initSynthetic (size_t _width, size_t _height, double _fps);
+  /**
+     \brief use frames read from a file of raw YUYV frames
+     \param _fps frame rate[Hz]
+   */
+  int initFile (size_t _width, size_t _height, const std::string& _filename,
+                double _fps);
 };
@@ -1,9 +1,13 @@
 #include "camera.h"
 #include <fstream>
+#include <iostream>
+#include <sys/time.h>
 
 int main(int argc, char *argv[])
 {
-    int w=640, h=480, n=1;
+    int w=640, h=480, n=1, nframes=1;
+    double fps=1000;
+    std::string source;
     for (int i=1; i<argc; i++){
         if (strcmp(argv[i], "-w") == 0){
             w = atoi(argv[++i]);
@@ -11,24 +15,57 @@ int main(int argc, char *argv[])
             h = atoi(argv[++i]);
         }else if (strcmp(argv[i], "-n") == 0){
             n = atoi(argv[++i]);
+        }else if (strcmp(argv[i], "-s") == 0){
+            source = "synthetic";
+        }else if (strcmp(argv[i], "-f") == 0){
+            source = argv[++i];
+        }else if (strcmp(argv[i], "-r") == 0){
+            fps = atof(argv[++i]);
+        }else if (strcmp(argv[i], "-b") == 0){
+            nframes = atoi(argv[++i]);
         }
     }
 
     v4l_capture cam;
 
-    if (cam.init(w, h, n) != 0){
-        std::cerr << "failed to initialize device(/dev/video" << n << ")" 
+    int ret;
+    if (source == "synthetic"){
+        ret = cam.initSynthetic(w, h, fps);
+    }else if (source != ""){
+        ret = cam.initFile(w, h, source, fps);
+    }else{
+        ret = cam.init(w, h, n);
+    }
+    if (ret != 0){
+        std::cerr << "failed to initialize device(/dev/video" << n << ")"
                   << std::endl;
         return 1;
     }
 
-    uchar *img = cam.capture();
+    // with -b, measure throughput of capture and conversion
+    struct timeval t1, t2;
+    gettimeofday(&t1, NULL);
+    uchar *img = NULL;
+    for (int i=0; i<nframes; i++){
+        img = cam.capture();
+        if (!img){
+            std::cerr << "failed to capture" << std::endl;
+            return 1;
+        }
+    }
+    gettimeofday(&t2, NULL);
+    if (nframes > 1){
+        double dt = t2.tv_sec - t1.tv_sec + (t2.tv_usec - t1.tv_usec)/1e6;
+        std::cout << nframes << " frames, " << nframes/dt << "[fps], "
+                  << cam.getConvertTime()*1e3 << "[ms/frame] for conversion"
+                  << std::endl;
+    }
 
     std::ofstream ofs("test.ppm");
     ofs << "P6" << std::endl;
     ofs << w << " " << h << std::endl;
     ofs << "255" << std::endl;
-    ofs.write((const char *)img, w*h*3); 
+    ofs.write((const char *)img, w*h*3);
 
     return 0;
 }
@@ -47,6 +47,7 @@ static const char* virtualcamera_spec[] =
     "conf.default.generateRange", "1",
     "conf.default.generatePointCloud", "0",
     "conf.default.generatePointCloudStep", "1",
+    "conf.default.generatePointCloudThreads", "1",
     "conf.default.pcFormat", "xyz",
     "conf.default.generateMovie", "0",
     "conf.default.debugLevel", "0",
@@ -103,6 +104,7 @@ RTC::ReturnCode_t VirtualCamera::onInitialize()
     bindParameter("generateRange",      m_generateRange, "1");
     bindParameter("generatePointCloud", m_generatePointCloud, "0");
     bindParameter("generatePointCloudStep",  m_generatePointCloudStep, "1");
+    bindParameter("generatePointCloudThreads",  m_generatePointCloudThreads, "1");
     bindParameter("pcFormat", 	      m_pcFormat, ref["conf.default.pcFormat"].c_str());
     bindParameter("generateMovie",      m_generateMovie, "0");
     bindParameter("debugLevel",         m_debugLevel, "0");
@@ -271,6 +273,7 @@ RTC::ReturnCode_t VirtualCamera::onActivated(RTC::UniqueId ec_id)
     m_image.data.image.height = m_camera->height();
     m_image.data.image.format = Img::CF_RGB;
     m_image.data.image.raw_data.length(m_image.data.image.width*m_image.data.image.height*3);
+    m_cloud.type = "";
 
     return RTC::RTC_OK;
 }
@@ -365,6 +368,8 @@ RTC::ReturnCode_t VirtualCamera::onExecute(RTC::UniqueId ec_id)
     m_poseSensor.data.orientation.y = rpy[2];
 
     coil::TimeValue t2(coil::gettimeofday());
+    m_unprojector.setup(m_camera->width(), m_camera->height(),
+                        m_camera->fovy(), m_camera->near(), m_camera->far());
     if (m_generateRange) setupRangeData();
     coil::TimeValue t3(coil::gettimeofday());
     if (m_generatePointCloud) setupPointCloud();
@@ -432,11 +437,9 @@ void VirtualCamera::setupRangeData()
 {
     int w = m_camera->width();
     int h = m_camera->height();
-    float depth[w];
+    float *depth = m_unprojector.depthBuffer();
     glReadPixels(0, h/2, w, 1, GL_DEPTH_COMPONENT, GL_FLOAT, depth);
-    double far = m_camera->far();
-    double near = m_camera->near();
-    double fovx = 2*atan(w*tan(m_camera->fovy()/2)/h);
+    double fovx = m_unprojector.fovx();
     RangerConfig &rc = m_range.config;
     double max = ((int)(fovx/2/rc.angularRes))*rc.angularRes;
     if (rc.maxAngle >  max) rc.maxAngle =  max;
@@ -444,17 +447,15 @@ void VirtualCamera::setupRangeData()
     unsigned int nrange = round((rc.maxAngle - rc.minAngle)/rc.angularRes)+1;
     //std::cout << "nrange = " << nrange << std::endl;
     m_range.ranges.length(nrange);
-#define THETA(x) (-atan(((x)-w/2)*2*tan(fovx/2)/w))
-#define RANGE(d,th) (-far*near/((d)*(far-near)-far)/cos(th))
-    double dth, alpha, th, th_old = THETA(w-1);
-    double r, r_old = RANGE(depth[w-1], th_old);
+    double dth, alpha, th, th_old = m_unprojector.columnAngle(w-1);
+    double r, r_old = m_unprojector.range(w-1, depth[w-1]);
     int idx = w-2;
     double angle;
     for (unsigned int i=0; i<nrange; i++){
         angle = rc.minAngle + rc.angularRes*i;
         while(idx >= 0){
-            th = THETA(idx);
-            r = RANGE(depth[idx], th);
+            th = m_unprojector.columnAngle(idx);
+            r = m_unprojector.range(idx, depth[idx]);
             idx--;
             if (th > angle){
                 //std::cout << idx << ":" << th << std::endl;
@@ -490,78 +491,60 @@ void VirtualCamera::setupPointCloud()
 {
     int w = m_camera->width();
     int h = m_camera->height();
-    float depth[w*h];
     m_cloud.width = w;
     m_cloud.height = h;
-    m_cloud.type = m_pcFormat.c_str();
-    bool colored = false;
-    if (m_pcFormat == "xyz"){
-        m_cloud.fields.length(3);
-    }else if (m_pcFormat == "xyzrgb"){
-        m_cloud.fields.length(6);
-        colored = true;
-    }else{
-        std::cerr << "unknown point cloud format:[" << m_pcFormat << "]" << std::endl;
-    }
-    m_cloud.fields[0].name = "x";
-    m_cloud.fields[0].offset = 0;
-    m_cloud.fields[0].data_type = PointCloudTypes::FLOAT32;
-    m_cloud.fields[0].count = 4;
-    m_cloud.fields[1].name = "y";
-    m_cloud.fields[1].offset = 4;
-    m_cloud.fields[1].data_type = PointCloudTypes::FLOAT32;
-    m_cloud.fields[1].count = 4;
-    m_cloud.fields[2].name = "z";
-    m_cloud.fields[2].offset = 8;
-    m_cloud.fields[2].data_type = PointCloudTypes::FLOAT32;
-    m_cloud.fields[2].count = 4;
-    if (m_pcFormat == "xyzrgb"){
-        m_cloud.fields[3].name = "r";
-        m_cloud.fields[3].offset = 12;
-        m_cloud.fields[3].data_type = PointCloudTypes::UINT8;
-        m_cloud.fields[3].count = 1;
-        m_cloud.fields[4].name = "g";
-        m_cloud.fields[4].offset = 13;
-        m_cloud.fields[4].data_type = PointCloudTypes::UINT8;
-        m_cloud.fields[4].count = 1;
-        m_cloud.fields[5].name = "b";
-        m_cloud.fields[5].offset = 14;
-        m_cloud.fields[5].data_type = PointCloudTypes::UINT8;
-        m_cloud.fields[5].count = 1;
+    bool colored = m_pcFormat == "xyzrgb";
+    if (m_pcFormat != (const char *)m_cloud.type){
+        // fields are rebuilt only when the format is changed
+        m_cloud.type = m_pcFormat.c_str();
+        if (m_pcFormat == "xyz"){
+            m_cloud.fields.length(3);
+        }else if (m_pcFormat == "xyzrgb"){
+            m_cloud.fields.length(6);
+        }else{
+            std::cerr << "unknown point cloud format:[" << m_pcFormat << "]" << std::endl;
+        }
+        m_cloud.fields[0].name = "x";
+        m_cloud.fields[0].offset = 0;
+        m_cloud.fields[0].data_type = PointCloudTypes::FLOAT32;
+        m_cloud.fields[0].count = 4;
+        m_cloud.fields[1].name = "y";
+        m_cloud.fields[1].offset = 4;
+        m_cloud.fields[1].data_type = PointCloudTypes::FLOAT32;
+        m_cloud.fields[1].count = 4;
+        m_cloud.fields[2].name = "z";
+        m_cloud.fields[2].offset = 8;
+        m_cloud.fields[2].data_type = PointCloudTypes::FLOAT32;
+        m_cloud.fields[2].count = 4;
+        if (m_pcFormat == "xyzrgb"){
+            m_cloud.fields[3].name = "r";
+            m_cloud.fields[3].offset = 12;
+            m_cloud.fields[3].data_type = PointCloudTypes::UINT8;
+            m_cloud.fields[3].count = 1;
+            m_cloud.fields[4].name = "g";
+            m_cloud.fields[4].offset = 13;
+            m_cloud.fields[4].data_type = PointCloudTypes::UINT8;
+            m_cloud.fields[4].count = 1;
+            m_cloud.fields[5].name = "b";
+            m_cloud.fields[5].offset = 14;
+            m_cloud.fields[5].data_type = PointCloudTypes::UINT8;
+            m_cloud.fields[5].count = 1;
+        }
+        m_cloud.is_bigendian = false;
+        m_cloud.point_step = 16;
+        m_cloud.is_dense = true;
     }
-    m_cloud.is_bigendian = false;
-    m_cloud.point_step = 16;
+    // capacity of the sequence is kept while shrinking, so this doesn't
+    // reallocate unless the resolution grows
     m_cloud.data.length(w*h*m_cloud.point_step);// will be shrinked later
     m_cloud.row_step = m_cloud.point_step*w;
-    m_cloud.is_dense = true;
-    double far = m_camera->far();
-    double near = m_camera->near();
-    double fovx = 2*atan(w*tan(m_camera->fovy()/2)/h);
-    double zs = w/(2*tan(fovx/2));
-    unsigned int npoints=0;
-    float *ptr = (float *)m_cloud.data.get_buffer();
-    unsigned char *rgb = m_image.data.image.raw_data.get_buffer();
+    float *depth = m_unprojector.depthBuffer();
     glReadPixels(0,0, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, depth);
-    for (int i=0; i<h; i+=m_generatePointCloudStep){
-        for (int j=0; j<w; j+=m_generatePointCloudStep){
-            float d = depth[i*w+j];
-            if (d == 1.0) {
-                continue;
-            }
-            ptr[2] = far*near/(d*(far-near)-far);
-            ptr[0] = -(j-w/2)*ptr[2]/zs;
-            ptr[1] = -(i-h/2)*ptr[2]/zs;
-            if (colored){
-                unsigned char *c = (unsigned char *)(ptr + 3);
-                int offset = ((h-1-i)*w+j)*3;
-                c[0] = rgb[offset];
-                c[1] = rgb[offset+1];
-                c[2] = rgb[offset+2];
-            }
-            ptr += 4;
-            npoints++;
-        }
-    }
+    unsigned int npoints = m_unprojector.unproject(
+        depth, (float *)m_cloud.data.get_buffer(),
+        m_generatePointCloudStep,
+        colored ? m_image.data.image.raw_data.get_buffer() : NULL,
+        m_generatePointCloudThreads);
     m_cloud.data.length(npoints*m_cloud.point_step);
 }
 /*
@@ -27,6 +27,7 @@
 #include "HRPDataTypes.hh"
 #include "pointcloud.hh"
 #include "GLscene.h"
+#include "util/DepthUnprojector.h"
 class GLcamera;
 class RTCGLbody;
 
@@ -167,7 +168,9 @@ class VirtualCamera
   bool m_generateRange;
   bool m_generatePointCloud;
   int m_generatePointCloudStep;
+  int m_generatePointCloudThreads;
   std::string m_pcFormat;
+  DepthUnprojector m_unprojector;
   bool m_generateMovie, m_isGeneratingMovie;
   int m_debugLevel;
   CvVideoWriter *m_videoWriter;
@@ -28,6 +28,7 @@ static const char* virtualforcesensor_spec[] =
     "lang_type",         "compile",
     // Configuration variables
     "conf.default.debugLevel", "0",
+    "conf.default.useKinematicsCache", "0",
     ""
   };
 // </rtc-template>
@@ -39,7 +40,9 @@ VirtualForceSensor::VirtualForceSensor(RTC::Manager* manager)
     m_tauInIn("tauIn", m_tauIn),
     m_VirtualForceSensorServicePort("VirtualForceSensorService"),
     // </rtc-template>
-    m_debugLevel(0)
+    m_debugLevel(0),
+    m_useKinematicsCache(false),
+    m_kinematicsCache(NULL)
 {
   m_service0.vfsensor(this);
 }
@@ -56,6 +59,7 @@ RTC::ReturnCode_t VirtualForceSensor::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("debugLevel", m_debugLevel, "0");
+  bindParameter("useKinematicsCache", m_useKinematicsCache, "0");
   
   // </rtc-template>
 
@@ -97,6 +101,7 @@ RTC::ReturnCode_t VirtualForceSensor::onInitialize()
               << m_profile.instance_name << std::endl;
     return RTC::RTC_ERROR;
   }
+  m_kinematicsCacheKey = prop["model"];
 
   // virtual_force_sensor: <name>, <base>, <target>, 0, 0, 0,  0, 0, 1, 0
   coil::vstring virtual_force_sensor = coil::split(prop["virtual_force_sensor"], ",");
@@ -165,6 +170,10 @@ RTC::ReturnCode_t VirtualForceSensor::onShutdown(RTC::UniqueId ec_id)
 RTC::ReturnCode_t VirtualForceSensor::onActivated(RTC::UniqueId ec_id)
 {
   std::cerr << "[" << m_profile.instance_name<< "] onActivated(" << ec_id << ")" << std::endl;
+  // a copy of the body is registered only when the cache is enabled
+  if (m_useKinematicsCache && !m_kinematicsCache && !m_kinematicsCacheKey.empty()){
+    m_kinematicsCache = KinematicsCache::attach(m_kinematicsCacheKey, m_robot);
+  }
   return RTC::RTC_OK;
 }
 
@@ -199,9 +208,13 @@ RTC::ReturnCode_t VirtualForceSensor::onExecute(RTC::UniqueId ec_id)
     for ( int i = 0; i < m_robot->numJoints(); i++ ){
       m_robot->joint(i)->q = m_qCurrent.data[i];
     }
-    m_robot->calcForwardKinematics();
-    m_robot->calcCM();
-    m_robot->rootLink()->calcSubMassCM();
+    if (m_useKinematicsCache && m_kinematicsCache){
+      m_kinematicsCache->calcForwardKinematics(m_robot);
+    }else{
+      m_robot->calcForwardKinematics();
+      m_robot->calcCM();
+      m_robot->rootLink()->calcSubMassCM();
+    }
 
     std::map<std::string, VirtualForceSensorParam>::iterator it = m_sensors.begin();
     int i = 0;
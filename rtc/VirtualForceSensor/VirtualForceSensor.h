@@ -21,6 +21,7 @@
 #include <hrpModel/Link.h>
 #include <hrpModel/JointPath.h>
 #include <hrpUtil/EigenTypes.h>
+#include "util/KinematicsCache.h"
 
 #include "VirtualForceSensorService_impl.h"
 
@@ -161,6 +162,9 @@ class VirtualForceSensor
   double m_dt;
   hrp::BodyPtr m_robot;
   unsigned int m_debugLevel;
+  bool m_useKinematicsCache;
+  KinematicsCache *m_kinematicsCache;
+  std::string m_kinematicsCacheKey;
 
   bool calcRawVirtualForce(std::string sensorName, hrp::dvector &outputForce);
   
@@ -0,0 +1,245 @@
+// -*- C++ -*-
+/*!
+ * @file  VoxelGridDownsampler.cpp
+ * @brief voxel grid downsampler based on a reusable voxel hash
+ */
+#include <cmath>
+#include <boost/bind.hpp>
+#include "VoxelGridDownsampler.h"
+
+// voxel indices are packed into 21 bits each
+#define INDEX_BITS   21
+#define INDEX_OFFSET (1<<(INDEX_BITS-1))
+#define INVALID_KEY  (~0ULL)
+#define MIN_TABLE_SIZE 1024
+
+static inline unsigned long long hashKey(unsigned long long i_key)
+{
+    return i_key*0x9E3779B97F4A7C15ULL;
+}
+
+static inline unsigned int slotOf(unsigned long long i_hash)
+{
+    return (unsigned int)(i_hash ^ (i_hash >> 31));
+}
+
+static inline unsigned int partitionOf(unsigned long long i_hash,
+                                       unsigned int i_nparts)
+{
+    return (unsigned int)(i_hash >> 32) % i_nparts;
+}
+
+VoxelGridDownsampler::VoxelGridDownsampler() :
+    m_invSize(100), m_nthreads(1), m_stamp(0),
+    m_points(NULL), m_npoints(0), m_pointStep(16), m_colored(false),
+    m_output(NULL), m_stage(KEYS)
+{
+    m_parts.resize(1);
+}
+
+void VoxelGridDownsampler::setLeafSize(double i_size)
+{
+    m_invSize = 1.0/i_size;
+}
+
+void VoxelGridDownsampler::setNumThreads(int i_nthreads)
+{
+    if (i_nthreads < 1) i_nthreads = 1;
+    if (i_nthreads == m_nthreads) return;
+    m_pool.setNumThreads(i_nthreads);
+    m_nthreads = i_nthreads;
+    m_parts.resize(m_nthreads);
+    // a voxel may belong to another partition now
+    for (unsigned int i=0; i<m_parts.size(); i++){
+        m_parts[i].table.clear();
+        m_parts[i].mask = 0;
+    }
+}
+
+void VoxelGridDownsampler::run(int i_part)
+{
+    switch(m_stage){
+    case KEYS:       computeKeys(i_part); break;
+    case SCATTER:    scatter(i_part); break;
+    case ACCUMULATE: accumulate(i_part); break;
+    case EMIT:       emit(i_part); break;
+    }
+}
+
+void VoxelGridDownsampler::dispatch(Stage i_stage)
+{
+    m_stage = i_stage;
+    // run all partitions here if there are too few points to wake workers up
+    m_pool.run(boost::bind(&VoxelGridDownsampler::run, this, _1),
+               m_npoints >= (unsigned int)m_nthreads);
+}
+
+void VoxelGridDownsampler::computeKeys(int i_part)
+{
+    unsigned int begin = (unsigned long long)m_npoints*i_part/m_nthreads;
+    unsigned int end = (unsigned long long)m_npoints*(i_part+1)/m_nthreads;
+    const float limit = INDEX_OFFSET - 1;
+    const float inv = m_invSize;
+    const unsigned int nparts = m_nthreads;
+    unsigned int *counts = &m_counts[i_part*nparts];
+    for (unsigned int i=0; i<nparts; i++) counts[i] = 0;
+    const unsigned char *ptr = m_points + (size_t)begin*m_pointStep;
+    for (unsigned int i=begin; i<end; i++, ptr+=m_pointStep){
+        const float *p = (const float *)ptr;
+        float fx = p[0]*inv, fy = p[1]*inv, fz = p[2]*inv;
+        // comparisons with NaN are false, so NaNs are rejected here too
+        if (!(fabsf(fx) < limit && fabsf(fy) < limit && fabsf(fz) < limit)){
+            m_keys[i] = INVALID_KEY;
+            continue;
+        }
+        unsigned long long ix = (long long)floorf(fx) + INDEX_OFFSET;
+        unsigned long long iy = (long long)floorf(fy) + INDEX_OFFSET;
+        unsigned long long iz = (long long)floorf(fz) + INDEX_OFFSET;
+        m_keys[i] = (ix << (2*INDEX_BITS)) | (iy << INDEX_BITS) | iz;
+        counts[partitionOf(hashKey(m_keys[i]), nparts)]++;
+    }
+}
+
+void VoxelGridDownsampler::scatter(int i_part)
+{
+    // points of partition p from chunk c are placed after those of
+    // partitions before p and those of p from chunks before c, so each
+    // partition keeps the order of points
+    const unsigned int nparts = m_nthreads;
+    unsigned int *offsets = &m_counts[nparts*nparts + i_part*nparts];
+    unsigned int base = 0;
+    for (unsigned int p=0; p<nparts; p++){
+        unsigned int total = 0;
+        offsets[p] = base;
+        for (unsigned int c=0; c<nparts; c++){
+            unsigned int n = m_counts[c*nparts + p];
+            if (c < (unsigned int)i_part) offsets[p] += n;
+            total += n;
+        }
+        if (p == (unsigned int)i_part){
+            m_parts[p].begin = base;
+            m_parts[p].end = base + total;
+        }
+        base += total;
+    }
+    unsigned int begin = (unsigned long long)m_npoints*i_part/m_nthreads;
+    unsigned int end = (unsigned long long)m_npoints*(i_part+1)/m_nthreads;
+    for (unsigned int i=begin; i<end; i++){
+        unsigned long long key = m_keys[i];
+        if (key == INVALID_KEY) continue;
+        m_order[offsets[partitionOf(hashKey(key), nparts)]++] = i;
+    }
+}
+
+void VoxelGridDownsampler::grow(Partition& io_part)
+{
+    std::vector<Voxel> table(io_part.table.size()
+                             ? io_part.table.size()*2 : MIN_TABLE_SIZE);
+    for (unsigned int i=0; i<table.size(); i++) table[i].stamp = 0;
+    unsigned int mask = table.size() - 1;
+    for (unsigned int i=0; i<io_part.table.size(); i++){
+        const Voxel& v = io_part.table[i];
+        if (v.stamp != m_stamp) continue;
+        unsigned int s = slotOf(hashKey(v.key)) & mask;
+        while (table[s].stamp == m_stamp) s = (s+1) & mask;
+        table[s] = v;
+    }
+    io_part.table.swap(table);
+    io_part.mask = mask;
+}
+
+void VoxelGridDownsampler::accumulate(int i_part)
+{
+    Partition& part = m_parts[i_part];
+    part.nvoxel = 0;
+    if (part.table.empty()) grow(part);
+    for (unsigned int j=part.begin; j<part.end; j++){
+        unsigned int i = m_order[j];
+        unsigned long long key = m_keys[i];
+        unsigned long long h = hashKey(key);
+        unsigned int s = slotOf(h) & part.mask;
+        Voxel *v;
+        while (1){
+            v = &part.table[s];
+            if (v->stamp != m_stamp){
+                // keep the load factor below 1/2
+                if ((part.nvoxel+1)*2 > part.table.size()){
+                    grow(part);
+                    s = slotOf(h) & part.mask;
+                    continue;
+                }
+                v->key = key;
+                v->stamp = m_stamp;
+                v->count = 0;
+                v->x = v->y = v->z = 0;
+                v->r = v->g = v->b = 0;
+                part.nvoxel++;
+                break;
+            }
+            if (v->key == key) break;
+            s = (s+1) & part.mask;
+        }
+        const unsigned char *ptr = m_points + (size_t)i*m_pointStep;
+        const float *p = (const float *)ptr;
+        v->count++;
+        v->x += p[0]; v->y += p[1]; v->z += p[2];
+        if (m_colored){
+            const unsigned char *rgb = ptr + 12;
+            v->r += rgb[0]; v->g += rgb[1]; v->b += rgb[2];
+        }
+    }
+}
+
+void VoxelGridDownsampler::emit(int i_part)
+{
+    unsigned int offset = 0;
+    for (int i=0; i<i_part; i++) offset += m_parts[i].nvoxel;
+    float *ptr = m_output + offset*4;
+    const Partition& part = m_parts[i_part];
+    for (unsigned int i=0; i<part.table.size(); i++){
+        const Voxel& v = part.table[i];
+        if (v.stamp != m_stamp) continue;
+        float inv = 1.0f/v.count;
+        ptr[0] = v.x*inv; ptr[1] = v.y*inv; ptr[2] = v.z*inv;
+        ptr[3] = 0;
+        if (m_colored){
+            unsigned char *rgb = (unsigned char *)(ptr+3);
+            rgb[0] = v.r/v.count; rgb[1] = v.g/v.count; rgb[2] = v.b/v.count;
+        }
+        ptr += 4;
+    }
+}
+
+unsigned int VoxelGridDownsampler::filter(const unsigned char *i_points,
+                                          unsigned int i_npoints,
+                                          unsigned int i_pointStep,
+                                          bool i_colored, float *o_points)
+{
+    if (!i_npoints) return 0;
+    m_points = i_points;
+    m_npoints = i_npoints;
+    m_pointStep = i_pointStep;
+    m_colored = i_colored;
+    m_output = o_points;
+    m_keys.resize(i_npoints);
+    m_order.resize(i_npoints);
+    // counts of points and then offsets of them per chunk and partition
+    m_counts.resize(2*m_nthreads*m_nthreads);
+    if (++m_stamp == 0){
+        // stamps wrapped around, forget all voxels
+        for (unsigned int i=0; i<m_parts.size(); i++){
+            std::vector<Voxel>& table = m_parts[i].table;
+            for (unsigned int j=0; j<table.size(); j++) table[j].stamp = 0;
+        }
+        m_stamp = 1;
+    }
+
+    dispatch(KEYS);
+    dispatch(SCATTER);
+    dispatch(ACCUMULATE);
+    dispatch(EMIT);
+
+    unsigned int total = 0;
+    for (int i=0; i<m_nthreads; i++) total += m_parts[i].nvoxel;
+    return total;
+}
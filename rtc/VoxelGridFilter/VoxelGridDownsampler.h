@@ -0,0 +1,94 @@
+// -*- C++ -*-
+/*!
+ * @file  VoxelGridDownsampler.h
+ * @brief voxel grid downsampler based on a reusable voxel hash
+ */
+#ifndef VOXEL_GRID_DOWNSAMPLER_H
+#define VOXEL_GRID_DOWNSAMPLER_H
+
+#include <vector>
+#include "util/WorkerPool.h"
+
+/**
+   \brief replace points in each voxel with their centroid
+
+   Points are 16 byte or larger records which start with float x, y and z.
+   When colored, r, g and b are unsigned char at offset 12, 13 and 14 and
+   they are averaged as well. Points with NaN or too large coordinates are
+   skipped.
+
+   Voxel keys are computed over chunks of points and the points are sorted
+   by partitions of the key space. The voxels of each partition are
+   accumulated in an open addressing hash table from the points of that
+   partition only. So every stage runs in parallel without locks and each
+   point is visited once per stage. Tables and buffers are kept across calls and
+   only grow, so no allocation occurs in steady state.
+ */
+class VoxelGridDownsampler
+{
+public:
+    VoxelGridDownsampler();
+    /**
+       \brief set the edge length of voxels
+       \param i_size edge length[m]
+     */
+    void setLeafSize(double i_size);
+    /**
+       \brief set the number of threads including the calling thread
+     */
+    void setNumThreads(int i_nthreads);
+    int numThreads() const { return m_nthreads; }
+    /**
+       \brief downsample points
+       \param i_points input points
+       \param i_npoints the number of input points
+       \param i_pointStep size of an input point[byte]
+       \param i_colored average rgb if true
+       \param o_points output buffer for 16 byte points. It must be able to
+       store i_npoints points
+       \return the number of output points
+     */
+    unsigned int filter(const unsigned char *i_points, unsigned int i_npoints,
+                        unsigned int i_pointStep, bool i_colored,
+                        float *o_points);
+private:
+    enum Stage { KEYS, SCATTER, ACCUMULATE, EMIT };
+    struct Voxel {
+        unsigned long long key;
+        unsigned int stamp, count;
+        float x, y, z;
+        unsigned int r, g, b;
+    };
+    struct Partition {
+        Partition() : mask(0), nvoxel(0), begin(0), end(0) {}
+        std::vector<Voxel> table;
+        unsigned int mask, nvoxel;
+        unsigned int begin, end; ///< range of points in m_order
+    };
+    void run(int i_part);
+    void dispatch(Stage i_stage);
+    void computeKeys(int i_part);
+    void scatter(int i_part);
+    void accumulate(int i_part);
+    void emit(int i_part);
+    void grow(Partition& io_part);
+
+    double m_invSize;
+    int m_nthreads;
+    unsigned int m_stamp;
+    std::vector<unsigned long long> m_keys;
+    std::vector<unsigned int> m_order;  ///< indices of points sorted by partition
+    std::vector<unsigned int> m_counts; ///< points per chunk and partition
+    std::vector<Partition> m_parts;
+
+    // arguments of the current call and the current stage
+    const unsigned char *m_points;
+    unsigned int m_npoints, m_pointStep;
+    bool m_colored;
+    float *m_output;
+    Stage m_stage;
+
+    WorkerPool m_pool;
+};
+
+#endif // VOXEL_GRID_DOWNSAMPLER_H
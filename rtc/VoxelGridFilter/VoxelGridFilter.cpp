@@ -12,6 +12,8 @@
 #include <pcl/filters/voxel_grid.h>
 #include "VoxelGridFilter.h"
 #include "pointcloud.hh"
+#include <cstring>
+#include "util/PCLUtil.h"
 
 // Module specification
 // <rtc-template block="module_spec">
@@ -29,6 +31,9 @@ static const char* spec[] =
     "lang_type",         "compile",
     // Configuration variables
     "conf.default.size", "0.01",
+    "conf.default.usePCL", "1",
+    "conf.default.threads", "1",
+    "conf.default.debugLevel", "0",
 
     ""
   };
@@ -40,7 +45,10 @@ VoxelGridFilter::VoxelGridFilter(RTC::Manager* manager)
     m_originalIn("original", m_original),
     m_filteredOut("filtered", m_filtered),
     // </rtc-template>
-    dummy(0)
+    m_cloud(new pcl::PointCloud<pcl::PointXYZ>),
+    m_cloudFiltered(new pcl::PointCloud<pcl::PointXYZ>),
+    dummy(0),
+    m_npoints(0), m_elapsed(0), m_tReport(0)
 {
 }
 
@@ -56,6 +64,9 @@ RTC::ReturnCode_t VoxelGridFilter::onInitialize()
   // <rtc-template block="bind_config">
   // Bind variables and configuration variable
   bindParameter("size", m_size, "0.01");
+  bindParameter("usePCL", m_usePCL, "1");
+  bindParameter("threads", m_threads, "1");
+  bindParameter("debugLevel", m_debugLevel, "0");
   
   // </rtc-template>
 
@@ -78,23 +89,7 @@ RTC::ReturnCode_t VoxelGridFilter::onInitialize()
   RTC::Properties& prop = getProperties();
 
   m_filtered.height = 1;
-  m_filtered.type = "xyz";
-  m_filtered.fields.length(3);
-  m_filtered.fields[0].name = "x";
-  m_filtered.fields[0].offset = 0;
-  m_filtered.fields[0].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[0].count = 4;
-  m_filtered.fields[1].name = "y";
-  m_filtered.fields[1].offset = 4;
-  m_filtered.fields[1].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[1].count = 4;
-  m_filtered.fields[2].name = "z";
-  m_filtered.fields[2].offset = 8;
-  m_filtered.fields[2].data_type = PointCloudTypes::FLOAT32;
-  m_filtered.fields[2].count = 4;
-  m_filtered.is_bigendian = false;
-  m_filtered.point_step = 16;
-  m_filtered.is_dense = true;
+  setupPointCloudFields(m_filtered);
 
   return RTC::RTC_OK;
 }
@@ -141,42 +136,81 @@ RTC::ReturnCode_t VoxelGridFilter::onExecute(RTC::UniqueId ec_id)
   if (m_originalIn.isNew()){
     m_originalIn.read();
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-
-    // RTM -> PCL
-    cloud->points.resize(m_original.width*m_original.height);
-    float *src = (float *)m_original.data.get_buffer();
-    for (int i=0; i<cloud->points.size(); i++){
-      cloud->points[i].x = src[0];
-      cloud->points[i].y = src[1];
-      cloud->points[i].z = src[2];
-      src += 4;
+    coil::TimeValue t1(coil::gettimeofday());
+    unsigned int npoint = m_original.point_step
+      ? m_original.data.length()/m_original.point_step : 0;
+    if (m_usePCL){
+      filterPCL();
+    }else{
+      filterNative(npoint);
     }
-    
-    // PCL Processing 
-    pcl::VoxelGrid<pcl::PointXYZ> sor;
-    sor.setInputCloud (cloud);
-    sor.setLeafSize(m_size, m_size, m_size);
-    sor.filter(*cloud_filtered);
-
-    // PCL -> RTM
-    m_filtered.width = cloud_filtered->points.size();
-    m_filtered.row_step = m_filtered.point_step*m_filtered.width;
-    m_filtered.data.length(m_filtered.height*m_filtered.row_step);
-    float *dst = (float *)m_filtered.data.get_buffer();
-    for (int i=0; i<cloud_filtered->points.size(); i++){
-      dst[0] = cloud_filtered->points[i].x;
-      dst[1] = cloud_filtered->points[i].y;
-      dst[2] = cloud_filtered->points[i].z;
-      dst += 4;
+    coil::TimeValue t2(coil::gettimeofday());
+
+    if (m_debugLevel > 0){
+      // report throughput averaged over about one second
+      coil::TimeValue dt = t2-t1;
+      m_npoints += npoint;
+      m_elapsed += dt.sec()+dt.usec()/1e6;
+      if ((double)t2 - m_tReport > 1.0 || m_debugLevel > 1){
+        m_tReport = (double)t2;
+        std::cout << m_profile.instance_name << ": "
+                  << npoint << " -> " << m_filtered.width << " points, "
+                  << m_npoints/m_elapsed << "[points/s]" << std::endl;
+        m_npoints = 0;
+        m_elapsed = 0;
+      }
     }
+
     m_filteredOut.write();
   }
 
   return RTC::RTC_OK;
 }
 
+void VoxelGridFilter::filterPCL()
+{
+  // clouds are reused to avoid allocation
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = m_cloud;
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered = m_cloudFiltered;
+
+  // RTM -> PCL
+  toPCL(m_original, *cloud);
+
+  // PCL Processing
+  pcl::VoxelGrid<pcl::PointXYZ> sor;
+  sor.setInputCloud (cloud);
+  sor.setLeafSize(m_size, m_size, m_size);
+  sor.filter(*cloud_filtered);
+
+  // PCL -> RTM
+  if (strcmp(m_filtered.type, "xyz") != 0) setupPointCloudFields(m_filtered);
+  wrapPCL(*cloud_filtered, m_filtered);
+}
+
+void VoxelGridFilter::filterNative(unsigned int i_npoint)
+{
+  bool colored = strcmp(m_original.type, "xyzrgb") == 0
+    && m_original.point_step >= 16;
+  if (strcmp(m_filtered.type, colored ? "xyzrgb" : "xyz") != 0){
+    setupPointCloudFields(m_filtered, colored);
+  }
+
+  // detach a buffer which was wrapped by wrapPCL() and make room for the
+  // worst case. The capacity is kept when the sequence is shrunk below.
+  if (!m_filtered.data.release()) m_filtered.data.replace(0, 0, NULL, false);
+  m_filtered.data.length(i_npoint*16);
+
+  m_downsampler.setLeafSize(m_size);
+  m_downsampler.setNumThreads(m_threads);
+  unsigned int n = m_downsampler.filter(m_original.data.get_buffer(), i_npoint,
+                                        m_original.point_step, colored,
+                                        (float *)m_filtered.data.get_buffer());
+  m_filtered.width = n;
+  m_filtered.height = 1;
+  m_filtered.row_step = m_filtered.point_step*n;
+  m_filtered.data.length(m_filtered.row_step);
+}
+
 /*
 RTC::ReturnCode_t VoxelGridFilter::onAborting(RTC::UniqueId ec_id)
 {
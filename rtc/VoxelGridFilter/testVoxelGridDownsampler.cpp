@@ -0,0 +1,285 @@
+/* -*- coding:utf-8-unix; mode:c++; -*- */
+
+#include "VoxelGridDownsampler.h"
+/* samples */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sys/time.h>
+
+struct Centroid
+{
+    Centroid() : n(0) { for (int i=0; i<6; i++) sum[i] = 0; }
+    int n;
+    double sum[6];
+};
+
+class testVoxelGridDownsampler
+{
+protected:
+    double size; /* [m] */
+    unsigned int npoints;
+    int nthreads, nloop;
+    std::vector<float> input, output;
+    void gen_points (bool colored)
+    {
+        input.resize(npoints*4);
+        srand(0);
+        for (unsigned int i = 0; i < npoints; i++) {
+            float *p = &input[i*4];
+            for (int j = 0; j < 3; j++) p[j] = (rand()/(double)RAND_MAX-0.5)*2.0;
+            p[3] = 0;
+            if (colored) {
+                unsigned char *rgb = (unsigned char *)(p+3);
+                for (int j = 0; j < 3; j++) rgb[j] = rand()%256;
+            }
+        }
+    };
+    void add_point (std::vector<float>& io_points, float x, float y, float z)
+    {
+        io_points.push_back(x); io_points.push_back(y); io_points.push_back(z); io_points.push_back(0);
+    };
+    // downsampled points in a fixed order, since the order depends on threads
+    std::vector<std::vector<float> > sorted (VoxelGridDownsampler& filter, const std::vector<float>& points, bool colored)
+    {
+        std::vector<float> out(points.size());
+        unsigned int n = points.empty() ? 0 : filter.filter((const unsigned char *)&points[0], points.size()/4, 16, colored, &out[0]);
+        std::vector<std::vector<float> > ret(n);
+        for (unsigned int i = 0; i < n; i++) ret[i].assign(&out[i*4], &out[i*4] + 4);
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    };
+    // reference implementation
+    std::map<std::vector<int>, Centroid> reference (bool colored)
+    {
+        std::map<std::vector<int>, Centroid> voxels;
+        for (unsigned int i = 0; i < npoints; i++) {
+            const float *p = &input[i*4];
+            if (std::isnan(p[0]) || std::isnan(p[1]) || std::isnan(p[2])) continue;
+            std::vector<int> key(3);
+            for (int j = 0; j < 3; j++) key[j] = (int)floorf(p[j]*(float)(1.0/size));
+            Centroid& c = voxels[key];
+            c.n++;
+            for (int j = 0; j < 3; j++) c.sum[j] += p[j];
+            if (colored) {
+                const unsigned char *rgb = (const unsigned char *)(p+3);
+                for (int j = 0; j < 3; j++) c.sum[3+j] += rgb[j];
+            }
+        }
+        return voxels;
+    };
+    bool check (bool colored)
+    {
+        gen_points(colored);
+        output.resize(npoints*4);
+        VoxelGridDownsampler filter;
+        filter.setLeafSize(size);
+        filter.setNumThreads(nthreads);
+        unsigned int n = 0;
+        struct timeval t1, t2;
+        gettimeofday(&t1, NULL);
+        for (int i = 0; i < nloop; i++) {
+            n = filter.filter((const unsigned char *)&input[0], npoints, 16, colored, &output[0]);
+        }
+        gettimeofday(&t2, NULL);
+        double dt = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec)/1e6;
+        std::cerr << "[testVoxelGridDownsampler]   " << npoints << " -> " << n << " points, "
+                  << npoints*nloop/dt << " [points/s]" << std::endl;
+
+        std::map<std::vector<int>, Centroid> voxels = reference(colored);
+        bool ret = (n == voxels.size());
+        if (!ret) std::cerr << "[testVoxelGridDownsampler]   expected " << voxels.size() << " points" << std::endl;
+        std::map<std::vector<int>, int> found;
+        for (unsigned int i = 0; i < n && ret; i++) {
+            const float *p = &output[i*4];
+            std::vector<int> key(3);
+            for (int j = 0; j < 3; j++) key[j] = (int)floorf(p[j]*(float)(1.0/size));
+            std::map<std::vector<int>, Centroid>::iterator it = voxels.find(key);
+            if (it == voxels.end() || found[key]++) {
+                std::cerr << "[testVoxelGridDownsampler]   unexpected voxel at " << p[0] << " " << p[1] << " " << p[2] << std::endl;
+                ret = false;
+                break;
+            }
+            const Centroid& c = it->second;
+            for (int j = 0; j < 3; j++) {
+                if (fabs(p[j] - c.sum[j]/c.n) > 1e-5) {
+                    std::cerr << "[testVoxelGridDownsampler]   centroid mismatch" << std::endl;
+                    ret = false;
+                }
+            }
+            if (colored) {
+                const unsigned char *rgb = (const unsigned char *)(p+3);
+                for (int j = 0; j < 3; j++) {
+                    if (rgb[j] != (unsigned char)((unsigned int)c.sum[3+j]/c.n)) {
+                        std::cerr << "[testVoxelGridDownsampler]   color mismatch" << std::endl;
+                        ret = false;
+                    }
+                }
+            }
+        }
+        return ret;
+    };
+public:
+    std::vector<std::string> arg_strs;
+    testVoxelGridDownsampler () : size(0.05), npoints(200000), nthreads(1), nloop(10) {};
+    bool test0 ()
+    {
+        std::cerr << "test0 : xyz" << std::endl;
+        parse_params();
+        return check(false);
+    };
+    bool test1 ()
+    {
+        std::cerr << "test1 : xyzrgb" << std::endl;
+        parse_params();
+        return check(true);
+    };
+    bool test2 ()
+    {
+        std::cerr << "test2 : borders of voxels and invalid points" << std::endl;
+        parse_params();
+        VoxelGridDownsampler filter;
+        filter.setLeafSize(size);
+        std::vector<float> points;
+        // corners of the voxel at the origin
+        add_point(points, 0, 0, 0);
+        add_point(points, size*0.99, size*0.99, size*0.99);
+        // voxels below zero are floored, not truncated
+        add_point(points, -size*0.01, 0, 0);
+        add_point(points, size*1.01, 0, 0);
+        // too large or NaN
+        float nan = std::numeric_limits<float>::quiet_NaN();
+        add_point(points, 1e7, 0, 0);
+        add_point(points, 0, -1e7, 0);
+        add_point(points, nan, 0, 0);
+        add_point(points, 0, 0, nan);
+        std::vector<std::vector<float> > out = sorted(filter, points, false);
+        double expected[3][3] = {{-size*0.01, 0, 0}, {size*0.495, size*0.495, size*0.495}, {size*1.01, 0, 0}};
+        if (out.size() != 3) {
+            std::cerr << "[testVoxelGridDownsampler]   " << out.size() << " points" << std::endl;
+            return false;
+        }
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                if (fabs(out[i][j] - expected[i][j]) > 1e-6) {
+                    std::cerr << "[testVoxelGridDownsampler]   unexpected point " << out[i][0] << " " << out[i][1] << " " << out[i][2] << std::endl;
+                    return false;
+                }
+            }
+        }
+        // no point is valid
+        points.erase(points.begin(), points.begin() + 16);
+        if (!sorted(filter, points, false).empty()) return false;
+        points.clear();
+        return sorted(filter, points, false).empty();
+    };
+    bool test3 ()
+    {
+        std::cerr << "test3 : voxels of the last frame" << std::endl;
+        parse_params();
+        gen_points(false);
+        VoxelGridDownsampler filter;
+        filter.setLeafSize(size);
+        filter.setNumThreads(nthreads);
+        std::vector<std::vector<float> > out1 = sorted(filter, input, false);
+        // voxels of the last frame don't remain in tables
+        std::vector<float> points;
+        for (int i = 0; i < 10; i++) add_point(points, size*(0.1 + (i%2)*2), 0, 0);
+        std::vector<std::vector<float> > out2 = sorted(filter, points, false);
+        if (out2.size() != 2) {
+            std::cerr << "[testVoxelGridDownsampler]   " << out2.size() << " voxels remain" << std::endl;
+            return false;
+        }
+        // tables grow from the small frame again, and are rebuilt when
+        // the number of threads changes
+        if (sorted(filter, input, false) != out1) return false;
+        filter.setNumThreads(nthreads + 2);
+        if (sorted(filter, input, false) != out1) {
+            std::cerr << "[testVoxelGridDownsampler]   results differ after threads are changed" << std::endl;
+            return false;
+        }
+        return true;
+    };
+    bool test4 ()
+    {
+        std::cerr << "test4 : partitions of voxels" << std::endl;
+        parse_params();
+        gen_points(true);
+        VoxelGridDownsampler filter;
+        filter.setLeafSize(size);
+        std::vector<std::vector<float> > out1 = sorted(filter, input, true);
+        std::vector<float> points(input.begin(), input.begin() + 8);
+        std::vector<std::vector<float> > few1 = sorted(filter, points, true);
+        for (int i = 2; i <= 6; i++) {
+            filter.setNumThreads(i);
+            // fewer points than threads are processed by the calling thread
+            if (sorted(filter, input, true) != out1 || sorted(filter, points, true) != few1) {
+                std::cerr << "[testVoxelGridDownsampler]   results differ with " << i << " threads" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    };
+    void parse_params ()
+    {
+      for (unsigned int i = 0; i < arg_strs.size(); ++ i) {
+          if ( arg_strs[i]== "--size" ) {
+              if (++i < arg_strs.size()) size = atof(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--points" ) {
+              if (++i < arg_strs.size()) npoints = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--threads" ) {
+              if (++i < arg_strs.size()) nthreads = atoi(arg_strs[i].c_str());
+          } else if ( arg_strs[i]== "--loop" ) {
+              if (++i < arg_strs.size()) nloop = atoi(arg_strs[i].c_str());
+          }
+      }
+      std::cerr << "[testVoxelGridDownsampler] params" << std::endl;
+      std::cerr << "[testVoxelGridDownsampler]   size = " << size << "[m], points = " << npoints << ", threads = " << nthreads << std::endl;
+    };
+};
+
+void print_usage ()
+{
+    std::cerr << "Usage : testVoxelGridDownsampler [option]" << std::endl;
+    std::cerr << " [option] should be:" << std::endl;
+    std::cerr << "  --test0 : xyz" << std::endl;
+    std::cerr << "  --test1 : xyzrgb" << std::endl;
+    std::cerr << "  --test2 : borders of voxels and invalid points" << std::endl;
+    std::cerr << "  --test3 : voxels of the last frame" << std::endl;
+    std::cerr << "  --test4 : partitions of voxels" << std::endl;
+};
+
+int main(int argc, char* argv[])
+{
+    int ret = 0;
+    if (argc >= 2) {
+        testVoxelGridDownsampler tvgd;
+        for (int i = 1; i < argc; ++ i) {
+            tvgd.arg_strs.push_back(std::string(argv[i]));
+        }
+        if (std::string(argv[1]) == "--test0") {
+            if (!tvgd.test0()) ret = 1;
+        } else if (std::string(argv[1]) == "--test1") {
+            if (!tvgd.test1()) ret = 1;
+        } else if (std::string(argv[1]) == "--test2") {
+            if (!tvgd.test2()) ret = 1;
+        } else if (std::string(argv[1]) == "--test3") {
+            if (!tvgd.test3()) ret = 1;
+        } else if (std::string(argv[1]) == "--test4") {
+            if (!tvgd.test4()) ret = 1;
+        } else {
+            print_usage();
+            ret = 1;
+        }
+    } else {
+        print_usage();
+        ret = 1;
+    }
+    return ret;
+}
@@ -9,7 +9,8 @@ Monitor::Monitor(CORBA::ORB_var orb, const std::string &i_hostname,
     m_rhCompName("RobotHardware0"),
     m_shCompName("StateHolder0"),
     m_interval(i_interval),
-    m_log(i_log)
+    m_log(i_log),
+    m_rhGeneration(0), m_shGeneration(0)
 {
     char buf[128];
     try {
@@ -30,6 +31,8 @@ bool Monitor::oneStep()
     static long long loop = 0;
     ThreadedObject::oneStep();
 
+    if (!m_rhTelemetrySource.empty()) return oneStepTelemetry();
+
     // RobotHardwareService
     if (CORBA::is_nil(m_rhService)){
         try{
@@ -111,8 +114,152 @@ bool Monitor::oneStep()
     return true;
 }
 
+namespace {
+    enum { ANGLE, COMMAND, TORQUE, SERVO_STATE, RATE_GYRO, ACCEL, FORCE,
+           POWER, NSTATE_FIELDS };
+    const char *stateFields[] = {"angle", "command", "torque", "servoState",
+                                 "rateGyro", "accel", "force", "power"};
+    enum { JOINT_REFS, BASE_TRANSFORM, ZMP, NCOMMAND_FIELDS };
+    const char *commandFields[] = {"jointRefs", "baseTransform", "zmp"};
+
+    // look up fields only when the layout of the stream has changed
+    bool resolve(const TelemetrySubscriber& tlm, const char **names,
+                 unsigned int n, unsigned int& io_generation,
+                 std::vector<int>& o_fields)
+    {
+        if (o_fields.size() == n && io_generation == tlm.generation()){
+            return false;
+        }
+        io_generation = tlm.generation();
+        o_fields.resize(n);
+        for (unsigned int i=0; i<n; i++) o_fields[i] = tlm.findField(names[i]);
+        return true;
+    }
+
+    unsigned int count(const TelemetrySubscriber& tlm, int f)
+    {
+        return f < 0 ? 0 : tlm.count(f);
+    }
+
+    template<class T>
+    void copy(const TelemetrySubscriber& tlm, int f, T& seq)
+    {
+        if (seq.length()){
+            memcpy(seq.get_buffer(), tlm.doubles(f), sizeof(double)*seq.length());
+        }
+    }
+
+    template<class T>
+    void resizeVectors(const TelemetrySubscriber& tlm, int f, unsigned int dim,
+                       T& seq)
+    {
+        seq.length(count(tlm, f)/dim);
+        for (unsigned int i=0; i<seq.length(); i++) seq[i].length(dim);
+    }
+
+    template<class T>
+    void copyVectors(const TelemetrySubscriber& tlm, int f, T& seq)
+    {
+        if (!seq.length()) return;
+        const double *v = tlm.doubles(f);
+        for (unsigned int i=0; i<seq.length(); i++){
+            memcpy(seq[i].get_buffer(), v, sizeof(double)*seq[i].length());
+            v += seq[i].length();
+        }
+    }
+
+    void resizeState(const TelemetrySubscriber& tlm, const std::vector<int>& f,
+                     OpenHRP::RobotHardwareService::RobotState& rs)
+    {
+        rs.angle.length(count(tlm, f[ANGLE]));
+        rs.command.length(count(tlm, f[COMMAND]));
+        rs.torque.length(count(tlm, f[TORQUE]));
+        resizeVectors(tlm, f[SERVO_STATE], 1, rs.servoState);
+        resizeVectors(tlm, f[RATE_GYRO], 3, rs.rateGyro);
+        resizeVectors(tlm, f[ACCEL], 3, rs.accel);
+        resizeVectors(tlm, f[FORCE], 6, rs.force);
+    }
+
+    void readState(const TelemetrySubscriber& tlm, const std::vector<int>& f,
+                   OpenHRP::RobotHardwareService::RobotState& rs)
+    {
+        copy(tlm, f[ANGLE], rs.angle);
+        copy(tlm, f[COMMAND], rs.command);
+        copy(tlm, f[TORQUE], rs.torque);
+        if (rs.servoState.length()){
+            const int32_t *s = tlm.ints(f[SERVO_STATE]);
+            for (unsigned int i=0; i<rs.servoState.length(); i++){
+                rs.servoState[i][0] = s[i];
+            }
+        }
+        copyVectors(tlm, f[RATE_GYRO], rs.rateGyro);
+        copyVectors(tlm, f[ACCEL], rs.accel);
+        copyVectors(tlm, f[FORCE], rs.force);
+        if (count(tlm, f[POWER]) == 2){
+            const double *v = tlm.doubles(f[POWER]);
+            rs.voltage = v[0];
+            rs.current = v[1];
+        }
+    }
+
+    void resizeCommand(const TelemetrySubscriber& tlm, const std::vector<int>& f,
+                       OpenHRP::StateHolderService::Command& com)
+    {
+        com.jointRefs.length(count(tlm, f[JOINT_REFS]));
+        com.baseTransform.length(count(tlm, f[BASE_TRANSFORM]));
+        com.zmp.length(count(tlm, f[ZMP]));
+    }
+
+    void readCommand(const TelemetrySubscriber& tlm, const std::vector<int>& f,
+                     OpenHRP::StateHolderService::Command& com)
+    {
+        copy(tlm, f[JOINT_REFS], com.jointRefs);
+        copy(tlm, f[BASE_TRANSFORM], com.baseTransform);
+        copy(tlm, f[ZMP], com.zmp);
+    }
+}
+
+bool Monitor::oneStepTelemetry()
+{
+    static long long loop = 0;
+
+    if (!m_rhTelemetry.isOpen() && !m_rhTelemetry.open(m_rhTelemetrySource)){
+        if ( (loop%(5*(1000/m_interval))) == 0 )
+            std::cerr << "[monitor] telemetry of RobotHardware is not found (" << m_rhTelemetrySource << ")" << std::endl;
+    }
+    if (!m_shTelemetrySource.empty() && !m_shTelemetry.isOpen()
+        && !m_shTelemetry.open(m_shTelemetrySource)){
+        if ( (loop%(5*(1000/m_interval))) == 0 )
+            std::cerr << "[monitor] telemetry of StateHolder is not found (" << m_shTelemetrySource << ")" << std::endl;
+    }
+
+    // only the latest records are shown and logged at the interval of
+    // the monitor, as done with services
+    if (m_shTelemetry.isOpen() && m_shTelemetry.latest()){
+        if (resolve(m_shTelemetry, commandFields, NCOMMAND_FIELDS,
+                    m_shGeneration, m_shFields)){
+            resizeCommand(m_shTelemetry, m_shFields, m_rstate.command);
+        }
+        readCommand(m_shTelemetry, m_shFields, m_rstate.command);
+    }
+    if (m_rhTelemetry.isOpen() && m_rhTelemetry.latest()){
+        if (resolve(m_rhTelemetry, stateFields, NSTATE_FIELDS,
+                    m_rhGeneration, m_rhFields)){
+            resizeState(m_rhTelemetry, m_rhFields, m_rstate.state);
+        }
+        readState(m_rhTelemetry, m_rhFields, m_rstate.state);
+        m_rstate.time = m_rhTelemetry.time();
+        m_log->add(m_rstate);
+    }
+    usleep(1000*m_interval);
+    loop ++;
+
+    return true;
+}
+
 bool Monitor::isConnected()
 {
+    if (!m_rhTelemetrySource.empty()) return m_rhTelemetry.isOpen();
     return !CORBA::is_nil(m_rhService);
 }
 
@@ -284,3 +431,9 @@ void Monitor::setStateHolderName(const char *i_name)
 {
     m_shCompName = i_name;
 }
+
+void Monitor::setTelemetry(const char *i_rhSource, const char *i_shSource)
+{
+    m_rhTelemetrySource = i_rhSource;
+    m_shTelemetrySource = i_shSource ? i_shSource : "";
+}
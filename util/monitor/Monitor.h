@@ -1,6 +1,8 @@
 #include <string>
+#include <vector>
 #include "util/ThreadedObject.h"
 #include "util/LogManager.h"
+#include "util/Telemetry.h"
 #include "StateHolderService.hh"
 #include "TimedRobotState.h"
 #include "hrpModel/Body.h"
@@ -15,7 +17,15 @@ public:
     bool isConnected();
     void setRobotHardwareName(const char *i_name);
     void setStateHolderName(const char *i_name);
+    /**
+       \brief read telemetry streams instead of calling services
+       \param i_rhSource source of the stream of RobotHardware
+       \param i_shSource source of the stream of StateHolder, can be NULL
+     */
+    void setTelemetry(const char *i_rhSource, const char *i_shSource);
 private:
+    bool oneStepTelemetry();
+
     CORBA::ORB_var m_orb;
     CosNaming::NamingContext_var m_naming;
     std::string m_rhCompName, m_shCompName;
@@ -24,6 +34,10 @@ private:
     TimedRobotState m_rstate;
     LogManager<TimedRobotState> *m_log;
     int m_interval;
+    std::string m_rhTelemetrySource, m_shTelemetrySource;
+    TelemetrySubscriber m_rhTelemetry, m_shTelemetry;
+    unsigned int m_rhGeneration, m_shGeneration; ///< layouts of fields below
+    std::vector<int> m_rhFields, m_shFields;     ///< indices of fields
 
     void white()  { fprintf(stdout, "\x1b[37m");}
     void red()    { fprintf(stdout, "\x1b[31m");}
@@ -44,7 +44,7 @@ hrp::BodyPtr createBody(const std::string& name, const ModelItem& mitem,
 int main(int argc, char* argv[]) 
 {
     if (argc < 2){
-        std::cerr << "Usage:" << argv[0] << " project.xml [-rh RobotHardwareComponent] [-sh StateHolder component] [-size size] [-bg r g b] [-host localhost] [-port 2809] [-interval 100] [-nogui]" << std::endl;
+        std::cerr << "Usage:" << argv[0] << " project.xml [-rh RobotHardwareComponent] [-sh StateHolder component] [-size size] [-bg r g b] [-host localhost] [-port 2809] [-interval 100] [-nogui] [-rhtelemetry name|group:port] [-shtelemetry name|group:port]" << std::endl;
         return 1;
     }
 
@@ -55,6 +55,7 @@ int main(int argc, char* argv[])
     }
 
     char *rhname = NULL, *shname = NULL, *hostname = NULL;
+    char *rhtelemetry = NULL, *shtelemetry = NULL;
     int wsize = 0, port=0, interval=0;
     float bgColor[] = {0,0,0};
     bool orbinitref = false, gui = true;
@@ -75,6 +76,10 @@ int main(int argc, char* argv[])
             port = atoi(argv[++i]);
         }else if(strcmp(argv[i], "-interval")==0){
             interval = atoi(argv[++i]);
+        }else if(strcmp(argv[i], "-rhtelemetry")==0){
+            rhtelemetry = argv[++i];
+        }else if(strcmp(argv[i], "-shtelemetry")==0){
+            shtelemetry = argv[++i];
         }else if(strcmp(argv[i], "-nogui")==0){
             gui = false;
         }else if(strcmp(argv[i], "-ORBInitRef")==0){
@@ -155,6 +160,10 @@ int main(int argc, char* argv[])
     }else{
         monitor.setStateHolderName(rhview.StateHolderName.c_str());
     }
+    if (rhtelemetry) {
+        std::cerr << "[monitor] Reading telemetry " << rhtelemetry << std::endl;
+        monitor.setTelemetry(rhtelemetry, shtelemetry);
+    }
     //==================== viewer ===============
     if ( gui ) {
         GLscene scene(&log);